@@ -52,7 +52,7 @@
 /* needed for writern and readn socket operations */
 #include "../Util/unp.h"
 
-/* needed for function getXMLMessageLen */
+/* needed for function getXMLMessageLen and the xml message structure */
 #include "../XML/xml.h"
 
 /* needed for malloc and free */
@@ -514,8 +514,8 @@ readMessage ( Chain_structp chain, int chain_stream )
 		}
 
 		// get the total length of the message
-		int msgLen = getXMLMessageLen(chain->UmsgHeaderBuf);
-		char *msg = malloc(msgLen);
+		int msgLen = getXMLMessageLen(chain->UmsgHeaderBuf, len);
+		XMLMessage msg = malloc(sizeof(struct XMLMessageStruct) + msgLen);
 		if (msg == NULL)
 		{
 			log_err("Read Update chain %d at %s port %d realloc failed", chain->chainID, chain->addr, chain->Uport);
@@ -523,20 +523,25 @@ readMessage ( Chain_structp chain, int chain_stream )
 		}	
 
 		// read the the message from socket.
-		len = readn(chain->Usocket, msg, msgLen); 
+		len = readn(chain->Usocket, msg->text, msgLen); 
 		// check something was read
 		if (len !=  msgLen )
 		{
 			log_err("Read Update chain %d at %s port %d expected %d bytes but read %d", chain->chainID, chain->addr, chain->Uport, msgLen, len);
+			free(msg);
 			return -1;
 		}
+		msg->length = msgLen;
 
 		//get BGPmon ID and sequence number of new message
 		u_int32_t msgID = -1;
 		u_int32_t msgSeq = -1;
-		if(getMsgIdSeq(msg,msgLen,&msgID,&msgSeq)){
+		if(getMsgIdSeq(msg->text,msgLen,&msgID,&msgSeq)){
 			if(msgLen > 0) writeQueue(chain->UxmlQueueWriter,msg);
-			else log_err("Chain %d attempted to parse an invalid/old message.", chain->chainID);
+			else {
+				log_err("Chain %d attempted to parse an invalid/old message.", chain->chainID);
+				free(msg);
+			}
 			return 0;
 		}
 
@@ -589,8 +594,8 @@ readMessage ( Chain_structp chain, int chain_stream )
 		}
 
 		// get the total length of the message
-		int msgLen = getXMLMessageLen(chain->RmsgHeaderBuf);
-		char *msg = malloc(msgLen);
+		int msgLen = getXMLMessageLen(chain->RmsgHeaderBuf, len);
+		XMLMessage msg = malloc(sizeof(struct XMLMessageStruct) + msgLen);
 		if (msg == NULL)
 		{
 			log_err("Read RIB chain %d at %s port %d realloc failed", chain->chainID, chain->addr, chain->Rport);
@@ -598,20 +603,25 @@ readMessage ( Chain_structp chain, int chain_stream )
 		}	
 
 		// read the the message from socket.
-		len = readn(chain->Rsocket, msg, msgLen); 
+		len = readn(chain->Rsocket, msg->text, msgLen); 
 		// check something was read
 		if (len !=  msgLen )
 		{
 			log_err("Read RIB chain %d at %s port %d expected %d bytes but read %d", chain->chainID, chain->addr, chain->Uport, msgLen, len);
+			free(msg);
 			return -1;
 		}
+		msg->length = msgLen;
 
 		//get BGPmon ID and sequence number of new message
 		u_int32_t msgID = -1;
 		u_int32_t msgSeq = -1;
-		if(getMsgIdSeq(msg,msgLen,&msgID,&msgSeq)){
+		if(getMsgIdSeq(msg->text,msgLen,&msgID,&msgSeq)){
 			if(msgLen > 0) writeQueue(chain->RxmlQueueWriter,msg);
-			else log_err("Chain %d attempted to parse an invalid/old message.", chain->chainID);
+			else {
+				log_err("Chain %d attempted to parse an invalid/old message.", chain->chainID);
+				free(msg);
+			}
 			return 0;
 		}
 
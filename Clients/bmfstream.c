@@ -0,0 +1,291 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: bmfstream.c
+ *  Date: Oct 18, 2026
+ */
+
+/*
+ * Encode the live messages for the binary clients, see bmfstream.h for the format
+ */
+
+/* the record format and the functions of this file */
+#include "bmfstream.h"
+/* needed for CLIENT_LISTENER_BINARY */
+#include "clients.h"
+/* needed for ClientControls.shutdown */
+#include "clientscontrol.h"
+
+/* required for logging functions */
+#include "../Util/log.h"
+/* needed for the label queue and the binary stream queue */
+#include "../Queues/queue.h"
+/* required for TRUE/FALSE defines  */
+#include "../Util/bgpmon_defaults.h"
+
+/* needed for malloc and free */
+#include <stdlib.h>
+/* needed for memcpy */
+#include <string.h>
+/* needed for htonl and ntohl */
+#include <netinet/in.h>
+/* needed for pthread related functions */
+#include <pthread.h>
+
+//#define DEBUG
+
+static pthread_t bmfStreamThreadID;
+
+// the thread waits here while no binary client is connected
+static pthread_mutex_t bmfStreamLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bmfStreamWake = PTHREAD_COND_INITIALIZER;
+
+static void
+put16(u_char *p, u_int16_t v)
+{
+	v = htons(v);
+	memcpy(p, &v, 2);
+}
+
+static void
+put32(u_char *p, u_int32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, 4);
+}
+
+static u_int16_t
+get16(u_char *p)
+{
+	u_int16_t v;
+	memcpy(&v, p, 2);
+	return ntohs(v);
+}
+
+static u_int32_t
+get32(u_char *p)
+{
+	u_int32_t v;
+	memcpy(&v, p, 4);
+	return ntohl(v);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the stream header a binary client gets first
+ * Input:  buf - the output, at least BMF_STREAM_HEADER_LEN bytes
+ * Output: the length of the header
+ * -------------------------------------------------------------------------------------*/
+int
+encodeBMFStreamHeader(u_char *buf)
+{
+	memcpy(buf, BMF_STREAM_MAGIC, 4);
+	put16(buf + 4, BMF_STREAM_VERSION);
+	put16(buf + 6, BMF_RECORD_HEADER_LEN);
+	return BMF_STREAM_HEADER_LEN;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Encode a BMF as a record of the binary stream
+ * Input:  bmf - the message
+ *         seq - the sequence number of the record
+ *         buf - the output
+ *         maxlen - the size of the output
+ * Output: the length of the record or -1 if it does not fit
+ * NOTE: only a labeled message has labels, they follow its BGP message in the BMF
+ * -------------------------------------------------------------------------------------*/
+int
+encodeBMFRecord(BMF bmf, u_int32_t seq, u_char *buf, int maxlen)
+{
+	int len = BMF_RECORD_HEADER_LEN + bmf->length;
+	int msgLen = bmf->length;
+	int bgpLen;
+
+	if ( len > maxlen )
+		return -1;
+
+	if ( bmf->type == BMF_TYPE_MSG_LABELED && bmf->length >= BGP_HEADER_LEN )
+	{
+		bgpLen = (bmf->message[16] << 8) | bmf->message[17];
+		if ( bgpLen >= BGP_HEADER_LEN && bgpLen <= bmf->length )
+			msgLen = bgpLen;
+	}
+
+	put32(buf, len - 4);
+	put32(buf + 4, seq);
+	put32(buf + 8, bmf->timestamp);
+	put32(buf + 12, bmf->precisiontime);
+	put16(buf + 16, bmf->sessionID);
+	put16(buf + 18, bmf->type);
+	put16(buf + 20, msgLen);
+	put16(buf + 22, bmf->length - msgLen);
+	memcpy(buf + BMF_RECORD_HEADER_LEN, bmf->message, bmf->length);
+	return len;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Decode a record of the binary stream, the reference decoder
+ * Input:  buf - the record, starting with its length
+ *         len - the number of bytes available at buf
+ *         rec - the decoded record
+ * Output: the length of the record, 0 if more bytes are needed, -1 if it is malformed
+ * NOTE: a client reads the stream header, then calls this on what it has read
+ *       and drops the returned number of bytes once it is done with the record
+ * -------------------------------------------------------------------------------------*/
+int
+decodeBMFRecord(u_char *buf, int len, BMFRecord *rec)
+{
+	u_int32_t recLen;
+
+	if ( len < 4 )
+		return 0;
+	recLen = get32(buf);
+	if ( recLen < BMF_RECORD_HEADER_LEN - 4 || recLen > BMF_RECORD_MAX_LEN )
+		return -1;
+	if ( len < recLen + 4 )
+		return 0;
+
+	rec->seq = get32(buf + 4);
+	rec->timestamp = get32(buf + 8);
+	rec->precisiontime = get32(buf + 12);
+	rec->sessionID = get16(buf + 16);
+	rec->type = get16(buf + 18);
+	rec->msgLen = get16(buf + 20);
+	rec->labelCount = get16(buf + 22);
+	if ( BMF_RECORD_HEADER_LEN + rec->msgLen + rec->labelCount > recLen + 4 )
+		return -1;
+	rec->msg = buf + BMF_RECORD_HEADER_LEN;
+	rec->labels = rec->msg + rec->msgLen;
+	return recLen + 4;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: The main function of the binary stream thread, it encodes the messages
+ *          of the label queue and writes them to the binary stream queue
+ * Input:  none
+ * Output: none
+ * NOTE: the thread only reads the label queue while a binary client is connected,
+ *       so the label queue does not copy its messages for nobody
+ * -------------------------------------------------------------------------------------*/
+static void *
+bmfStreamThread( void *arg )
+{
+	QueueWriter bmfStreamWriter = createQueueWriter( bmfStreamQueue );
+	QueueReader labeledQueueReader = NULL;
+	u_int32_t seq = 0;
+	u_char *record;
+	BMF bmf;
+
+	log_msg( "Binary stream thread started" );
+
+	while ( ClientControls.shutdown == FALSE )
+	{
+		// no binary client, leave the label queue until one connects
+		if ( getReaderCountForWriter( bmfStreamWriter ) == 0 )
+		{
+			if ( labeledQueueReader != NULL )
+			{
+				destroyQueueReader( labeledQueueReader );
+				labeledQueueReader = NULL;
+			}
+			pthread_mutex_lock( &bmfStreamLock );
+			while ( getReaderCountForWriter( bmfStreamWriter ) == 0 && ClientControls.shutdown == FALSE )
+				pthread_cond_wait( &bmfStreamWake, &bmfStreamLock );
+			pthread_mutex_unlock( &bmfStreamLock );
+			continue;
+		}
+		if ( labeledQueueReader == NULL )
+			labeledQueueReader = createQueueReader( &labeledQueue, 1 );
+
+		readQueue( labeledQueueReader );
+		bmf = (BMF)labeledQueueReader->items[0];
+		// a NULL item is only used to wake up the thread
+		if ( bmf == NULL )
+			continue;
+
+		record = malloc( BMF_RECORD_HEADER_LEN + bmf->length );
+		if ( record == NULL )
+			log_err( "bmfStreamThread: malloc failed" );
+		else
+		{
+			encodeBMFRecord( bmf, seq, record, BMF_RECORD_HEADER_LEN + bmf->length );
+			writeQueue( bmfStreamWriter, record );
+			seq++;
+		}
+		destroyBMF( bmf );
+	}
+
+	if ( labeledQueueReader != NULL )
+		destroyQueueReader( labeledQueueReader );
+	destroyQueueWriter( bmfStreamWriter );
+	log_warning( "Binary stream thread exiting" );
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: launch the thread encoding the live messages for the binary clients
+ * Input:  none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void
+launchBMFStreamThread()
+{
+	int error;
+
+	if ( (error = pthread_create(&bmfStreamThreadID, NULL, bmfStreamThread, NULL)) > 0 )
+		log_fatal( "Failed to create binary stream thread: %s\n", strerror(error) );
+
+#ifdef DEBUG
+	debug(__FUNCTION__, "Created binary stream thread!");
+#endif
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wake the binary stream thread, a client connected or BGPmon is closing
+ * Input:  none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void
+wakeBMFStreamThread()
+{
+	pthread_mutex_lock( &bmfStreamLock );
+	pthread_cond_broadcast( &bmfStreamWake );
+	pthread_mutex_unlock( &bmfStreamLock );
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wait for the binary stream thread to exit
+ * Input:  none
+ * Output: none
+ * NOTE: the thread may be reading the label queue, a NULL item wakes it up
+ * -------------------------------------------------------------------------------------*/
+void
+waitForBMFStreamShutdown()
+{
+	QueueWriter labeledQueueWriter = createQueueWriter( labeledQueue );
+	writeQueue( labeledQueueWriter, NULL );
+	destroyQueueWriter( labeledQueueWriter );
+	wakeBMFStreamThread();
+	pthread_join( bmfStreamThreadID, NULL );
+}
@@ -0,0 +1,131 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: bmfstream.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef BMFSTREAM_H_
+#define BMFSTREAM_H_
+
+/* needed for BMF */
+#include "../Util/bgpmon_formats.h"
+
+/*
+ * The binary stream of the live messages, for clients that want the BGP
+ * messages and labels BGPmon has without the xml around them.
+ *
+ * A connection starts with an 8 byte stream header:
+ *   0  4  magic "BMFS"
+ *   4  2  version of the record format, BMF_STREAM_VERSION
+ *   6  2  length of the record header, BMF_RECORD_HEADER_LEN
+ * followed by the records, one for each message of the label queue.
+ * All numbers are in network byte order.
+ *
+ * A record:
+ *   0  4  length of the record, not counting this field
+ *   4  4  sequence number, one more than the record before, wraps around;
+ *         a gap means the client was too slow and records were dropped
+ *   8  4  timestamp of the BMF
+ *  12  4  precision time of the BMF
+ *  16  2  session ID of the BMF
+ *  18  2  type of the BMF, see bgpmon_formats.h
+ *  20  2  message length n
+ *  22  2  label count m
+ *  24  n  the BGP message, with its 19 byte header; for the BMF types that
+ *         do not carry a BGP message, the BMF payload as it is
+ *  24+n m the labels of a BMF_TYPE_MSG_LABELED message, one byte for each
+ *         prefix in the order the prefixes appear in the message
+ * A reader should skip what follows the labels, later versions may add fields.
+ */
+#define BMF_STREAM_MAGIC	"BMFS"
+#define BMF_STREAM_VERSION	1
+#define BMF_STREAM_HEADER_LEN	8
+#define BMF_RECORD_HEADER_LEN	24
+#define BMF_RECORD_MAX_LEN	(BMF_RECORD_HEADER_LEN + BMF_MAX_MSG_LEN)
+
+/* a record decoded by decodeBMFRecord, the pointers are into the record */
+struct BMFRecordStruct
+{
+	u_int32_t	seq;
+	u_int32_t	timestamp;
+	u_int32_t	precisiontime;
+	u_int16_t	sessionID;
+	u_int16_t	type;
+	u_int16_t	msgLen;
+	u_int16_t	labelCount;
+	u_char		*msg;
+	u_char		*labels;
+};
+typedef struct BMFRecordStruct BMFRecord;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the stream header a binary client gets first
+ * Input:  buf - the output, at least BMF_STREAM_HEADER_LEN bytes
+ * Output: the length of the header
+ * -------------------------------------------------------------------------------------*/
+int encodeBMFStreamHeader(u_char *buf);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Encode a BMF as a record of the binary stream
+ * Input:  bmf - the message
+ *         seq - the sequence number of the record
+ *         buf - the output
+ *         maxlen - the size of the output
+ * Output: the length of the record or -1 if it does not fit
+ * -------------------------------------------------------------------------------------*/
+int encodeBMFRecord(BMF bmf, u_int32_t seq, u_char *buf, int maxlen);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Decode a record of the binary stream, the reference decoder
+ * Input:  buf - the record, starting with its length
+ *         len - the number of bytes available at buf
+ *         rec - the decoded record
+ * Output: the length of the record, 0 if more bytes are needed, -1 if it is malformed
+ * -------------------------------------------------------------------------------------*/
+int decodeBMFRecord(u_char *buf, int len, BMFRecord *rec);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: launch the thread encoding the live messages for the binary clients
+ * Input:  none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void launchBMFStreamThread();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wake the binary stream thread, a client connected or BGPmon is closing
+ * Input:  none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void wakeBMFStreamThread();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wait for the binary stream thread to exit
+ * Input:  none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void waitForBMFStreamShutdown();
+
+#endif /*BMFSTREAM_H_*/
@@ -0,0 +1,137 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: bmfstream_t.c
+ *  Date: Oct 18, 2026
+ */
+#include <CUnit/Basic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "bmfstream_t.h"
+
+#define TEST_SESSION_ID 7
+
+/* an UPDATE without routes, the labels follow it in a labeled BMF */
+static u_char update[] = {
+  0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,          // marker
+  0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+  0x00,0x17,0x02,                                   // length 23, UPDATE
+  0x00,0x00,0x00,0x00                               // no withdrawn routes or attributes
+};
+static u_char labels[] = { 0x01, 0x03 };
+
+/* the payload of a BMF type without a BGP message */
+static u_char status[] = { 0xde,0xad,0xbe,0xef,0x00 };
+
+static u_char record[BMF_RECORD_MAX_LEN];
+
+/* The suite initialization function.
+ * Returns zero on success, non-zero otherwise.
+ */
+int
+init_BMFStream(void)
+{
+  return 0;
+}
+
+/* The suite cleanup function.
+ * Returns zero on success, non-zero otherwise.
+ */
+int
+clean_BMFStream(void)
+{
+  return 0;
+}
+
+// a record decodes to the message it was encoded from
+void
+testBMFStream_roundTrip(void)
+{
+  BMFRecord rec;
+  BMF bmf;
+  int len;
+
+  CU_ASSERT(BMF_STREAM_HEADER_LEN == encodeBMFStreamHeader(record));
+  CU_ASSERT(0 == memcmp(record, BMF_STREAM_MAGIC, 4));
+
+  // a labeled message is split into the BGP message and its labels
+  bmf = createBMF(TEST_SESSION_ID, BMF_TYPE_MSG_LABELED);
+  bgpmonMessageAppend(bmf, update, sizeof(update));
+  bgpmonMessageAppend(bmf, labels, sizeof(labels));
+  len = encodeBMFRecord(bmf, 0xfffffffe, record, sizeof(record));
+  CU_ASSERT(BMF_RECORD_HEADER_LEN + sizeof(update) + sizeof(labels) == len);
+  CU_ASSERT(len == decodeBMFRecord(record, len, &rec));
+  CU_ASSERT(0xfffffffe == rec.seq);
+  CU_ASSERT(bmf->timestamp == rec.timestamp);
+  CU_ASSERT(bmf->precisiontime == rec.precisiontime);
+  CU_ASSERT(TEST_SESSION_ID == rec.sessionID);
+  CU_ASSERT(BMF_TYPE_MSG_LABELED == rec.type);
+  CU_ASSERT(sizeof(update) == rec.msgLen);
+  CU_ASSERT(0 == memcmp(rec.msg, update, sizeof(update)));
+  CU_ASSERT(sizeof(labels) == rec.labelCount);
+  CU_ASSERT(0 == memcmp(rec.labels, labels, sizeof(labels)));
+
+  // it does not fit a smaller buffer
+  CU_ASSERT(-1 == encodeBMFRecord(bmf, 0, record, len - 1));
+  destroyBMF(bmf);
+
+  // other types keep their payload as it is
+  bmf = createBMF(TEST_SESSION_ID, BMF_TYPE_SESSION_STATUS);
+  bgpmonMessageAppend(bmf, status, sizeof(status));
+  len = encodeBMFRecord(bmf, 1, record, sizeof(record));
+  CU_ASSERT(len == decodeBMFRecord(record, len, &rec));
+  CU_ASSERT(BMF_TYPE_SESSION_STATUS == rec.type);
+  CU_ASSERT(sizeof(status) == rec.msgLen);
+  CU_ASSERT(0 == rec.labelCount);
+  CU_ASSERT(0 == memcmp(rec.msg, status, sizeof(status)));
+  destroyBMF(bmf);
+}
+
+// the decoder waits for a full record and rejects a broken one
+void
+testBMFStream_partial(void)
+{
+  BMFRecord rec;
+  BMF bmf;
+  int len;
+
+  bmf = createBMF(TEST_SESSION_ID, BMF_TYPE_MSG_LABELED);
+  bgpmonMessageAppend(bmf, update, sizeof(update));
+  bgpmonMessageAppend(bmf, labels, sizeof(labels));
+  len = encodeBMFRecord(bmf, 2, record, sizeof(record));
+  destroyBMF(bmf);
+
+  CU_ASSERT(0 == decodeBMFRecord(record, 3, &rec));
+  CU_ASSERT(0 == decodeBMFRecord(record, len - 1, &rec));
+
+  // the message and labels claim more than the record has
+  record[23] = 0xff;
+  CU_ASSERT(-1 == decodeBMFRecord(record, len, &rec));
+
+  // a length no record can have
+  record[0] = 0xff;
+  CU_ASSERT(-1 == decodeBMFRecord(record, len, &rec));
+}
@@ -49,9 +49,17 @@
 /* needed for writen function  */
 #include "../Util/unp.h"
 
-/* needed for function getXMLMessageLen */
+/* needed for the xml message structure */
 #include "../XML/xml.h"
 
+/* needed for the stream header of a binary client */
+#include "bmfstream.h"
+
+/* needed for the rib snapshot of a new client */
+#include "../Labeling/label.h"
+#include "../Labeling/rtable.h"
+#include "../Peering/peersession.h"
+
 /* needed for malloc and free */
 #include <stdlib.h>
 /* needed for strncpy */
@@ -170,6 +178,49 @@ getActiveClientsIDs(long **clientIDs, int client_listener)
 
 		return i;
 	}		
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		// lock the client list
+		if ( pthread_mutex_lock( &(ClientControls.clientBLock ) ) )
+			log_fatal("lock client list failed");
+
+		// allocate an array whose size depends on the active clients
+		long *IDs = malloc(sizeof(long)*ClientControls.activeBClients);
+		if (IDs == NULL) 
+		{
+			log_err("Failed to allocate memory for getActiveClientIDs");
+			*clientIDs = NULL; 
+			return -1;
+		}
+
+		// for each active client, add its ID to the array
+		ClientNode *cn = ClientControls.firstBNode;
+		int i = 0;
+		while( cn != NULL )
+		{
+			IDs[i] = cn->id;
+			i++;
+			cn = cn->next;
+		}
+		*clientIDs = IDs; 
+
+		//sanity check how many IDs we found
+		if (i != ClientControls.activeBClients)
+		{
+			log_err("Unable to get Active Client IDs!");
+			free(IDs);
+			*clientIDs = NULL; 
+			i = -1;
+		}
+
+		// unlock the client list
+		if ( pthread_mutex_unlock( &(ClientControls.clientBLock ) ) )
+		log_fatal( "unlock client list failed");
+
+		return i;
+	}		
 	return err;
 	
 }
@@ -215,6 +266,22 @@ getClientPort(long ID, int client_listener)
 			cn = cn->next;
 		}
 
+	log_err("getClientPort: couldn't find a client with ID: %d", ID);
+	return -1;
+	}
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			return cn->port;
+		else	
+			cn = cn->next;
+		}
+
 	log_err("getClientPort: couldn't find a client with ID: %d", ID);
 	return -1;
 	}
@@ -278,6 +345,30 @@ getClientAddress(long ID, int client_listener)
 				cn = cn->next;
 		}
 
+	log_err("getClientAddress: couldn't find a client with ID: %d", ID);
+	return NULL;
+	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			{   
+				char *ans = malloc( strlen(cn->addr) + 1 );
+				if (ans == NULL) 
+				{
+					log_err("getClientAddress: couldn't allocate string memory");
+					return NULL;
+				}
+			strncpy(ans, cn->addr, strlen(cn->addr) + 1);
+			return ans;
+			}
+			else	
+				cn = cn->next;
+		}
+
 	log_err("getClientAddress: couldn't find a client with ID: %d", ID);
 	return NULL;
 	}	
@@ -328,6 +419,23 @@ getClientConnectedTime(long ID, int client_listener)
 		log_err("getClientConnectedTime: couldn't find a client with ID: %d", ID);
 		return ans;
 	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		time_t ans = 0;
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
+		{
+			if(cn->id == ID)
+				return cn->connectedTime;
+			else	
+				cn = cn->next;
+		}
+
+		log_err("getClientConnectedTime: couldn't find a client with ID: %d", ID);
+		return ans;
+	}	
 	return err;
 }
 
@@ -377,6 +485,39 @@ getClientReadItems(long ID, int client_listener)
 		
 		ClientNode *cn = ClientControls.firstRNode;
 		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			{
+				QueueReader reader = cn->qReader;
+				// no reader until its rib snapshot is sent
+				if (reader == NULL)
+					return 0;
+				char *qname = getQueueNameForReader(reader);
+				if (qname == NULL) 
+					return -1;
+				long index = getQueueIndexForReader(reader);
+				if (index == -1 )
+				{
+					free(qname);
+					return -1;
+				}
+				long ans = getReaderReadItems( qname, index );
+				free(qname);
+				return ans;
+			}
+			else	
+				cn = cn->next;
+		}
+
+	log_warning("getClientReadItems: couldn't find a client with ID:%d", ID);
+	return -1;
+	}
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
 		{
 			if(cn->id == ID)
 			{
@@ -448,6 +589,38 @@ getClientUnreadItems(long ID, int client_listener)
 	{
 		ClientNode *cn = ClientControls.firstRNode;
 		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			{
+				QueueReader reader = cn->qReader;
+				// no reader until its rib snapshot is sent
+				if (reader == NULL)
+					return 0;
+				char *qname = getQueueNameForReader(reader);
+				if (qname == NULL) 
+					return -1;
+				long index = getQueueIndexForReader(reader);
+				if (index == -1 )
+				{
+					free(qname);
+					return -1;
+				}
+				long ans = getReaderUnreadItems( qname, index );
+				free(qname);
+				return ans;
+			}
+			else	
+				cn = cn->next;
+		}
+
+	log_warning("getClientUnreadItems: couldn't find a client with ID:%d", ID);
+	return -1;
+	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
 		{
 			if(cn->id == ID)
 			{
@@ -516,6 +689,22 @@ getClientLastAction(long ID, int client_listener)
 		log_err("getClientLastAction: couldn't find a client with ID: %d", ID);
 		return ans;			
 	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)	
+	{
+
+		time_t ans = 0;
+		ClientNode *cn = ClientControls.firstBNode;
+		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			return  cn->lastAction;
+			else	
+			cn = cn->next;
+		}
+		log_err("getClientLastAction: couldn't find a client with ID: %d", ID);
+		return ans;			
+	}	
 	return err;
 }
 
@@ -559,6 +748,23 @@ deleteClient(long ID, int client_listener)
 		}
 		log_err("deleteClient: couldn't find a client with ID:%d", ID);
 	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		ClientNode *cn = ClientControls.firstBNode;
+		log_msg("deleteClient Called!");
+		while( cn != NULL )
+		{
+			if(cn->id == ID)
+			{
+				cn->deleteClient = TRUE;
+				return;
+			}
+			else	
+				cn = cn->next;
+		}
+		log_err("deleteClient: couldn't find a client with ID:%d", ID);
+	}	
 	
 }
 
@@ -642,7 +848,8 @@ destroyClient(long id, int client_listener)
 				else
 					prev->next = cn->next;
 				// clean up the memory
-				destroyQueueReader( cn->qReader );
+				if ( cn->qReader != NULL )
+					destroyQueueReader( cn->qReader );
 				free(cn);
 				// unlock the client list
 				if ( pthread_mutex_unlock( &(ClientControls.clientRLock ) ) )
@@ -662,6 +869,52 @@ destroyClient(long id, int client_listener)
 			log_fatal( "unlock client list failed");
 		return;
 	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		// lock the client list
+		if ( pthread_mutex_lock( &(ClientControls.clientBLock ) ) )
+			log_fatal( "lock client list failed");
+
+		ClientNode *prev = NULL;
+		ClientNode *cn = ClientControls.firstBNode;
+
+		while(cn != NULL) 
+		{
+			if (cn->id == id ) 
+			{
+				// close this client connection
+				log_msg("Deleting client id (%d)", cn->id);		
+				// close the client socket
+				close( cn->socket );
+				// remove from the client list
+				ClientControls.activeBClients--;
+				if (prev == NULL) 
+					ClientControls.firstBNode = cn->next;
+				else
+					prev->next = cn->next;
+				// clean up the memory
+				destroyQueueReader( cn->qReader );
+				free(cn);
+				// unlock the client list
+				if ( pthread_mutex_unlock( &(ClientControls.clientBLock ) ) )
+					log_fatal( "unlock client list failed");			
+				return;
+			}
+			else
+			{
+				prev = cn;
+				cn = cn->next;
+			}
+		}
+
+		log_err("destroyClient: couldn't find a client with ID:%d", id);
+		// unlock the client list
+		if ( pthread_mutex_unlock( &(ClientControls.clientBLock ) ) )
+			log_fatal( "unlock client list failed");
+		return;
+	}	
 	
 }
 
@@ -715,7 +968,36 @@ createClientRNode( long ID, char *addr, int port, int socket )
 	cn->socket = socket;
 	cn->connectedTime = time(NULL);
 	cn->lastAction = time(NULL);
-	cn->qReader = createQueueReader( &xmlRQueue, 1 );
+	// the reader is created once the rib snapshot is sent, see clientRThread
+	cn->qReader = NULL;
+	cn->deleteClient = FALSE;		
+	cn->next = NULL;
+	return cn;
+}
+
+/*-------------------------------------------------------------------------------------- 
+ * Purpose: Create a new BINARY ClientNode structure.
+ * Input:  the client ID, address (as string), port, and socket
+ * Output: a pointer to the new ClientNode structure 
+ *         or NULL if an error occurred.
+ * -------------------------------------------------------------------------------------*/
+ClientNode * 
+createClientBNode( long ID, char *addr, int port, int socket )
+{
+	// create a client node structure
+	ClientNode *cn = malloc(sizeof(ClientNode));
+	if (cn == NULL) {
+		log_warning("Failed to allocate memory for new client.");
+		return NULL;
+	}
+	cn->id = ID;
+	strncpy( cn->addr, addr, ADDR_MAX_CHARS-1 );
+	cn->addr[ADDR_MAX_CHARS-1] = '\0';
+	cn->port = port;
+	cn->socket = socket;
+	cn->connectedTime = time(NULL);
+	cn->lastAction = time(NULL);
+	cn->qReader = createQueueReader( &bmfStreamQueue, 1 );
 	cn->deleteClient = FALSE;		
 	cn->next = NULL;
 	return cn;
@@ -732,7 +1014,7 @@ clientUThread( void *arg  )
 {
 	ClientNode *cn = arg;	// the client node structure
 	int readresult;		// result of reading from queue
-	u_char *xmlDataOut=NULL;// the data read in from the queue
+	XMLMessage xmlDataOut=NULL;// the data read in from the queue
 	int readlength;		// the length of data read from queue
 	int wrotelength;	// the length of data written to client
 			
@@ -752,7 +1034,7 @@ clientUThread( void *arg  )
 		cn->lastAction = time(NULL);
 		// read from the queue
 		readresult = readQueue( xmlQueueReader );
-                xmlDataOut = (u_char*)xmlQueueReader->items[0];
+                xmlDataOut = (XMLMessage)xmlQueueReader->items[0];
 		// if reader has been canceled or ceased, close client
 		if ( readresult == READER_SLOT_AVAILABLE ) 
 		{
@@ -761,10 +1043,8 @@ clientUThread( void *arg  )
 		// otherwise write data to client
 		else 
 		{
-			// readlength = strlen((const char *)xmlDataOut);
-			readlength = getXMLMessageLen((char *)xmlDataOut);
-			//wrotelength = writen(cn->socket,xmlDataOut,readlength+1);
-			wrotelength = writen(cn->socket,xmlDataOut,readlength);
+			readlength = xmlDataOut->length;
+			wrotelength = writen(cn->socket,xmlDataOut->text,readlength);
 			// if write fails, close client
 			//if ( wrotelength != readlength+1 ) // socket connection lost
 			if ( wrotelength != readlength ) // socket connection lost
@@ -788,10 +1068,148 @@ clientUThread( void *arg  )
 }
 
 
+/* the messages of a rib snapshot waiting to be written to the client */
+typedef struct ClientSnapshotStruct
+{
+	ClientNode	*cn;
+	BMF		*bmfs;
+	int		count;
+	int		size;
+} ClientSnapshot;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Keep a message of a rib snapshot until the next flush
+ * Input:  bmf - the message, taken over
+ *         arg - the ClientSnapshot
+ * Output: 0 on success, -1 on failure
+ * NOTE: called inside an epoch section, so it only stores the message
+ * -------------------------------------------------------------------------------------*/
+static int
+putSnapshotBMF( BMF bmf, void *arg )
+{
+	ClientSnapshot *snap = arg;
+
+	if ( snap->count == snap->size )
+	{
+		int size = snap->size ? snap->size * 2 : 256;
+		BMF *bmfs = realloc(snap->bmfs, size * sizeof(BMF));
+		if ( bmfs == NULL )
+		{
+			log_err("putSnapshotBMF: realloc failed");
+			destroyBMF(bmf);
+			return -1;
+		}
+		snap->bmfs = bmfs;
+		snap->size = size;
+	}
+	snap->bmfs[snap->count++] = bmf;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Convert the stored messages of a rib snapshot and write them to the client
+ * Input:  arg - the ClientSnapshot
+ * Output: 0 on success, -1 if the client is gone or BGPmon is closing
+ * -------------------------------------------------------------------------------------*/
+static int
+flushSnapshot( void *arg )
+{
+	ClientSnapshot *snap = arg;
+	ClientNode *cn = snap->cn;
+	char *xmlData;
+	int i, len;
+
+	for ( i = 0; i < snap->count; i++ )
+	{
+		if ( cn->deleteClient == FALSE && ClientControls.shutdown == FALSE )
+		{
+			xmlData = renderClientXML(snap->bmfs[i], &len);
+			if ( xmlData != NULL )
+			{
+				if ( writen(cn->socket, xmlData, len) != len )
+					cn->deleteClient = TRUE;
+				free(xmlData);
+			}
+			cn->lastAction = time(NULL);
+		}
+		destroyBMF(snap->bmfs[i]);
+	}
+	snap->count = 0;
+	if ( cn->deleteClient != FALSE || ClientControls.shutdown != FALSE )
+		return -1;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send the rib tables of all established sessions to a new rib client
+ *          and create its reader of the xml rib queue
+ * Input:  the client node structure for this client
+ * Output: 0 on success, -1 if the client is gone or BGPmon is closing
+ * NOTE: The tables are sent to this client only, bracketed by SNAPSHOT_START and
+ *       SNAPSHOT_STOP. The reader is created after the full tables, then the
+ *       changes made while they were sent follow as delta transfers, so the client
+ *       misses nothing. SNAPSHOT_STOP carries the lowest sequence number of the
+ *       messages of the xml rib queue the client gets after the snapshot.
+ * -------------------------------------------------------------------------------------*/
+static int
+sendRibSnapshot( ClientNode *cn )
+{
+	ClientSnapshot snap;
+	TransferSink sink;
+	u_int64_t *checkpoints;
+	u_int32_t seq;
+	BMF bmf;
+	int i, tables = 0;
+
+	memset(&snap, 0, sizeof(ClientSnapshot));
+	snap.cn = cn;
+	sink.put = putSnapshotBMF;
+	sink.flush = flushSnapshot;
+	sink.arg = &snap;
+
+	checkpoints = calloc(MAX_SESSION_IDS, sizeof(u_int64_t));
+	if ( checkpoints == NULL )
+	{
+		log_err("sendRibSnapshot: calloc failed");
+		return -1;
+	}
+
+	bmf = createBMF(0, BMF_TYPE_SNAPSHOT_START);
+	putSnapshotBMF(bmf, &snap);
+	for ( i = 0; i < MAX_SESSION_IDS && flushSnapshot(&snap) == 0; i++ )
+	{
+		if ( Sessions[i] != NULL && isSessionEstablished(i) == TRUE )
+		{
+			if ( streamRibTable(i, &sink, 0, &checkpoints[i]) == 0 )
+				tables++;
+		}
+	}
+
+	// from here on the client gets the live messages, catch up to them
+	cn->qReader = createRibClientReader(&seq);
+	for ( i = 0; i < MAX_SESSION_IDS && flushSnapshot(&snap) == 0; i++ )
+	{
+		if ( checkpoints[i] != 0 && Sessions[i] != NULL && isSessionEstablished(i) == TRUE )
+			streamRibTable(i, &sink, checkpoints[i], NULL);
+	}
+	free(checkpoints);
+
+	bmf = createBMF(0, BMF_TYPE_SNAPSHOT_STOP);
+	seq = htonl(seq);
+	bgpmonMessageAppend(bmf, &seq, sizeof(u_int32_t));
+	putSnapshotBMF(bmf, &snap);
+	i = flushSnapshot(&snap);
+	free(snap.bmfs);
+	if ( i == 0 )
+		log_msg("Sent a rib snapshot of %d sessions to client %d", tables, cn->id);
+	return i;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: The main function of a thread handling one client
  * Input:  the client node structure for this client
  * Output: none
+ * NOTE: a rib client first gets a snapshot of the rib tables, see sendRibSnapshot
  * He Yan @ July 22, 2008
  * -------------------------------------------------------------------------------------*/
 void *
@@ -799,7 +1217,7 @@ clientRThread( void *arg  )
 {
 	ClientNode *cn = arg;	// the client node structure
 	int readresult;		// result of reading from queue
-	u_char *xmlDataOut =NULL;// the data read in from the queue
+	XMLMessage xmlDataOut =NULL;// the data read in from the queue
 	int readlength;		// the length of data read from queue
 	int wrotelength;	// the length of data written to client
 			
@@ -808,6 +1226,10 @@ clientRThread( void *arg  )
 
 	// write a open tag <xml> when connection starts
 	wrotelength = writen(cn->socket,"<xml>",5);
+
+	// send the current rib tables, this creates the xml queue reader
+	if ( sendRibSnapshot(cn) )
+		cn->deleteClient = TRUE;
 	
 	// get the xml queue reader
 	QueueReader xmlQueueReader = cn->qReader;
@@ -819,7 +1241,7 @@ clientRThread( void *arg  )
 		cn->lastAction = time(NULL);
 		// read from the queue
 		readresult = readQueue( xmlQueueReader );
-                xmlDataOut = (u_char*)xmlQueueReader->items[0];
+                xmlDataOut = (XMLMessage)xmlQueueReader->items[0];
 		// if reader has been canceled or ceased, close client
 		if ( readresult == READER_SLOT_AVAILABLE ) 
 		{
@@ -828,10 +1250,8 @@ clientRThread( void *arg  )
 		// otherwise write data to client
 		else 
 		{
-			// readlength = strlen((const char *)xmlDataOut);
-			readlength = getXMLMessageLen((char *)xmlDataOut);
-			//wrotelength = writen(cn->socket,xmlDataOut,readlength+1);
-			wrotelength = writen(cn->socket,xmlDataOut,readlength);
+			readlength = xmlDataOut->length;
+			wrotelength = writen(cn->socket,xmlDataOut->text,readlength);
 			// if write fails, close client
 			//if ( wrotelength != readlength+1 ) // socket connection lost
 			if ( wrotelength != readlength ) // socket connection lost
@@ -854,3 +1274,67 @@ clientRThread( void *arg  )
 
 	pthread_exit( (void *) 1 ); 
 }
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: The main function of a thread handling one binary client
+ * Input:  the client node structure for this client
+ * Output: none
+ * NOTE: the client gets the stream header, then the records of the binary
+ *       stream queue as they are, see bmfstream.h
+ * -------------------------------------------------------------------------------------*/
+void *
+clientBThread( void *arg  )
+{
+	ClientNode *cn = arg;	// the client node structure
+	int readresult;		// result of reading from queue
+	u_char *recordOut = NULL;// the record read in from the queue
+	int readlength;		// the length of the record read from queue
+	int wrotelength;	// the length of data written to client
+	u_char header[BMF_STREAM_HEADER_LEN];
+
+	// write the stream header when connection starts
+	readlength = encodeBMFStreamHeader(header);
+	if ( writen(cn->socket, header, readlength) != readlength )
+		cn->deleteClient = TRUE;
+
+	// get the binary stream queue reader
+	QueueReader bmfStreamReader = cn->qReader;
+
+	// while the client is alive, read records and write them to client
+	while ( cn->deleteClient == FALSE )
+	{
+		// update the last action time
+		cn->lastAction = time(NULL);
+		// read from the queue
+		readresult = readQueue( bmfStreamReader );
+		recordOut = (u_char *)bmfStreamReader->items[0];
+		// if reader has been canceled or ceased, close client
+		if ( readresult == READER_SLOT_AVAILABLE ) 
+		{
+			cn->deleteClient = TRUE;
+		}
+		// otherwise write the record to client
+		else 
+		{
+			readlength = sizeOfBMFRecord(recordOut);
+			wrotelength = writen(cn->socket, recordOut, readlength);
+			// if write fails, close client
+			if ( wrotelength != readlength ) // socket connection lost
+			{
+				cn->deleteClient = TRUE;
+			}
+			// free the record we just wrote and get next one
+			free(recordOut);
+			recordOut = NULL;
+		}
+	}
+
+	// destroy the client  
+	destroyClient(cn->id, CLIENT_LISTENER_BINARY);
+
+	// free any record that hasn't been written
+	if (recordOut != NULL) 
+		free(recordOut);
+
+	pthread_exit( (void *) 1 ); 
+}
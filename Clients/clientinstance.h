@@ -46,7 +46,7 @@ struct ClientStruct
 	int		socket;			// client's socket for writing
 	time_t		connectedTime;		// client's connected time
 	time_t		lastAction;		// client's last action time
-	QueueReader 	qReader;		// client's XML queue reader 
+	QueueReader 	qReader;		// client's XML or binary stream queue reader 
 	int		deleteClient;		// flag to indicate delete
 	pthread_t	clientThread;
 	struct ClientStruct *	next;		// pointer to next client node
@@ -71,6 +71,14 @@ ClientNode * createClientUNode( long ID, char *addr, int port, int socket );
  * -------------------------------------------------------------------------------------*/
 ClientNode * createClientRNode( long ID, char *addr, int port, int socket );
 
+/*-------------------------------------------------------------------------------------- 
+ * Purpose: Create a new BINARY ClientNode structure.
+ * Input:  the client ID, address (as string), port, and socket
+ * Output: a pointer to the new ClientNode structure 
+ *         or NULL if an error occurred.
+ * -------------------------------------------------------------------------------------*/
+ClientNode * createClientBNode( long ID, char *addr, int port, int socket );
+
 
 /*--------------------------------------------------------------------------------------
  * Purpose: The main function of a thread handling one client
@@ -80,5 +88,6 @@ ClientNode * createClientRNode( long ID, char *addr, int port, int socket );
  * -------------------------------------------------------------------------------------*/
 void * clientUThread( void *arg );
 void * clientRThread( void *arg );
+void * clientBThread( void *arg );
 
 #endif /*CLIENTINSTANCE_H_*/
@@ -34,9 +34,10 @@
 /* needed for system types such as time_t */
 #include <sys/types.h>
 
-/* RIB and UPDATA constants */
+/* RIB, UPDATA and BINARY constants */
 #define CLIENT_LISTENER_UPDATA 1
 #define CLIENT_LISTENER_RIB 2
+#define CLIENT_LISTENER_BINARY 3
 
 // functions related to accepting and managing client connections
 // see clientscontrol.c for corresponding functions
@@ -55,6 +55,9 @@
 /* needed for checkACL */
 #include "../Util/acl.h"
 
+/* needed for the binary stream thread */
+#include "bmfstream.h"
+
 /* needed for malloc and free */
 #include <stdlib.h>
 /* needed for strncpy */
@@ -148,6 +151,35 @@ initClientsControlSettings()
 		else
 			ClientControls.maxRClients = MAX_CLIENT_IDS;
 
+	// BINARY SETTINGS
+		// address used to listen for binary client connections
+		result = checkAddress(CLIENTS_BINARY_LISTEN_ADDR, ADDR_PASSIVE);
+		if(result != ADDR_VALID)
+		{
+			err = 1;
+			strncpy(ClientControls.listenBAddr, IPv4_LOOPBACK, ADDR_MAX_CHARS);
+		}
+		else
+			strncpy(ClientControls.listenBAddr, CLIENTS_BINARY_LISTEN_ADDR, ADDR_MAX_CHARS);
+
+		// port used to listen for binary client connections
+		if ( (CLIENTS_BINARY_LISTEN_PORT < 1) || (CLIENTS_BINARY_LISTEN_PORT > 65536) ) {
+			err = 1;
+			log_warning("Invalid site default for client listen port.");
+			ClientControls.listenBPort = 50003;
+		}
+		else
+			ClientControls.listenBPort = CLIENTS_BINARY_LISTEN_PORT;
+
+		// Maximum number of binary clients allowed
+		if (MAX_CLIENT_IDS < 0)  {
+			err = 1;
+			log_warning("Invalid site default for max allowed clients.");
+			ClientControls.maxBClients = 1;
+		}
+		else
+			ClientControls.maxBClients = MAX_CLIENT_IDS;
+
 	// client connections enabled
 	if ( (CLIENTS_LISTEN_ENABLED != TRUE) && (CLIENTS_LISTEN_ENABLED != FALSE) ) {
                 err = 1;
@@ -164,11 +196,15 @@ initClientsControlSettings()
 	ClientControls.activeRClients = 0;
 	ClientControls.nextRClientID = 1;
 	ClientControls.rebindRFlag = FALSE;	
+	ClientControls.activeBClients = 0;
+	ClientControls.nextBClientID = 1;
+	ClientControls.rebindBFlag = FALSE;
 	
 	ClientControls.shutdown = FALSE;
 	ClientControls.lastAction = time(NULL);
 	ClientControls.firstUNode = NULL;
 	ClientControls.firstRNode = NULL;
+	ClientControls.firstBNode = NULL;
 
 	//randomize RNG and set initial sequence number
 	srand(time(NULL));
@@ -179,6 +215,8 @@ initClientsControlSettings()
                 log_fatal( "unable to init mutex lock for clients updates");
         if (pthread_mutex_init( &(ClientControls.clientRLock), NULL ) )
                 log_fatal( "unable to init mutex lock for clients rib");
+        if (pthread_mutex_init( &(ClientControls.clientBLock), NULL ) )
+                log_fatal( "unable to init mutex lock for clients binary");
 
 	return err;
 }
@@ -313,6 +351,64 @@ readClientsControlSettings()
 		debug(__FUNCTION__, "Maximum RIB clients allowed is %d", ClientControls.maxRClients);
 #endif
 
+	// BINARY LISTENER
+		// get listen addr
+		result = getConfigValueAsAddr(&addr, XML_CLIENTS_CTR_BINARY_LISTEN_ADDR_PATH, ADDR_PASSIVE);
+		if (result == CONFIG_VALID_ENTRY) 
+		{
+			result = checkAddress(addr, ADDR_PASSIVE);
+			if(result != ADDR_VALID)
+			{
+				err = 1;
+				log_warning("Invalid configuration of client binary listener address.");
+			}
+			else 
+			{
+				strncpy(ClientControls.listenBAddr,addr,ADDR_MAX_CHARS);
+				free(addr);
+			}
+		}
+		else if ( result == CONFIG_INVALID_ENTRY ) 
+		{
+			err = 1;
+			log_warning("Invalid configuration of client binary listener address.");
+		}
+		else
+			log_msg("No configuration of client binary listener address, using default.");
+#ifdef DEBUG
+		debug(__FUNCTION__, "Client Binary Listener Addr: %s", ClientControls.listenBAddr);
+#endif
+
+		// get listen port
+		result = getConfigValueAsInt(&num, XML_CLIENTS_CTR_BINARY_LISTEN_PORT_PATH,1,65536);
+		if (result == CONFIG_VALID_ENTRY) 
+			ClientControls.listenBPort = num;
+		else if( result == CONFIG_INVALID_ENTRY ) 
+		{
+			err = 1;
+			log_warning("Invalid configuration of client binary listener port.");
+		}
+		else
+			log_msg("No configuration of client binary listener port, using default.");
+#ifdef DEBUG
+		debug(__FUNCTION__, "Clients Binary Listener Port: %d", ClientControls.listenBPort);
+#endif
+
+		// get the max number of clients
+		result = getConfigValueAsInt(&num, XML_CLIENTS_CTR_BINARY_MAX_CLIENTS_PATH, 0, 65536);
+		if (result == CONFIG_VALID_ENTRY) 
+			ClientControls.maxBClients = num;
+		else if ( result == CONFIG_INVALID_ENTRY ) 
+		{
+			err = 1;
+			log_warning("Invalid configuration of max binary clients.");
+		}
+		else
+			log_msg("No configuration of max binary clients, using default.");
+#ifdef DEBUG
+		debug(__FUNCTION__, "Maximum binary clients allowed is %d", ClientControls.maxBClients);
+#endif
+
 	// get enabled status of clients control module
 	result = getConfigValueAsInt(&num, XML_CLIENTS_CTR_ENABLED_PATH, 0, 1);
 	if (result == CONFIG_VALID_ENTRY) 
@@ -415,6 +511,28 @@ saveClientsControlSettings()
 			err = 1;
 			log_warning("Failed to save max rib clients to config file.");
 		}
+
+	// BINARY LISTENER
+		// save binary listener addr
+		if ( setConfigValueAsString(XML_CLIENTS_CTR_BINARY_LISTEN_ADDR, ClientControls.listenBAddr) ) 
+		{
+			err = 1;
+			log_warning("Failed to save client binary listener address to config file.");
+		}
+
+		// save binary listener port
+		if ( setConfigValueAsInt(XML_CLIENTS_CTR_BINARY_LISTEN_PORT, ClientControls.listenBPort) ) 
+		{
+			err = 1;
+			log_warning("Failed to save client binary listener port to config file.");
+		}
+
+		// save the max number of binary clients
+		if (setConfigValueAsInt(XML_CLIENTS_CTR_BINARY_MAX_CLIENTS, ClientControls.maxBClients) ) 
+		{
+			err = 1;
+			log_warning("Failed to save max binary clients to config file.");
+		}
 	
 	// save the status of clients control module
 	if (setConfigValueAsInt(XML_CLIENTS_CTR_ENABLED, ClientControls.enabled) ) 
@@ -462,6 +580,9 @@ launchClientsControlThread()
 	// keep clients listener thread reference
 	ClientControls.clientsListenerThread = clientsThreadID;
 
+	// the thread feeding the binary clients
+	launchBMFStreamThread();
+
 #ifdef DEBUG
 	debug(__FUNCTION__, "Created Clients thread!");
 #endif
@@ -524,6 +645,10 @@ getClientsControlListenPort(int client_listener)
 	{
 		return ClientControls.listenRPort;
 	}	
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		return ClientControls.listenBPort;
+	}	
 	return err;
 }
 
@@ -553,6 +678,14 @@ setClientsControlListenPort( int port, int client_listener)
 			ClientControls.listenRPort = port;
 		}
 	}	
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		if( ClientControls.listenBPort != port && port > 0)
+		{
+			ClientControls.rebindBFlag = TRUE;
+			ClientControls.listenBPort = port;
+		}
+	}	
 }
 
 /*--------------------------------------------------------------------------------------
@@ -596,6 +729,19 @@ getClientsControlListenAddr(int client_listener)
 	memcpy(Rans, ClientControls.listenRAddr, sizeof(ClientControls.listenRAddr));
         return Rans;
 	}	
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		// allocate memory for the result
+		char *Bans = malloc(sizeof(ClientControls.listenBAddr));
+		if (Bans == NULL)
+		{
+			log_err("getClientsControlListenAddr: couldn't allocate string memory");
+			return NULL;
+		}
+		// copy the string and return result
+		memcpy(Bans, ClientControls.listenBAddr, sizeof(ClientControls.listenBAddr));
+		return Bans;
+	}	
 	return NULL;
 }
 
@@ -641,6 +787,21 @@ setClientsControlListenAddr( char *addr, int client_listener )
 		}
 		return result;
 	}	
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		
+		int result = checkAddress(addr, ADDR_PASSIVE);
+		if(result == ADDR_VALID)
+		{
+			if( strcmp(ClientControls.listenBAddr, addr) != 0 )
+			{
+				ClientControls.rebindBFlag = TRUE;
+				strncpy(ClientControls.listenBAddr, addr, ADDR_MAX_CHARS);
+			}
+		}
+		return result;
+	}	
 	return err;
 }
 
@@ -657,6 +818,8 @@ getClientsControlMaxConnections(int client_listener)
     return ClientControls.maxUClients;
   }else if(client_listener == CLIENT_LISTENER_RIB){
     return ClientControls.maxRClients;
+  }else if(client_listener == CLIENT_LISTENER_BINARY){
+    return ClientControls.maxBClients;
   }else{
     return -1;
   }
@@ -676,6 +839,8 @@ setClientsControlMaxConnections(int newMax, int client_listener)
     ClientControls.maxUClients = newMax;
   }else if(client_listener == CLIENT_LISTENER_RIB){
     ClientControls.maxRClients = newMax;
+  }else if(client_listener == CLIENT_LISTENER_BINARY){
+    ClientControls.maxBClients = newMax;
   }else{
     return 1;
   }
@@ -710,6 +875,7 @@ clientsControlThread( void *arg )
 	int fdmax = 0;		// maximum file descriptor number
 	int listenUSocket = -1;	// socket to listen for UPDATA connections
 	int listenRSocket = -1;  // socket to listen for RIB connections
+	int listenBSocket = -1;  // socket to listen for BINARY connections
 
 	// timer to periodically check thread status
 	struct timeval timeout; 
@@ -749,6 +915,17 @@ clientsControlThread( void *arg )
 				fdmax = 0;
 				listenRSocket = -1;			
 			}			
+			// close the BINARY listening socket if active			
+			if( listenBSocket >= 0 )
+			{
+#ifdef DEBUG
+				debug( __FUNCTION__, "Close the BINARY listening socket(%d)!! ", listenBSocket );
+#endif
+				close( listenBSocket );
+				FD_ZERO( &read_fds );
+				fdmax = 0;
+				listenBSocket = -1;			
+			}			
 			
 #ifdef DEBUG
 			debug( __FUNCTION__, "clients control thread is disabled");
@@ -782,6 +959,18 @@ clientsControlThread( void *arg )
 #endif
 			}
 			
+			if( (listenBSocket != -1) && (ClientControls.rebindBFlag == TRUE) )
+			{
+				close( listenBSocket );
+				FD_ZERO( &read_fds );
+				fdmax = 0;
+				listenBSocket = -1;			
+				ClientControls.rebindBFlag = FALSE;
+#ifdef DEBUG
+				debug( __FUNCTION__, "Close the BINARY listening socket(%d)!! ", listenBSocket );
+#endif
+			}
+			
 			// if socket is down, reopen
 			if (listenUSocket == - 1) 
 			{
@@ -827,6 +1016,28 @@ clientsControlThread( void *arg )
 				fdmax = listenRSocket+1;
 			}			
 			
+			if (listenBSocket == - 1) 
+			{
+				listenBSocket = startListener(ClientControls.listenBAddr, ClientControls.listenBPort);
+				// if listen succeeded, setup FD values
+				// otherwise we will try next loop time
+				if (listenBSocket != - 1) 
+				{
+					FD_SET(listenBSocket, &read_fds);
+					if( listenBSocket+1 > fdmax )
+						fdmax = listenBSocket+1;
+#ifdef DEBUG
+					debug( __FUNCTION__, "Opened the BINARY listening socket(%d)!! ", listenBSocket );
+#endif
+				}
+			}
+			else
+			{
+				FD_SET(listenBSocket, &read_fds);
+				if( listenBSocket+1 > fdmax )
+					fdmax = listenBSocket+1;
+			}			
+			
 #ifdef DEBUG
 			debug( __FUNCTION__, "clients control thread is enabled" );
 #endif
@@ -863,6 +1074,17 @@ clientsControlThread( void *arg )
 			}
 		}		
 		
+		if( listenBSocket >= 0)
+		{
+			if( FD_ISSET(listenBSocket, &read_fds) )//new BINARY client
+			{
+#ifdef DEBUG
+				debug( __FUNCTION__, "new BINARY client attempting to start." );
+#endif
+				startClient( listenBSocket, CLIENT_LISTENER_BINARY );
+			}
+		}		
+		
 	}
 	
 	log_warning( "Clients control thread exiting" );	 
@@ -891,6 +1113,18 @@ clientsControlThread( void *arg )
 #endif
 	}	
 
+	// close BINARY socket if open
+	if( listenBSocket != -1) 
+	{
+		close(listenBSocket);
+		FD_ZERO( &read_fds );
+		fdmax = 0;
+		listenBSocket = -1;			
+#ifdef DEBUG
+		debug( __FUNCTION__, "Close the BINARY listening socket(%d)!! ", listenBSocket );
+#endif
+	}	
+
 	return NULL;
 }
 
@@ -1017,6 +1251,19 @@ startClient( int listenSocket, int client_listener)
 		}
 	}	
 
+	// too many BINARY clients, close this one	
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+
+		if ( ClientControls.activeBClients >= ClientControls.maxBClients )
+		{
+			log_warning( "At maximum number of connected clients: connection from %s port %d rejected.", addr, port );
+			close(clientSocket);
+			free(addr);
+			return;
+		}
+	}	
+
 	if (client_listener == CLIENT_LISTENER_UPDATA)
 	{
 		//check the new client against ACL
@@ -1040,6 +1287,18 @@ startClient( int listenSocket, int client_listener)
 			return;
 		}		
 	}
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		//check the new client against ACL, the binary clients get the updates
+		if ( checkACL((struct sockaddr *) &clientaddr, CLIENT_UPDATE_ACL) == FALSE )
+		{
+			log_msg("client connection from %s port %d rejected by access control list",addr, port);
+			close(clientSocket);
+			free(addr);
+			return;
+		}		
+	}
 	
 	if (client_listener == CLIENT_LISTENER_UPDATA)
 	{
@@ -1119,6 +1378,48 @@ startClient( int listenSocket, int client_listener)
 		}
 	}	
 	
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		// create a BINARY client node structure
+		ClientNode *Bcn = createClientBNode(ClientControls.nextBClientID,addr, port, clientSocket);
+		if (Bcn == NULL) 
+		{
+			log_warning( "Failed to create client structure.   Closing connection from  %s port %d rejected.", addr, port );
+			close(clientSocket);
+			free(addr);
+			return;
+		}
+
+		// lock the BINARY client list
+		if ( pthread_mutex_lock( &(ClientControls.clientBLock) ) )
+			log_fatal( "lock client binary list failed" );
+
+		// add the client to the list 
+		Bcn->next = ClientControls.firstBNode;
+		ClientControls.firstBNode = Bcn;
+
+		//increment the number of active clients
+		ClientControls.activeBClients++;
+		ClientControls.nextBClientID++;
+
+		// unlock the client list
+		if ( pthread_mutex_unlock( &(ClientControls.clientBLock ) ) )
+			log_fatal( "unlock client binary list failed");
+	
+		// the stream thread starts encoding now that it has a reader
+		wakeBMFStreamThread();
+
+		// spawn a new thread for this client
+		pthread_t clientBThreadID;
+		Bcn->clientThread = clientBThreadID;
+		int error;
+		if ((error = pthread_create( &clientBThreadID, NULL, &clientBThread, Bcn)) > 0) 
+		{
+			log_warning("Failed to create BINARY client thread: %s", strerror(error));
+			destroyClient(Bcn->id, CLIENT_LISTENER_BINARY);
+		}
+	}	
+	
 // testing
 	/*
 	if( ClientControls.activeClients == 1 )
@@ -1197,6 +1498,24 @@ printClients(int client_listener)
 			Rcn = Rcn->next;
 		}
 	}
+
+	if (client_listener == CLIENT_LISTENER_BINARY)
+	{
+		// print all connected BINARY clients for debugging
+		ClientNode *Bcn = ClientControls.firstBNode;
+		while( Bcn != NULL )
+		{
+			long id = Bcn->id;
+			char *Baddr = getClientAddress(id, CLIENT_LISTENER_BINARY);
+			int Bport = getClientPort(id, CLIENT_LISTENER_BINARY);
+			long Bread = getClientReadItems(id, CLIENT_LISTENER_BINARY);
+			long Bunread = getClientUnreadItems(id, CLIENT_LISTENER_BINARY);
+			time_t BconnectedTime = getClientConnectedTime(id, CLIENT_LISTENER_BINARY);
+			log_msg("Client id: %ld  addr: %s, port: %d, read:%ld, unread:%ld, connectedTime:%d", id, Baddr, Bport, Bread, Bunread, BconnectedTime);			
+			free(Baddr);
+			Bcn = Bcn->next;
+		}
+	}
 }
 
 /*--------------------------------------------------------------------------------------
@@ -1209,6 +1528,7 @@ void signalClientsShutdown() {
 	// both the client listener and all client connections check this variable
 	// to determine when to shutdown
 	ClientControls.shutdown = TRUE;
+	wakeBMFStreamThread();
 
 #ifdef DEBUG
 	debug(__FUNCTION__, "Client module signaled for shutdown.");
@@ -1246,4 +1566,15 @@ void waitForClientsShutdown() {
 		//free(cn);
 		cn = cn->next;
 	}
+
+	// wait for each binary client connection thread to exit
+	cn = ClientControls.firstBNode;
+	while(cn!=NULL) {
+		status = NULL;
+		deleteClient(cn->id, CLIENT_LISTENER_BINARY);
+		cn = cn->next;
+	}
+
+	// and for the thread feeding them
+	waitForBMFStreamShutdown();
 }
@@ -68,7 +68,17 @@ struct ClientControls_struct_st
 	ClientNode *firstRNode; 	// first node in list of active clients
 	pthread_mutex_t clientRLock; 	// lock client changes 
 
-/* for both UPDATA and RIB */
+/* for BINARY, the live messages as length-prefixed records, see bmfstream.h */
+	char listenBAddr[ADDR_MAX_CHARS];
+	int listenBPort;
+	int maxBClients; 		// the max number of clients
+	int activeBClients; 		// the number of active clients
+	long nextBClientID; 		// id for the next client to connect
+	int rebindBFlag; 		// indicates whether to reopen socket
+	ClientNode *firstBNode; 	// first node in list of active clients
+	pthread_mutex_t clientBLock; 	// lock client changes 
+
+/* for UPDATA, RIB and BINARY */
 	int enabled; 			// TRUE: enabled or FALSE: disabled
 	int shutdown; 			// indicates whether to stop the thread
 	time_t lastAction; 		// last time the thread was active
@@ -75,6 +75,9 @@
 #define XML_CLIENTS_CTR_RIB_LISTEN_ADDR "RIB_LISTEN_ADDR"
 #define XML_CLIENTS_CTR_RIB_LISTEN_PORT "RIB_LISTEN_PORT"
 #define XML_CLIENTS_CTR_RIB_MAX_CLIENTS "RIB_MAX_CLIENTS"
+#define XML_CLIENTS_CTR_BINARY_LISTEN_ADDR "BINARY_LISTEN_ADDR"
+#define XML_CLIENTS_CTR_BINARY_LISTEN_PORT "BINARY_LISTEN_PORT"
+#define XML_CLIENTS_CTR_BINARY_MAX_CLIENTS "BINARY_MAX_CLIENTS"
 #define XML_CLIENTS_CTR_UPDATES_LISTEN_ADDR "UPDATES_LISTEN_ADDR"
 #define XML_CLIENTS_CTR_UPDATES_LISTEN_PORT "UPDATES_LISTEN_PORT"
 #define XML_CLIENTS_CTR_UPDATES_MAX_CLIENTS "UPDATES_MAX_CLIENTS"
@@ -89,6 +92,16 @@
 #define XML_MRTS_CTR_MAX_MRTS "MAX_MRTS"
 #define XML_MRTS_CTR_LABEL_ACTION "LABEL_ACTION"
 
+// Mrt export Tags
+#define XML_MRT_EXPORT_TAG "MRT_EXPORT"
+#define XML_MRT_EXPORT_ENABLED "ENABLED"
+#define XML_MRT_EXPORT_DIR "DIRECTORY"
+#define XML_MRT_EXPORT_INTERVAL "INTERVAL"
+#define XML_MRT_EXPORT_FSYNC_INTERVAL "FSYNC_INTERVAL"
+#define XML_MRT_EXPORT_RIB_ENABLED "RIB_ENABLED"
+#define XML_MRT_EXPORT_RIB_INTERVAL "RIB_INTERVAL"
+#define XML_MRT_EXPORT_RIB_RATE "RIB_RATE"
+
 // Chains Tags
 #define XML_CHAINS_LIST_TAG "CHAINS"
 #define XML_CHAIN_TAG "CHAIN"
@@ -142,6 +155,24 @@
 #define XML_STATUS_MSG_INTERVAL "PEER_STATUS_INTERVAL"
 #define XML_ROUTE_REFRESH_INTERVAL "RIB_REFRESH_INTERVAL"
 #define XML_SEND_ROUTE_REFRESH "SEND_ROUTE_REFRESH"
+#define XML_TRANSFER_MSG_RATE "TRANSFER_MSG_RATE"
+#define XML_TRANSFER_BYTE_RATE "TRANSFER_BYTE_RATE"
+#define XML_TRANSFER_QUEUE_FILL "TRANSFER_QUEUE_FILL"
+#define XML_TRANSFER_WORKERS "TRANSFER_WORKERS"
+#define XML_DELTA_TRANSFER "DELTA_TRANSFER"
+
+// Labeling module tags
+#define XML_LABELING_TAG "LABELING"
+#define XML_LABELING_WORKERS "WORKER_THREADS"
+#define XML_LABELING_SNAPSHOT_DIR "SNAPSHOT_DIR"
+#define XML_LABELING_SNAPSHOT_INTERVAL "SNAPSHOT_INTERVAL"
+#define XML_LABELING_JOURNAL_SIZE "DELTA_JOURNAL_SIZE"
+#define XML_LABELING_STALE_TIME "STALE_RIB_TIME"
+
+// XML conversion tags
+#define XML_CONVERSION_TAG "XML_CONVERSION"
+#define XML_CONVERSION_WORKERS "RENDER_WORKERS"
+#define XML_CONVERSION_RIB_WORKERS "RIB_RENDER_WORKERS"
 
 // XML Paths to various tags
 #define XML_ROOT_PATH "//" XML_BGPMON_TAG "/"
@@ -174,6 +205,9 @@
 #define XML_CLIENTS_CTR_RIB_LISTEN_ADDR_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_RIB_LISTEN_ADDR
 #define XML_CLIENTS_CTR_RIB_LISTEN_PORT_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_RIB_LISTEN_PORT
 #define XML_CLIENTS_CTR_RIB_MAX_CLIENTS_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_RIB_MAX_CLIENTS
+#define XML_CLIENTS_CTR_BINARY_LISTEN_ADDR_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_BINARY_LISTEN_ADDR
+#define XML_CLIENTS_CTR_BINARY_LISTEN_PORT_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_BINARY_LISTEN_PORT
+#define XML_CLIENTS_CTR_BINARY_MAX_CLIENTS_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_BINARY_MAX_CLIENTS
 #define XML_CLIENTS_CTR_ENABLED_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_ENABLED
 #define XML_CLIENTS_CTR_BGPMON_ID_PATH XML_CLIENTS_CTR_PATH "/" XML_CLIENTS_CTR_BGPMON_ID
 
@@ -185,6 +219,16 @@
 #define XML_MRTS_CTR_MAX_MRTS_PATH XML_MRTS_CTR_PATH "/" XML_MRTS_CTR_MAX_MRTS
 #define XML_MRTS_CTR_LABEL_ACTION_PATH XML_MRTS_CTR_PATH "/" XML_MRTS_CTR_LABEL_ACTION
 
+// Mrt export related XML Paths
+#define XML_MRT_EXPORT_PATH XML_ROOT_PATH "/" XML_MRT_EXPORT_TAG
+#define XML_MRT_EXPORT_ENABLED_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_ENABLED
+#define XML_MRT_EXPORT_DIR_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_DIR
+#define XML_MRT_EXPORT_INTERVAL_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_INTERVAL
+#define XML_MRT_EXPORT_FSYNC_INTERVAL_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_FSYNC_INTERVAL
+#define XML_MRT_EXPORT_RIB_ENABLED_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_RIB_ENABLED
+#define XML_MRT_EXPORT_RIB_INTERVAL_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_RIB_INTERVAL
+#define XML_MRT_EXPORT_RIB_RATE_PATH XML_MRT_EXPORT_PATH "/" XML_MRT_EXPORT_RIB_RATE
+
 
 // Chains related XML Paths
 #define XML_CHAINS_PATH XML_ROOT_PATH "/" XML_CHAINS_LIST_TAG "/" XML_CHAIN_TAG
@@ -199,5 +243,23 @@
 #define XML_PERIODIC_STATUS_INTERVAL_PATH XML_PERIODIC_PATH "/" XML_STATUS_MSG_INTERVAL
 #define XML_PERIODIC_RR_INTERVAL_PATH XML_PERIODIC_PATH "/" XML_ROUTE_REFRESH_INTERVAL
 #define XML_PERIODIC_SEND_ROUTE_REFRESH_PATH XML_PERIODIC_PATH "/" XML_SEND_ROUTE_REFRESH 
+#define XML_PERIODIC_TRANSFER_MSG_RATE_PATH XML_PERIODIC_PATH "/" XML_TRANSFER_MSG_RATE
+#define XML_PERIODIC_TRANSFER_BYTE_RATE_PATH XML_PERIODIC_PATH "/" XML_TRANSFER_BYTE_RATE
+#define XML_PERIODIC_TRANSFER_QUEUE_FILL_PATH XML_PERIODIC_PATH "/" XML_TRANSFER_QUEUE_FILL
+#define XML_PERIODIC_TRANSFER_WORKERS_PATH XML_PERIODIC_PATH "/" XML_TRANSFER_WORKERS
+#define XML_PERIODIC_DELTA_TRANSFER_PATH XML_PERIODIC_PATH "/" XML_DELTA_TRANSFER
+
+// Labeling module Paths
+#define XML_LABELING_PATH XML_ROOT_PATH "/" XML_LABELING_TAG
+#define XML_LABELING_WORKERS_PATH XML_LABELING_PATH "/" XML_LABELING_WORKERS
+#define XML_LABELING_SNAPSHOT_DIR_PATH XML_LABELING_PATH "/" XML_LABELING_SNAPSHOT_DIR
+#define XML_LABELING_SNAPSHOT_INTERVAL_PATH XML_LABELING_PATH "/" XML_LABELING_SNAPSHOT_INTERVAL
+#define XML_LABELING_JOURNAL_SIZE_PATH XML_LABELING_PATH "/" XML_LABELING_JOURNAL_SIZE
+#define XML_LABELING_STALE_TIME_PATH XML_LABELING_PATH "/" XML_LABELING_STALE_TIME
+
+// XML conversion Paths
+#define XML_CONVERSION_PATH XML_ROOT_PATH "/" XML_CONVERSION_TAG
+#define XML_CONVERSION_WORKERS_PATH XML_CONVERSION_PATH "/" XML_CONVERSION_WORKERS
+#define XML_CONVERSION_RIB_WORKERS_PATH XML_CONVERSION_PATH "/" XML_CONVERSION_RIB_WORKERS
 
 #endif	// CONFIGDEFAULTS_H_
@@ -51,8 +51,11 @@
 #include "../Peering/peergroup.h"
 #include "../Clients/clients.h"
 #include "../Mrt/mrt.h"
+#include "../Mrt/mrtexport.h"
 #include "../Chains/chains.h"
 #include "../PeriodicEvents/periodic.h"
+#include "../Labeling/label.h"
+#include "../XML/xml.h"
 #include "../Util/acl.h"
 #include "../Util/address.h"
 
@@ -116,6 +119,13 @@ readConfigFile (char *configfile)
 		return 1;
 	}
 
+	// parse the mrt export information
+	if (readMrtExportSettings()) {
+		xmlFreeDoc(xmlConfigFilePtr);
+		log_err("Invalid mrt export configuration in file %s.", configfile);
+		return 1;
+	}
+
 	//parse the chain information
 	if (readChainsSettings()) {
 		xmlFreeDoc(xmlConfigFilePtr);
@@ -151,6 +161,20 @@ readConfigFile (char *configfile)
 		return 1;
 	}
 
+	// parse the Labeling information
+	if (readLabelingSettings()) {
+		xmlFreeDoc(xmlConfigFilePtr);
+		log_err("Invalid labeling configuration in file %s.", configfile);
+		return 1;
+	}
+
+	// parse the XML conversion information
+	if (readXMLSettings()) {
+		xmlFreeDoc(xmlConfigFilePtr);
+		log_err("Invalid xml conversion configuration in file %s.", configfile);
+		return 1;
+	}
+
 	// parse the acl information
 	if (readACLSettings()) {
 		xmlFreeDoc(xmlConfigFilePtr);
@@ -319,6 +343,12 @@ int saveConfigFile(char * configFile) {
 		err = 1;
 		log_warning("Unable to save mrt control settings in file %s.", configFile);
 	}
+
+	// save the mrt export settings
+	if(saveMrtExportSettings()) {
+		err = 1;
+		log_warning("Unable to save mrt export settings in file %s.", configFile);
+	}
 	
 	// save the Client settings
 	if(savePeriodicSettings()) {
@@ -326,6 +356,18 @@ int saveConfigFile(char * configFile) {
 		log_warning("Unable to save periodic module settings in file %s.", configFile);
 	}
 
+	// save the Labeling settings
+	if(saveLabelingSettings()) {
+		err = 1;
+		log_warning("Unable to save labeling module settings in file %s.", configFile);
+	}
+
+	// save the XML conversion settings
+	if(saveXMLSettings()) {
+		err = 1;
+		log_warning("Unable to save xml conversion settings in file %s.", configFile);
+	}
+
 	// close the root element
 	if(closeConfigElement()) {
 		err = 1;
@@ -0,0 +1,200 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: epoch.c
+ *  Date: Oct 18, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "epoch.h"
+#include "../Util/log.h"
+
+//#define DEBUG
+
+/* a pointer waiting for the readers of its epoch to leave */
+typedef struct RetiredStruct {
+	void		*ptr;
+	EpochFreeFunc	fn;
+	u_int64_t	epoch;
+} Retired;
+
+/* the epoch every reader entered in, 0 for a free slot */
+static volatile u_int64_t	globalEpoch = 1;
+static volatile u_int64_t	readerEpochs[EPOCH_MAX_READERS];
+/* no reader from an epoch before this one is left */
+static volatile u_int64_t	passedEpoch = 0;
+
+/* retired pointers in the order they were retired, so by epoch */
+static Retired			*retired = NULL;
+static u_int32_t		retiredCount = 0;
+static u_int32_t		retiredSize = 0;
+static pthread_mutex_t		retiredLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Start a read side section
+ * Input:
+ * Output: the reader slot to pass to epochExit
+ * NOTE: The epoch is checked again once the slot is visible, since a reclaim that
+ *       ran before that could not see the reader.
+ * -------------------------------------------------------------------------------------*/
+int epochEnter()
+{
+	u_int64_t	epoch = globalEpoch;
+	int		slot = 0;
+
+	while( readerEpochs[slot] != 0 || !__sync_bool_compare_and_swap(&readerEpochs[slot], 0, epoch) )
+	{
+		if( ++slot == EPOCH_MAX_READERS )
+		{
+			slot = 0;
+			sched_yield();
+			epoch = globalEpoch;
+		}
+	}
+	for( ;; )
+	{
+		__sync_synchronize();
+		if( globalEpoch == epoch )
+			break;
+		epoch = globalEpoch;
+		readerEpochs[slot] = epoch;
+	}
+	return slot;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: End a read side section
+ * Input: slot - the slot returned by epochEnter
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void epochExit(int slot)
+{
+	__sync_synchronize();
+	readerEpochs[slot] = 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free a pointer once no reader can see it anymore
+ * Input: ptr - the unlinked memory
+ *		fn - the function to free it with, NULL for free()
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void epochRetire(void *ptr, EpochFreeFunc fn)
+{
+	if( ptr == NULL )
+		return;
+
+	pthread_mutex_lock(&retiredLock);
+	if( retiredCount == retiredSize )
+	{
+		retiredSize = retiredSize ? retiredSize * 2 : 1024;
+		retired = realloc(retired, retiredSize * sizeof(Retired));
+		if( retired == NULL )
+			log_fatal("epochRetire: out of memory for %u retired pointers", retiredSize);
+	}
+	// the unlink must be visible before the epoch is read
+	__sync_synchronize();
+	retired[retiredCount].ptr = ptr;
+	retired[retiredCount].fn = fn;
+	retired[retiredCount].epoch = globalEpoch;
+	retiredCount++;
+	pthread_mutex_unlock(&retiredLock);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the retired pointers that no reader can see anymore
+ * Input:
+ * Output: the number of pointers freed
+ * NOTE: The free functions are called without holding the lock, so they may
+ *       retire more pointers.
+ * -------------------------------------------------------------------------------------*/
+int epochReclaim()
+{
+	u_int64_t	oldest, epoch;
+	Retired		*done;
+	u_int32_t	i, n;
+
+	oldest = __sync_add_and_fetch(&globalEpoch, 1);
+	for( i = 0; i < EPOCH_MAX_READERS; i++ )
+	{
+		epoch = readerEpochs[i];
+		if( epoch != 0 && epoch < oldest )
+			oldest = epoch;
+	}
+
+	pthread_mutex_lock(&retiredLock);
+	if( oldest > passedEpoch )
+		passedEpoch = oldest;
+	for( n = 0; n < retiredCount && retired[n].epoch < oldest; n++ )
+		;
+	if( n == 0 || (done = malloc(n * sizeof(Retired))) == NULL )
+	{
+		pthread_mutex_unlock(&retiredLock);
+		return 0;
+	}
+	memcpy(done, retired, n * sizeof(Retired));
+	memmove(retired, retired + n, (retiredCount - n) * sizeof(Retired));
+	retiredCount -= n;
+	pthread_mutex_unlock(&retiredLock);
+
+	for( i = 0; i < n; i++ )
+	{
+		if( done[i].fn != NULL )
+			done[i].fn(done[i].ptr);
+		else
+			free(done[i].ptr);
+	}
+	free(done);
+
+#ifdef DEBUG
+	debug(__FUNCTION__, "Freed %u retired pointers, oldest reader epoch is %llu", n, (unsigned long long)oldest);
+#endif
+	return n;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the current epoch
+ * Input:
+ * Output: the epoch
+ * -------------------------------------------------------------------------------------*/
+u_int64_t epochCurrent()
+{
+	return globalEpoch;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if every reader that was active in an epoch has left
+ * Input: epoch - an epoch returned by epochCurrent
+ * Output: 1 if no reader from that epoch is left, 0 otherwise
+ * NOTE: only as recent as the last epochReclaim
+ * -------------------------------------------------------------------------------------*/
+int epochPassed(u_int64_t epoch)
+{
+	return epoch < passedEpoch;
+}
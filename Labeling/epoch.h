@@ -0,0 +1,95 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: epoch.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------------------
+ * Epoch based reclamation of rib memory.
+ * Threads that read a rib table they do not own (table transfer, CLI) do it
+ * between epochEnter and epochExit and take no locks. The labeling workers
+ * unlink nodes as before but hand them to epochRetire instead of freeing them,
+ * and a retired node is freed by epochReclaim only once every reader that could
+ * still see it has left. Writers never wait for readers, a slow reader only
+ * delays when memory is given back.
+ * A reader must not keep a pointer to a rib node after epochExit.
+ * -------------------------------------------------------------------------------------*/
+#define EPOCH_MAX_READERS	256
+
+/* frees a retired pointer */
+typedef void (*EpochFreeFunc)(void *ptr);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Start a read side section
+ * Input:
+ * Output: the reader slot to pass to epochExit
+ * NOTE: waits for a free slot if EPOCH_MAX_READERS readers are active
+ * -------------------------------------------------------------------------------------*/
+int epochEnter();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: End a read side section
+ * Input: slot - the slot returned by epochEnter
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void epochExit(int slot);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free a pointer once no reader can see it anymore
+ * Input: ptr - the unlinked memory
+ *		fn - the function to free it with, NULL for free()
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void epochRetire(void *ptr, EpochFreeFunc fn);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the retired pointers that no reader can see anymore
+ * Input:
+ * Output: the number of pointers freed
+ * -------------------------------------------------------------------------------------*/
+int epochReclaim();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the current epoch
+ * Input:
+ * Output: the epoch
+ * -------------------------------------------------------------------------------------*/
+u_int64_t epochCurrent();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if every reader that was active in an epoch has left
+ * Input: epoch - an epoch returned by epochCurrent
+ * Output: 1 if no reader from that epoch is left, 0 otherwise
+ * NOTE: only as recent as the last epochReclaim
+ * -------------------------------------------------------------------------------------*/
+int epochPassed(u_int64_t epoch);
+
+#endif /*EPOCH_H_*/
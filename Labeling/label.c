@@ -30,11 +30,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 #include <assert.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <time.h>
+#include <sched.h>
 
 #include "../Util/log.h"
 #include "../site_defaults.h"
@@ -43,6 +45,8 @@
 #include "label.h"
 #include "labelinternal.h"
 #include "rtable.h"
+#include "ribsnapshot.h"
+#include "epoch.h"
 
 // needed to parse/save XML
 #include "../Config/configdefaults.h"
@@ -62,6 +66,7 @@
 #include "../Peering/bgpstates.h"
 
 #include "../PeriodicEvents/internalperiodic.h"
+#include "../PeriodicEvents/transferbudget.h"
 
 //#define DEBUG
 
@@ -74,6 +79,12 @@
 int initLabelingSettings()
 {
 	LabelControls.shutdown = FALSE;
+	LabelControls.numWorkers = LABEL_WORKER_THREADS;
+	LabelControls.stopping = FALSE;
+	strncpy(LabelControls.snapshotDir, RIB_SNAPSHOT_DIR, PATH_MAX_CHARS-1);
+	LabelControls.snapshotInterval = RIB_SNAPSHOT_INTERVAL;
+	LabelControls.journalSize = DELTA_JOURNAL_SIZE;
+	LabelControls.staleTime = STALE_RIB_TIME;
 	return 0;
 }
 
@@ -85,7 +96,87 @@ int initLabelingSettings()
  * -------------------------------------------------------------------------------------*/
 int readLabelingSettings()
 {	
-	return 0;
+	int err = 0;
+	int result;
+	int num;
+
+	// get the number of labeling worker threads
+	result = getConfigValueAsInt(&num, XML_LABELING_WORKERS_PATH, 1, MAX_LABEL_WORKERS);
+	if (result == CONFIG_VALID_ENTRY)
+		LabelControls.numWorkers = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the number of labeling worker threads.");
+	}
+	else
+		log_msg("No configuration of the number of labeling worker threads, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "Labeling worker threads %d.", LabelControls.numWorkers );
+#endif
+
+	// get the rib snapshot directory
+	char *dir = NULL;
+	result = getConfigValueAsString(&dir, XML_LABELING_SNAPSHOT_DIR_PATH, PATH_MAX_CHARS-1);
+	if (result == CONFIG_VALID_ENTRY)
+	{
+		strncpy(LabelControls.snapshotDir, dir, PATH_MAX_CHARS-1);
+		free(dir);
+	}
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the rib snapshot directory.");
+	}
+	else
+		log_msg("No configuration of the rib snapshot directory, using default.");
+
+	// get the rib snapshot interval
+	result = getConfigValueAsInt(&num, XML_LABELING_SNAPSHOT_INTERVAL_PATH, 0, MAX_RIB_SNAPSHOT_INTERVAL);
+	if (result == CONFIG_VALID_ENTRY)
+		LabelControls.snapshotInterval = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the rib snapshot interval.");
+	}
+	else
+		log_msg("No configuration of the rib snapshot interval, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "Rib snapshots in [%s] every %d seconds.", LabelControls.snapshotDir, LabelControls.snapshotInterval );
+#endif
+
+	// get the size of the withdrawal journal
+	result = getConfigValueAsInt(&num, XML_LABELING_JOURNAL_SIZE_PATH, 0, MAX_DELTA_JOURNAL_SIZE);
+	if (result == CONFIG_VALID_ENTRY)
+		LabelControls.journalSize = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the delta journal size.");
+	}
+	else
+		log_msg("No configuration of the delta journal size, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "Delta journal size %u.", LabelControls.journalSize );
+#endif
+
+	// get how long a rib is kept over a session flap
+	result = getConfigValueAsInt(&num, XML_LABELING_STALE_TIME_PATH, 0, MAX_STALE_RIB_TIME);
+	if (result == CONFIG_VALID_ENTRY)
+		LabelControls.staleTime = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the stale rib time.");
+	}
+	else
+		log_msg("No configuration of the stale rib time, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "Stale rib time %d seconds.", LabelControls.staleTime );
+#endif
+
+	return err;
 }
 
 
@@ -97,6 +188,74 @@ int readLabelingSettings()
  * -------------------------------------------------------------------------------------*/
 int saveLabelingSettings()
 {	
+	int err = 0;
+
+	// save labeling tag
+	if ( openConfigElement(XML_LABELING_TAG) ) {
+		err = 1;
+		log_warning("Failed to save labeling settings to config file.");
+	}
+
+	// save the number of worker threads
+	if ( setConfigValueAsInt(XML_LABELING_WORKERS, LabelControls.numWorkers) ) {
+		err = 1;
+		log_warning("Failed to save labeling worker threads to config file.");
+	}
+
+	// save the rib snapshot directory and interval
+	if ( setConfigValueAsString(XML_LABELING_SNAPSHOT_DIR, LabelControls.snapshotDir) ) {
+		err = 1;
+		log_warning("Failed to save rib snapshot directory to config file.");
+	}
+	if ( setConfigValueAsInt(XML_LABELING_SNAPSHOT_INTERVAL, LabelControls.snapshotInterval) ) {
+		err = 1;
+		log_warning("Failed to save rib snapshot interval to config file.");
+	}
+
+	// save the size of the withdrawal journal
+	if ( setConfigValueAsInt(XML_LABELING_JOURNAL_SIZE, LabelControls.journalSize) ) {
+		err = 1;
+		log_warning("Failed to save delta journal size to config file.");
+	}
+
+	// save how long a rib is kept over a session flap
+	if ( setConfigValueAsInt(XML_LABELING_STALE_TIME, LabelControls.staleTime) ) {
+		err = 1;
+		log_warning("Failed to save stale rib time to config file.");
+	}
+
+	// close labeling tag
+	if ( closeConfigElement(XML_LABELING_TAG) ) {
+		err = 1;
+		log_warning("Failed to save labeling settings to config file.");
+	}
+
+	return err;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: get the number of labeling worker threads
+ * Input:  none
+ * Output: the number of worker threads
+ * -------------------------------------------------------------------------------------*/
+int getLabelWorkers()
+{
+	return LabelControls.numWorkers;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: set the number of labeling worker threads, takes effect on restart
+ * Input:  workers - the number of worker threads (1 to MAX_LABEL_WORKERS)
+ * Output: 0 means success, -1 means failure.
+ * -------------------------------------------------------------------------------------*/
+int setLabelWorkers(int workers)
+{
+	if( workers < 1 || workers > MAX_LABEL_WORKERS )
+	{
+		log_warning("Invalid number of labeling worker threads %d.", workers);
+		return -1;
+	}
+	LabelControls.numWorkers = workers;
 	return 0;
 }
 
@@ -104,41 +263,287 @@ int saveLabelingSettings()
  * Purpose: launch labeling thread, called by main.c
  * Input:  none
  * Output: none
+ * Note: The labeling thread only dispatches messages, one worker queue and
+ *       worker thread is created for each labeling worker.
  * He Yan @ July 22, 2008
  * -------------------------------------------------------------------------------------*/
 void launchLabelingThread()
 {
 	int error;
+	long i;
+	char name[64];
 	
 	pthread_t labelingThreadID;
 
+	if( LabelControls.numWorkers < 1 || LabelControls.numWorkers > MAX_LABEL_WORKERS )
+		LabelControls.numWorkers = LABEL_WORKER_THREADS;
+
+	// map the rib snapshots of the last run before any session comes up
+	loadRibSnapshots();
+
+	for( i = 0; i < LabelControls.numWorkers; i++ )
+	{
+		snprintf(name, sizeof(name), "%s%ld", LABEL_WORKER_QUEUE_NAME, i);
+		LabelControls.workerQueues[i] = createQueue(copyBMF, sizeOfBMF, name, FALSE, NULL, NULL);
+		if ((error = pthread_create(&LabelControls.workerThreads[i], NULL, labelingWorkerThread, (void *)i)) > 0 )
+			log_fatal("Failed to create labeling worker thread %ld: %s\n", i, strerror(error));
+	}
+
+	if ((error = pthread_create(&LabelControls.reaperThread, NULL, ribReaperThread, NULL)) > 0 )
+		log_fatal("Failed to create rib reaper thread: %s\n", strerror(error));
+
+	if ((error = pthread_create(&LabelControls.snapshotThread, NULL, ribSnapshotThread, NULL)) > 0 )
+		log_fatal("Failed to create rib snapshot thread: %s\n", strerror(error));
+
 	if ((error = pthread_create(&labelingThreadID, NULL, labelingThread, NULL)) > 0 )
 		log_fatal("Failed to create labeling thread: %s\n", strerror(error));
 
 	LabelControls.labelThread = labelingThreadID;
 
-	debug(__FUNCTION__, "Created labeling thread!");
+	debug(__FUNCTION__, "Created labeling thread and %d workers!", LabelControls.numWorkers);
+}
+
+/* the tables of a rib that was taken out of its session */
+typedef struct RetiredRibStruct {
+	PrefixTable	*prefixTable;
+	AttrTable	*attributeTable;
+	long		memoryUsed;		// bytes the tables held when they were retired
+	struct RetiredRibStruct *next;
+} RetiredRib;
+
+/* ribs no reader can see anymore, waiting for the reaper thread */
+static pthread_mutex_t	reaperLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	reaperCond = PTHREAD_COND_INITIALIZER;
+static RetiredRib	*reaperHead = NULL;
+static RetiredRib	*reaperTail = NULL;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Hand a retired rib to the reaper thread, called once no reader can see it
+ * Input:  ptr - the retired rib
+ * Output:
+ * NOTE: This runs in the epoch reclaim of a labeling worker, so it only queues
+ *       the rib, the tables are freed by the reaper thread.
+ * -------------------------------------------------------------------------------------*/
+static void queueRetiredRib(void *ptr)
+{
+	RetiredRib *rib = ptr;
+
+	rib->next = NULL;
+	pthread_mutex_lock(&reaperLock);
+	if( reaperTail == NULL )
+		reaperHead = rib;
+	else
+		reaperTail->next = rib;
+	reaperTail = rib;
+	pthread_cond_signal(&reaperCond);
+	pthread_mutex_unlock(&reaperLock);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Move the memory freed by the reaper out of the retired rib memory
+ * Input:  scratch - the session the freed memory was accounted to
+ *		published - the memory that was already moved, updated
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void publishReapedMemory(Session_structp scratch, long *published)
+{
+	// the scratch session counts down from 0 as nodes are freed
+	__sync_add_and_fetch(&LabelControls.retiredMemory, scratch->stats.memoryUsed - *published);
+	*published = scratch->stats.memoryUsed;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the tables of a retired rib a few buckets at a time
+ * Input:  rib - the retired rib
+ * Output:
+ * NOTE: The freed memory is published and the thread yields after every 
+ *       RIB_REAPER_BATCH buckets so a large rib does not hold a cpu.
+ * -------------------------------------------------------------------------------------*/
+static void reapRetiredRib(RetiredRib *rib)
+{
+	// the statistics of the session were settled when the rib was retired
+	Session_structp scratch = calloc(1, sizeof(struct SessionStruct));
+	PrefixTable *prefixTable = rib->prefixTable;
+	AttrTable *attributeTable = rib->attributeTable;
+	long published = 0;
+	u_int32_t i;
+
+	if( scratch == NULL )
+	{
+		log_err("reapRetiredRib: calloc failed");
+		return;
+	}
+	if( prefixTable != NULL )
+	{
+		for( i = 0; i < prefixTable->tableSize; i++ )
+		{
+			prefixTable->prefixCount -= destroyPrefixBucket(prefixTable, i, scratch);
+			if( (i + 1) % RIB_REAPER_BATCH == 0 )
+			{
+				publishReapedMemory(scratch, &published);
+				sched_yield();
+			}
+		}
+		if( destroyPrefixTable(prefixTable, scratch) ) 
+			log_err("Failed to destroy a retired prefix table!");
+		free(prefixTable->prefixEntries);
+		if( prefixTable->v4Table != NULL )
+			destroyV4Table(prefixTable->v4Table);
+		free(prefixTable);
+	}
+	if( attributeTable != NULL )
+	{
+		for( i = 0; i < attributeTable->tableSize; i++ )
+		{
+			attributeTable->attrCount -= destroyAttrBucket(attributeTable, i, scratch);
+			if( (i + 1) % RIB_REAPER_BATCH == 0 )
+			{
+				publishReapedMemory(scratch, &published);
+				sched_yield();
+			}
+		}
+		if( destroyAttrTable(attributeTable, scratch) ) 
+			log_err("Failed to destroy a retired attribute table!");
+		free(attributeTable->attrEntries);
+		free(attributeTable);
+	}
+	// the table arrays are not counted node by node, settle the rest at once
+	__sync_add_and_fetch(&LabelControls.retiredMemory, -rib->memoryUsed - published);
+	free(scratch);
+	free(rib);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Entry function of the reaper thread, frees the retired ribs
+ * Input:
+ * Output:
+ * NOTE: Tearing down a full table takes seconds, so it is done at idle priority
+ *       here instead of in the labeling workers.  Ribs still queued when the
+ *       thread exits are left to the process exit.
+ * -------------------------------------------------------------------------------------*/
+void *
+ribReaperThread( void *arg ) 
+{
+	RetiredRib *rib;
+	struct timespec wait;
+#ifdef SCHED_IDLE
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	if( pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) )
+		log_warning("Rib reaper runs at normal priority");
+#endif
+
+	log_msg( "Rib reaper started" );
+	while( LabelControls.shutdown == FALSE )
+	{
+		pthread_mutex_lock(&reaperLock);
+		while( reaperHead == NULL && LabelControls.shutdown == FALSE )
+		{
+			// wake up now and then to notice the shutdown
+			clock_gettime(CLOCK_REALTIME, &wait);
+			wait.tv_sec += THREAD_CHECK_INTERVAL;
+			pthread_cond_timedwait(&reaperCond, &reaperLock, &wait);
+		}
+		rib = reaperHead;
+		if( rib != NULL )
+		{
+			reaperHead = rib->next;
+			if( reaperHead == NULL )
+				reaperTail = NULL;
+		}
+		pthread_mutex_unlock(&reaperLock);
+
+		if( rib != NULL )
+			reapRetiredRib(rib);
+	}
+	log_warning( "Rib reaper exiting" );
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the memory held by retired ribs the reaper has not freed yet
+ * Input:
+ * Output: the memory in bytes
+ * -------------------------------------------------------------------------------------*/
+long getRetiredRibMemory()
+{
+	return LabelControls.retiredMemory;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Retire the tables of a rib that no session uses anymore
+ * Input:  prefixTable, attributeTable - the tables, either may be NULL
+ *		memoryUsed - the memory the tables hold
+ * Output:
+ * NOTE: Readers that are still walking the tables keep doing so safely, the 
+ *       tables go to the reaper thread once they are done.
+ * -------------------------------------------------------------------------------------*/
+static void retireTables(PrefixTable *prefixTable, AttrTable *attributeTable, long memoryUsed)
+{
+	RetiredRib *rib = malloc(sizeof(RetiredRib));
+
+	if( rib == NULL )
+	{
+		log_err("retireTables: malloc failed");
+		return;
+	}
+	rib->prefixTable = prefixTable;
+	rib->attributeTable = attributeTable;
+	rib->memoryUsed = memoryUsed;
+	// the memory stays counted as retired until the reaper frees it
+	__sync_add_and_fetch(&LabelControls.retiredMemory, memoryUsed);
+	epochRetire(rib, queueRetiredRib);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Take the rib tables out of a session and retire them
+ * Input:  sessionID - ID of the session
+ * Output: 0 means success, -1 means the session did not have both tables
+ * -------------------------------------------------------------------------------------*/
+static int retireRibTable(int sessionID)
+{
+	Session_structp session = Sessions[sessionID];
+	int complete = (session->prefixTable != NULL && session->attributeTable != NULL);
+
+	if( session->prefixTable == NULL && session->attributeTable == NULL )
+		return -1;
+	retireTables(session->prefixTable, session->attributeTable, session->stats.memoryUsed);
+	session->prefixTable = NULL;
+	session->attributeTable = NULL;
+	session->stats.memoryUsed = 0;
+
+	return complete ? 0 : -1;
 }
 
 /*--------------------------------------------------------------------------------------
  * Purpose: Clear the content of Rib table of a session
  * Input:  sessionID - ID of the session needs to clear Rib
  * Output: 0 means success, -1 means failure.
+ * NOTE: the session gets new empty tables of the same size
  * He Yan @ July 22, 2008
  * -------------------------------------------------------------------------------------*/
 int cleanRibTable(int sessionID)
 {
-	if( destroyPrefixTable(Sessions[sessionID]->prefixTable, Sessions[sessionID]) ) 
+	Session_structp session = Sessions[sessionID];
+	u_int32_t prefixTableSize, attributeTableSize;
+	u_int16_t prefixCollision, attributeCollision;
+
+	if( session->prefixTable == NULL || session->attributeTable == NULL )
 	{
-		log_err ("Failed to clean the prefix table for session %d!", sessionID);
+		log_err ("Failed to clean the rib table for session %d!", sessionID);
 		return -1;
 	}
+	prefixTableSize = session->prefixTable->tableSize;
+	prefixCollision = session->prefixTable->maxCollision;
+	attributeTableSize = session->attributeTable->tableSize;
+	attributeCollision = session->attributeTable->maxCollision;
 
-	if( destroyAttrTable(Sessions[sessionID]->attributeTable, Sessions[sessionID]) ) 
-	{
-		log_err ("Failed to clean the attr table for session %d!", sessionID);
-		return -1;
-	}	
+	retireRibTable(sessionID);
+	session->stats.prefixCount = 0;
+	session->stats.attrCount = 0;
+	createPrefixTable(sessionID, prefixTableSize, prefixCollision);
+	createAttributeTable(sessionID, attributeTableSize, attributeCollision);
 	return 0;
 }
 
@@ -150,60 +555,269 @@ int cleanRibTable(int sessionID)
  * -------------------------------------------------------------------------------------*/
 int deleteRibTable(int sessionID)
 {
-	int i;
-	int error;
-	// delete the prefix hash table
-	if( Sessions[sessionID]->prefixTable !=NULL )
-	{
-		if( destroyPrefixTable(Sessions[sessionID]->prefixTable, Sessions[sessionID]) ) 
-		{
-			log_err("Failed to destroy the prefix table for session %d!", sessionID);
-			return -1;
-		}    
-		free(Sessions[sessionID]->prefixTable->prefixEntries);
-		free(Sessions[sessionID]->prefixTable);
-		Sessions[sessionID]->prefixTable = NULL;
+	if( retireRibTable(sessionID) )
+		return -1;
 #ifdef DEBUG
-		debug (__FUNCTION__,  "Successfully destroy the prefix table for session %d!", sessionID);
+	debug (__FUNCTION__,  "Successfully retired the rib table for session %d!", sessionID);
 #endif 
+	return 0;
+}
+
+/* the rib of a session that went down, kept for the session coming back */
+typedef struct StaleRibStruct {
+	struct StaleRibStruct	*next;
+	PrefixTable		*prefixTable;
+	AttrTable		*attributeTable;
+	long			memoryUsed;
+	u_int32_t		remoteAS;
+	u_int32_t		ASNumLen;
+	char			remoteAddr[ADDR_MAX_CHARS];
+	char			localAddr[ADDR_MAX_CHARS];
+	time_t			deadline;		// freed if not taken back by then
+} StaleRib;
+
+static StaleRib		*staleRibs = NULL;
+static pthread_mutex_t	staleRibLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the ribs of the sessions closed by the shutdown, saved by the rib snapshot thread */
+static StaleRib		*closedRibs = NULL;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Take the rib tables out of a session that went down
+ * Input:  sessionID - ID of the session
+ * Output: the tables with the addresses and AS of the session or NULL if the 
+ *         session did not have both tables
+ * -------------------------------------------------------------------------------------*/
+static StaleRib *detachRib(int sessionID)
+{
+	Session_structp session = Sessions[sessionID];
+	StaleRib *rib;
+
+	if( session->prefixTable == NULL || session->attributeTable == NULL )
+		return NULL;
+	rib = calloc(1, sizeof(StaleRib));
+	if( rib == NULL )
+	{
+		log_err("detachRib: calloc failed");
+		return NULL;
 	}
-	else
+	rib->prefixTable = session->prefixTable;
+	rib->attributeTable = session->attributeTable;
+	rib->memoryUsed = session->stats.memoryUsed;
+	rib->remoteAS = session->configInUse.remoteAS2;
+	rib->ASNumLen = session->fsm.ASNumlen;
+	memcpy(rib->remoteAddr, session->configInUse.remoteAddr, ADDR_MAX_CHARS);
+	rib->remoteAddr[ADDR_MAX_CHARS-1] = '\0';
+	memcpy(rib->localAddr, session->configInUse.localAddr, ADDR_MAX_CHARS);
+	rib->localAddr[ADDR_MAX_CHARS-1] = '\0';
+	session->prefixTable = NULL;
+	session->attributeTable = NULL;
+	session->stats.memoryUsed = 0;
+	return rib;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Take the rib out of a session that went down and keep it 
+ * Input:  sessionID - ID of the session
+ * Output: 0 if the rib is kept, -1 if it was not
+ * NOTE: The rib is kept for LabelControls.staleTime seconds, a session to the
+ *       same peer that is established by then takes it over.
+ * -------------------------------------------------------------------------------------*/
+static int keepStaleRib(int sessionID)
+{
+	StaleRib *rib;
+
+	if( LabelControls.staleTime == 0 || (rib = detachRib(sessionID)) == NULL )
 		return -1;
+	rib->deadline = time(NULL) + LabelControls.staleTime;
 
-	// delete the attribute hash table
-	if( Sessions[sessionID]->attributeTable !=NULL )
-	{
+	pthread_mutex_lock(&staleRibLock);
+	rib->next = staleRibs;
+	staleRibs = rib;
+	pthread_mutex_unlock(&staleRibLock);
+	return 0;
+}
 
-		if (destroyAttrTable(Sessions[sessionID]->attributeTable, Sessions[sessionID])) 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Keep the rib of a session that went down until the rib snapshot thread
+ *          saved it, called once the shutdown closes the session
+ * Input:  sessionID - ID of the session
+ * Output: 0 if the rib is kept, -1 if it was not
+ * -------------------------------------------------------------------------------------*/
+static int keepClosedRib(int sessionID)
+{
+	StaleRib *rib;
+
+	if( LabelControls.snapshotDir[0] == '\0' || (rib = detachRib(sessionID)) == NULL )
+		return -1;
+	pthread_mutex_lock(&staleRibLock);
+	rib->next = closedRibs;
+	closedRibs = rib;
+	pthread_mutex_unlock(&staleRibLock);
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Mark every prefix in the rib of a session stale
+ * Input:  session - the session
+ *		seconds - how long the prefixes are kept if they are not announced again
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void markRibStale(Session_structp session, int seconds)
+{
+	session->prefixTable->staleGeneration = session->prefixTable->generation;
+	session->prefixTable->staleDeadline = time(NULL) + seconds;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Give a session that was just established the rib kept for its peer
+ * Input:  sessionID - ID of the session
+ * Output: the number of prefixes taken over or -1 if no rib was kept
+ * NOTE: All prefixes of the rib are stale until they are announced again.
+ * -------------------------------------------------------------------------------------*/
+static int takeStaleRib(int sessionID)
+{
+	Session_structp session = Sessions[sessionID];
+	StaleRib *rib, *prev = NULL;
+
+	if( session->prefixTable == NULL || session->attributeTable == NULL )
+		return -1;
+	pthread_mutex_lock(&staleRibLock);
+	for( rib = staleRibs; rib != NULL; prev = rib, rib = rib->next )
+	{
+		if( rib->remoteAS == session->configInUse.remoteAS2
+			&& !strncmp(rib->remoteAddr, session->configInUse.remoteAddr, ADDR_MAX_CHARS)
+			&& !strncmp(rib->localAddr, session->configInUse.localAddr, ADDR_MAX_CHARS) )
 		{
-			log_err("Failed to destroy the attribute table for session %d!", sessionID);
-			return -1;
+			if( prev == NULL )
+				staleRibs = rib->next;
+			else
+				prev->next = rib->next;
+			break;
 		}
-		for (i=0; i<Sessions[sessionID]->attributeTable->tableSize; i++) 
+	}
+	pthread_mutex_unlock(&staleRibLock);
+	if( rib == NULL )
+		return -1;
+
+	// the empty tables of the new session are replaced by the kept ones
+	retireRibTable(sessionID);
+	session->stats.memoryUsed = rib->memoryUsed;
+	session->stats.prefixCount = rib->prefixTable->prefixCount;
+	session->stats.attrCount = rib->attributeTable->attrCount;
+	__sync_synchronize();
+	session->prefixTable = rib->prefixTable;
+	session->attributeTable = rib->attributeTable;
+	markRibStale(session, LabelControls.staleTime);
+	free(rib);
+
+	log_msg("Session %d took over the rib of its peer with %u stale prefixes", sessionID, session->prefixTable->prefixCount);
+	return session->prefixTable->prefixCount;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the kept ribs whose session did not come back in time
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void expireStaleRibs()
+{
+	StaleRib *rib, **prev;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&staleRibLock);
+	prev = &staleRibs;
+	while( (rib = *prev) != NULL )
+	{
+		if( now < rib->deadline )
 		{
-			if ((error = pthread_rwlock_destroy(&(Sessions[sessionID]->attributeTable->attrEntries[i].lock))) > 0)  
-			{
-				log_err("Failed to destroy rwlock: %s\n", strerror(error));  
-				return -1;
-			}
-		}  		
-		free(Sessions[sessionID]->attributeTable->attrEntries);
-		free(Sessions[sessionID]->attributeTable);
-		Sessions[sessionID]->attributeTable = NULL;
-#ifdef DEBUG
-		debug (__FUNCTION__,  "Successfully destroy the attribute table for session %d!", sessionID);
-#endif
+			prev = &rib->next;
+			continue;
+		}
+		*prev = rib->next;
+		log_msg("Peer %s did not come back in %d seconds, freeing its kept rib", rib->remoteAddr, LabelControls.staleTime);
+		retireTables(rib->prefixTable, rib->attributeTable, rib->memoryUsed);
+		free(rib);
 	}
+	pthread_mutex_unlock(&staleRibLock);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Label a withdrawal of stale prefixes and pass it on like one from the peer
+ * Input:  bmf - the withdrawal, taken over
+ *		arg - the labeled queue writer
+ * Output: 0 
+ * -------------------------------------------------------------------------------------*/
+static int putStaleWithdrawal(BMF bmf, void *arg)
+{
+	bmf->type = BMF_TYPE_MSG_FROM_PEER;
+	if( processBMF(bmf) == 1 )
+		destroyBMF(bmf);
 	else
-		return -1;
-	
+		writeQueue((QueueWriter)arg, bmf);
 	return 0;
 }
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Withdraw the stale prefixes of a session
+ * Input:  sessionID - ID of the session
+ *		afi, safi - the address family to withdraw, afi 0 for all of them
+ *		labeledQueueWriter - where the withdrawals are written
+ * Output:
+ * NOTE: The withdrawals are applied to the rib and labeled as if the peer had 
+ *       sent them, so clients see them like any other withdrawal.
+ * -------------------------------------------------------------------------------------*/
+static void sweepStaleRib(int sessionID, u_int16_t afi, u_int8_t safi, QueueWriter labeledQueueWriter)
+{
+	PrefixTable *prefixTable = Sessions[sessionID]->prefixTable;
+	TransferState transfer;
+	TransferSink sink;
+	WithdrawEntry *entries;
+	u_int32_t count;
+
+	if( prefixTable == NULL || prefixTable->staleGeneration == 0 )
+		return;
+	if( copyStalePrefixes(prefixTable, afi, safi, &entries, &count) == 0 && count > 0 )
+	{
+		memset(&transfer, 0, sizeof(TransferState));
+		sink.put = putStaleWithdrawal;
+		sink.flush = NULL;
+		sink.arg = labeledQueueWriter;
+		transfer.sink = &sink;
+		sendWithdrawalBMFs(sessionID, entries, count, NULL, &transfer);
+		log_msg("Withdrew %u stale prefixes of session %d (afi %d safi %d)", count, sessionID, afi, safi);
+	}
+	free(entries);
+	if( afi == 0 )
+		prefixTable->staleGeneration = 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Withdraw the stale prefixes of the sessions of a worker that are out
+ *          of time and free the kept ribs nobody came back for
+ * Input:  worker - index of the worker in LabelControls
+ *		labeledQueueWriter - where the withdrawals are written
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void checkStaleRibs(int worker, QueueWriter labeledQueueWriter)
+{
+	time_t now = time(NULL);
+	int i;
+
+	for( i = 0; i < MAX_SESSION_IDS; i++ )
+	{
+		if( Sessions[i] == NULL || Sessions[i]->prefixTable == NULL || getLabelWorkerIndex(i) != worker )
+			continue;
+		if( Sessions[i]->prefixTable->staleGeneration != 0 && now >= Sessions[i]->prefixTable->staleDeadline )
+			sweepStaleRib(i, 0, 0, labeledQueueWriter);
+	}
+	expireStaleRibs();
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Process one BMF message 
  * Input: BMF message
- * Output:  0 for success or -1 for failure
+ * Output:  0 for success, 1 if nothing is left of the message to pass on or -1 for failure
  * Note: 1. Apply this BGP update message to the correspondong rib table based on the sessionID.
  	 2. Label this BGP update message based on the correspondong rib.  
  * He Yan @ Jun 22, 2008
@@ -291,7 +905,8 @@ int processBMF (BMF bmf)
 #endif
 	
 	// Need to label the update
-	if( (type != BMF_TYPE_TABLE_TRANSFER) && (Sessions[bmf->sessionID]->configInUse.labelAction == Label ))
+	if( (type != BMF_TYPE_TABLE_TRANSFER) && (Sessions[bmf->sessionID]->configInUse.labelAction == Label 
+		|| Sessions[bmf->sessionID]->configInUse.labelAction == LabelNoDuplicates ))
 	{
 		// Convert BMF message from type BMF_TYPE_MSG_FROM_PEER to type BMF_TYPE_MSG_LABELED
 		bmf->type = BMF_TYPE_MSG_LABELED;
@@ -300,6 +915,9 @@ int processBMF (BMF bmf)
 			log_err( "processBMF, Failed to apply BGP update message to rib table!");
 			return -1;
 		}
+		// the duplicates are counted in the session statistics but not passed on
+		if( Sessions[bmf->sessionID]->configInUse.labelAction == LabelNoDuplicates && stripDuplicatePrefixes(bmf) == 0 )
+			return 1;
 	}
 	else
 	{
@@ -331,38 +949,193 @@ void *
 labelingThread( void *arg ) 
 {
 	log_msg( "Labeling Thread Started" );
-        Queue queues[2] = {peerQueue, mrtQueue};
+	Queue queues[2] = {peerQueue, mrtQueue};
 	QueueReader peerQueueReader =  createQueueReader( queues, 2 );
-	QueueWriter labeledQueueWriter = createQueueWriter( labeledQueue );
+	QueueWriter workerWriters[MAX_LABEL_WORKERS];
+	int i;
+
+	for( i = 0; i < LabelControls.numWorkers; i++ )
+		workerWriters[i] = createQueueWriter( LabelControls.workerQueues[i] );
 
 	while( LabelControls.shutdown == FALSE )
 	{
-                // update the last active time for this thread
+		// update the last active time for this thread
 		LabelControls.lastAction = time(NULL);
 		
 		#ifdef DEBUG
 		debug (__FUNCTION__, "Labeling thread waiting to read from peer queue");
 		#endif
 		BMF bmf = NULL;	
-                int idx = 0;
+		int idx = 0;
 		readQueue( peerQueueReader );
-                for(idx=0;idx<peerQueueReader->count;idx++){
-                  bmf = (BMF)peerQueueReader->items[idx];
-                  // there is no guarantee that we will have an item from each queue
-                  if(bmf == NULL){
-                    continue;
-                  }
+		for(idx=0;idx<peerQueueReader->count;idx++){
+			bmf = (BMF)peerQueueReader->items[idx];
+			// there is no guarantee that we will have an item from each queue
+			if(bmf == NULL){
+				continue;
+			}
+			// the sessions are about to be closed, their ribs are saved from now on
+			if( bmf->type == BMF_TYPE_BGPMON_STOP )
+				LabelControls.stopping = TRUE;
+			// all messages of a session go to the same worker to keep them in order
+			writeQueue( workerWriters[getLabelWorkerIndex(bmf->sessionID)], bmf );
+		}
+	}
+
+	// wake up the workers so they notice the shutdown
+	for( i = 0; i < LabelControls.numWorkers; i++ )
+	{
+		writeQueue( workerWriters[i], NULL );
+		destroyQueueWriter( workerWriters[i] );
+	}
+
+	destroyQueueReader(peerQueueReader);
+	log_warning( "Labeling thread exiting" );
+
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Get the index of the worker that handles a session
+ * Input: sessionID - ID of the session
+ * Output: the worker index
+ * -------------------------------------------------------------------------------------*/
+int getLabelWorkerIndex( int sessionID )
+{
+	return sessionID % LabelControls.numWorkers;
+}
+
+/* wakes up the rib snapshot thread for the last snapshots */
+static pthread_mutex_t	snapshotThreadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	snapshotThreadCond = PTHREAD_COND_INITIALIZER;
+static int		snapshotFinal = FALSE;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Save the rib snapshots of the sessions
+ * Input: final - TRUE for the last snapshots, once the workers are gone
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void saveRibSnapshots( int final )
+{
+	StaleRib *rib;
+	int i, save;
+
+	for( i = 0; i < MAX_SESSION_IDS; i++ )
+	{
+		// the periodic snapshots are left to the last ones once the shutdown started
+		if( !final && LabelControls.shutdown != FALSE )
+			return;
+		// mrt sessions are not restored, so there is no point in saving them
+		lockXMLSessions();
+		save = Sessions[i] != NULL && Sessions[i]->prefixTable != NULL
+			&& ( Sessions[i]->fsm.state == stateEstablished 
+			|| (final && Sessions[i]->fsm.state != stateMrtEstablished) );
+		unlockXMLSessions();
+		if( save )
+			saveRibSnapshot(i);
+	}
+	if( !final )
+		return;
+
+	// the ribs of the sessions the shutdown closed
+	pthread_mutex_lock(&staleRibLock);
+	while( (rib = closedRibs) != NULL )
+	{
+		closedRibs = rib->next;
+		pthread_mutex_unlock(&staleRibLock);
+		saveRibTablesSnapshot(rib->localAddr, rib->remoteAddr, rib->remoteAS, rib->ASNumLen,
+			rib->prefixTable, rib->attributeTable);
+		retireTables(rib->prefixTable, rib->attributeTable, rib->memoryUsed);
+		free(rib);
+		pthread_mutex_lock(&staleRibLock);
+	}
+	pthread_mutex_unlock(&staleRibLock);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of the rib snapshot thread, saves the rib snapshots every
+ *          snapshot interval and once more at the end of the shutdown
+ * Input:
+ * Output:
+ * NOTE: The ribs are read in epoch sections while the workers go on labeling,
+ *       writing and syncing a full table never holds up a worker.
+ * -------------------------------------------------------------------------------------*/
+void *
+ribSnapshotThread( void *arg ) 
+{
+	time_t nextSnapshot = time(NULL) + LabelControls.snapshotInterval;
+	struct timespec wait;
+
+	log_msg( "Rib snapshot thread started" );
+	pthread_mutex_lock(&snapshotThreadLock);
+	while( snapshotFinal == FALSE )
+	{
+		// wake up now and then to check the interval
+		clock_gettime(CLOCK_REALTIME, &wait);
+		wait.tv_sec += THREAD_CHECK_INTERVAL;
+		pthread_cond_timedwait(&snapshotThreadCond, &snapshotThreadLock, &wait);
+		if( snapshotFinal != FALSE || LabelControls.snapshotInterval <= 0 || time(NULL) < nextSnapshot )
+			continue;
+		pthread_mutex_unlock(&snapshotThreadLock);
+		saveRibSnapshots( FALSE );
+		nextSnapshot = time(NULL) + LabelControls.snapshotInterval;
+		pthread_mutex_lock(&snapshotThreadLock);
+	}
+	pthread_mutex_unlock(&snapshotThreadLock);
+
+	// the workers are gone, the ribs that are still open are saved for the next run
+	saveRibSnapshots( TRUE );
+	log_warning( "Rib snapshot thread exiting" );
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of a labeling worker thread, labels the updates of the
+ *          sessions assigned to this worker and writes them to the labeled queue
+ * Input: arg - index of the worker in LabelControls
+ * Output:
+ * Note: Sessions never move between workers and each session has its own rib,
+ *       so workers do not share any rib state.
+ * -------------------------------------------------------------------------------------*/
+void *
+labelingWorkerThread( void *arg ) 
+{
+	int worker = (int)(long)arg;
+	QueueReader workerQueueReader =  createQueueReader( &LabelControls.workerQueues[worker], 1 );
+	QueueWriter labeledQueueWriter = createQueueWriter( labeledQueue );
+	time_t lastStaleCheck = 0;
+	u_int16_t eorAfi = 0;
+	u_int8_t eorSafi = 0;
+	int sessionID;
+
+	log_msg( "Labeling worker %d started", worker );
+	while( LabelControls.shutdown == FALSE )
+	{
+		BMF bmf = NULL;	
+		int idx = 0;
+		readQueue( workerQueueReader );
+		for(idx=0;idx<workerQueueReader->count;idx++){
+		  bmf = (BMF)workerQueueReader->items[idx];
+		  // a NULL item is only used to wake up the worker
+		  if(bmf == NULL){
+		    continue;
+		  }
 		  #ifdef DEBUG
-		  debug (__FUNCTION__, "Labeling thread read from queue, processing BMF");
+		  debug (__FUNCTION__, "Labeling worker %d read from queue, processing BMF", worker);
 		  #endif
 		  incrementSessionMsgCount(bmf->sessionID);
 		
 		  int action  = getSessionLabelAction(bmf->sessionID);
-		  if( action == Label || action == StoreRibOnly ){	
+		  int endOfRib = FALSE;
+		  if( action == Label || action == StoreRibOnly || action == LabelNoDuplicates ){	
 		    if(processBMF( bmf )){
                       free(bmf);
                       continue;
                     }
+		    // the end of rib of a session that kept its rib ends the stale prefixes of that family
+		    if( bmf->type != BMF_TYPE_TABLE_TRANSFER && Sessions[bmf->sessionID]->prefixTable != NULL
+			&& Sessions[bmf->sessionID]->prefixTable->staleGeneration != 0 )
+		      endOfRib = getEndOfRib(bmf->message, getBGPHeaderLength((PBgpHeader)bmf->message), &eorAfi, &eorSafi);
 		  }
 
 
@@ -371,20 +1144,39 @@ labelingThread( void *arg )
 		  {
 			if( checkStateChangeMessage(bmf) )
 			{				
-				if( deleteRibTable(bmf->sessionID) )
+				// a session closed by the shutdown keeps its rib for the last snapshot
+				if( LabelControls.stopping && keepClosedRib(bmf->sessionID) == 0 )
+					log_msg( "Kept the rib of session %d for the last snapshot", bmf->sessionID);
+				// the rib of an established session is kept for the session coming back
+				else if( !LabelControls.stopping && ((StateChangeMsg *)(bmf->message))->oldState == stateEstablished
+					&& keepStaleRib(bmf->sessionID) == 0 )
+					log_msg( "Kept the rib of session %d for %d seconds", bmf->sessionID, LabelControls.staleTime);
+				else if( deleteRibTable(bmf->sessionID) )
 					log_msg( "no rib table for session %d", bmf->sessionID);
 				else
 					log_msg( "Successfully destroy the rib table for session %d!", bmf->sessionID);
 			}
+			else if( ((StateChangeMsg *)(bmf->message))->newState == stateEstablished )
+			{
+				// the updates that follow are labeled against the rib the peer had before,
+				// from a flap of the session or from the last run, a restored rib is 
+				// swept at End-of-RIB or after a bounded time even without stale rib time
+				if( takeStaleRib(bmf->sessionID) < 0 && restoreRibSnapshot(bmf->sessionID) > 0 )
+					markRibStale(Sessions[bmf->sessionID], 
+						LabelControls.staleTime > 0 ? LabelControls.staleTime : RESTORED_RIB_STALE_TIME);
+			}
 
 		  }		
 		
 		  #ifdef DEBUG
-		  debug (__FUNCTION__, "Labeling thread processed BMF, writing to labeled queue");
+		  debug (__FUNCTION__, "Labeling worker %d processed BMF, writing to labeled queue", worker);
 		  #endif
 
 		  if( bmf->type != BMF_TYPE_TABLE_TRANSFER ) {
+			  sessionID = bmf->sessionID;
 			  writeQueue( labeledQueueWriter, bmf);
+			  if( endOfRib )
+				  sweepStaleRib( sessionID, eorAfi, eorSafi, labeledQueueWriter );
 		  }else{
 			  free(bmf);
 		  }
@@ -392,227 +1184,255 @@ labelingThread( void *arg )
 		  #ifdef DEBUG
 		  debug (__FUNCTION__, "wrote to queue");
 		  #endif
-        	}
+		}
 
+		// free the rib memory this batch retired once no reader can see it
+		epochReclaim();
+
+		// stale prefixes are withdrawn once their time is up
+		if( time(NULL) != lastStaleCheck )
+		{
+			checkStaleRibs( worker, labeledQueueWriter );
+			lastStaleCheck = time(NULL);
+		}
 	}
 
-	destroyQueueReader(peerQueueReader);
+	destroyQueueReader(workerQueueReader);
 	destroyQueueWriter(labeledQueueWriter);
-	log_warning( "Labeling thread exiting" );
+	log_warning( "Labeling worker %d exiting", worker );
 
 	return NULL;
 }
 
 /*----------------------------------------------------------------------------------------
- * Purpose: send out the rib table of a session
+ * Purpose: Append a 64 bit value to a BMF message in network byte order
+ * Input:	bmf - the BMF message
+ *		value - the value
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void appendGeneration(BMF bmf, u_int64_t value)
+{
+	u_int32_t word[2];
+
+	word[0] = htonl((u_int32_t)(value >> 32));
+	word[1] = htonl((u_int32_t)value);
+	bgpmonMessageAppend( bmf, word, sizeof(word) );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: send out the rib table of a session to the labeled queue or a sink
  * Input:	ID of a session
- * 		Queue rwiter
- * 		time for each session to tranfer data
+ * 		Queue rwiter, unused with a sink
+ *		sink - where to send the messages, NULL for the labeled queue
+ *		since - checkpoint of an earlier transfer to send the changes since, 0 for the full table
+ *		checkpoint - set to the checkpoint of this transfer, may be NULL
  * Output: 0 means success, -1 means failure
+ * NOTE: see sendRibTable and streamRibTable
  * He Yan @ Jun 22, 2008
  * Mikhail Strizhov @ July 23, 2010
  * -------------------------------------------------------------------------------------*/
-int sendRibTable(int sessionID, QueueWriter labeledQueueWriter, int transfer_time)
+static int transferRibTable(int sessionID, QueueWriter labeledQueueWriter, TransferSink *sink, u_int64_t since, u_int64_t *checkpoint)
 {
-	int i,j, error;
-	int xml_message_counter = 0;
-	u_int32_t num_of_sleeps = 0;
-	int indexes_per_second=0, index_counter=0, timethrloop=0;
-	// get time when we enter this function
-	time_t function_start_stamp, current_time_stamp, function_end_stamp, desired_time;
-
-	// for printing time
-	char desired_time_extended[64];
-	memset(desired_time_extended, 0, 64);
-#ifdef DEBUG
-	struct tm * desired_tm = NULL;
-#endif
-
-	// get time
-	function_start_stamp = time(NULL);
+	int i, reader;
+	u_int32_t tableSize = 0;
+	u_int32_t chargedMessages = 0, chargedBytes = 0;
+	u_int64_t generation = 0;
+	WithdrawEntry *withdrawals = NULL;
+	u_int32_t withdrawCount = 0;
+	TransferState transfer;
+	time_t function_start_stamp = time(NULL);
 
  	Session_structp session;
-	if( sessionID == -1 )
+	if( checkpoint != NULL )
+		*checkpoint = 0;
+	if( sessionID < 0 || sessionID >= MAX_SESSION_IDS )
 	{
 		log_err ("Failed to send a rib table of session %d", sessionID);
-		num_of_sleeps = transfer_time / THREAD_CHECK_INTERVAL;
-		for (i=0; i < num_of_sleeps; i++) 
+		return -1;
+	}
+	memset(&transfer, 0, sizeof(TransferState));
+	transfer.sink = sink;
+
+	// a client's snapshot is not a transfer closeTableTransfer waits for, it keeps
+	// the session from being destroyed while it reads it
+	if( sink != NULL )
+		lockXMLSessions();
+	session = Sessions[sessionID];
+	if( session != NULL )
+	{
+		reader = epochEnter();
+		if( session->attributeTable != NULL )
+			tableSize = session->attributeTable->tableSize;
+		PrefixTable *prefixTable = session->prefixTable;
+		if( prefixTable != NULL )
 		{
-			sleep(THREAD_CHECK_INTERVAL);
-			// after sleep update thread time
-			PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			// check if BGPmon is closing
-			if ( PeriodicEvents.shutdown != FALSE )
-			{
-				return -1;
-			}
+			// everything up to the checkpoint is visible once we read it
+			generation = prefixTable->completeGeneration;
+			__sync_synchronize();
+			if( since != 0 && since >= prefixTable->baseGeneration && since <= generation
+				&& copyRibWithdrawals(prefixTable, since, &withdrawals, &withdrawCount) == 0 )
+				transfer.since = since;
 		}
-		sleep(transfer_time % THREAD_CHECK_INTERVAL);
-		// after sleep update thread time
-		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-		return -1;
+		epochExit(reader);
 	}
-	else
-		 session = Sessions[sessionID];
+	if( sink != NULL )
+		unlockXMLSessions();
 
 	// send TABLE_START message with sessionID
 	BMF bmf_start = createBMF( sessionID, BMF_TYPE_TABLE_START );
-	writeQueue( labeledQueueWriter, bmf_start );
+	if( transfer.since != 0 )
+		appendGeneration( bmf_start, transfer.since );
+	writeTransferBMF( &transfer, labeledQueueWriter, bmf_start );
 
-	if( session == NULL || session->attributeTable == NULL )
+	if( tableSize == 0 )
 	{
+		free(withdrawals);
 		log_err ("Failed to send a rib table of session %d", sessionID);
-		num_of_sleeps = transfer_time / THREAD_CHECK_INTERVAL;
-		for (i=0; i < num_of_sleeps; i++) 
+		return -1;
+	}
+
+	// the withdrawals of a delta come first, a prefix withdrawn and announced
+	// again since the checkpoint is then announced by the walk below
+	if( withdrawCount > 0 )
+	{
+		if( sendWithdrawalBMFs(sessionID, withdrawals, withdrawCount, labeledQueueWriter, &transfer) )
+			log_err ("Failed to send the withdrawals of session %d", sessionID);
+		free(withdrawals);
+		if( sink != NULL )
 		{
-			sleep(THREAD_CHECK_INTERVAL);
-			// after sleep update thread time
-			PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			// check if BGPmon is closing
-			if ( PeriodicEvents.shutdown != FALSE )
-			{
+			if( sink->flush(sink->arg) || transfer.failed )
 				return -1;
-			}
 		}
-		sleep(transfer_time % THREAD_CHECK_INTERVAL);
-		// after sleep update thread time
-		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-		return -1;
+		else if( chargeTransferBudget(transfer.messages, transfer.bytes) )
+			return -1;
+		chargedMessages = transfer.messages;
+		chargedBytes = transfer.bytes;
 	}
 	
-	// calculate how many messages we need to send per second
-	indexes_per_second = session->attributeTable->tableSize / transfer_time;
-	if (indexes_per_second < 1)
-	{
-		indexes_per_second = 1;
-		log_warning("Session %d, Indexes per seconds in table transfer is too low, set it to 1", sessionID);
-	}
-#ifdef DEBUG	  
-	debug(__FUNCTION__, "Session %d, indexes per second is %d, transfer_time is %d", sessionID, indexes_per_second, transfer_time);
-#endif 
 	// to through table size
 	// remember - tablesize is an index table and has different number of attribute entries inside
-	for (i=0; i<session->attributeTable->tableSize; i++) 
+	for (i=0; i<tableSize; i++) 
 	{
-		// check i index is eq to send rate
-		if ( index_counter == indexes_per_second)
-		{
-#ifdef DEBUG		
-			debug(__FUNCTION__, "index is %d", i);
-#endif			
-			// update refresh time
-			PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			// close BGPmon if shutdown is enabled
-			if ( PeriodicEvents.shutdown != FALSE )
-			{
-				return -1;
-			}
-
-			// reset index to 0
-			index_counter = 0;
-
-			// assume that each send block (messages_per_second ) will take 1 second
-			timethrloop++;
+		// close BGPmon if shutdown is enabled, a transfer without a budget never sleeps
+		if ( PeriodicEvents.shutdown != FALSE )
+			return -1;
 
-			current_time_stamp = time(NULL);
-			desired_time = function_start_stamp + timethrloop;
-#ifdef DEBUG
-			debug(__FUNCTION__, "Desired time - current time stamp is %f",difftime(desired_time, current_time_stamp));
-#endif 			
-			if ( (int)(difftime(desired_time, current_time_stamp)) > 2)
-			{
-#ifdef DEBUG			
-				debug(__FUNCTION__, "going to sleep for %f seconds", difftime(desired_time, current_time_stamp));
-#endif				
-				int difference = (int)(difftime(desired_time, current_time_stamp));
-				num_of_sleeps = difference / THREAD_CHECK_INTERVAL;
-				for (j=0; j < num_of_sleeps; j++) 
-				{
-					sleep(THREAD_CHECK_INTERVAL);
-					// after sleep update thread time
-					PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-					// check if BGPmon is closing
-					if ( PeriodicEvents.shutdown != FALSE )
-					{
-						return -1;
-					}
-				}
-				sleep(difference % THREAD_CHECK_INTERVAL);
-				// after sleep update thread time
-				PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			}
-			else 
-			if ( (int)(difftime(desired_time,current_time_stamp)) < 2)
-			{
-#ifdef DEBUG
-				desired_tm = localtime(&desired_time);
-				strftime(desired_time_extended, sizeof(desired_time_extended), "%Y-%m-%dT%H:%M:%SZ", desired_tm);
-				log_warning("Session %d, Table transfer took %d seconds to proceed %d/%d indexes, desired time is %s", sessionID, (int)(difftime(desired_time,current_time_stamp)), i, session->attributeTable->tableSize, desired_time_extended );
-#endif
-			}	
-		} // end of if check
+		// let the queues drain before adding more to them
+		if( sink == NULL && waitForTransferQueues() )
+			return -1;
 
-		//check to see if session has been shut down by another thread
-		if(!Sessions[sessionID]){
+		//check to see if session has been shut down by another thread, a closed
+		//session is destroyed once the transfer is done, see closeTableTransfer
+		if( sink != NULL )
+			lockXMLSessions();
+		if(Sessions[sessionID] != session || isSessionEstablished(sessionID) != TRUE){
+			if( sink != NULL )
+				unlockXMLSessions();
 			log_msg("Session %d closed while sending its RIB!",sessionID);
 			// send TABLE_STOP message with sessionID
 			BMF bmf_stop = createBMF( sessionID, BMF_TYPE_TABLE_STOP);
-			u_int32_t super_counter = htonl(xml_message_counter);
+			u_int32_t super_counter = htonl(transfer.messages);
 			bgpmonMessageAppend( bmf_stop, &super_counter, sizeof(u_int32_t) );   // include number of xml messages in bmf_stop
-			writeQueue( labeledQueueWriter, bmf_stop);
+			writeTransferBMF( &transfer, labeledQueueWriter, bmf_stop );
+			if( sink != NULL )
+				sink->flush(sink->arg);
 			return 0;	//if the session gets torn down somewhere along the line, break out of the loop because there will be no more stuff coming			
 		}
 	
-		if ((error = pthread_rwlock_rdlock (&(session->attributeTable->attrEntries[i].lock))) > 0) 
-		{
-			log_err ("Failed to rdlock an entry in the rib table: %s", strerror(error));
-		 	continue;
-		}
+		// the bucket is read without locks, the labeling thread frees nothing we
+		// can still reach until we leave the epoch section
+		reader = epochEnter();
+		AttrTable *attributeTable = session->attributeTable;
 		AttrNode *node;
-		node = session->attributeTable->attrEntries[i].node;
+		node = (attributeTable != NULL && i < attributeTable->tableSize) ? attributeTable->attrEntries[i].node : NULL;
 		while (node != NULL)
 		{
-			// send messages
-			if  (sendBMFFromAttrNode(node, session->sessionID, labeledQueueWriter) == -1)
+			// send messages, a delta skips the attributes no prefix was added to
+			if  (node->generation > transfer.since 
+				&& sendBMFFromAttrNode(node, sessionID, labeledQueueWriter, &transfer) == -1)
 			{
-				log_err ("Failed to send BMF message for Session %d, Attribute index is %d", session->sessionID, i);
+				log_err ("Failed to send BMF message for Session %d, Attribute index is %d", sessionID, i);
 			}
-			// increment number of sent XML messages
-			xml_message_counter++;
 			node = node->next;
 		}	
-		pthread_rwlock_unlock(&(session->attributeTable->attrEntries[i].lock));
-		
-		// count how many indexes were send
-		index_counter++;
+		epochExit(reader);
+		if( sink != NULL )
+			unlockXMLSessions();
+
+		// a sink is paced by its own flush, the others pay for what this
+		// bucket sent, outside the epoch section as it may sleep
+		if( sink != NULL )
+		{
+			if( transfer.messages != chargedMessages && (sink->flush(sink->arg) || transfer.failed) )
+				return -1;
+			chargedMessages = transfer.messages;
+			continue;
+		}
+		if( transfer.messages != chargedMessages )
+		{
+			if( chargeTransferBudget(transfer.messages - chargedMessages, transfer.bytes - chargedBytes) )
+				return -1;
+			chargedMessages = transfer.messages;
+			chargedBytes = transfer.bytes;
+		}
+		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
 				
 	} // end of tablesize for-loop
 
-	// send TABLE_STOP message with sessionID
+	// send TABLE_STOP message with sessionID and the checkpoint for the next delta
 	BMF bmf_stop = createBMF( sessionID, BMF_TYPE_TABLE_STOP);
-	u_int32_t super_counter = htonl(xml_message_counter);
+	u_int32_t super_counter = htonl(transfer.messages);
 	bgpmonMessageAppend( bmf_stop, &super_counter, sizeof(u_int32_t) );   // include number of xml messages in bmf_stop
-	writeQueue( labeledQueueWriter, bmf_stop);
-	
-	// check time difference with transfer time
-	function_end_stamp = time(NULL);
-#ifdef DEBUG	
-	debug(__FUNCTION__, "Diff btw finish and start functions is %d, transfer_time is %d", function_end_stamp - function_start_stamp, transfer_time);
-#endif	
-	if ( (function_end_stamp - function_start_stamp) > transfer_time)
-	{
-		log_warning("Session %d, Table transfer: Sending messages too slow!", sessionID);
-	}
-	else
-	if ( (function_end_stamp - function_start_stamp) < transfer_time)
-	{
-		log_warning("Session %d, Table transfer: Sending messages too fast!", sessionID);
-	}
+	appendGeneration( bmf_stop, generation );
+	writeTransferBMF( &transfer, labeledQueueWriter, bmf_stop );
+	if( sink != NULL && (sink->flush(sink->arg) || transfer.failed) )
+		return -1;
+	if( checkpoint != NULL )
+		*checkpoint = generation;
 
-	log_msg( "Successfully sent RIB table of session %d ! ", session->sessionID);
+	log_msg( "Successfully sent %s RIB table of session %d%s, %u messages and %u bytes in %d seconds",
+		transfer.since ? "delta" : "full", sessionID, sink ? " to a client" : "",
+		transfer.messages, transfer.bytes, (int)(time(NULL) - function_start_stamp));
 	return 0;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: send out the rib table of a session
+ * Input:	ID of a session
+ * 		Queue rwiter
+ *		since - checkpoint of an earlier transfer to send the changes since, 0 for the full table
+ *		checkpoint - set to the checkpoint of this transfer, may be NULL
+ * Output: 0 means success, -1 means failure
+ * NOTE: the transfer is paced by the global table transfer budget and waits
+ *	while the labeled or xml rib queue is too full, see transferbudget.h
+ *	A delta transfer first withdraws the prefixes withdrawn since the checkpoint,
+ *	then announces the prefixes that got their attributes after it. TABLE_START
+ *	carries since for a delta, TABLE_STOP carries the checkpoint of the transfer.
+ *	If the rib can no longer tell what changed since the checkpoint, it was taken
+ *	from another rib or too many prefixes were withdrawn, the full table is sent.
+ * He Yan @ Jun 22, 2008
+ * Mikhail Strizhov @ July 23, 2010
+ * -------------------------------------------------------------------------------------*/
+int sendRibTable(int sessionID, QueueWriter labeledQueueWriter, u_int64_t since, u_int64_t *checkpoint)
+{
+	return transferRibTable(sessionID, labeledQueueWriter, NULL, since, checkpoint);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: send out the rib table of a session to a sink instead of the labeled queue
+ * Input:	ID of a session
+ *		sink - where to send the messages
+ *		since - checkpoint of an earlier transfer to send the changes since, 0 for the full table
+ *		checkpoint - set to the checkpoint of this transfer, may be NULL
+ * Output: 0 means success, -1 means failure or the sink stopped the transfer
+ * NOTE: the messages are the same as those of sendRibTable, but the transfer
+ *	is paced by the sink alone, not by the table transfer budget or the queues
+ * -------------------------------------------------------------------------------------*/
+int streamRibTable(int sessionID, struct TransferSinkStruct *sink, u_int64_t since, u_int64_t *checkpoint)
+{
+	return transferRibTable(sessionID, NULL, sink, since, checkpoint);
+}
+
 /*--------------------------------------------------------------------------------------
  *  * Purpose: get the last action time of the lable thread
  *   * Input:
@@ -644,8 +1464,27 @@ void signalLabelShutdown()
 void waitForLabelShutdown() 
 {
 	void * status = NULL;
+	int i;
 
 	// wait for label control thread exit
 	pthread_join(LabelControls.labelThread, status);
+
+	// the label control thread wakes up the workers before exiting
+	for( i = 0; i < LabelControls.numWorkers; i++ )
+		pthread_join(LabelControls.workerThreads[i], status);
+
+	// the last snapshots are taken once no worker changes the ribs
+	pthread_mutex_lock(&snapshotThreadLock);
+	snapshotFinal = TRUE;
+	pthread_cond_signal(&snapshotThreadCond);
+	pthread_mutex_unlock(&snapshotThreadLock);
+	pthread_join(LabelControls.snapshotThread, status);
+
+	pthread_mutex_lock(&reaperLock);
+	pthread_cond_signal(&reaperCond);
+	pthread_mutex_unlock(&reaperLock);
+	pthread_join(LabelControls.reaperThread, status);
+
+	freeRibSnapshots();
 }
 
@@ -35,18 +35,32 @@
 #include <pthread.h>
 
 #include "../Queues/queue.h"
+// needed for MAX_LABEL_WORKERS
+#include "../Util/bgpmon_defaults.h"
 
 /* label action */
 enum labelAction {
 	NoAction = 0,	// nothing needs to be done by labeling module
 	Label,			// labeling module needs to store rib and label updates
-	StoreRibOnly	// labeling module only needs to store rib
+	StoreRibOnly,	// labeling module only needs to store rib
+	LabelNoDuplicates	// as Label, but the prefixes labeled as duplicates are left out
 };
 
 struct LabelControls_struct_st {
 	time_t		lastAction;
 	pthread_t 	labelThread;
 	int		shutdown;
+	int		numWorkers;				// number of labeling worker threads
+	Queue		workerQueues[MAX_LABEL_WORKERS];	// dispatcher -> worker queues
+	pthread_t	workerThreads[MAX_LABEL_WORKERS];
+	int		stopping;				// set once BGPMON_STOP is read, the ribs are being saved
+	char		snapshotDir[PATH_MAX_CHARS];		// rib snapshot directory, empty disables snapshots
+	int		snapshotInterval;			// seconds between periodic rib snapshots
+	u_int32_t	journalSize;				// withdrawals kept per rib for delta transfers
+	pthread_t	reaperThread;				// frees the ribs of closed sessions
+	pthread_t	snapshotThread;				// writes the rib snapshots
+	long		retiredMemory;				// bytes of retired ribs not freed yet
+	int		staleTime;				// seconds a rib is kept over a session flap, 0 disables
 };
 typedef struct LabelControls_struct_st LabelControls_struct;
 
@@ -93,6 +107,20 @@ int saveLabelingSettings();
  * -------------------------------------------------------------------------------------*/
 void launchLabelingThread();
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: get the number of labeling worker threads
+ * Input:  none
+ * Output: the number of worker threads
+ * -------------------------------------------------------------------------------------*/
+int getLabelWorkers();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: set the number of labeling worker threads, takes effect on restart
+ * Input:  workers - the number of worker threads (1 to MAX_LABEL_WORKERS)
+ * Output: 0 means success, -1 means failure.
+ * -------------------------------------------------------------------------------------*/
+int setLabelWorkers(int workers);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Clear the content of Rib table of a session
  * Input:  sessionID - ID of the session needs to clear Rib
@@ -113,12 +141,42 @@ int deleteRibTable(int sessionID);
  * Purpose: send out the rib table of a session
  * Input:	ID of a session
  * 		Queue rwiter
- * 		time for each session to tranfer data
+ *		since - checkpoint of an earlier transfer to send the changes since, 0 for the full table
+ *		checkpoint - set to the checkpoint of this transfer, may be NULL
  * Output: 0 means success, -1 means failure
+ * NOTE: the transfer is paced by the global table transfer budget and waits
+ *	while the labeled or xml rib queue is too full, see transferbudget.h
+ *	A delta transfer first withdraws the prefixes withdrawn since the checkpoint,
+ *	then announces the prefixes that got their attributes after it. TABLE_START
+ *	carries since for a delta, TABLE_STOP carries the checkpoint of the transfer.
+ *	If the rib can no longer tell what changed since the checkpoint, it was taken
+ *	from another rib or too many prefixes were withdrawn, the full table is sent.
  * He Yan @ Jun 22, 2008
  * Mikhail Strizhov @ July 23, 2010
  * -------------------------------------------------------------------------------------*/
-int sendRibTable(int sessionID, QueueWriter labeledQueueWriter, int transfer_time);
+int sendRibTable(int sessionID, QueueWriter labeledQueueWriter, u_int64_t since, u_int64_t *checkpoint);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: send out the rib table of a session to a sink instead of the labeled queue
+ * Input:	ID of a session
+ *		sink - where to send the messages
+ *		since - checkpoint of an earlier transfer to send the changes since, 0 for the full table
+ *		checkpoint - set to the checkpoint of this transfer, may be NULL
+ * Output: 0 means success, -1 means failure or the sink stopped the transfer
+ * NOTE: the messages are the same as those of sendRibTable, but the transfer
+ *	is paced by the sink alone, not by the table transfer budget or the queues
+ * -------------------------------------------------------------------------------------*/
+struct TransferSinkStruct;
+int streamRibTable(int sessionID, struct TransferSinkStruct *sink, u_int64_t since, u_int64_t *checkpoint);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the memory held by retired ribs the reaper has not freed yet
+ * Input:
+ * Output: the memory in bytes
+ * NOTE: The rib of a closed session leaves its session at once and is freed
+ *       in the background, this is what is still waiting.
+ * -------------------------------------------------------------------------------------*/
+long getRetiredRibMemory();
 
 /*--------------------------------------------------------------------------------------
  * Purpose: get the last action time of the lable thread
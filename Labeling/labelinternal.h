@@ -41,7 +41,7 @@
 /*----------------------------------------------------------------------------------------
  * Purpose: Process one BMF message 
  * Input: BMF message
- * Output:  0 for success or 1 for failure
+ * Output:  0 for success, 1 if nothing is left of the message to pass on or -1 for failure
  * Note: 1. Apply this BGP update message to the correspondong rib table based on the peerID.
  	 2. Label this BGP update message based on the correspondong rib.  
  * He Yan @ Jun 22, 2008
@@ -59,6 +59,29 @@ int processBMF (BMF bmf);
  * -------------------------------------------------------------------------------------*/ 
 int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Session_structp session, BMF bmf);
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Search the attribute table based on the AS path
+ * Input:	asPath - the data of as path
+ *		len  - the length of as Path in bytes
+ *		session - the corresponding session structure
+ * Output:  Success: the pointer to the existing attribute node or a new created node.
+ *		   Failure: NULL
+ * He Yan @ July 4th, 2008
+ * -------------------------------------------------------------------------------------*/
+AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_int16_t totalAttrLen, u_int16_t basicAttrLen, Session_structp session );
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Apply a reachable prefix to the rib table
+ * Input:	 prefix - the pointer to the prefix
+ *		 attrNode - the associated attribute node of the prefix
+ *		 originatedTS - the timestamp
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * He Yan @ July 4th, 2008 
+ * -------------------------------------------------------------------------------------*/
+int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t originatedTS, Session_structp session, BMF bmf);
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Entry function of rib/label thread
  * Input:
@@ -67,6 +90,47 @@ int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Sessi
  * -------------------------------------------------------------------------------------*/
 void * labelingThread( void *arg ) ;
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of a labeling worker thread, labels the updates of the
+ *          sessions assigned to this worker and writes them to the labeled queue
+ * Input: arg - index of the worker in LabelControls
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void * labelingWorkerThread( void *arg ) ;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of the reaper thread, frees the retired ribs
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void * ribReaperThread( void *arg ) ;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of the rib snapshot thread, saves the rib snapshots every
+ *          snapshot interval and once more at the end of the shutdown
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void * ribSnapshotThread( void *arg ) ;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Get the index of the worker that handles a session
+ * Input: sessionID - ID of the session
+ * Output: the worker index
+ * -------------------------------------------------------------------------------------*/
+int getLabelWorkerIndex( int sessionID );
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the prefix nodes of one bucket of a prefix table
+ * Input:	 prefixTable - the pointer to a prefix table
+ *		 bucket - index of the bucket
+ *		 session - the session the freed memory is accounted to
+ * Output: the number of prefix nodes freed
+ * NOTE: only for a table no reader can see anymore, the prefix count of the
+ *       table is left to the caller.
+ * -------------------------------------------------------------------------------------*/
+u_int32_t destroyPrefixBucket ( PrefixTable *prefixTable, u_int32_t bucket, Session_structp session );
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Destory a prefix table
  * Input:	 prefixTable - the pointer to a prefix table
@@ -76,6 +140,16 @@ void * labelingThread( void *arg ) ;
  * -------------------------------------------------------------------------------------*/
 int destroyPrefixTable ( PrefixTable *prefixTable, Session_structp session );
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the attribute nodes of one bucket of a attribute table
+ * Input:	 attrTable - the pointer to a attribute table
+ *		 bucket - index of the bucket
+ *		 session - the session the freed memory is accounted to
+ * Output: the number of attribute nodes freed
+ * NOTE: only for a table no reader can see anymore, the attribute count of
+ *       the table is left to the caller.
+ * -------------------------------------------------------------------------------------*/
+u_int32_t destroyAttrBucket ( AttrTable *attrTable, u_int32_t bucket, Session_structp session );
 
 /*--------------------------------------------------------------------------------------
  * Purpose: Destory a attribute table
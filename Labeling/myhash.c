@@ -30,6 +30,7 @@
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "myhash.h"
 #include "../Util/log.h"
@@ -82,6 +83,33 @@ INDEX prefix_hash ( const u_char *key, u_int16_t len, u_int32_t table_size )
 }
 
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Hash function for fixed width prefix keys, used to computed the position 
+ *          of the prefix in the rib table
+ * Input:   The 64 bit words of the key, the number of words (1 or 3), the rib table size
+ * Return:  The position of prefix in the table
+ * NOTE:    Multiply-shift hashing, the high 32 bits of the sum of the products are
+ *          mapped to the table with a multiply instead of a modulo.
+ * -------------------------------------------------------------------------------------*/
+INDEX prefix_key_hash ( const u_int64_t *words, int count, u_int32_t table_size )
+{
+   u_int64_t hash_val;
+
+   hash_val = words[0] * 0x9E3779B97F4A7C15ULL;
+   if( count > 1 )
+   {
+      hash_val += words[1] * 0xC2B2AE3D27D4EB4FULL;
+      hash_val += words[2] * 0x165667B19E3779F9ULL;
+   }
+
+#ifdef DEBUG
+   debug(__FUNCTION__, "The computed prefix key hash value is %u.", (INDEX)(((hash_val >> 32) * table_size) >> 32));
+#endif
+
+   return (INDEX)(((hash_val >> 32) * table_size) >> 32);
+}
+
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Hash function, used to computed the position of the attr in the attr table
  * Input:   The ptr and len of the attr, the attr table size
@@ -109,3 +137,54 @@ INDEX attr_hash ( const u_char *key, u_int16_t len, u_int32_t table_size )
 
    return hash_val % table_size;
 }
+
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Mix a block of bytes into a 64 bit fingerprint
+ * Input:   The running hash, the ptr and len of the bytes
+ * Return:  The new hash
+ * NOTE:    The bytes are taken 8 at a time, the last block is zero padded.
+ * -------------------------------------------------------------------------------------*/
+static u_int64_t fingerprint_bytes ( u_int64_t hash_val, const u_char *key, u_int16_t len )
+{
+   u_int64_t w;
+
+   while (len >= 8) {
+      memcpy(&w, key, 8);
+      hash_val = (hash_val ^ w) * 0x9E3779B97F4A7C15ULL;
+      hash_val ^= hash_val >> 29;
+      key += 8;
+      len -= 8;
+   }
+   if (len > 0) {
+      w = 0;
+      memcpy(&w, key, len);
+      hash_val = (hash_val ^ w) * 0x9E3779B97F4A7C15ULL;
+      hash_val ^= hash_val >> 29;
+   }
+   return hash_val;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: 64 bit fingerprint of a full attribute set, used to rule out attribute
+ *          sets that differ before comparing them
+ * Input:   The ptr and len of the AS path, the ptr and len of the other attributes
+ * Return:  The fingerprint
+ * NOTE:    Both lengths are part of the fingerprint, so moving bytes between the
+ *          AS path and the attributes changes it.
+ * -------------------------------------------------------------------------------------*/
+u_int64_t attr_fingerprint ( const u_char *as_path, u_int16_t as_path_len, const u_char *attr, u_int16_t attr_len )
+{
+   u_int64_t hash_val = ((u_int64_t)as_path_len << 16 | attr_len) * 0xC2B2AE3D27D4EB4FULL;
+
+   hash_val = fingerprint_bytes(hash_val, as_path, as_path_len);
+   hash_val = fingerprint_bytes(hash_val, attr, attr_len);
+
+   // final avalanche
+   hash_val ^= hash_val >> 33;
+   hash_val *= 0xFF51AFD7ED558CCDULL;
+   hash_val ^= hash_val >> 33;
+   hash_val *= 0xC4CEB9FE1A85EC53ULL;
+   hash_val ^= hash_val >> 33;
+   return hash_val;
+}
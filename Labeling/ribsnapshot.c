@@ -0,0 +1,576 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: ribsnapshot.c
+ *  Date: Oct 18, 2026
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ribsnapshot.h"
+#include "rtable.h"
+#include "label.h"
+#include "labelinternal.h"
+#include "epoch.h"
+#include "../Util/log.h"
+#include "../site_defaults.h"
+#include "../XML/xml.h"
+
+//#define DEBUG
+
+/* a snapshot file mapped at startup and not restored yet */
+typedef struct RibSnapshotStruct {
+	struct RibSnapshotStruct	*next;
+	char				*map;
+	size_t				len;
+} RibSnapshot;
+
+static RibSnapshot	*snapshots = NULL;
+static pthread_mutex_t	snapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* a record being written, filled inside an epoch section and written out after it */
+typedef struct SnapshotBufStruct {
+	char		*data;
+	size_t		len;
+	size_t		size;
+} SnapshotBuf;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Build the snapshot file name of a session
+ * Input: hdr - the snapshot header with the addresses and AS of the session
+ *		path - buffer of FILENAME_MAX_CHARS characters for the name
+ *		suffix - appended to the name
+ * Output: 0 for success or -1 if the name is too long
+ * -------------------------------------------------------------------------------------*/
+static int ribSnapshotPath(const RibSnapshotHeader *hdr, char *path, const char *suffix)
+{
+	if( snprintf(path, FILENAME_MAX_CHARS, "%s/rib-%s-%s-%u.snap%s", LabelControls.snapshotDir,
+		hdr->localAddr, hdr->remoteAddr, hdr->remoteAS, suffix) >= FILENAME_MAX_CHARS )
+		return -1;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check that a mapped file is a usable snapshot
+ * Input: map - the mapped file
+ *		len - the length of the file
+ * Output: 1 if the snapshot can be restored, 0 otherwise
+ * -------------------------------------------------------------------------------------*/
+static int checkRibSnapshot(const char *map, size_t len)
+{
+	RibSnapshotHeader hdr;
+
+	if( len < sizeof(RibSnapshotHeader) )
+		return 0;
+	memcpy(&hdr, map, sizeof(RibSnapshotHeader));
+	if( memcmp(hdr.magic, RIB_SNAPSHOT_MAGIC, sizeof(RIB_SNAPSHOT_MAGIC)) || hdr.version != RIB_SNAPSHOT_VERSION )
+		return 0;
+	if( time(NULL) - (time_t)hdr.timestamp > RIB_SNAPSHOT_MAX_AGE )
+		return 0;
+	return 1;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Map the rib snapshots found in the snapshot directory, called once at startup
+ * Input:
+ * Output: the number of snapshots that can be restored
+ * -------------------------------------------------------------------------------------*/
+int loadRibSnapshots()
+{
+	DIR		*dir;
+	struct dirent	*ent;
+	struct stat	st;
+	char		path[FILENAME_MAX_CHARS];
+	int		fd, count = 0;
+	size_t		nameLen;
+
+	if( LabelControls.snapshotDir[0] == '\0' )
+		return 0;
+
+	dir = opendir(LabelControls.snapshotDir);
+	if( dir == NULL )
+	{
+		log_msg("No rib snapshots loaded from %s: %s", LabelControls.snapshotDir, strerror(errno));
+		return 0;
+	}
+
+	while( (ent = readdir(dir)) != NULL )
+	{
+		nameLen = strlen(ent->d_name);
+		if( strncmp(ent->d_name, "rib-", 4) || nameLen < 5 || strcmp(ent->d_name + nameLen - 5, ".snap") )
+			continue;
+
+		if( snprintf(path, FILENAME_MAX_CHARS, "%s/%s", LabelControls.snapshotDir, ent->d_name) >= FILENAME_MAX_CHARS )
+		{
+			log_warning("Ignoring rib snapshot %s, the path is too long", ent->d_name);
+			continue;
+		}
+		fd = open(path, O_RDONLY);
+		if( fd < 0 )
+		{
+			log_warning("Failed to open rib snapshot %s: %s", path, strerror(errno));
+			continue;
+		}
+		if( fstat(fd, &st) || st.st_size < sizeof(RibSnapshotHeader) )
+		{
+			close(fd);
+			continue;
+		}
+
+		char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if( map == MAP_FAILED )
+		{
+			log_warning("Failed to map rib snapshot %s: %s", path, strerror(errno));
+			continue;
+		}
+		if( !checkRibSnapshot(map, st.st_size) )
+		{
+			log_msg("Ignoring old or unknown rib snapshot %s", path);
+			munmap(map, st.st_size);
+			continue;
+		}
+
+		RibSnapshot *snapshot = malloc(sizeof(RibSnapshot));
+		if( snapshot == NULL )
+		{
+			log_err("loadRibSnapshots: malloc failed");
+			munmap(map, st.st_size);
+			break;
+		}
+		snapshot->map = map;
+		snapshot->len = st.st_size;
+		pthread_mutex_lock(&snapshotLock);
+		snapshot->next = snapshots;
+		snapshots = snapshot;
+		pthread_mutex_unlock(&snapshotLock);
+		count++;
+	}
+	closedir(dir);
+
+	log_msg("Loaded %d rib snapshots from %s", count, LabelControls.snapshotDir);
+	return count;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Release the snapshots that were not restored
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void freeRibSnapshots()
+{
+	RibSnapshot *snapshot;
+
+	pthread_mutex_lock(&snapshotLock);
+	while( snapshots != NULL )
+	{
+		snapshot = snapshots;
+		snapshots = snapshot->next;
+		munmap(snapshot->map, snapshot->len);
+		free(snapshot);
+	}
+	pthread_mutex_unlock(&snapshotLock);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Append bytes to a snapshot buffer
+ * Input: buf - the buffer
+ *		data - the bytes
+ *		len - the number of bytes
+ * Output: 0 for success or -1 if the buffer could not grow
+ * -------------------------------------------------------------------------------------*/
+static int snapshotBufAdd(SnapshotBuf *buf, const void *data, size_t len)
+{
+	char	*grown;
+	size_t	size;
+
+	if( buf->len + len > buf->size )
+	{
+		for( size = (buf->size > 0) ? buf->size : 4096; size < buf->len + len; size *= 2 )
+			;
+		grown = realloc(buf->data, size);
+		if( grown == NULL )
+			return -1;
+		buf->data = grown;
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add the record of an attribute node to a snapshot buffer
+ * Input: buf - the buffer
+ *		attrNode - the attribute node
+ *		v4 - the compact IPv4 table of the session or NULL
+ * Output: the number of prefixes added, 0 if the node has none or -1 if the buffer 
+ *         could not grow
+ * NOTE: Called inside an epoch section. The prefixes are counted as they are 
+ *       added, so the count of the record matches its prefixes even while the
+ *       labeling worker changes the rib.
+ * -------------------------------------------------------------------------------------*/
+static int addAttrRecord(SnapshotBuf *buf, AttrNode *attrNode, V4TableData *v4)
+{
+	RibSnapshotAttr	rec;
+	PrefixRefNode	*ref;
+	Prefix		*prefix;
+	size_t		start = buf->len;
+	u_int32_t	slot, handle;
+	int		err;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.asPathLen = attrNode->asPath->asPathData.len;
+	rec.totalAttrLen = attrNode->totalAttrLen;
+	rec.basicAttrLen = attrNode->basicAttrLen;
+	err = snapshotBufAdd(buf, &rec, sizeof(rec));
+	err |= snapshotBufAdd(buf, attrNode->asPath->asPathData.data, rec.asPathLen);
+	err |= snapshotBufAdd(buf, attrNode->attr, rec.totalAttrLen);
+
+	for( ref = attrNode->prefixRefNode; ref != NULL && !err; ref = ref->next )
+	{
+		prefix = &ref->prefixNode->keyPrefix;
+		err = snapshotBufAdd(buf, prefix, sizeof(Prefix) + (PREFIX_SIZE(prefix->addr.p_len)));
+		rec.prefixCount++;
+	}
+	handle = attrNode->v4Handle;
+	if( v4 != NULL && handle != V4_NONE && handle < v4->handleSize && v4->values[handle] == attrNode )
+	{
+		for( slot = v4->heads[handle]; slot != V4_NONE && !err; slot = v4->next[slot] )
+		{
+			u_int64_t keyBuf = v4->keys[slot];
+			if( v4->attrs[slot] != handle )
+				continue;
+			prefix = (Prefix *)&keyBuf;
+			err = snapshotBufAdd(buf, prefix, sizeof(Prefix) + (PREFIX_SIZE(prefix->addr.p_len)));
+			rec.prefixCount++;
+		}
+	}
+
+	if( err || rec.prefixCount == 0 )
+	{
+		buf->len = start;
+		return err ? -1 : 0;
+	}
+	memcpy(buf->data + start, &rec, sizeof(rec));
+	return rec.prefixCount;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write rib tables to a snapshot file
+ * Input: hdr - the snapshot header with the addresses, AS and AS number length
+ *		sessionID - the session the tables are read from, -1 if they are not
+ *		in a session anymore
+ *		attrTable, prefixTable - the tables
+ * Output: 0 for success or -1 for failure
+ * NOTE: The tables are read in epoch sections of one attribute bucket and each 
+ *       bucket is written out after its section. The tables of a session must
+ *       still be the ones of the session in every section, a rib that was deleted
+ *       or replaced meanwhile is not saved. The snapshot is written to a temporary
+ *       file and renamed, so a crash never leaves a partial snapshot behind.
+ * -------------------------------------------------------------------------------------*/
+static int writeRibSnapshot(RibSnapshotHeader *hdr, int sessionID, AttrTable *attrTable, PrefixTable *prefixTable)
+{
+	Session_structp		session;
+	AttrNode		*attrNode;
+	V4TableData		*v4;
+	SnapshotBuf		buf;
+	char			path[FILENAME_MAX_CHARS];
+	char			tmpPath[FILENAME_MAX_CHARS];
+	FILE			*f;
+	u_int32_t		i;
+	int			reader, count, err = 0;
+
+	memcpy(hdr->magic, RIB_SNAPSHOT_MAGIC, sizeof(RIB_SNAPSHOT_MAGIC));
+	hdr->version = RIB_SNAPSHOT_VERSION;
+	hdr->attrCount = 0;
+	hdr->prefixCount = 0;
+	hdr->timestamp = time(NULL);
+
+	if( ribSnapshotPath(hdr, path, "") || ribSnapshotPath(hdr, tmpPath, ".tmp") )
+	{
+		log_err("Failed to save rib snapshot of %s: the path is too long", hdr->remoteAddr);
+		return -1;
+	}
+	f = fopen(tmpPath, "w");
+	if( f == NULL )
+	{
+		log_err("Failed to open rib snapshot %s: %s", tmpPath, strerror(errno));
+		return -1;
+	}
+	// the header is written again with the counts at the end
+	fwrite(hdr, sizeof(RibSnapshotHeader), 1, f);
+
+	memset(&buf, 0, sizeof(buf));
+	for( i = 0; i < attrTable->tableSize && !err; i++ )
+	{
+		buf.len = 0;
+		reader = epochEnter();
+		if( sessionID >= 0 )
+		{
+			lockXMLSessions();
+			session = Sessions[sessionID];
+			if( session == NULL || session->attributeTable != attrTable || session->prefixTable != prefixTable )
+				err = 1;
+			unlockXMLSessions();
+		}
+		v4 = (!err && prefixTable->v4Table != NULL) ? prefixTable->v4Table->data : NULL;
+		for( attrNode = err ? NULL : attrTable->attrEntries[i].node; attrNode != NULL && !err; attrNode = attrNode->next )
+		{
+			count = addAttrRecord(&buf, attrNode, v4);
+			if( count < 0 )
+				err = 1;
+			else if( count > 0 )
+			{
+				hdr->attrCount++;
+				hdr->prefixCount += count;
+			}
+		}
+		epochExit(reader);
+		if( !err && buf.len > 0 )
+			fwrite(buf.data, buf.len, 1, f);
+	}
+	free(buf.data);
+
+	rewind(f);
+	fwrite(hdr, sizeof(RibSnapshotHeader), 1, f);
+	if( err || ferror(f) || fflush(f) || fsync(fileno(f)) )
+	{
+		if( err )
+			log_err("Failed to write rib snapshot %s: the rib went away or memory ran out", tmpPath);
+		else
+			log_err("Failed to write rib snapshot %s: %s", tmpPath, strerror(errno));
+		fclose(f);
+		unlink(tmpPath);
+		return -1;
+	}
+	fclose(f);
+
+	if( rename(tmpPath, path) )
+	{
+		log_err("Failed to rename rib snapshot %s: %s", tmpPath, strerror(errno));
+		unlink(tmpPath);
+		return -1;
+	}
+	log_msg("Saved rib snapshot of %s: %u attributes, %u prefixes", hdr->remoteAddr, hdr->attrCount, hdr->prefixCount);
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib table of a session to its snapshot file
+ * Input: sessionID - the ID of the session
+ * Output: 0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+int saveRibSnapshot(int sessionID)
+{
+	Session_structp		session;
+	RibSnapshotHeader	hdr;
+	AttrTable		*attrTable = NULL;
+	PrefixTable		*prefixTable = NULL;
+	int			reader;
+
+	if( LabelControls.snapshotDir[0] == '\0' )
+		return 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	// the tables are read in epoch sections, the session itself may be destroyed
+	reader = epochEnter();
+	lockXMLSessions();
+	session = Sessions[sessionID];
+	if( session != NULL && session->prefixTable != NULL && session->attributeTable != NULL )
+	{
+		attrTable = session->attributeTable;
+		prefixTable = session->prefixTable;
+		hdr.remoteAS = session->configInUse.remoteAS2;
+		memcpy(hdr.localAddr, session->configInUse.localAddr, ADDR_MAX_CHARS-1);
+		memcpy(hdr.remoteAddr, session->configInUse.remoteAddr, ADDR_MAX_CHARS-1);
+		hdr.ASNumLen = session->fsm.ASNumlen;
+	}
+	unlockXMLSessions();
+	epochExit(reader);
+	if( attrTable == NULL )
+		return 0;
+	return writeRibSnapshot(&hdr, sessionID, attrTable, prefixTable);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib tables taken out of a closed session to its snapshot file
+ * Input: localAddr, remoteAddr, remoteAS - the session the tables were taken from
+ *		ASNumLen - the AS number length of the session
+ *		prefixTable, attrTable - the tables
+ * Output: 0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+int saveRibTablesSnapshot(const char *localAddr, const char *remoteAddr, u_int32_t remoteAS, 
+	u_int32_t ASNumLen, PrefixTable *prefixTable, AttrTable *attrTable)
+{
+	RibSnapshotHeader	hdr;
+
+	if( LabelControls.snapshotDir[0] == '\0' || prefixTable == NULL || attrTable == NULL )
+		return 0;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.remoteAS = remoteAS;
+	strncat(hdr.localAddr, localAddr, ADDR_MAX_CHARS-1);
+	strncat(hdr.remoteAddr, remoteAddr, ADDR_MAX_CHARS-1);
+	hdr.ASNumLen = ASNumLen;
+	return writeRibSnapshot(&hdr, -1, attrTable, prefixTable);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Take the loaded snapshot of a session out of the list
+ * Input: session - the session
+ * Output: the snapshot or NULL if there is none
+ * -------------------------------------------------------------------------------------*/
+static RibSnapshot *takeRibSnapshot(Session_structp session)
+{
+	RibSnapshot		*snapshot, *prev = NULL;
+	RibSnapshotHeader	hdr;
+
+	pthread_mutex_lock(&snapshotLock);
+	for( snapshot = snapshots; snapshot != NULL; prev = snapshot, snapshot = snapshot->next )
+	{
+		memcpy(&hdr, snapshot->map, sizeof(hdr));
+		if( hdr.remoteAS == session->configInUse.remoteAS2
+			&& !strncmp(hdr.remoteAddr, session->configInUse.remoteAddr, ADDR_MAX_CHARS)
+			&& !strncmp(hdr.localAddr, session->configInUse.localAddr, ADDR_MAX_CHARS) )
+		{
+			if( prev == NULL )
+				snapshots = snapshot->next;
+			else
+				prev->next = snapshot->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&snapshotLock);
+	return snapshot;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Fill the rib table of a session from its loaded snapshot
+ * Input: sessionID - the ID of the session
+ * Output: the number of restored prefixes, 0 if there was no usable snapshot
+ *         or -1 if the snapshot was corrupt
+ * NOTE: The restored prefixes are not labeled and do not count as NANN.
+ * -------------------------------------------------------------------------------------*/
+int restoreRibSnapshot(int sessionID)
+{
+	Session_structp		session = Sessions[sessionID];
+	RibSnapshot		*snapshot;
+	RibSnapshotHeader	hdr;
+	RibSnapshotAttr		rec;
+	AttrNode		*attrNode;
+	u_int64_t		prefixBuf[8];
+	Prefix			*prefix = (Prefix *)prefixBuf;
+	size_t			pos, prefixLen;
+	u_int32_t		i, j;
+	int			nannRcvd, err = 0;
+
+	if( session == NULL || session->prefixTable == NULL || session->attributeTable == NULL )
+		return 0;
+	snapshot = takeRibSnapshot(session);
+	if( snapshot == NULL )
+		return 0;
+
+	memcpy(&hdr, snapshot->map, sizeof(hdr));
+	if( hdr.ASNumLen != session->fsm.ASNumlen )
+	{
+		log_msg("Not restoring rib snapshot of session %d: AS number length changed", sessionID);
+		munmap(snapshot->map, snapshot->len);
+		free(snapshot);
+		return 0;
+	}
+
+	madvise(snapshot->map, snapshot->len, MADV_SEQUENTIAL);
+	nannRcvd = session->stats.nannRcvd;
+	// the restored prefixes are one generation, like a single update
+	session->prefixTable->generation++;
+	pos = sizeof(hdr);
+	for( i = 0; i < hdr.attrCount && !err; i++ )
+	{
+		if( pos + sizeof(rec) > snapshot->len )
+		{
+			err = 1;
+			break;
+		}
+		memcpy(&rec, snapshot->map + pos, sizeof(rec));
+		pos += sizeof(rec);
+		if( pos + rec.asPathLen + rec.totalAttrLen > snapshot->len || rec.basicAttrLen > rec.totalAttrLen )
+		{
+			err = 1;
+			break;
+		}
+		attrNode = searchAttrNode((u_char *)snapshot->map + pos, rec.asPathLen,
+			(u_char *)snapshot->map + pos + rec.asPathLen, rec.totalAttrLen, rec.basicAttrLen, session);
+		pos += rec.asPathLen + rec.totalAttrLen;
+		if( attrNode == NULL )
+		{
+			err = 1;
+			break;
+		}
+
+		for( j = 0; j < rec.prefixCount; j++ )
+		{
+			if( pos + sizeof(Prefix) > snapshot->len )
+			{
+				err = 1;
+				break;
+			}
+			memcpy(prefix, snapshot->map + pos, sizeof(Prefix));
+			prefixLen = sizeof(Prefix) + (PREFIX_SIZE(prefix->addr.p_len));
+			if( prefixLen > sizeof(prefixBuf) || pos + prefixLen > snapshot->len )
+			{
+				err = 1;
+				break;
+			}
+			memcpy(prefix, snapshot->map + pos, prefixLen);
+			pos += prefixLen;
+			applyReachablePrefix(prefix, attrNode, hdr.timestamp, session, NULL);
+		}
+	}
+	session->stats.nannRcvd = nannRcvd;
+	__sync_synchronize();
+	session->prefixTable->completeGeneration = session->prefixTable->generation;
+	munmap(snapshot->map, snapshot->len);
+	free(snapshot);
+
+	if( err )
+	{
+		log_err("Rib snapshot of session %d is corrupt, starting with an empty rib", sessionID);
+		cleanRibTable(sessionID);
+		return -1;
+	}
+	log_msg("Restored rib snapshot of session %d: %u attributes, %u prefixes", sessionID, hdr.attrCount, hdr.prefixCount);
+	return hdr.prefixCount;
+}
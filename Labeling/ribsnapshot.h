@@ -0,0 +1,117 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: ribsnapshot.h
+ *  Date: Oct 18, 2026
+ */
+
+
+#ifndef RIBSNAPSHOT_H_
+#define RIBSNAPSHOT_H_
+
+#include <sys/types.h>
+// needed for ADDR_MAX_CHARS
+#include "../Util/bgpmon_defaults.h"
+// needed for PrefixTable and AttrTable
+#include "rtable.h"
+
+/*----------------------------------------------------------------------------------------
+ * Rib snapshot file format.
+ * One file per session, named rib-<local addr>-<remote addr>-<remote AS>.snap.
+ * The file starts with a RibSnapshotHeader, followed by attrCount attribute
+ * records. Each record is a RibSnapshotAttr, the AS path, the attributes and
+ * then prefixCount prefixes. A prefix is stored as a Prefix header followed by
+ * PREFIX_SIZE(p_len) address bytes. Values are in host byte order, a snapshot is
+ * only meant to be read back by the same host.
+ * -------------------------------------------------------------------------------------*/
+#define RIB_SNAPSHOT_MAGIC	"BGPMRIB"
+#define RIB_SNAPSHOT_VERSION	1
+
+typedef struct RibSnapshotHeaderStruct {
+   char			magic[8];
+   u_int32_t		version;
+   u_int32_t		remoteAS;
+   char			localAddr[ADDR_MAX_CHARS];
+   char			remoteAddr[ADDR_MAX_CHARS];
+   u_int32_t		ASNumLen;
+   u_int32_t		attrCount;
+   u_int32_t		prefixCount;
+   u_int32_t		timestamp;
+} RibSnapshotHeader;
+
+typedef struct RibSnapshotAttrStruct {
+   u_int32_t		prefixCount;
+   u_int16_t		asPathLen;
+   u_int16_t		totalAttrLen;
+   u_int16_t		basicAttrLen;
+   u_int16_t		reserved;
+} RibSnapshotAttr;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Map the rib snapshots found in the snapshot directory, called once at startup
+ * Input:
+ * Output: the number of snapshots that can be restored
+ * -------------------------------------------------------------------------------------*/
+int loadRibSnapshots();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Release the snapshots that were not restored
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void freeRibSnapshots();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib table of a session to its snapshot file
+ * Input: sessionID - the ID of the session
+ * Output: 0 for success or -1 for failure
+ * NOTE: Reads the rib like the other readers that do not own it, so it is called
+ *       by the rib snapshot thread and does not hold up the labeling worker. 
+ *       Only one snapshot of a session may be written at a time.
+ * -------------------------------------------------------------------------------------*/
+int saveRibSnapshot(int sessionID);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib tables taken out of a closed session to its snapshot file
+ * Input: localAddr, remoteAddr, remoteAS - the session the tables were taken from
+ *		ASNumLen - the AS number length of the session
+ *		prefixTable, attrTable - the tables
+ * Output: 0 for success or -1 for failure
+ * NOTE: Nothing may change the tables meanwhile.
+ * -------------------------------------------------------------------------------------*/
+int saveRibTablesSnapshot(const char *localAddr, const char *remoteAddr, u_int32_t remoteAS, 
+	u_int32_t ASNumLen, PrefixTable *prefixTable, AttrTable *attrTable);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Fill the rib table of a session from its loaded snapshot
+ * Input: sessionID - the ID of the session
+ * Output: the number of restored prefixes, 0 if there was no usable snapshot
+ *         or -1 if the snapshot was corrupt
+ * NOTE: Must be called by the labeling worker of the session. A snapshot is
+ *       restored at most once.
+ * -------------------------------------------------------------------------------------*/
+int restoreRibSnapshot(int sessionID);
+
+#endif /*RIBSNAPSHOT_H_*/
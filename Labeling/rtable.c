@@ -51,13 +51,34 @@
 #include "../Queues/queue.h"
 
 #include "myhash.h"
+#include "epoch.h"
 /* needed for copying BGPmon Internal Format messages */
 #include "../Util/bgpmon_formats.h"
 
 //#define DEBUG
 
-static u_char buffer[MAX_BGP_MESSAGE_LEN];
-static u_char buffer1[MAX_BGP_MESSAGE_LEN];
+/* the base generation given to the last prefix table created */
+static u_int64_t lastBaseGeneration = 0;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get a base generation for a new prefix table
+ * Input:
+ * Output: a base generation above that of any other table of this process
+ * NOTE: the base is built from the current time so checkpoints of an earlier run
+ *       of BGPmon are not valid either. Every table has 2^32 generations of its own.
+ * -------------------------------------------------------------------------------------*/
+static u_int64_t newBaseGeneration()
+{
+	u_int64_t base, last;
+
+	do {
+		last = lastBaseGeneration;
+		base = (u_int64_t)time(NULL) << 32;
+		if( base <= last )
+			base = last + ((u_int64_t)1 << 32);
+	} while( !__sync_bool_compare_and_swap(&lastBaseGeneration, last, base) );
+	return base;
+}
 
 
 /*--------------------------------------------------------------------------------------
@@ -71,31 +92,53 @@ static u_char buffer1[MAX_BGP_MESSAGE_LEN];
 void createPrefixTable(int sessionID, u_int32_t prefixTableSize, u_int16_t  maxCollision) 
 {
 	u_int32_t i;
+	PrefixTable *prefixTable;
 
 	Session_structp session = Sessions[sessionID];
 	//assert(session->prefixTable == NULL);
 	
 	/*Allocation Memory*/
-	session->prefixTable = malloc(sizeof(struct PrefixTableStruct));
+	prefixTable = malloc(sizeof(struct PrefixTableStruct));
 
-	if( session->prefixTable )
+	if( prefixTable )
 	{
 		/* Initialize prefix table */
-		session->prefixTable->tableSize = prefixTableSize; 
-		session->prefixTable->prefixCount = 0;
-		session->prefixTable->ocupiedSize = 0;
-		session->prefixTable->maxNodeCount = 0;
-		session->prefixTable->maxCollision = maxCollision;
-		session->prefixTable->prefixEntries = calloc (prefixTableSize, sizeof(PrefixEntry));
+		prefixTable->tableSize = prefixTableSize; 
+		prefixTable->prefixCount = 0;
+		prefixTable->ocupiedSize = 0;
+		prefixTable->maxNodeCount = 0;
+		prefixTable->maxCollision = maxCollision;
+		prefixTable->prefixEntries = calloc (prefixTableSize, sizeof(PrefixEntry));
 	
-		if (session->prefixTable->prefixEntries == NULL) 
+		if (prefixTable->prefixEntries == NULL) 
 	  		log_fatal( "createPrefixTable: session %d calloc failed", sessionID );
 		
-		for (i=0; i<session->prefixTable->tableSize; i++) {
-		  session->prefixTable->prefixEntries[i].nodeCount = 0;
-		  session->prefixTable->prefixEntries[i].node = NULL;
+		for (i=0; i<prefixTable->tableSize; i++) {
+		  prefixTable->prefixEntries[i].nodeCount = 0;
+		  prefixTable->prefixEntries[i].node = NULL;
 		}   
 		session->stats.memoryUsed += sizeof(PrefixTable) + prefixTableSize*sizeof(PrefixEntry);
+
+		/* IPv4 unicast prefixes are kept in the compact table */
+		prefixTable->v4Table = createV4Table(V4_TABLE_INITIAL_SIZE);
+		session->stats.memoryUsed += v4TableMemory(prefixTable->v4Table);
+
+		/* generations and the withdrawals for delta transfers */
+		prefixTable->baseGeneration = newBaseGeneration();
+		prefixTable->generation = prefixTable->baseGeneration;
+		prefixTable->completeGeneration = prefixTable->baseGeneration;
+		pthread_mutex_init(&prefixTable->journal.lock, NULL);
+		prefixTable->journal.entries = NULL;
+		prefixTable->journal.size = 0;
+		prefixTable->journal.start = 0;
+		prefixTable->journal.count = 0;
+		prefixTable->journal.floor = prefixTable->baseGeneration;
+		prefixTable->staleGeneration = 0;
+		prefixTable->staleDeadline = 0;
+
+		/* readers may pick up the table as soon as it is set */
+		__sync_synchronize();
+		session->prefixTable = prefixTable;
 		log_msg( "createPrefixTable: session %d successfully", session->sessionID);
 	}
 	else
@@ -120,40 +163,66 @@ void printPrefixTable(Session_structp session)
 	log_msg("prefix table max collision: %d", session->prefixTable->maxCollision);
 }
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the prefix nodes of one bucket of a prefix table
+ * Input:	 prefixTable - the pointer to a prefix table
+ *		 bucket - index of the bucket
+ *		 session - the session the freed memory is accounted to
+ * Output: the number of prefix nodes freed
+ * NOTE: only for a table no reader can see anymore, the prefix count of the
+ *       table is left to the caller.
+ * -------------------------------------------------------------------------------------*/
+u_int32_t destroyPrefixBucket ( PrefixTable *prefixTable, u_int32_t bucket, Session_structp session )
+{
+	u_int32_t      prefixCount = 0;
+	PrefixNode    *prefixNode;
+	PrefixNode    *nextPrefixNode;
+
+	prefixNode = prefixTable->prefixEntries[bucket].node;
+	while (prefixNode != NULL) 
+	{
+		nextPrefixNode = prefixNode->next;
+		session->stats.memoryUsed -= ( sizeof(PrefixNode) + (PREFIX_KEY_BYTES(prefixNode->keyPrefix.addr.p_len)) ); 
+		free(prefixNode);
+		prefixCount++;
+		prefixNode = nextPrefixNode;
+	}
+	prefixTable->prefixEntries[bucket].nodeCount= 0;
+	prefixTable->prefixEntries[bucket].node = NULL;
+	return prefixCount;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Destory a prefix table
  * Input:	 prefixTable - the pointer to a prefix table
  *		 session - the corresponding session structure which includes the prefix table
  * Output: 0 means success, -1 means failure.
+ * NOTE: the withdrawal journal is released too, the table can not be used again
  * He Yan @ June 15, 2008
  * -------------------------------------------------------------------------------------*/
 int destroyPrefixTable ( PrefixTable *prefixTable, Session_structp session )
 {
 	u_int32_t      i, prefixCount = 0;
-	PrefixNode    *prefixNode;
-	PrefixNode    *nextPrefixNode;
 
 	if( prefixTable == NULL)
 		return -1;
 	
 	for( i=0; i< prefixTable->tableSize; i++ ) 
+		prefixCount += destroyPrefixBucket(prefixTable, i, session);
+
+	if( prefixTable->v4Table != NULL )
 	{
-		if (prefixTable->prefixEntries[i].node != NULL) 
-		{
-			prefixNode = prefixTable->prefixEntries[i].node;
-			while (prefixNode != NULL) 
-			{
-				nextPrefixNode = prefixNode->next;
-				session->stats.memoryUsed -= ( sizeof(PrefixNode) + (PREFIX_SIZE(prefixNode->keyPrefix.addr.p_len)) ); 
-				free(prefixNode);
-				prefixCount++;
-				prefixNode = nextPrefixNode;
-			}
-	  	}
-	    prefixTable->prefixEntries[i].nodeCount= 0;
-	    prefixTable->prefixEntries[i].node = NULL;
+		prefixCount += prefixTable->v4Table->count;
+		clearV4Table(prefixTable->v4Table);
 	}
 
+	session->stats.memoryUsed -= (long)prefixTable->journal.size * sizeof(WithdrawEntry);
+	free(prefixTable->journal.entries);
+	prefixTable->journal.entries = NULL;
+	prefixTable->journal.size = 0;
+	prefixTable->journal.count = 0;
+	pthread_mutex_destroy(&prefixTable->journal.lock);
+
 	if( prefixTable->prefixCount != prefixCount)
 	{
 		log_err("prefixTable's prefix count(%d) != actual prefix count(%d)", prefixTable->prefixCount, prefixCount);
@@ -177,34 +246,41 @@ int destroyPrefixTable ( PrefixTable *prefixTable, Session_structp session )
 void createAttributeTable(int sessionID, u_int32_t attributeTableSize, u_int16_t  maxCollision) 
 {
 	u_int32_t i;
-	int error;
+	AttrTable *attributeTable;
 
 	Session_structp session = Sessions[sessionID];
 	assert(session->attributeTable== NULL);
 	
 	/*Allocation Memory*/
-	session->attributeTable = malloc(sizeof(struct AttrTableStruct));
+	attributeTable = malloc(sizeof(struct AttrTableStruct));
 
-	if( session->attributeTable )
+	if( attributeTable )
 	{
-		session->attributeTable->tableSize = attributeTableSize;
-		session->attributeTable->attrCount = 0;
-		session->attributeTable->ocupiedSize = 0;
-		session->attributeTable->maxNodeCount = 0;  
-		session->attributeTable->maxCollision = maxCollision;
-		session->attributeTable->attrEntries = calloc(attributeTableSize, sizeof(AttrEntry));
-		if (session->attributeTable->attrEntries == NULL) 
+		attributeTable->tableSize = attributeTableSize;
+		attributeTable->attrCount = 0;
+		attributeTable->ocupiedSize = 0;
+		attributeTable->maxNodeCount = 0;  
+		attributeTable->maxCollision = maxCollision;
+		attributeTable->attrEntries = calloc(attributeTableSize, sizeof(AttrEntry));
+		if (attributeTable->attrEntries == NULL) 
 		  log_fatal( "createAttributeTable: session %d calloc failed", session->sessionID);
 		
-		for (i=0; i<session->attributeTable->tableSize; i++)
+		for (i=0; i<attributeTable->tableSize; i++)
 		{
-			session->attributeTable->attrEntries[i].nodeCount = 0;
-			session->attributeTable->attrEntries[i].node = NULL;
- 			if ((error = pthread_rwlock_init(&(session->attributeTable->attrEntries[i].lock), NULL)) > 0)       
-		     	log_fatal("createAttributeTable: session %d failed to init rwlock: %s\n", session->sessionID, strerror(error));    			
+			attributeTable->attrEntries[i].nodeCount = 0;
+			attributeTable->attrEntries[i].node = NULL;
 		}
+		for (i=0; i<ATTR_CACHE_SIZE; i++)
+			attributeTable->recent[i] = NULL;
+		attributeTable->recentNext = 0;
+		memset(&attributeTable->originIndex, 0, sizeof(AsIndex));
+		memset(&attributeTable->transitIndex, 0, sizeof(AsIndex));
 		
 		session->stats.memoryUsed += sizeof(AttrTable) + attributeTableSize*sizeof(AttrEntry);
+
+		/* readers may pick up the table as soon as it is set */
+		__sync_synchronize();
+		session->attributeTable = attributeTable;
 		log_msg( "createAttributeTable: session %d successfully", session->sessionID );
 	}
 	else
@@ -259,6 +335,277 @@ void printAttrTable( Session_structp session )
 	log_msg("attribute table AS Path Count: %d", asPathCount);
 }
 
+/* the most ASes an AS path of a BGP message can have */
+#define MAX_PATH_ASES (MAX_BGP_MESSAGE_LEN / 2)
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Find the entry of an AS in an AS index
+ * Input:	index - the origin or transit index of an attribute table
+ *		as - the AS number
+ * Output: the entry of the AS or NULL if no attribute node has it
+ * -------------------------------------------------------------------------------------*/ 
+static AsIndexHead *findAsIndexHead( AsIndex *index, u_int32_t as )
+{
+	AsIndexHead *head;
+
+	for( head = index->heads[as % AS_INDEX_SIZE]; head != NULL; head = head->next )
+		if( head->as == as )
+			return head;
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the distinct origin and transit ASes of an AS path
+ * Input:	asPath - the AS path attribute
+ *		asLen - 2 or 4 bytes AS
+ *		ases - filled with the origin ASes followed by the transit ASes, 
+ *		       room for MAX_PATH_ASES
+ *		originCount - set to the number of origin ASes
+ * Output: the number of ASes
+ * NOTE: The origin is the last AS of the path, or all ASes of a trailing AS_SET.
+ *       Confederation segments are not looked at.
+ * -------------------------------------------------------------------------------------*/ 
+static int getPathASes( ASPath *asPath, int asLen, u_int32_t *ases, int *originCount )
+{
+	u_char		*data = asPath->asPathData.data;
+	u_int32_t	len = asPath->asPathData.len;
+	u_int32_t	path[MAX_PATH_ASES];
+	u_int32_t	pos, end, as;
+	u_int16_t	as2;
+	int		count = 0, found = 0, lastSegment = 0, lastType = 0, i, j, n, type;
+
+	*originCount = 0;
+	if( len < 3 || (asLen != 2 && asLen != 4) )
+		return 0;
+	if( data[0] & 0x10 )
+	{
+		if( len < 4 )
+			return 0;
+		pos = 4;
+		end = 4 + ((data[2] << 8) | data[3]);
+	}
+	else
+	{
+		pos = 3;
+		end = 3 + data[2];
+	}
+	if( end > len )
+		end = len;
+
+	while( pos + 2 <= end )
+	{
+		type = data[pos];
+		n = data[pos+1];
+		pos += 2;
+		if( pos + n * asLen > end || count + n > MAX_PATH_ASES )
+			break;
+		// AS_SET or AS_SEQUENCE
+		if( type == 1 || type == 2 )
+		{
+			lastSegment = count;
+			lastType = type;
+			for( i = 0; i < n; i++ )
+			{
+				if( asLen == 2 )
+				{
+					memcpy(&as2, data + pos + i * 2, 2);
+					path[count++] = ntohs(as2);
+				}
+				else
+				{
+					memcpy(&as, data + pos + i * 4, 4);
+					path[count++] = ntohl(as);
+				}
+			}
+		}
+		pos += n * asLen;
+	}
+	if( count == 0 )
+		return 0;
+	if( lastType == 2 )
+		lastSegment = count - 1;
+
+	// the origins first, then the rest, each AS once
+	for( i = lastSegment; i < count; i++ )
+	{
+		for( j = 0; j < found && ases[j] != path[i]; j++ );
+		if( j == found )
+			ases[found++] = path[i];
+	}
+	*originCount = found;
+	for( i = 0; i < lastSegment; i++ )
+	{
+		for( j = 0; j < found && ases[j] != path[i]; j++ );
+		if( j == found )
+			ases[found++] = path[i];
+	}
+	return found;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Link an attribute node to the entry of an AS in an AS index
+ * Input:	index - the origin or transit index of an attribute table
+ *		as - the AS number
+ *		link - the link to use
+ *		attrNode - the attribute node
+ *		session - the corresponding session structure
+ * Output: 0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/ 
+static int linkAsIndex( AsIndex *index, u_int32_t as, AsIndexLink *link, AttrNode *attrNode, Session_structp session )
+{
+	AsIndexHead *head = findAsIndexHead(index, as);
+
+	if( head == NULL )
+	{
+		head = malloc(sizeof(AsIndexHead));
+		if( head == NULL )
+		{
+			log_err("linkAsIndex: malloc failed");
+			return -1;
+		}
+		session->stats.memoryUsed += sizeof(AsIndexHead);
+		head->as = as;
+		head->count = 0;
+		head->first = NULL;
+		head->next = index->heads[as % AS_INDEX_SIZE];
+		__sync_synchronize();
+		index->heads[as % AS_INDEX_SIZE] = head;
+		index->asCount++;
+	}
+	link->attrNode = attrNode;
+	link->head = head;
+	link->prev = NULL;
+	link->next = head->first;
+	if( link->next != NULL )
+		link->next->prev = link;
+	__sync_synchronize();	// the link is complete before readers can reach it
+	head->first = link;
+	head->count++;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Unlink an attribute node from the entry of an AS in an AS index
+ * Input:	index - the index the link is in
+ *		link - the link of the attribute node
+ *		session - the corresponding session structure
+ * Output:
+ * NOTE: The link keeps its next for readers standing on it, an entry left 
+ *       without attribute nodes is retired.
+ * -------------------------------------------------------------------------------------*/ 
+static void unlinkAsIndex( AsIndex *index, AsIndexLink *link, Session_structp session )
+{
+	AsIndexHead	*head = link->head;
+	AsIndexHead	**prevHead;
+
+	if( link->prev == NULL )
+		head->first = link->next;
+	else
+		link->prev->next = link->next;
+	if( link->next != NULL )
+		link->next->prev = link->prev;
+	if( --head->count > 0 )
+		return;
+
+	for( prevHead = &index->heads[head->as % AS_INDEX_SIZE]; *prevHead != head; prevHead = &(*prevHead)->next );
+	*prevHead = head->next;
+	index->asCount--;
+	epochRetire(head, NULL);
+	session->stats.memoryUsed -= sizeof(AsIndexHead);
+}
+
+static void unindexAttrNode( AttrNode *attrNode, Session_structp session );
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add an attribute node to the AS indexes of its attribute table
+ * Input:	attrNode - the attribute node, called when it gets its first prefix
+ *		session - the corresponding session structure
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+static void indexAttrNode( AttrNode *attrNode, Session_structp session )
+{
+	AttrTable	*attrTable = session->attributeTable;
+	AsIndexLink	*links;
+	u_int32_t	ases[MAX_PATH_ASES];
+	int		count, origins, i;
+
+	if( attrNode->asLinks != NULL )
+		return;
+	count = getPathASes(attrNode->asPath, session->fsm.ASNumlen, ases, &origins);
+	if( count == 0 )
+		return;
+	links = malloc(count * sizeof(AsIndexLink));
+	if( links == NULL )
+	{
+		log_err("indexAttrNode: malloc failed");
+		return;
+	}
+	session->stats.memoryUsed += count * sizeof(AsIndexLink);
+	attrNode->asLinks = links;
+	attrNode->asOriginCount = origins;
+	for( attrNode->asLinkCount = 0; attrNode->asLinkCount < count; attrNode->asLinkCount++ )
+	{
+		i = attrNode->asLinkCount;
+		if( linkAsIndex(i < origins ? &attrTable->originIndex : &attrTable->transitIndex, 
+			ases[i], &links[i], attrNode, session) )
+		{
+			// leave the node out of the indexes rather than in part of them
+			session->stats.memoryUsed -= (count - i) * sizeof(AsIndexLink);
+			unindexAttrNode(attrNode, session);
+			return;
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove an attribute node from the AS indexes of its attribute table
+ * Input:	attrNode - the attribute node that is removed
+ *		session - the corresponding session structure
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+static void unindexAttrNode( AttrNode *attrNode, Session_structp session )
+{
+	AttrTable	*attrTable = session->attributeTable;
+	int		i;
+
+	if( attrNode->asLinks == NULL )
+		return;
+	for( i = 0; i < attrNode->asLinkCount; i++ )
+		unlinkAsIndex(i < attrNode->asOriginCount ? &attrTable->originIndex : &attrTable->transitIndex, 
+			&attrNode->asLinks[i], session);
+	session->stats.memoryUsed -= attrNode->asLinkCount * sizeof(AsIndexLink);
+	epochRetire(attrNode->asLinks, NULL);
+	attrNode->asLinks = NULL;
+	attrNode->asLinkCount = 0;
+	attrNode->asOriginCount = 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the entries of an AS index
+ * Input:	index - the index
+ *		session - the session the freed memory is accounted to
+ * Output:
+ * NOTE: only for a table no reader can see anymore, the links are freed with
+ *       their attribute nodes.
+ * -------------------------------------------------------------------------------------*/ 
+static void destroyAsIndex( AsIndex *index, Session_structp session )
+{
+	AsIndexHead	*head, *next;
+	u_int32_t	i;
+
+	for( i = 0; i < AS_INDEX_SIZE; i++ )
+	{
+		for( head = index->heads[i]; head != NULL; head = next )
+		{
+			next = head->next;
+			free(head);
+			session->stats.memoryUsed -= sizeof(AsIndexHead);
+		}
+		index->heads[i] = NULL;
+	}
+	index->asCount = 0;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Destory a attribute node
  * Input:	attrNode - pointer to the attribute node needed to be deleted
@@ -268,11 +615,6 @@ void printAttrTable( Session_structp session )
  * -------------------------------------------------------------------------------------*/ 
 void destroyAttrNode ( AttrNode *attrNode, Session_structp session )
 {
-	int error;
-  	if( (error = pthread_rwlock_wrlock (&(attrNode->lock))) > 0 ) 
-	{
-    	log_fatal ("Failed to wrlock an entry in the rib table: %s", strerror(error));
-	}	
 	PrefixRefNode *prefixRefNode = NULL;
 	PrefixRefNode *nextPrefixRefNode = NULL;
 	prefixRefNode = attrNode->prefixRefNode;	
@@ -283,9 +625,8 @@ void destroyAttrNode ( AttrNode *attrNode, Session_structp session )
 	 	session->stats.memoryUsed -= sizeof(PrefixRefNode);
 	 	prefixRefNode = nextPrefixRefNode;	 	
 	}
-	pthread_rwlock_unlock(&(attrNode->lock));
-	if( (error = pthread_rwlock_destroy(&(attrNode->lock))) > 0 )       
-    	log_fatal("Failed to destroy rwlock: %s\n", strerror(error));  		
+	session->stats.memoryUsed -= attrNode->asLinkCount * sizeof(AsIndexLink);
+	free(attrNode->asLinks);
 	session->stats.memoryUsed -= (sizeof(AttrNode) + attrNode->totalAttrLen);
 	attrNode->asPath->refCount--;
 	if( attrNode->asPath->refCount == 0 )
@@ -299,6 +640,34 @@ void destroyAttrNode ( AttrNode *attrNode, Session_structp session )
 }
 
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free the attribute nodes of one bucket of a attribute table
+ * Input:	 attrTable - the pointer to a attribute table
+ *		 bucket - index of the bucket
+ *		 session - the session the freed memory is accounted to
+ * Output: the number of attribute nodes freed
+ * NOTE: only for a table no reader can see anymore, the attribute count of
+ *       the table is left to the caller.
+ * -------------------------------------------------------------------------------------*/
+u_int32_t destroyAttrBucket ( AttrTable *attrTable, u_int32_t bucket, Session_structp session )
+{
+	u_int32_t      attrCount = 0;
+	AttrNode      *attrNode;
+	AttrNode      *nextAttrNode;
+
+	attrNode = attrTable->attrEntries[bucket].node;
+	while (attrNode != NULL) 
+	{
+		nextAttrNode = attrNode->next;
+		destroyAttrNode (attrNode, session);
+		attrCount++;
+		attrNode = nextAttrNode;
+	}
+	attrTable->attrEntries[bucket].nodeCount= 0;
+	attrTable->attrEntries[bucket].node= NULL;
+	return attrCount;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Destory a attribute table
  * Input:	 attrTable - the pointer to a attribute table
@@ -309,34 +678,13 @@ void destroyAttrNode ( AttrNode *attrNode, Session_structp session )
 int destroyAttrTable ( AttrTable *attrTable, Session_structp session )
 {
 	u_int32_t      i, attrCount = 0;
-	AttrNode      *attrNode;
-	AttrNode      *nextAttrNode;
-	int error;
    
 	if( attrTable == NULL )
 	{
 		return -1;
 	}
 	for (i=0; i<attrTable->tableSize; i++) 
-	{
-		attrNode = attrTable->attrEntries[i].node;
-		if( (error = pthread_rwlock_wrlock (&(attrTable->attrEntries[i].lock))) > 0 ) 
-		{
-			log_err ("Failed to wrlock an entry in the attribute table: %s", strerror(error));
-			return -1;
-		}      	
-
-		while (attrNode != NULL) 
-		{
-			nextAttrNode = attrNode->next;
-			destroyAttrNode (attrNode, session);
-			attrCount++;
-         	        attrNode = nextAttrNode;
-		}
-		attrTable->attrEntries[i].nodeCount= 0;
-		attrTable->attrEntries[i].node= NULL;
-		pthread_rwlock_unlock(&(attrTable->attrEntries[i].lock));
-	}
+		attrCount += destroyAttrBucket(attrTable, i, session);
 
    	// sanity check
 	if(attrTable->attrCount != attrCount)
@@ -345,6 +693,9 @@ int destroyAttrTable ( AttrTable *attrTable, Session_structp session )
 	attrTable->attrCount= 0;
 	attrTable->ocupiedSize= 0;
 	attrTable->maxNodeCount= 0;  
+	memset(attrTable->recent, 0, sizeof(attrTable->recent));
+	destroyAsIndex(&attrTable->originIndex, session);
+	destroyAsIndex(&attrTable->transitIndex, session);
 
 	return 0;
 }
@@ -379,11 +730,42 @@ int removePefixFomAttr( PrefixNode *prefixNode, AttrNode *attrNode, Session_stru
   }else{
     prevNode->next = prefixRefNode->next;   
   }
-  free(prefixRefNode);
-  session->stats.memoryUsed -= sizeof(prefixRefNode);
+  // readers may still be on the node, it keeps its next
+  epochRetire(prefixRefNode, NULL);
+  session->stats.memoryUsed -= sizeof(PrefixRefNode);
   return 0;		
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Retire an attribute node that was unlinked from the attribute table
+ * Input:	 attrNode - the unlinked attribute node
+ *		 session - the corresponding session structure
+ * Output:
+ * NOTE: The node and its AS path are freed once no reader can see them anymore,
+ *       the statistics are updated right away.
+ * -------------------------------------------------------------------------------------*/
+static void retireAttrNode( AttrNode *attrNode, Session_structp session )
+{
+	PrefixRefNode *prefixRefNode = attrNode->prefixRefNode;
+	PrefixRefNode *nextPrefixRefNode = NULL;
+
+	while( prefixRefNode != NULL )
+	{
+		nextPrefixRefNode = prefixRefNode->next;
+		epochRetire(prefixRefNode, NULL);
+		session->stats.memoryUsed -= sizeof(PrefixRefNode);
+		prefixRefNode = nextPrefixRefNode;
+	}
+	session->stats.memoryUsed -= (sizeof(AttrNode) + attrNode->totalAttrLen);
+	attrNode->asPath->refCount--;
+	if( attrNode->asPath->refCount == 0 )
+	{
+		epochRetire(attrNode->asPath->asPathData.data, NULL);
+		epochRetire(attrNode->asPath, NULL);
+	}
+	epochRetire(attrNode, NULL);
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Remove the given attr node from attr table and free that attr node's space
  * Input:	 removedNode - the pointer to the attribute node to be deleted
@@ -395,6 +777,7 @@ int removePefixFomAttr( PrefixNode *prefixNode, AttrNode *attrNode, Session_stru
 int removeAttrNode( AttrNode *removedNode, Session_structp session )
 {
 	INDEX          i;
+	int            j;
 	AttrNode      *node, *prevNode;
 	prevNode = NULL;
 
@@ -428,7 +811,15 @@ int removeAttrNode( AttrNode *removedNode, Session_structp session )
 	else 
 		prevNode->next = node->next;   
 
-	destroyAttrNode(node, session);
+	/* the next update with these attributes must not find the node in the cache */
+	for (j = 0; j < ATTR_CACHE_SIZE; j++)
+		if (session->attributeTable->recent[j] == node)
+			session->attributeTable->recent[j] = NULL;
+
+	if( node->v4Handle != V4_NONE )
+		v4TableFreeHandle(session->prefixTable->v4Table, node->v4Handle);
+	unindexAttrNode(node, session);
+	retireAttrNode(node, session);
         node = NULL;
 
 	if (session->attributeTable->attrEntries[i].node == NULL )
@@ -459,7 +850,6 @@ int removeAttrNode( AttrNode *removedNode, Session_structp session )
 AttrNode * createAttrNode( INDEX bucketIndex, ASPath *asPath, u_char *attr, u_int16_t totalAttrLen, u_int16_t basicAttrLen, Session_structp session )
 {
    	AttrNode      *newNode = NULL;
-	int            error;
 
    	/* create a new node for the new attr */
    	newNode = malloc(sizeof(AttrNode) + totalAttrLen);
@@ -474,12 +864,15 @@ AttrNode * createAttrNode( INDEX bucketIndex, ASPath *asPath, u_char *attr, u_in
    	newNode->refCount = 0;
 	
    	newNode->prefixRefNode = NULL;
-	if( (error = pthread_rwlock_init(&(newNode->lock), NULL)) > 0 )       
-    	log_fatal("createAttrNode: Failed to init rwlock: %s\n", strerror(error)); 
-
 	newNode->asPath = asPath;
 	newNode->asPath->refCount++;
 	newNode->bucketIndex = bucketIndex;
+	newNode->v4Handle = V4_NONE;
+	newNode->generation = 0;
+	newNode->fingerprint = attr_fingerprint(asPath->asPathData.data, asPath->asPathData.len, attr, totalAttrLen);
+	newNode->asLinks = NULL;
+	newNode->asLinkCount = 0;
+	newNode->asOriginCount = 0;
 	
    	newNode->totalAttrLen = totalAttrLen;
    	newNode->basicAttrLen = basicAttrLen;
@@ -488,6 +881,7 @@ AttrNode * createAttrNode( INDEX bucketIndex, ASPath *asPath, u_char *attr, u_in
     	session->attributeTable->ocupiedSize++;
    
    	newNode->next = session->attributeTable->attrEntries[bucketIndex].node;   //point to the head of current list   
+	__sync_synchronize();	// the node is complete before readers can reach it
    	session->attributeTable->attrEntries[bucketIndex].node = newNode;         //make new node as the head of the list 
    	session->attributeTable->attrEntries[bucketIndex].nodeCount++;
    	session->attributeTable->maxNodeCount = MAXV(session->attributeTable->maxNodeCount, session->attributeTable->attrEntries[bucketIndex].nodeCount);
@@ -501,6 +895,18 @@ AttrNode * createAttrNode( INDEX bucketIndex, ASPath *asPath, u_char *attr, u_in
    	return newNode;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Remember the attribute node the last update of a session resolved to
+ * Input:	attrTable - the attribute table of the session
+ *		node - the attribute node
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void cacheAttrNode( AttrTable *attrTable, AttrNode *node )
+{
+	attrTable->recent[attrTable->recentNext] = node;
+	attrTable->recentNext = (attrTable->recentNext + 1) % ATTR_CACHE_SIZE;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Search the attribute table based on the AS path
  * Input:	asPath - the data of as path
@@ -508,6 +914,9 @@ AttrNode * createAttrNode( INDEX bucketIndex, ASPath *asPath, u_char *attr, u_in
  *		session - the corresponding session structure
  * Output:  Success: the pointer to the existing attribute node or a new created node.
  *		   Failure: NULL
+ * NOTE: The attribute nodes of the last ATTR_CACHE_SIZE lookups are checked 
+ *       first, without hashing the AS path. The fingerprint only rules out the 
+ *       nodes that differ, a match is always confirmed by comparing the bytes.
  * He Yan @ July 4th, 2008
  * -------------------------------------------------------------------------------------*/
 AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_int16_t totalAttrLen, u_int16_t basicAttrLen, Session_structp session )
@@ -515,6 +924,19 @@ AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_in
 	AttrNode		*node;
 	INDEX			i;
 	ASPath			*asPath;
+	u_int64_t		fingerprint = attr_fingerprint(asPathData, len, attr, totalAttrLen);
+	int			j;
+
+	for( j = 0; j < ATTR_CACHE_SIZE; j++ )
+	{
+		node = session->attributeTable->recent[j];
+		if( node != NULL && node->fingerprint == fingerprint 
+			&& node->totalAttrLen == totalAttrLen && node->asPath->asPathData.len == len
+			&& !memcmp(node->asPath->asPathData.data, asPathData, len)
+			&& !memcmp(node->attr, attr, totalAttrLen) )
+			return node;
+	}
+
 	i = attr_hash(asPathData, len, session->attributeTable->tableSize);
 	node = session->attributeTable->attrEntries[i].node;
 
@@ -523,18 +945,17 @@ AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_in
 	// if AS path of the 'node' is same as the new AS path specified by 'asPathData'
 	while( node != NULL )
 	{
-		// if AS paths are same, continue to check other attributes
-		if( len == node->asPath->asPathData.len && !memcmp(node->asPath->asPathData.data, asPathData, len)) 	
+		// the same attributes have the same fingerprint
+		if( node->fingerprint == fingerprint && totalAttrLen == node->totalAttrLen 
+			&& len == node->asPath->asPathData.len && !memcmp(node->asPath->asPathData.data, asPathData, len)
+			&& !memcmp(node->attr, attr, totalAttrLen))
 		{
-			if( totalAttrLen == node->totalAttrLen && !memcmp(node->attr, attr, totalAttrLen))
-			{
-				return node;
-			}
-			else
-			{
-				tmpNode = node;
-			}
+			cacheAttrNode(session->attributeTable, node);
+			return node;
 		}
+		// if AS paths are same, the new node can share the AS path
+		if( tmpNode == NULL && len == node->asPath->asPathData.len && !memcmp(node->asPath->asPathData.data, asPathData, len)) 	
+			tmpNode = node;
 		if( maxPathID < node->asPath->asPathID )
 			maxPathID = node->asPath->asPathID;
      	node = node->next;   
@@ -552,7 +973,6 @@ AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_in
 #endif
 		ASPath *existingAsPath = tmpNode->asPath;
 		node =	createAttrNode(i, existingAsPath, attr, totalAttrLen, basicAttrLen, session);
-		return node;
 	}
 	else
 	{
@@ -567,8 +987,10 @@ AttrNode * searchAttrNode( u_char *asPathData, u_int16_t len, u_char *attr, u_in
 
 		// create the attr node			
 		node = createAttrNode(i, asPath, attr, totalAttrLen, basicAttrLen, session);
-		return node;
 	}
+	if( node != NULL )
+		cacheAttrNode(session->attributeTable, node);
+	return node;
 }
 
 /*----------------------------------------------------------------------------------------
@@ -631,10 +1053,10 @@ int parseBGPUpdate (void *rawBGPUpdate, u_int32_t len, ParsedBGPUpdate *parsedBG
 
 	/* initialize buffer */
 	mstream_init(&s, rawBGPUpdate+19, length);
-	memset (buffer, 0, MAX_BGP_MESSAGE_LEN);
-	mstream_init(&b, buffer, MAX_BGP_MESSAGE_LEN);
-	memset (buffer1, 0, MAX_BGP_MESSAGE_LEN);
-	mstream_init(&b1, buffer1, MAX_BGP_MESSAGE_LEN);	
+	memset (parsedBGPUpdate->buffer, 0, MAX_BGP_MESSAGE_LEN);
+	mstream_init(&b, parsedBGPUpdate->buffer, MAX_BGP_MESSAGE_LEN);
+	memset (parsedBGPUpdate->buffer1, 0, MAX_BGP_MESSAGE_LEN);
+	mstream_init(&b1, parsedBGPUpdate->buffer1, MAX_BGP_MESSAGE_LEN);	
 	
 	/* process IPv4 unicast unreach nlri */   
 	mstream_getw( &s, &parsedBGPUpdate->unreachNlri.nlriLen );   
@@ -925,6 +1347,214 @@ int parseBGPUpdate (void *rawBGPUpdate, u_int32_t len, ParsedBGPUpdate *parsedBG
    return 0;
 }
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if a BGP Update message is an End-of-RIB marker (RFC 4724)
+ * Input: rawBGPUpdate - Raw BGP update message
+ *		len	- length of rw BGP update
+ *		afi, safi - set to the address family of the marker
+ * Output:  1 if it is a marker, 0 otherwise
+ * NOTE: IPv4 unicast uses an empty update, the other families an update with
+ *       only an empty MP_UNREACH attribute.
+ * -------------------------------------------------------------------------------------*/ 
+int getEndOfRib (void *rawBGPUpdate, u_int32_t length, u_int16_t *afi, u_int8_t *safi)
+{
+	u_char		*p = (u_char *)rawBGPUpdate + BGP_HEADER_LEN;
+	u_int16_t	withdrawnLen, attrLen, mpLen;
+	int		hdrLen;
+
+	if( length < BGP_HEADER_LEN + 4 )
+		return 0;
+	withdrawnLen = ntohs(*(u_int16_t *)p);
+	attrLen = ntohs(*(u_int16_t *)(p + 2));
+	if( withdrawnLen != 0 || BGP_HEADER_LEN + 4 + attrLen != length )
+		return 0;
+	if( attrLen == 0 )
+	{
+		*afi = BGP_AFI_IPv4;
+		*safi = BGP_MP_SAFI_UNICAST;
+		return 1;
+	}
+
+	p += 4;
+	if( p[1] != BGP_MP_UNREACH )
+		return 0;
+	hdrLen = (p[0] & BGP_ATTR_FLAG_EXT_LEN) ? 4 : 3;
+	mpLen = (hdrLen == 4) ? ntohs(*(u_int16_t *)(p + 2)) : p[2];
+	if( mpLen != 3 || hdrLen + mpLen != attrLen )
+		return 0;
+	*afi = ntohs(*(u_int16_t *)(p + hdrLen));
+	*safi = p[hdrLen + 2];
+	return 1;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy the prefixes of an NLRI block whose labels are not duplicates
+ * Input: nlri - the prefixes
+ *		len - the length of the prefixes
+ *		out - where the kept prefixes are written, may overlap nlri from below
+ *		labels - the labels of the message
+ *		labelCount - the number of labels
+ *		next - the label of the first prefix, moved past the prefixes
+ *		kept - where the labels of the kept prefixes are written, moved past them
+ * Output: the length of the kept prefixes or -1 if the labels do not match the prefixes
+ * -------------------------------------------------------------------------------------*/ 
+static int copyFreshPrefixes (u_char *nlri, int len, u_char *out, u_char *labels, u_int32_t labelCount, 
+	u_int32_t *next, u_char **kept)
+{
+	int pos = 0, size, outLen = 0;
+
+	while( pos < len )
+	{
+		size = 1 + (PREFIX_SIZE(nlri[pos]));
+		if( pos + size > len || *next >= labelCount )
+			return -1;
+		if( labels[*next] != BGPMON_LABEL_ANNOUNCE_DUPLICATE && labels[*next] != BGPMON_LABEL_WITHDRAW_DUPLICATE )
+		{
+			memmove(out + outLen, nlri + pos, size);
+			outLen += size;
+			*(*kept)++ = labels[*next];
+		}
+		(*next)++;
+		pos += size;
+	}
+	return outLen;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove the prefixes labeled as duplicates from a labeled BGP update
+ * Input: bmf - the labeled message, rewritten in place
+ * Output: 0 if only duplicates were in it and it should be dropped, 1 otherwise
+ * NOTE: The withdrawn routes, the NLRI and the prefixes of the MP_REACH and 
+ *       MP_UNREACH attributes are rewritten along with their lengths and labels.
+ *       An MP attribute left without prefixes is dropped, so is the rest of the
+ *       path attributes once nothing reachable is left.  A message without 
+ *       duplicates, like an End-of-RIB marker, is left alone.
+ * -------------------------------------------------------------------------------------*/ 
+int stripDuplicatePrefixes (BMF bmf)
+{
+	u_char		out[BMF_MAX_MSG_LEN];
+	u_char		keptLabels[BMF_MAX_MSG_LEN];
+	u_char		*kept = keptLabels;
+	u_char		*msg = bmf->message, *labels, *attr, *attrEnd, *v;
+	u_int32_t	bgpLen, labelCount, next = 0, i;
+	u_int16_t	withdrawnLen, attrLen, len;
+	int		pos, attrStart, hdrLen, fixedLen, n, reachable = 0, withdrawn = 0;
+
+	if( bmf->length < BGP_HEADER_LEN + 4 )
+		return 1;
+	bgpLen = getBGPHeaderLength((PBgpHeader)msg);
+	if( bgpLen < BGP_HEADER_LEN + 4 || bgpLen > bmf->length )
+		return 1;
+	labels = msg + bgpLen;
+	labelCount = bmf->length - bgpLen;
+	for( i = 0; i < labelCount; i++ )
+		if( labels[i] == BGPMON_LABEL_ANNOUNCE_DUPLICATE || labels[i] == BGPMON_LABEL_WITHDRAW_DUPLICATE )
+			break;
+	if( i == labelCount )
+		return 1;
+
+	withdrawnLen = ntohs(*(u_int16_t *)(msg + BGP_HEADER_LEN));
+	if( BGP_HEADER_LEN + 4 + withdrawnLen > bgpLen )
+		return 1;
+	attrLen = ntohs(*(u_int16_t *)(msg + BGP_HEADER_LEN + 2 + withdrawnLen));
+	if( BGP_HEADER_LEN + 4 + withdrawnLen + attrLen > bgpLen )
+		return 1;
+
+	// withdrawn routes
+	memcpy(out, msg, BGP_HEADER_LEN);
+	pos = BGP_HEADER_LEN + 2;
+	n = copyFreshPrefixes(msg + BGP_HEADER_LEN + 2, withdrawnLen, out + pos, labels, labelCount, &next, &kept);
+	if( n < 0 )
+		return 1;
+	*(u_int16_t *)(out + BGP_HEADER_LEN) = htons(n);
+	withdrawn += n;
+	pos += n;
+
+	// path attributes, the MP ones lose their duplicates
+	attrStart = pos;
+	pos += 2;
+	attr = msg + BGP_HEADER_LEN + 4 + withdrawnLen;
+	attrEnd = attr + attrLen;
+	while( attr < attrEnd )
+	{
+		if( attr + 3 > attrEnd )
+			return 1;
+		hdrLen = (attr[0] & BGP_ATTR_FLAG_EXT_LEN) ? 4 : 3;
+		if( attr + hdrLen > attrEnd )
+			return 1;
+		len = (hdrLen == 4) ? ntohs(*(u_int16_t *)(attr + 2)) : attr[2];
+		if( attr + hdrLen + len > attrEnd )
+			return 1;
+		v = attr + hdrLen;
+		if( attr[1] == BGP_MP_REACH || attr[1] == BGP_MP_UNREACH )
+		{
+			// afi, safi and for MP_REACH the next hop and the reserved byte
+			if( attr[1] == BGP_MP_REACH && len < 4 )
+				return 1;
+			fixedLen = (attr[1] == BGP_MP_REACH) ? 5 + v[3] : 3;
+			if( fixedLen > len )
+				return 1;
+			memcpy(out + pos, attr, hdrLen + fixedLen);
+			n = copyFreshPrefixes(v + fixedLen, len - fixedLen, out + pos + hdrLen + fixedLen, 
+				labels, labelCount, &next, &kept);
+			if( n < 0 )
+				return 1;
+			if( n > 0 )
+			{
+				if( hdrLen == 4 )
+					*(u_int16_t *)(out + pos + 2) = htons(fixedLen + n);
+				else
+					out[pos + 2] = fixedLen + n;
+				pos += hdrLen + fixedLen + n;
+				if( attr[1] == BGP_MP_REACH )
+					reachable += n;
+				else
+					withdrawn += n;
+			}
+		}
+		else
+		{
+			memcpy(out + pos, attr, hdrLen + len);
+			pos += hdrLen + len;
+		}
+		attr += hdrLen + len;
+	}
+
+	// NLRI
+	n = copyFreshPrefixes(attrEnd, msg + bgpLen - attrEnd, out + pos, labels, labelCount, &next, &kept);
+	if( n < 0 || next != labelCount )
+		return 1;
+	reachable += n;
+	pos += n;
+
+	if( reachable == 0 && withdrawn == 0 )
+		return 0;
+	if( reachable == 0 )
+	{
+		// no route is left for the attributes, keep the MP_UNREACH ones only
+		u_char *a = out + attrStart + 2, *end = out + pos, *dst = a;
+		while( a < end )
+		{
+			hdrLen = (a[0] & BGP_ATTR_FLAG_EXT_LEN) ? 4 : 3;
+			len = (hdrLen == 4) ? ntohs(*(u_int16_t *)(a + 2)) : a[2];
+			if( a[1] == BGP_MP_UNREACH )
+			{
+				memmove(dst, a, hdrLen + len);
+				dst += hdrLen + len;
+			}
+			a += hdrLen + len;
+		}
+		pos = dst - out;
+	}
+	*(u_int16_t *)(out + attrStart) = htons(pos - attrStart - 2 - n);
+	setBGPHeaderLength((PBgpHeader)out, pos - BGP_HEADER_LEN);
+
+	memcpy(msg, out, pos);
+	memcpy(msg + pos, keptLabels, kept - keptLabels);
+	bmf->length = pos + (kept - keptLabels);
+	return 1;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Sanity check of nlri
  * Input: nlri - pointer to the buffer of NLRI
@@ -1400,76 +2030,750 @@ printPrefix(const Prefix *prefix){
 
 }
 
-/*----------------------------------------------------------------------------------------
- * Purpose: Apply a reachable prefix to the rib table
- * Input:	 prefix - the pointer to the prefix
- *		 attrNode - the associated attribute node of the prefix
- *		 originatedTS - the timestamp
- *		 session - the corresponding session structure
- *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
- * Output:  0 for success or -1 for failure
- * NOTE:    
- * He Yan @ July 4th, 2008 
- * -------------------------------------------------------------------------------------*/
-int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t originatedTS, Session_structp session, BMF bmf)
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every prefix in the rib table of a session
+ * Input: sessionID - the ID of the session
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int walkRibTable(int sessionID, RibWalkCallback callback, void *arg)
 {
-   	PrefixNode   *prefixNode = NULL;
-   	INDEX          i;
-   	int            error;
-
-	i = prefix_hash((u_char *)prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix), session->prefixTable->tableSize);
-   	prefixNode = session->prefixTable->prefixEntries[i].node;
-   	while( prefixNode != NULL && memcmp(prefix, &(prefixNode->keyPrefix), (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix)) )
-		prefixNode = prefixNode->next;   
+	RibWalkCursor	cursor;
 
-   	/* If the prefix is not existing in the rib table */
-   	if( prefixNode == NULL ) 
-	{	   	
-#ifdef DEBUG
-	    debug(__FUNCTION__, "Given prefix was not found in the rib table, insert a new one.");
-#endif
+	memset(&cursor, 0, sizeof(cursor));
+	return walkRibTablePage(sessionID, &cursor, callback, arg);
+}
 
-		if( bmf != NULL)
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the prefixes in the rib table of a session, from a 
+ *		cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		cursor - where to start, zeroed for the first prefix, moved past the 
+ *		prefix that stopped the walk
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if the end of the table was reached
+ * NOTE: The table is read in epoch sections of one bucket or RIB_WALK_SLOTS slots
+ *       and the walk returns in between, so a caller that has to wait for a user
+ *       pages the prefixes out and calls again with the cursor. A prefix may be 
+ *       passed twice or not at all if its bucket or the compact IPv4 table changes
+ *       meanwhile.
+ * -------------------------------------------------------------------------------------*/ 
+#define RIB_WALK_SLOTS 4096
+int walkRibTablePage(int sessionID, RibWalkCursor *cursor, RibWalkCallback callback, void *arg)
+{
+	PrefixTable	*prefixTable;
+	PrefixNode	*node;
+	V4TableData	*d;
+	u_int32_t	i, n, end;
+	int		reader, stop = 0;
+
+	while( !stop )
+	{
+		reader = epochEnter();
+		prefixTable = (Sessions[sessionID] != NULL) ? Sessions[sessionID]->prefixTable : NULL;
+		if( prefixTable == NULL || cursor->bucket >= prefixTable->tableSize )
+		{
+			epochExit(reader);
+			break;
+		}
+		n = 0;
+		for( node = prefixTable->prefixEntries[cursor->bucket].node; node != NULL && !stop; node = node->next, n++ )
+			if( n >= cursor->skip )
+				stop = callback(&node->keyPrefix, node->dataAttr, arg);
+		epochExit(reader);
+		if( stop )
+			cursor->skip = n;
+		else
+		{
+			cursor->bucket++;
+			cursor->skip = 0;
+		}
+	}
+
+	while( !stop )
+	{
+		reader = epochEnter();
+		prefixTable = (Sessions[sessionID] != NULL) ? Sessions[sessionID]->prefixTable : NULL;
+		if( prefixTable == NULL || prefixTable->v4Table == NULL || cursor->slot >= prefixTable->v4Table->data->size )
+		{
+			epochExit(reader);
+			break;
+		}
+		d = prefixTable->v4Table->data;
+		i = cursor->slot;
+		end = (d->size - i > RIB_WALK_SLOTS) ? i + RIB_WALK_SLOTS : d->size;
+		for( ; i < end && !stop; i++ )
+		{
+			u_int64_t keyBuf = d->keys[i];
+			u_int32_t handle = d->attrs[i];
+			AttrNode *attrNode;
+
+			if( keyBuf == V4_KEY_EMPTY || keyBuf == V4_KEY_DELETED || handle == V4_NONE )
+				continue;
+			attrNode = d->values[handle];
+			if( attrNode != NULL )
+				stop = callback((Prefix *)&keyBuf, attrNode, arg);
+		}
+		epochExit(reader);
+		cursor->slot = i;
+	}
+	return stop ? 1 : 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every prefix originated by an AS in the rib of a session
+ * Input: sessionID - the ID of the session
+ *		as - the origin AS
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int walkOriginAS(int sessionID, u_int32_t as, RibWalkCallback callback, void *arg)
+{
+	AsWalkCursor	cursor;
+
+	memset(&cursor, 0, sizeof(cursor));
+	return walkOriginASPage(sessionID, as, &cursor, callback, arg);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the prefixes originated by an AS in the rib of a 
+ *		session, from a cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		as - the origin AS
+ *		cursor - where to start, zeroed for the first prefix, moved past the 
+ *		prefix that stopped the walk
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if all prefixes were passed
+ * NOTE: The index is read in epoch sections of up to RIB_WALK_SLOTS prefixes, 
+ *       each one finds its place again by counting from the head of the list. A
+ *       prefix may be passed twice or not at all if the list changes meanwhile.
+ * -------------------------------------------------------------------------------------*/ 
+int walkOriginASPage(int sessionID, u_int32_t as, AsWalkCursor *cursor, RibWalkCallback callback, void *arg)
+{
+	AttrTable	*attrTable;
+	PrefixTable	*prefixTable;
+	AsIndexHead	*head;
+	AsIndexLink	*link;
+	AttrNode	*attrNode;
+	PrefixRefNode	*ref;
+	V4TableData	*d;
+	u_int32_t	slot, handle, n, passed;
+	int		reader, stop = 0, done = 0;
+
+	while( !stop && !done )
+	{
+		reader = epochEnter();
+		attrTable = (Sessions[sessionID] != NULL) ? Sessions[sessionID]->attributeTable : NULL;
+		prefixTable = (Sessions[sessionID] != NULL) ? Sessions[sessionID]->prefixTable : NULL;
+		head = (attrTable != NULL) ? findAsIndexHead(&attrTable->originIndex, as) : NULL;
+		link = (head != NULL) ? head->first : NULL;
+		for( n = 0; link != NULL && n < cursor->link; n++ )
+			link = link->next;
+
+		// a slot or link that was unlinked while we stand on it still leads to the rest of the list
+		for( passed = 0; link != NULL; link = link->next )
+		{
+			attrNode = link->attrNode;
+			n = 0;
+			for( ref = attrNode->prefixRefNode; ref != NULL && !stop && passed < RIB_WALK_SLOTS; ref = ref->next, n++ )
+				if( n >= cursor->skip )
+				{
+					stop = callback(&ref->prefixNode->keyPrefix, attrNode, arg);
+					passed++;
+				}
+
+			handle = attrNode->v4Handle;
+			if( !stop && passed < RIB_WALK_SLOTS && prefixTable != NULL && prefixTable->v4Table != NULL && handle != V4_NONE )
+			{
+				d = prefixTable->v4Table->data;
+				slot = (handle < d->handleSize && d->values[handle] == attrNode) ? d->heads[handle] : V4_NONE;
+				for( ; slot != V4_NONE && !stop && passed < RIB_WALK_SLOTS; slot = d->next[slot] )
+				{
+					u_int64_t keyBuf = d->keys[slot];
+					if( d->attrs[slot] != handle )
+						continue;
+					if( n++ >= cursor->skip )
+					{
+						stop = callback((Prefix *)&keyBuf, attrNode, arg);
+						passed++;
+					}
+				}
+			}
+			if( stop || passed >= RIB_WALK_SLOTS )
+			{
+				// the next section goes on with the prefixes of this node
+				cursor->skip = n;
+				break;
+			}
+			cursor->link++;
+			cursor->skip = 0;
+		}
+		if( link == NULL )
+			done = 1;
+		epochExit(reader);
+	}
+	return stop ? 1 : 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every attribute node whose AS path transits an AS
+ * Input: sessionID - the ID of the session
+ *		as - the transit AS
+ *		callback - the function to call with each attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int walkTransitAS(int sessionID, u_int32_t as, AttrWalkCallback callback, void *arg)
+{
+	AsWalkCursor	cursor;
+
+	memset(&cursor, 0, sizeof(cursor));
+	return walkTransitASPage(sessionID, as, &cursor, callback, arg);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the attribute nodes whose AS path transits an AS, 
+ *		from a cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		as - the transit AS
+ *		cursor - where to start, zeroed for the first node, moved past the 
+ *		node that stopped the walk
+ *		callback - the function to call with each attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if all nodes were passed
+ * NOTE: The index is read in epoch sections of up to RIB_WALK_SLOTS nodes, as in
+ *       walkOriginASPage.
+ * -------------------------------------------------------------------------------------*/ 
+int walkTransitASPage(int sessionID, u_int32_t as, AsWalkCursor *cursor, AttrWalkCallback callback, void *arg)
+{
+	AttrTable	*attrTable;
+	AsIndexHead	*head;
+	AsIndexLink	*link;
+	u_int32_t	n, passed;
+	int		reader, stop = 0, done = 0;
+
+	while( !stop && !done )
+	{
+		reader = epochEnter();
+		attrTable = (Sessions[sessionID] != NULL) ? Sessions[sessionID]->attributeTable : NULL;
+		head = (attrTable != NULL) ? findAsIndexHead(&attrTable->transitIndex, as) : NULL;
+		link = (head != NULL) ? head->first : NULL;
+		for( n = 0; link != NULL && n < cursor->link; n++ )
+			link = link->next;
+		for( passed = 0; link != NULL && !stop && passed < RIB_WALK_SLOTS; link = link->next, passed++ )
+		{
+			stop = callback(link->attrNode, arg);
+			cursor->link++;
+		}
+		if( link == NULL )
+			done = 1;
+		epochExit(reader);
+	}
+	return stop ? 1 : 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Build the fixed width lookup key of a prefix
+ * Input: prefix - the prefix
+ *		key - the key to fill in
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+void makePrefixKey(const Prefix *prefix, PrefixKey *key)
+{
+	int bytes = PREFIX_SIZE(prefix->addr.p_len);
+
+	key->w[0] = key->w[1] = key->w[2] = 0;
+	if( bytes <= 4 )
+		key->words = 1;
+	else if( bytes <= 20 )
+		key->words = PREFIX_KEY_WORDS;
+	else
+	{
+		key->words = 0;
+		return;
+	}
+	memcpy(key->w, prefix, sizeof(Prefix) + bytes);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if a prefix stored in a prefix node matches a lookup key
+ * Input: key - the lookup key built by makePrefixKey
+ *		prefix - the lookup prefix, used when the key does not fit in words
+ *		nodePrefix - the zero padded key prefix of a prefix node
+ * Output: 1 if they match, 0 otherwise
+ * NOTE: The first word holds afi, safi and length, so once it matches the node 
+ *       is known to be as wide as the key.
+ * -------------------------------------------------------------------------------------*/ 
+int prefixKeyMatch(const PrefixKey *key, const Prefix *prefix, const Prefix *nodePrefix)
+{
+	u_int64_t	w[PREFIX_KEY_WORDS];
+
+	if( key->words == 0 )
+		return !memcmp(prefix, nodePrefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix));
+
+	memcpy(&w[0], nodePrefix, sizeof(u_int64_t));
+	if( w[0] != key->w[0] )
+		return 0;
+	if( key->words == 1 )
+		return 1;
+	memcpy(&w[1], (const u_char *)nodePrefix + sizeof(u_int64_t), 2*sizeof(u_int64_t));
+	return w[1] == key->w[1] && w[2] == key->w[2];
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Record a withdrawn prefix in the withdrawal journal of a prefix table
+ * Input:	 key - the fixed width key of the prefix
+ *		 session - the corresponding session structure
+ * Output:
+ * NOTE: The journal grows up to LabelControls.journalSize entries, after that
+ *       the oldest entry is dropped for every new one. A prefix without a fixed
+ *       width key can not be recorded, so no delta can go back past it.
+ * -------------------------------------------------------------------------------------*/
+static void journalWithdrawal (const PrefixKey *key, Session_structp session)
+{
+	PrefixTable	*prefixTable = session->prefixTable;
+	WithdrawJournal	*j = &prefixTable->journal;
+	WithdrawEntry	*entries;
+	u_int32_t	size, i;
+
+	pthread_mutex_lock(&j->lock);
+	if( key->words == 0 )
+	{
+		j->floor = prefixTable->generation;
+		j->count = 0;
+		pthread_mutex_unlock(&j->lock);
+		return;
+	}
+	if( j->count == j->size && j->size < LabelControls.journalSize )
+	{
+		size = j->size ? j->size * 2 : 256;
+		if( size > LabelControls.journalSize )
+			size = LabelControls.journalSize;
+		entries = malloc(size * sizeof(WithdrawEntry));
+		if( entries != NULL )
 		{
-			/* Add new announcement label to this prefix */
-			u_char label = BGPMON_LABEL_ANNOUNCE_NEW;
-			bgpmonMessageAppend( bmf, &label, 1);
-			//createLabelNode(prefix, BGPMON_LABEL_ANNOUNCE_NEW, lt);
+			for( i = 0; i < j->count; i++ )
+				entries[i] = j->entries[(j->start + i) % j->size];
+			free(j->entries);
+			session->stats.memoryUsed += (long)(size - j->size) * sizeof(WithdrawEntry);
+			j->entries = entries;
+			j->size = size;
+			j->start = 0;
 		}
+	}
+	if( j->size == 0 )
+	{
+		j->floor = prefixTable->generation;
+		pthread_mutex_unlock(&j->lock);
+		return;
+	}
+	if( j->count == j->size )
+	{
+		// the oldest withdrawal is lost, deltas from before it are not possible
+		j->floor = j->entries[j->start].generation;
+		j->start = (j->start + 1) % j->size;
+		j->count--;
+	}
+	i = (j->start + j->count) % j->size;
+	j->entries[i].generation = prefixTable->generation;
+	memcpy(j->entries[i].key, key->w, sizeof(j->entries[i].key));
+	j->count++;
+	pthread_mutex_unlock(&j->lock);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Copy the prefixes withdrawn from a rib after a checkpoint
+ * Input:	 prefixTable - the prefix table
+ *		 since - the checkpoint
+ *		 entries - set to a malloced copy of the withdrawals, NULL if there are none
+ *		 count - set to the number of withdrawals
+ * Output:  0 for success or -1 if the journal no longer goes back to the checkpoint
+ * -------------------------------------------------------------------------------------*/
+int copyRibWithdrawals (PrefixTable *prefixTable, u_int64_t since, WithdrawEntry **entries, u_int32_t *count)
+{
+	WithdrawJournal	*j = &prefixTable->journal;
+	u_int32_t	first, i;
+
+	*entries = NULL;
+	*count = 0;
+	pthread_mutex_lock(&j->lock);
+	if( since < j->floor )
+	{
+		pthread_mutex_unlock(&j->lock);
+		return -1;
+	}
+	// the entries are in generation order, find the first one after the checkpoint
+	first = j->count;
+	while( first > 0 && j->entries[(j->start + first - 1) % j->size].generation > since )
+		first--;
+	if( first < j->count )
+	{
+		*entries = malloc((j->count - first) * sizeof(WithdrawEntry));
+		if( *entries == NULL )
+		{
+			pthread_mutex_unlock(&j->lock);
+			log_err("copyRibWithdrawals: malloc failed");
+			return -1;
+		}
+		for( i = first; i < j->count; i++ )
+			(*entries)[i - first] = j->entries[(j->start + i) % j->size];
+		*count = j->count - first;
+	}
+	pthread_mutex_unlock(&j->lock);
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add a prefix to a growing array of withdraw entries
+ * Input:	 prefix - the prefix, zero padded to its key width
+ *		 entries - the array, grown as needed
+ *		 count - the number of entries, updated
+ *		 size - the allocated entries, updated
+ * Output:  0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+static int addStalePrefix (const Prefix *prefix, WithdrawEntry **entries, u_int32_t *count, u_int32_t *size)
+{
+	PrefixKey	key;
+	WithdrawEntry	*grown;
+
+	makePrefixKey(prefix, &key);
+	if( key.words == 0 )
+		return 0;
+	if( *count == *size )
+	{
+		*size = *size ? *size * 2 : 1024;
+		grown = realloc(*entries, *size * sizeof(WithdrawEntry));
+		if( grown == NULL )
+		{
+			log_err("addStalePrefix: realloc failed");
+			return -1;
+		}
+		*entries = grown;
+	}
+	(*entries)[*count].generation = 0;
+	memcpy((*entries)[*count].key, key.w, sizeof(key.w));
+	(*count)++;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy the stale prefixes of a rib that was kept over a session flap
+ * Input:	 prefixTable - the prefix table, owned by the calling labeling worker
+ *		 afi, safi - the address family to copy, afi 0 for all of them
+ *		 entries - set to a malloced array of the prefixes, NULL if there are none
+ *		 count - set to the number of prefixes
+ * Output:  0 for success or -1 for failure
+ * NOTE: Prefixes without a fixed width key can not be copied, they stay stale.
+ * -------------------------------------------------------------------------------------*/
+int copyStalePrefixes (PrefixTable *prefixTable, u_int16_t afi, u_int8_t safi, WithdrawEntry **entries, u_int32_t *count)
+{
+	V4TableData	*d;
+	PrefixNode	*node;
+	u_int32_t	i, size = 0;
+	u_int64_t	keyBuf;
+
+	*entries = NULL;
+	*count = 0;
+	for( i = 0; i < prefixTable->tableSize; i++ )
+	{
+		for( node = prefixTable->prefixEntries[i].node; node != NULL; node = node->next )
+		{
+			if( node->generation > prefixTable->staleGeneration
+				|| (afi != 0 && (node->keyPrefix.afi != afi || node->keyPrefix.safi != safi)) )
+				continue;
+			if( addStalePrefix(&node->keyPrefix, entries, count, &size) )
+				return -1;
+		}
+	}
+
+	if( prefixTable->v4Table == NULL || (afi != 0 && (afi != BGP_AFI_IPv4 || safi != BGP_MP_SAFI_UNICAST)) )
+		return 0;
+	d = prefixTable->v4Table->data;
+	for( i = 0; i < d->size; i++ )
+	{
+		keyBuf = d->keys[i];
+		if( keyBuf == V4_KEY_EMPTY || keyBuf == V4_KEY_DELETED || d->attrs[i] == V4_NONE 
+			|| d->gens[i] > prefixTable->staleGeneration )
+			continue;
+		if( addStalePrefix((Prefix *)&keyBuf, entries, count, &size) )
+			return -1;
+	}
+	return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Label an announced prefix and update the session statistics
+ * Input:	 oldAttr - the attribute node the prefix had in the rib table, NULL if it was not there
+ *		 attrNode - the attribute node announced with the prefix
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void labelAnnouncement (AttrNode *oldAttr, AttrNode *attrNode, Session_structp session, BMF bmf)
+{
+	u_char label;
+
+	/* If the prefix is not existing in the rib table */
+	if( oldAttr == NULL )
+	{
+		label = BGPMON_LABEL_ANNOUNCE_NEW;
 		session->stats.nannRcvd++;
+	}
+	/* If the attributes are same */
+	else if( oldAttr == attrNode )
+	{
+		#ifdef DEBUG
+		debug (__FUNCTION__,  "Found a duplicate prefix.");
+		#endif
+		label = BGPMON_LABEL_ANNOUNCE_DUPLICATE;
+		session->stats.dannRcvd++;
+	}
+	/* If the attributes are not same, then check the AS path to determine it is a DPATH or SPATH update */	   
+	else if( oldAttr->bucketIndex != attrNode->bucketIndex || 
+		oldAttr->asPath->asPathID != attrNode->asPath->asPathID )
+	{
+		#ifdef DEBUG
+		debug (__FUNCTION__,  "Found a DPATH prefix.");
+		#endif
+		label = BGPMON_LABEL_ANNOUNCE_DPATH;
+		session->stats.dpathRcvd++;
+	}
+	else
+	{
+		#ifdef DEBUG
+		debug (__FUNCTION__,  "Found a SPATH prefix.");
+		#endif
+		label = BGPMON_LABEL_ANNOUNCE_SPATH;
+		session->stats.spathRcvd++;
+	}
+
+	if( bmf != NULL )
+		bgpmonMessageAppend( bmf, &label, 1);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Label a withdrawn prefix and update the session statistics
+ * Input:	 found - whether the prefix was in the rib table
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void labelWithdrawal (int found, Session_structp session, BMF bmf)
+{
+	u_char label;
+
+	if( found )
+	{
+		label = BGPMON_LABEL_WITHDRAW;
+		session->stats.withRcvd++;
+	}
+	else
+	{
+		label = BGPMON_LABEL_WITHDRAW_DUPLICATE;
+		session->stats.duwiRcvd++;
+	}
+
+	if( bmf != NULL )
+		bgpmonMessageAppend( bmf, &label, 1);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Apply a reachable IPv4 unicast prefix to the compact prefix table
+ * Input:	 key - the fixed width key of the prefix
+ *		 attrNode - the associated attribute node of the prefix
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * NOTE: The compact table does not keep the originated timestamp.
+ *       A prefix that changes attributes gets a new slot, so a reader walking the
+ *       list of the old attribute node is never led into the list of the new one.
+ * -------------------------------------------------------------------------------------*/
+static int applyReachableV4Prefix (u_int64_t key, AttrNode *attrNode, Session_structp session, BMF bmf)
+{
+	V4Table		*t = session->prefixTable->v4Table;
+	AttrNode	*oldAttr = NULL;
+	long		memory = v4TableMemory(t);
+	u_int32_t	slot;
+
+	slot = v4TableFind(t, key);
+	if( slot != V4_NONE )
+		oldAttr = t->data->values[t->data->attrs[slot]];
+	labelAnnouncement(oldAttr, attrNode, session, bmf);
+	if( oldAttr == attrNode )
+	{
+		// a stale prefix that is announced again is no longer stale
+		if( t->data->gens[slot] <= session->prefixTable->staleGeneration )
+		{
+			t->data->gens[slot] = session->prefixTable->generation;
+			attrNode->generation = session->prefixTable->generation;
+		}
+		return 0;
+	}
+
+	if( oldAttr == NULL )
+	{
+		session->prefixTable->prefixCount++;
+		session->stats.prefixCount++;
+	}
+	else
+	{
+		/* Remove the prefix from the prefix list of old attribute node */
+		oldAttr->refCount--;
+		if( v4TableUnlink(t, slot) )
+			log_fatal("Failed to remove a prefix fom a attribute.");
+		v4TableRemove(t, slot);
+
+	    /* If the old attribute node is not used by any prefixes, delete it*/    
+		if( oldAttr->refCount == 0 && removeAttrNode( oldAttr, session ) ) 
+			log_err ("Failed to remove given attr from attr table");
+	}
+	slot = v4TableAdd(t, key);
+	t->data->gens[slot] = session->prefixTable->generation;
+	attrNode->generation = session->prefixTable->generation;
+
+	if( attrNode->v4Handle == V4_NONE )
+		attrNode->v4Handle = v4TableNewHandle(t, attrNode);
+	session->stats.memoryUsed += (long)v4TableMemory(t) - memory;
+
+	/* Add the prefix to the prefix list of new attribute node */
+	if( attrNode->refCount++ == 0 )
+		indexAttrNode(attrNode, session);
+	v4TableLink(t, slot, attrNode->v4Handle);
+	return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Remove an IPv4 unicast prefix from the compact prefix table
+ * Input:	 key - the fixed width key of the prefix, one word
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+static int applyUnreachableV4Prefix (const PrefixKey *key, Session_structp session, BMF bmf)
+{
+	V4Table		*t = session->prefixTable->v4Table;
+	AttrNode	*oldAttr;
+	u_int32_t	slot;
+
+	slot = v4TableFind(t, key->w[0]);
+	labelWithdrawal(slot != V4_NONE, session, bmf);
+	if( slot == V4_NONE )
+		return 0;
+
+	oldAttr = t->data->values[t->data->attrs[slot]];
+	oldAttr->refCount--;
+	if( v4TableUnlink(t, slot) )
+		log_err("Failed to remove a prefix fom a attribute.");
+	journalWithdrawal(key, session);
+
+	if( oldAttr->refCount == 0 && removeAttrNode( oldAttr, session ) ) 
+		log_err ("Failed to remove given attr from attr table");
+
+	v4TableRemove(t, slot);
+	session->prefixTable->prefixCount--;
+	session->stats.prefixCount--;
+	return 0;
+}
+
+static int applyReachableKey (const Prefix *prefix, const PrefixKey *keyp, AttrNode *attrNode, u_int32_t originatedTS, Session_structp session, BMF bmf);
+static int applyUnreachableKey (const Prefix *prefix, const PrefixKey *keyp, Session_structp session, BMF bmf);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Apply a reachable prefix to the rib table
+ * Input:	 prefix - the pointer to the prefix
+ *		 attrNode - the associated attribute node of the prefix
+ *		 originatedTS - the timestamp
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * NOTE:    IPv4 unicast prefixes are stored in the compact prefix table.
+ * He Yan @ July 4th, 2008 
+ * -------------------------------------------------------------------------------------*/
+int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t originatedTS, Session_structp session, BMF bmf)
+{
+	PrefixKey      key;
+
+	makePrefixKey(prefix, &key);
+	return applyReachableKey(prefix, &key, attrNode, originatedTS, session, bmf);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Apply a reachable prefix whose lookup key is already built to the rib table
+ * Input:	 prefix - the pointer to the prefix
+ *		 key - the key of the prefix, see makePrefixKey
+ *		 attrNode - the associated attribute node of the prefix
+ *		 originatedTS - the timestamp
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+static int applyReachableKey (const Prefix *prefix, const PrefixKey *keyp, AttrNode *attrNode, u_int32_t originatedTS, Session_structp session, BMF bmf)
+{
+   	PrefixNode   *prefixNode = NULL;
+   	INDEX          i;
+	PrefixKey      key = *keyp;
+
+	if( key.words == 1 && prefix->afi == BGP_AFI_IPv4 && prefix->safi == BGP_MP_SAFI_UNICAST 
+		&& session->prefixTable->v4Table != NULL )
+		return applyReachableV4Prefix(key.w[0], attrNode, session, bmf);
+
+	if( key.words )
+		i = prefix_key_hash(key.w, key.words, session->prefixTable->tableSize);
+	else
+		i = prefix_hash((u_char *)prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix), session->prefixTable->tableSize);
+   	prefixNode = session->prefixTable->prefixEntries[i].node;
+   	while( prefixNode != NULL && !prefixKeyMatch(&key, prefix, &(prefixNode->keyPrefix)) )
+		prefixNode = prefixNode->next;   
+
+	labelAnnouncement(prefixNode ? prefixNode->dataAttr : NULL, attrNode, session, bmf);
+
+   	/* If the prefix is not existing in the rib table */
+   	if( prefixNode == NULL ) 
+	{	   	
+#ifdef DEBUG
+	    debug(__FUNCTION__, "Given prefix was not found in the rib table, insert a new one.");
+#endif
 
 		/* Create and insert a new prefix node */
 		#ifdef DEBUG
-	    debug(__FUNCTION__, "Malloc a prefix node: %d %d %d", PREFIX_SIZE(prefix->addr.p_len), sizeof(PrefixNode), (PREFIX_SIZE(prefix->addr.p_len))+sizeof(PrefixNode));
+	    debug(__FUNCTION__, "Malloc a prefix node: %d %d %d", PREFIX_KEY_BYTES(prefix->addr.p_len), sizeof(PrefixNode), (PREFIX_KEY_BYTES(prefix->addr.p_len))+sizeof(PrefixNode));
 		#endif		
-	    prefixNode = malloc((PREFIX_SIZE(prefix->addr.p_len)) + sizeof(PrefixNode));  
-		session->stats.memoryUsed += (sizeof(PrefixNode) + (PREFIX_SIZE(prefix->addr.p_len)));
-		prefixNode->keyPrefix.afi = prefix->afi;
-	 	prefixNode->keyPrefix.safi = prefix->safi;
-		prefixNode->keyPrefix.addr.p_len = prefix->addr.p_len;
-	        memcpy( prefixNode->keyPrefix.addr.paddr, prefix->addr.paddr,
-                        PREFIX_SIZE(prefix->addr.p_len) );
+	    prefixNode = malloc((PREFIX_KEY_BYTES(prefix->addr.p_len)) + sizeof(PrefixNode));  
+		session->stats.memoryUsed += (sizeof(PrefixNode) + (PREFIX_KEY_BYTES(prefix->addr.p_len)));
+		if( key.words )
+			memcpy( &(prefixNode->keyPrefix), key.w, sizeof(Prefix) + PREFIX_KEY_BYTES(prefix->addr.p_len) );
+		else
+		{
+			prefixNode->keyPrefix.afi = prefix->afi;
+	 		prefixNode->keyPrefix.safi = prefix->safi;
+			prefixNode->keyPrefix.addr.p_len = prefix->addr.p_len;
+	        	memcpy( prefixNode->keyPrefix.addr.paddr, prefix->addr.paddr,
+                        	PREFIX_SIZE(prefix->addr.p_len) );
+		}
 	        prefixNode->dataAttr = attrNode;
 		prefixNode->originatedTS = originatedTS;
+		prefixNode->generation = session->prefixTable->generation;
+		attrNode->generation = session->prefixTable->generation;
 
 		/* Create and insert a new prefix ref node in the prefix ref list of attribute node*/	
-		if( (error = pthread_rwlock_wrlock (&(attrNode->lock))) > 0 ) 
-		{
-			log_fatal ("Failed to wrlock an attribute node in the attribute table: %s", strerror(error));
-		}	
-	    attrNode->refCount++;
+	    if( attrNode->refCount++ == 0 )
+			indexAttrNode(attrNode, session);
 		PrefixRefNode *newRefNode = NULL;
 		newRefNode = malloc(sizeof(PrefixRefNode));
 		session->stats.memoryUsed += sizeof(PrefixRefNode);
 		newRefNode->prefixNode = prefixNode;
 		newRefNode->next = attrNode->prefixRefNode;
-		attrNode->prefixRefNode = newRefNode;		    
-		pthread_rwlock_unlock(&(attrNode->lock));
 
 		/*Update the prefix entry*/
 	    if( session->prefixTable->prefixEntries[i].node == NULL )
 	    	session->prefixTable->ocupiedSize++;
 	    prefixNode->next = session->prefixTable->prefixEntries[i].node;
+		__sync_synchronize();	// the nodes are complete before readers can reach them
+		attrNode->prefixRefNode = newRefNode;		    
 	    session->prefixTable->prefixEntries[i].node = prefixNode;	      
 	    session->prefixTable->prefixEntries[i].nodeCount++;
 
@@ -1488,64 +2792,20 @@ int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t or
 		/* If the attributes are same */
 	    if( prefixNode->dataAttr == attrNode ) 
 		{
-			#ifdef DEBUG
-		    debug (__FUNCTION__,  "Found a duplicate prefix.");
-			#endif
-
-			if( bmf != NULL)
-			{
-				// Add duplicate announcement label to this prefix
-				u_char label = BGPMON_LABEL_ANNOUNCE_DUPLICATE;
-				bgpmonMessageAppend( bmf, &label, 1);
-				//createLabelNode(prefix, BGPMON_LABEL_ANNOUNCE_DUPLICATE, lt);
-			}
-			session->stats.dannRcvd++;
-
 			// Update the timestamp of the existing prefix
 			prefixNode->originatedTS = originatedTS;
+			if( prefixNode->generation <= session->prefixTable->staleGeneration )
+			{
+				prefixNode->generation = session->prefixTable->generation;
+				attrNode->generation = session->prefixTable->generation;
+			}
 		    return 0;
     	}
-		
-		/* If the attributes are not same, then check the AS path to determine it is a DPATH or SPATH update */	   
-	    if( prefixNode->dataAttr->bucketIndex != attrNode->bucketIndex || 
-			prefixNode->dataAttr->asPath->asPathID != attrNode->asPath->asPathID )
-	    {
-	    	#ifdef DEBUG
-		    debug (__FUNCTION__,  "Found a DPATH prefix.");
-			#endif
-	    	// DPATH
-			if( bmf != NULL)
-			{	    
-				u_char label = BGPMON_LABEL_ANNOUNCE_DPATH;
-				bgpmonMessageAppend( bmf, &label, 1);
-				//createLabelNode(prefix, BGPMON_LABEL_ANNOUNCE_DPATH, lt);  
-			}
-			session->stats.dpathRcvd++;
-	    }
-	    else
-	    {
-	    	#ifdef DEBUG
-		    debug (__FUNCTION__,  "Found a SPATH prefix.");
-			#endif		    
-	    	//SPATH
-			if( bmf != NULL)
-			{	   
-				u_char label = BGPMON_LABEL_ANNOUNCE_SPATH;
-				bgpmonMessageAppend( bmf, &label, 1);
-				//createLabelNode(prefix, BGPMON_LABEL_ANNOUNCE_SPATH, lt);   
-			}
-			session->stats.spathRcvd++;
-		}
 
 		/* Remove the prefix from the prefix ref list of old attribute node */
-		if( (error = pthread_rwlock_wrlock (&(prefixNode->dataAttr->lock))) > 0 ) 
-		{
-			log_fatal ("Failed to wrlock an attribute node in the attribute table: %s", strerror(error));
-		}	
 		prefixNode->dataAttr->refCount--;
 		if( removePefixFomAttr(prefixNode, prefixNode->dataAttr, session) )
 			log_fatal("Failed to remove a prefix fom a attribute.");
-		pthread_rwlock_unlock(&(prefixNode->dataAttr->lock));
 		  	
 	    /* If the old attribute node is not used by any prefixes, delete it*/    
 	    if( prefixNode->dataAttr->refCount == 0 ) 
@@ -1555,20 +2815,19 @@ int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t or
 	    }
 
 		/* Add the prefix to the prefix ref list of new attribute node */
-		if( (error = pthread_rwlock_wrlock (&(attrNode->lock))) > 0 ) 
-		{
-			log_fatal ("Failed to wrlock an attribute node in the attribute table: %s", strerror(error));
-		}	      
 	    prefixNode->dataAttr= attrNode;
 		prefixNode->originatedTS = originatedTS;
-	    attrNode->refCount++;
+		prefixNode->generation = session->prefixTable->generation;
+		attrNode->generation = session->prefixTable->generation;
+	    if( attrNode->refCount++ == 0 )
+			indexAttrNode(attrNode, session);
 	    PrefixRefNode *newRefNode = NULL;
 	    newRefNode = malloc(sizeof(PrefixRefNode));
 		session->stats.memoryUsed += sizeof(PrefixRefNode);
 	    newRefNode->prefixNode = prefixNode;
 	    newRefNode->next = attrNode->prefixRefNode;
+		__sync_synchronize();
 	    attrNode->prefixRefNode = newRefNode;    
-		pthread_rwlock_unlock(&(attrNode->lock));	
 	}
 	return 0;
 }
@@ -1583,58 +2842,60 @@ int applyReachablePrefix (const Prefix *prefix, AttrNode *attrNode, u_int32_t or
  * He Yan @ July 4th, 2008
  * -------------------------------------------------------------------------------------*/
 int applyUnreachablePrefix (const Prefix *prefix, Session_structp session, BMF bmf)
+{
+	PrefixKey		key;
+
+	makePrefixKey(prefix, &key);
+	return applyUnreachableKey(prefix, &key, session, bmf);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Remove a prefix whose lookup key is already built from the rib table
+ * Input:	 prefix - the pointer to the prefix
+ *		 key - the key of the prefix, see makePrefixKey
+ *		 session - the corresponding session structure
+ *		 bmf - BMF message if labeling is enabled and the label will be appened to the BMF message
+ * Output:  0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+static int applyUnreachableKey (const Prefix *prefix, const PrefixKey *keyp, Session_structp session, BMF bmf)
 {
 	INDEX			i;
 	PrefixNode		*node, *prevNode;
-	int				error;
+	PrefixKey		key = *keyp;
    
 	prevNode = NULL;
-	i = prefix_hash((u_char *)prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix), session->prefixTable->tableSize);
+	if( key.words == 1 && prefix->afi == BGP_AFI_IPv4 && prefix->safi == BGP_MP_SAFI_UNICAST 
+		&& session->prefixTable->v4Table != NULL )
+		return applyUnreachableV4Prefix(&key, session, bmf);
+
+	if( key.words )
+		i = prefix_key_hash(key.w, key.words, session->prefixTable->tableSize);
+	else
+		i = prefix_hash((u_char *)prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix), session->prefixTable->tableSize);
 
 	/* lookup the prefix */
  	node = session->prefixTable->prefixEntries[i].node;
-	while( node != NULL && memcmp(prefix, &(node->keyPrefix), (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix)) )
+	while( node != NULL && !prefixKeyMatch(&key, prefix, &(node->keyPrefix)) )
 	{
 		prevNode = node;
     	node = node->next;
    	}
    
-   	// create the corresponding entry in label table   
+	labelWithdrawal(node != NULL, session, bmf);
    	/* if nonexist */
    	if( node == NULL ) 
 	{
-   		// Duplicate withdraw
-		if( bmf != NULL)
-		{   		
-			u_char label = BGPMON_LABEL_WITHDRAW_DUPLICATE;
-			bgpmonMessageAppend( bmf, &label, 1);
-    		//createLabelNode(prefix, BGPMON_LABEL_WITHDRAW_DUPLICATE, lt);
-		}
-		session->stats.duwiRcvd++;
 #ifdef DEBUG
 	log_warning( "Try to remove a non-exist prefix node from rib table.");
 #endif
 	return 0;
    	}
-	
-   	// Non Duplicate withdraw
-	if( bmf != NULL)
-	{   	
-		u_char label = BGPMON_LABEL_WITHDRAW;
-		bgpmonMessageAppend( bmf, &label, 1);
-   		//createLabelNode(prefix, BGPMON_LABEL_WITHDRAW, lt); 
-	}
-	session->stats.withRcvd++;
 			
-	if( (error = pthread_rwlock_wrlock (&(node->dataAttr->lock))) > 0 ) 
-	{
-		log_fatal ("Failed to wrlock an entry in the rib table: %s", strerror(error));
-	}
    	node->dataAttr->refCount--;
 	
    	if( removePefixFomAttr(node, node->dataAttr, session) )
 		log_err("Failed to remove a prefix fom a attribute.");
-	pthread_rwlock_unlock(&(node->dataAttr->lock));
+	journalWithdrawal(&key, session);
 	
 	  
    	if( node->dataAttr->refCount == 0 )
@@ -1652,55 +2913,163 @@ int applyUnreachablePrefix (const Prefix *prefix, Session_structp session, BMF b
     	session->prefixTable->ocupiedSize--;
    
    	session->prefixTable->prefixEntries[i].nodeCount--;
-	session->stats.memoryUsed -= ( sizeof(PrefixNode) + (PREFIX_SIZE(node->keyPrefix.addr.p_len)) );	
-	free(node);
+	session->stats.memoryUsed -= ( sizeof(PrefixNode) + (PREFIX_KEY_BYTES(node->keyPrefix.addr.p_len)) );	
+	epochRetire(node, NULL);
    	session->prefixTable->prefixCount--;
 	session->stats.prefixCount--;
    	return 0;
 }
 
+/* prefixes of an NLRI block that are decoded and looked up together */
+#define NLRI_BATCH_SIZE 64
+
+typedef struct NlriBatchStruct {
+	u_int32_t	count;
+	PrefixKey	keys[NLRI_BATCH_SIZE];		/* the key words hold the Prefix */
+	u_int16_t	offsets[NLRI_BATCH_SIZE];	/* position of each prefix in the NLRI */
+} NlriBatch;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Decode the next prefixes of an NLRI block straight into their lookup keys
+ * Input:  nlri - the NLRI block
+ *		position - where to start, moved past the decoded prefixes
+ *		batch - filled with up to NLRI_BATCH_SIZE prefixes
+ * Output:  the number of decoded prefixes, 0 at the end of the block
+ * NOTE: A prefix too long for a key gets words 0 and is rebuilt from its offset.
+ * -------------------------------------------------------------------------------------*/
+static u_int32_t decodeNLRIBatch (BGPNlri *nlri, u_int32_t *position, NlriBatch *batch)
+{
+	u_int32_t	pos = *position;
+	u_int8_t	len;
+	int		bytes;
+	PrefixKey	*key;
+	Prefix		*prefix;
+
+	batch->count = 0;
+	while( batch->count < NLRI_BATCH_SIZE && pos < nlri->nlriLen )
+	{
+		len = nlri->nlri[pos];
+		bytes = PREFIX_SIZE(len);
+		if( pos + 1 + bytes > nlri->nlriLen )
+			break;
+		key = &batch->keys[batch->count];
+		batch->offsets[batch->count] = pos;
+		key->w[0] = key->w[1] = key->w[2] = 0;
+		if( bytes <= 4 )
+			key->words = 1;
+		else if( bytes <= 20 )
+			key->words = PREFIX_KEY_WORDS;
+		else
+			key->words = 0;
+		if( key->words )
+		{
+			prefix = (Prefix *)key->w;
+			prefix->afi = nlri->afi;
+			prefix->safi = nlri->safi;
+			prefix->addr.p_len = len;
+			memcpy(prefix->addr.paddr, nlri->nlri + pos + 1, bytes);
+		}
+		pos += 1 + bytes;
+		batch->count++;
+	}
+	*position = pos;
+	return batch->count;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Prefetch the table slots the prefixes of a batch will be looked up in
+ * Input:  batch - the decoded prefixes
+ *		session - the corresponding session structure
+ * Output: 
+ * NOTE: The buckets of the prefix table are fetched first and their first node
+ *       after, so the misses of the whole batch overlap instead of following 
+ *       each other.
+ * -------------------------------------------------------------------------------------*/
+static void prefetchNLRIBatch (NlriBatch *batch, Session_structp session)
+{
+	PrefixTable	*prefixTable = session->prefixTable;
+	V4TableData	*d = prefixTable->v4Table ? prefixTable->v4Table->data : NULL;
+	INDEX		buckets[NLRI_BATCH_SIZE];
+	Prefix		*prefix;
+	u_int32_t	i;
+
+	for( i = 0; i < batch->count; i++ )
+	{
+		prefix = (Prefix *)batch->keys[i].w;
+		buckets[i] = prefixTable->tableSize;
+		if( batch->keys[i].words == 0 )
+			continue;
+		if( d != NULL && batch->keys[i].words == 1 && prefix->afi == BGP_AFI_IPv4 && prefix->safi == BGP_MP_SAFI_UNICAST )
+			__builtin_prefetch(&d->keys[prefix_key_hash(batch->keys[i].w, 1, d->size)]);
+		else
+		{
+			buckets[i] = prefix_key_hash(batch->keys[i].w, batch->keys[i].words, prefixTable->tableSize);
+			__builtin_prefetch(&prefixTable->prefixEntries[buckets[i]]);
+		}
+	}
+	for( i = 0; i < batch->count; i++ )
+	{
+		if( buckets[i] != prefixTable->tableSize && prefixTable->prefixEntries[buckets[i]].node != NULL )
+			__builtin_prefetch(prefixTable->prefixEntries[buckets[i]].node);
+	}
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Rebuild a prefix of a batch that is too long for a lookup key
+ * Input:  nlri - the NLRI block
+ *		offset - position of the prefix in the block
+ *		buf - room for the prefix, at least sizeof(Prefix) + 32 bytes
+ * Output:  the prefix
+ * -------------------------------------------------------------------------------------*/
+static Prefix *longNLRIPrefix (BGPNlri *nlri, u_int16_t offset, u_int64_t *buf)
+{
+	Prefix *prefix = (Prefix *)buf;
+
+	prefix->afi = nlri->afi;
+	prefix->safi = nlri->safi;
+	prefix->addr.p_len = nlri->nlri[offset];
+	memcpy(prefix->addr.paddr, nlri->nlri + offset + 1, PREFIX_SIZE(prefix->addr.p_len));
+	return prefix;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Apply the reachable NLRI of a BGP update to the rib table
  * Input:  originatedTS - the timestamp
  *		 nlri - the pointer to the BGPNlri structure whcin includes multiple prefixes
- *		 attrNode - the associated attribute node of the nlri	
+ *		 attrNode - the associated attribute node of the prefixes
  *		 session - the corresponding session structure
  *		 bmf - BMF message if labeling is enabled and the labels of prefixes will be appened to the BMF message 
  * Output:
- * NOTE:  This function calls function 'applyReachablePrefix', one for each prefix.
+ * NOTE:  The prefixes are decoded and prefetched NLRI_BATCH_SIZE at a time and 
+ *        then applied in order, one label for each prefix.
  * He Yan @ July 4th, 2008 
  * -------------------------------------------------------------------------------------*/
 void applyReachableNLRI (time_t originatedTS, BGPNlri *nlri, AttrNode	*attrNode, Session_structp session, BMF bmf)
 {
-	MSTREAM		s;
-	u_int8_t	len;
-	Prefix		*prefix = NULL;
+	NlriBatch	batch;
+	u_int64_t	longBuf[(sizeof(Prefix) + 32) / sizeof(u_int64_t) + 1];
+	Prefix		*prefix;
+	u_int32_t	position = 0, i;
 	
-	mstream_init(&s, nlri->nlri, nlri->nlriLen);
-	while( mstream_can_read(&s) > 0 )
-	{
-		mstream_getc(&s, &len);
-		prefix = malloc(sizeof(Prefix) + (PREFIX_SIZE(len)));
-		prefix->afi = nlri->afi;
-		prefix->safi = nlri->safi;
-		prefix->addr.p_len = len;
-		memcpy( prefix->addr.paddr, mstream_current_address(&s),
-                        PREFIX_SIZE(len));
-		if( applyReachablePrefix (prefix, attrNode, originatedTS, session, bmf))
+	while( decodeNLRIBatch(nlri, &position, &batch) > 0 )
+	{
+		prefetchNLRIBatch(&batch, session);
+		for( i = 0; i < batch.count; i++ )
 		{
-			log_err( "Failed to apply a reachable prefix to the rib table.");
-	//#ifdef DEBUG		
-			hexdump(LOG_ERR, prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix));
-                        log_err( "%s: advancing position: %d",__FUNCTION__,prefix->addr.p_len);
-	//#endif		
+			if( batch.keys[i].words )
+				prefix = (Prefix *)batch.keys[i].w;
+			else
+				prefix = longNLRIPrefix(nlri, batch.offsets[i], longBuf);
+			if( applyReachableKey (prefix, &batch.keys[i], attrNode, originatedTS, session, bmf))
+			{
+				log_err( "Failed to apply a reachable prefix to the rib table.");
+				hexdump(LOG_ERR, prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix));
+			}
+		#ifdef DEBUG
+			else
+				debug (__FUNCTION__, "Succefully apply a reachable prefix to the rib table.");
+		#endif
 		}
-	#ifdef DEBUG
-	else
-		debug (__FUNCTION__, "Succefully apply a reachable prefix to the rib table.");
-	#endif
-   		s.position += PREFIX_SIZE(prefix->addr.p_len);
-		free(prefix);
-		prefix = NULL;
 	}
 }
 
@@ -1710,42 +3079,40 @@ void applyReachableNLRI (time_t originatedTS, BGPNlri *nlri, AttrNode	*attrNode,
  *		 session - the corresponding session structure
  *		 bmf - BMF message if labeling is enabled and the labels of prefixes will be appened to the BMF message 
  * Output:
- * NOTE:  This function calls function 'applyUNreachablePrefix', one for each prefix.
+ * NOTE:  The prefixes are decoded and prefetched NLRI_BATCH_SIZE at a time and 
+ *        then withdrawn in order, one label for each prefix.
  * He Yan @ July 4th, 2008 
  * -------------------------------------------------------------------------------------*/
 void applyUnreachableNLRI (BGPNlri *nlri, Session_structp session, BMF bmf)
 {
-	MSTREAM		s;
-	u_int8_t	len;
-	Prefix		*prefix = NULL;
+	NlriBatch	batch;
+	u_int64_t	longBuf[(sizeof(Prefix) + 32) / sizeof(u_int64_t) + 1];
+	Prefix		*prefix;
+	u_int32_t	position = 0, i;
 	
-	mstream_init(&s, nlri->nlri, nlri->nlriLen);
-	while( mstream_can_read(&s) > 0 )
-	{
-		mstream_getc(&s, &len);
-		prefix = malloc(sizeof(Prefix) + (PREFIX_SIZE(len)));
-		prefix->afi = nlri->afi;
-		prefix->safi = nlri->safi;
-		prefix->addr.p_len = len;
-		memcpy( prefix->addr.paddr, mstream_current_address(&s),
-                        PREFIX_SIZE(len));
-		if( applyUnreachablePrefix (prefix, session, bmf) ) 
+	while( decodeNLRIBatch(nlri, &position, &batch) > 0 )
+	{
+		prefetchNLRIBatch(&batch, session);
+		for( i = 0; i < batch.count; i++ )
 		{
-			log_err ("Failed to withdraw a IPv4 prefix from rib table.");
-			hexdump(LOG_ERR, prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix));
+			if( batch.keys[i].words )
+				prefix = (Prefix *)batch.keys[i].w;
+			else
+				prefix = longNLRIPrefix(nlri, batch.offsets[i], longBuf);
+			if( applyUnreachableKey (prefix, &batch.keys[i], session, bmf) ) 
+			{
+				log_err ("Failed to withdraw a IPv4 prefix from rib table.");
+				hexdump(LOG_ERR, prefix, (PREFIX_SIZE(prefix->addr.p_len))+sizeof(Prefix));
+			}
+		#ifdef DEBUG
+			debug (__FUNCTION__, "Succefully withdraw a IPv4 prefix from rib table.");
+		#endif
 		}
-	#ifdef DEBUG
-		debug (__FUNCTION__, "Succefully withdraw a IPv4 prefix from rib table.");
-	#endif
-		s.position += PREFIX_SIZE(prefix->addr.p_len);
-		free(prefix);
-		prefix = NULL;
 	}
-
 }
 
 /*--------------------------------------------------------------------------------------
- * Purpose: Apply a BGP Update message to a rib table
+ * Purpose: Apply the NLRI of a BGP Update message to a rib table
   * Input:  originatedTS - the timestamp
  *		  parsedUpdateMsg -  Parsed BGP update messages
  *		  session - the corresponding session structure
@@ -1753,7 +3120,7 @@ void applyUnreachableNLRI (BGPNlri *nlri, Session_structp session, BMF bmf)
  * Output: 0 for success or -1 for failure
  * He Yan @ July 4th, 2008
  * -------------------------------------------------------------------------------------*/ 
-int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Session_structp session, BMF bmf)
+static int applyBGPUpdateNLRI (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Session_structp session, BMF bmf)
 {
 	AttrNode	*attrNode = NULL;
 	int			i;
@@ -1890,6 +3257,116 @@ int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Sessi
 	return 0;
 }
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Apply a BGP Update message to a rib table
+  * Input:  originatedTS - the timestamp
+ *		  parsedUpdateMsg -  Parsed BGP update messages
+ *		  session - the corresponding session structure
+ *		  bmf - BMF message if labeling is enabled and the labels of prefixes will be appened to the BMF message 
+ * Output: 0 for success or -1 for failure
+ * NOTE: the changes are stamped with the next generation of the prefix table
+ * -------------------------------------------------------------------------------------*/ 
+int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Session_structp session, BMF bmf)
+{
+	int result;
+
+	session->prefixTable->generation++;
+	result = applyBGPUpdateNLRI(originatedTS, parsedUpdateMsg, session, bmf);
+
+	// a transfer may take this generation as its checkpoint once every change is visible
+	__sync_synchronize();
+	session->prefixTable->completeGeneration = session->prefixTable->generation;
+	return result;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send the body of a BGP update as a table transfer BMF message
+ * Input: sessionID - the ID of the session
+ *		body - the update without the BGP header
+ *		len - the length of the body
+ *	  labeledQueueWriter - name of queue for sending BMF messages
+ *	  transfer - counts the messages and bytes sent
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void sendTransferUpdate(int sessionID, u_char *body, int len, QueueWriter labeledQueueWriter, TransferState *transfer)
+{
+	// create BGP message header
+	PBgpHeader hdr = createBGPHeader( typeUpdate );
+	setBGPHeaderLength( hdr, len );
+
+	// create the BMF message
+	BMF bmf = createBMF(sessionID, BMF_TYPE_TABLE_TRANSFER);
+	bgpmonMessageAppend( bmf, hdr, BGP_HEADER_LEN);
+	bgpmonMessageAppend( bmf, body, len );
+	transfer->messages++;
+	transfer->bytes += bmf->length;
+
+	// write BMF message to queue
+	writeTransferBMF(transfer, labeledQueueWriter, bmf);
+
+	free(hdr);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send a message of a table transfer to its sink or the labeled queue
+ * Input: transfer - the table transfer
+ *	  labeledQueueWriter - name of queue for sending BMF messages, unused with a sink
+ *	  bmf - the message, taken over
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+void writeTransferBMF(TransferState *transfer, QueueWriter labeledQueueWriter, BMF bmf)
+{
+	if( transfer->sink == NULL )
+		writeQueue(labeledQueueWriter, bmf);
+	else if( transfer->failed )
+		destroyBMF(bmf);
+	else if( transfer->sink->put(bmf, transfer->sink->arg) )
+		transfer->failed = TRUE;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add an afi:1 safi:1 prefix to the NLRI section of a table transfer update,
+ *			sending the update first if the prefix does not fit
+ * Input: addr - the address of the prefix
+ *		attrNode - the attribute node used to create a BMF
+ *		sessionID - the ID of the session
+ *		mpAttr - the mp attributes section of the update
+ *		nlri - the NLRI section of the update
+ *		remainingLen - the remaining length of the update, updated on return
+ *	  labeledQueueWriter - name of queue for sending BMF messages
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
+ * Output: 0 for success or -1 for failure
+ * -------------------------------------------------------------------------------------*/
+static int addTransferNLRI(PAddress *addr, AttrNode *attrNode, int sessionID, MSTREAM *mpAttr,
+	MSTREAM *nlri, int *remainingLen, QueueWriter labeledQueueWriter, TransferState *transfer)
+{
+	u_int16_t prefixLenInBytes = PREFIX_SIZE(addr->p_len);
+	// check if the remaining buffer len is suffcient
+	if( *remainingLen < prefixLenInBytes + 1 )
+	{
+		// BGP update message is full, send it and start new message
+		if (createAndSendBMFFromAttr(sessionID, attrNode, *mpAttr, *nlri, labeledQueueWriter, transfer) == -1)
+		{
+			log_err("%s [%d] Could not send BMF message!", __FILE__, __LINE__);
+			return -1;
+		}
+		// reset mp reach to 0
+		memset (mpAttr->start, 0, MAX_BGP_MESSAGE_LEN);
+		mstream_init(mpAttr, mpAttr->start, MAX_BGP_MESSAGE_LEN);
+		// reset nrli to 0
+		memset (nlri->start, 0, MAX_BGP_MESSAGE_LEN);
+		mstream_init(nlri, nlri->start, MAX_BGP_MESSAGE_LEN);
+		*remainingLen = MAX_BGP_MESSAGE_LEN - 2 - 2 - attrNode->basicAttrLen - attrNode->asPath->asPathData.len;
+	}
+	if( mstream_add( nlri, addr, prefixLenInBytes+1 ))
+	{
+		log_err("Buffer is overflow %d!3", nlri->position);
+		return -1;
+	}
+	*remainingLen -= (prefixLenInBytes + 1);
+	return 0;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Create and send table transfer BMF messages (type BMF_TYPE_TABLE_TRANSFER) from a specific
  *			attribute node in attribute hash table.
@@ -1899,32 +3376,26 @@ int applyBGPUpdate (time_t originatedTS, ParsedBGPUpdate *parsedUpdateMsg, Sessi
  * Input: attrNode -  the attribute node used to create a BMF
  *		sessionID -  the ID of the session	
  *	  labeledQueueWriter - name of queue for sending BMF messages	
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
  * Output: 0 for success or -1 for failure
+ * NOTE: must be called inside an epoch section, see epoch.h
+ *       Only the prefixes added after transfer->since are included.
  * He Yan @ July 4th, 2008
  * Mikhail Strizhov @ July 21st, 2010
  * -------------------------------------------------------------------------------------*/ 
-static u_char	updateBuf[MAX_BGP_MESSAGE_LEN];
-static u_char	mpAttrBuf[MAX_BGP_MESSAGE_LEN];
-static u_char	nlriBuf[MAX_BGP_MESSAGE_LEN];
-int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQueueWriter)
+int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQueueWriter, TransferState *transfer)
 {
 	MSTREAM			source;
 	// initialize buffer for the mp attrbutes section in a update
 	MSTREAM			mpAttr;
-	memset (mpAttrBuf, 0, MAX_BGP_MESSAGE_LEN);
-	mstream_init(&mpAttr, mpAttrBuf, MAX_BGP_MESSAGE_LEN);
+	memset (transfer->mpAttrBuf, 0, MAX_BGP_MESSAGE_LEN);
+	mstream_init(&mpAttr, transfer->mpAttrBuf, MAX_BGP_MESSAGE_LEN);
 	
 	MSTREAM			nlri;
-	memset (nlriBuf, 0, MAX_BGP_MESSAGE_LEN);
-	mstream_init(&nlri, nlriBuf, MAX_BGP_MESSAGE_LEN);
+	memset (transfer->nlriBuf, 0, MAX_BGP_MESSAGE_LEN);
+	mstream_init(&nlri, transfer->nlriBuf, MAX_BGP_MESSAGE_LEN);
 
-	// lock this attribute node 
 	int error;
-	if( (error = pthread_rwlock_rdlock (&(attrNode->lock))) > 0 ) 
-	{
-		log_err("Failed to read lock an attribute node in the attribute table: %s", strerror(error));
-		return -1;
-	}	
 	
 	//1. process the mp attributes
 	u_int16_t startPos;
@@ -1938,13 +3409,11 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 		if( mstream_getc(&source, &mpAttrFlag) )
 		{
 			log_err("%s [%d] - Failed! Message was corrupt.", __FILE__, __LINE__);
-			pthread_rwlock_unlock(&(attrNode->lock));
 			return -1;
 		}			
 		if( mstream_getc(&source, &mpAttrType) ) 
 		{
 			log_err("%s [%d] - Failed! Message was corrupt.", __FILE__, __LINE__);
-			pthread_rwlock_unlock(&(attrNode->lock));
 			return -1;
 		}		
 		/* get attribute length */
@@ -1953,7 +3422,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 			if( mstream_getw(&source, &mpAttrLen) )
 			{
 				log_err("%s [%d] - Failed! Message was corrupt.", __FILE__, __LINE__);
-				pthread_rwlock_unlock(&(attrNode->lock));
 				return -1;
 			}					
 		} 
@@ -1962,7 +3430,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 			if( mstream_getc(&source,&ampAttrLenShort) )
 			{
 				log_err("%s [%d] - Failed! Message was corrupt.", __FILE__, __LINE__);
-				pthread_rwlock_unlock(&(attrNode->lock));
 				return -1;
 			}
 			mpAttrLen = ampAttrLenShort;
@@ -1971,7 +3438,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 		if( mstream_can_read(&source) < mpAttrLen) 
 		{
 			log_err("%s [%d] - Failed! Message was corrupt.", __FILE__, __LINE__);
-			pthread_rwlock_unlock(&(attrNode->lock));
 			return -1;
 		}			
 
@@ -1985,13 +3451,11 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 					if( mstream_getw(&source, &afi) )
 					{
 						log_err("%s [%d] - Failed! Mpreach message was corrupt.", __FILE__, __LINE__);
-						pthread_rwlock_unlock(&(attrNode->lock));
 						return -1;
 					}
 					if( mstream_getc(&source, &safi) )
 					{
 						log_err("%s [%d] - Failed! Mpreach message was corrupt.", __FILE__, __LINE__);
-						pthread_rwlock_unlock(&(attrNode->lock));
 						return -1;
 					}
 
@@ -2003,7 +3467,8 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 					{
 						//find one matched prefix with the same afi&safi as this mp attribute.
 						if( prefixRefNode->prefixNode->keyPrefix.afi == afi
-							&& prefixRefNode->prefixNode->keyPrefix.safi == safi )
+							&& prefixRefNode->prefixNode->keyPrefix.safi == safi
+							&& prefixRefNode->prefixNode->generation > transfer->since )
 						{
 							if( flag == 0)
 							{
@@ -2011,7 +3476,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 								if(mstream_add( &mpAttr, source.start+startPos, mpAttrLen + source.position - startPos -3 ))
 								{
 							 		log_err("Buffer is overflow!1");
-									pthread_rwlock_unlock(&(attrNode->lock));
 							 		return -1;
 								}		
 								flag = 1;
@@ -2021,26 +3485,23 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 							if( mstream_add( &mpAttr, &prefixRefNode->prefixNode->keyPrefix.addr, prefixLenInBytes+1 ) )
 							{
 								// BGP update message is full, send it and start new message
-								if (createAndSendBMFFromAttr(sessionID, attrNode,mpAttr, nlri, labeledQueueWriter) == -1)
+								if (createAndSendBMFFromAttr(sessionID, attrNode,mpAttr, nlri, labeledQueueWriter, transfer) == -1)
 								{
 									log_err("%s [%d] Could not send BMF message!", __FILE__, __LINE__);
-									pthread_rwlock_unlock(&(attrNode->lock));
 									return -1;
 								}
 								// reset mp reach to 0
-								memset (mpAttrBuf, 0, MAX_BGP_MESSAGE_LEN);
-								mstream_init(&mpAttr, mpAttrBuf, MAX_BGP_MESSAGE_LEN);
+								memset (transfer->mpAttrBuf, 0, MAX_BGP_MESSAGE_LEN);
+								mstream_init(&mpAttr, transfer->mpAttrBuf, MAX_BGP_MESSAGE_LEN);
 								if(mstream_add( &mpAttr, source.start+startPos, mpAttrLen + source.position - startPos -3 ))
 								{
 							 		log_err("Buffer is overflow!1");
-									pthread_rwlock_unlock(&(attrNode->lock));
 							 		return -1;
 								}		
 								if( mstream_add( &mpAttr, &prefixRefNode->prefixNode->keyPrefix.addr, prefixLenInBytes+1 ) )
 
 								{
 							 		log_err("Buffer is overflow!2");
-									pthread_rwlock_unlock(&(attrNode->lock));
 							 		return -1;
 								}		
 							}									
@@ -2063,7 +3524,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 
 			case BGP_MP_UNREACH:
 				log_err("%s [%d] - Failed! Found a mp unreach attribute.", __FILE__, __LINE__);
-				pthread_rwlock_unlock(&(attrNode->lock));
 				return -1;
 				break;
 				
@@ -2074,7 +3534,6 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 				log_msg("--------------------------------------");
 				hexdump(LOG_INFO, attrNode->attr+attrNode->basicAttrLen, attrNode->totalAttrLen-attrNode->basicAttrLen);
 #endif				
-				pthread_rwlock_unlock(&(attrNode->lock));
 				return -1;
 				break;
 		}
@@ -2091,42 +3550,43 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
 		//find a prefix with afi:1 and safi:1
 		//log_msg("preifx loop %d %d", prefixRefNode->prefixNode->keyPrefix.afi, prefixRefNode->prefixNode->keyPrefix.safi);
 		if( prefixRefNode->prefixNode->keyPrefix.afi == 1
-			&& prefixRefNode->prefixNode->keyPrefix.safi == 1 )
+			&& prefixRefNode->prefixNode->keyPrefix.safi == 1
+			&& prefixRefNode->prefixNode->generation > transfer->since )
 		{
-			// insert every matched prefix
-			u_int16_t prefixLenInBytes = PREFIX_SIZE(prefixRefNode->prefixNode->keyPrefix.addr.p_len);
-			// check if the remaining buffer len is suffcient
-			if( remainingLen < prefixLenInBytes + 1 )
+			if( addTransferNLRI(&prefixRefNode->prefixNode->keyPrefix.addr, attrNode, sessionID,
+				&mpAttr, &nlri, &remainingLen, labeledQueueWriter, transfer) )
 			{
-				// BGP update message is full, send it and start new message
-				if (createAndSendBMFFromAttr(sessionID, attrNode,mpAttr, nlri, labeledQueueWriter) == -1)
-				{
-					log_err("%s [%d] Could not send BMF message!", __FILE__, __LINE__);
-					pthread_rwlock_unlock(&(attrNode->lock));
-					return -1;
-				}
-				// reset mp reach to 0
-				memset (mpAttrBuf, 0, MAX_BGP_MESSAGE_LEN);
-				mstream_init(&mpAttr, mpAttrBuf, MAX_BGP_MESSAGE_LEN);
-				// reset nrli to 0
-				memset (nlriBuf, 0, MAX_BGP_MESSAGE_LEN);
-				mstream_init(&nlri, nlriBuf, MAX_BGP_MESSAGE_LEN);
-				remainingLen = MAX_BGP_MESSAGE_LEN - 2 - 2 - attrNode->basicAttrLen - attrNode->asPath->asPathData.len;
-			}	
-			if( mstream_add( &nlri, &prefixRefNode->prefixNode->keyPrefix.addr, prefixLenInBytes+1 ))
-			{
-				log_err("Buffer is overflow %d!3", nlri.position);
-				pthread_rwlock_unlock(&(attrNode->lock));
-		 		return -1;
-			}	
-			remainingLen -= (prefixLenInBytes + 1);
-			
+				return -1;
+			}
 		}
 		prefixRefNode = prefixRefNode->next;
 	}
-	pthread_rwlock_unlock(&(attrNode->lock));
+
+	// 3. the prefixes of this attribute node in the compact IPv4 table
+	// a slot that was unlinked while we stand on it still leads to the rest of the list
+	PrefixTable *prefixTable = Sessions[sessionID]->prefixTable;
+	u_int32_t handle = attrNode->v4Handle;
+	if( prefixTable != NULL && prefixTable->v4Table != NULL && handle != V4_NONE )
+	{
+		V4TableData *d = prefixTable->v4Table->data;
+		// the rib may have been cleaned since the attribute node was read
+		u_int32_t slot = (handle < d->handleSize && d->values[handle] == attrNode) ? d->heads[handle] : V4_NONE;
+		while( slot != V4_NONE )
+		{
+			u_int64_t keyBuf = d->keys[slot];
+			Prefix *prefix = (Prefix *)&keyBuf;
+			if( d->attrs[slot] == handle && d->gens[slot] > transfer->since && addTransferNLRI(&prefix->addr, attrNode, sessionID,
+				&mpAttr, &nlri, &remainingLen, labeledQueueWriter, transfer) )
+				return -1;
+			slot = d->next[slot];
+		}
+	}
+
+	// a delta transfer may have found nothing left to send
+	if( mpAttr.position == 0 && nlri.position == 0 && transfer->since != 0 )
+		return 0;
 		
-	error = createAndSendBMFFromAttr(sessionID, attrNode, mpAttr, nlri, labeledQueueWriter);
+	error = createAndSendBMFFromAttr(sessionID, attrNode, mpAttr, nlri, labeledQueueWriter, transfer);
 
 	return error;
 }
@@ -2137,16 +3597,17 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
  * Input: attrNode -  the attribute node used to create a BMF
  * 	  nlri - NLRI structure
  *	  labeledQueueWriter - name of queue for sending BMF messages	
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
  * Output: 0 for success or -1 for failure
  * Mikhail Strizhov @ July 21st, 2010
  * -------------------------------------------------------------------------------------*/ 
-int createAndSendBMFFromAttr(int sessionID,AttrNode *attrNode, MSTREAM mpAttr, MSTREAM nlri,  QueueWriter labeledQueueWriter) 
+int createAndSendBMFFromAttr(int sessionID,AttrNode *attrNode, MSTREAM mpAttr, MSTREAM nlri,  QueueWriter labeledQueueWriter, TransferState *transfer) 
 {
 
 	// initialize buffer for the body of update 
 	MSTREAM		update;	
-	memset (updateBuf, 0, MAX_BGP_MESSAGE_LEN);
-	mstream_init(&update, updateBuf, MAX_BGP_MESSAGE_LEN);
+	memset (transfer->updateBuf, 0, MAX_BGP_MESSAGE_LEN);
+	mstream_init(&update, transfer->updateBuf, MAX_BGP_MESSAGE_LEN);
 
 
 	// 3. add withdraw routes len to 0 in a update
@@ -2197,20 +3658,106 @@ int createAndSendBMFFromAttr(int sessionID,AttrNode *attrNode, MSTREAM mpAttr, M
 	hexdump(LOG_INFO, update.start, update.position);
 	#endif
 
-	// 9. create BGP message header
-	PBgpHeader hdr = createBGPHeader( typeUpdate );
-	setBGPHeaderLength( hdr, update.position );
+	// 9. wrap it in a BGP header and a BMF message
+	sendTransferUpdate(sessionID, update.start, update.position, labeledQueueWriter, transfer);
+	return 0;
+}	
 
-	// 10. create the BMF message
-	BMF bmf = createBMF(sessionID, BMF_TYPE_TABLE_TRANSFER);
-	bgpmonMessageAppend( bmf, hdr, 19);
-	bgpmonMessageAppend( bmf, update.start, update.position );	
-	
-	// write BMF message to queue
-	writeQueue (labeledQueueWriter, bmf);
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send the withdrawn prefixes of one address family in a table transfer update
+ * Input: sessionID - the ID of the session
+ *		afi, safi - the address family of the prefixes
+ *		prefixes - the prefixes, in NLRI encoding
+ *		len - the length of the prefixes
+ *	  labeledQueueWriter - name of queue for sending BMF messages
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
+ * Output:
+ * NOTE: IPv4 unicast prefixes go in the withdrawn routes, others in a MP_UNREACH attribute
+ * -------------------------------------------------------------------------------------*/ 
+static void sendWithdrawnPrefixes(int sessionID, u_int16_t afi, u_int8_t safi, u_char *prefixes,
+	u_int16_t len, QueueWriter labeledQueueWriter, TransferState *transfer)
+{
+	u_char		*p = transfer->updateBuf;
 
-	free(hdr);
+	if( afi == 1 && safi == 1 )
+	{
+		*((u_int16_t *)p) = htons(len);
+		memcpy(p + 2, prefixes, len);
+		*((u_int16_t *)(p + 2 + len)) = 0;
+		sendTransferUpdate(sessionID, p, len + 4, labeledQueueWriter, transfer);
+		return;
+	}
+	*((u_int16_t *)p) = 0;
+	*((u_int16_t *)(p + 2)) = htons(len + 7);
+	p[4] = BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_EXT_LEN;
+	p[5] = BGP_MP_UNREACH;
+	*((u_int16_t *)(p + 6)) = htons(len + 3);
+	*((u_int16_t *)(p + 8)) = htons(afi);
+	p[10] = safi;
+	memcpy(p + 11, prefixes, len);
+	sendTransferUpdate(sessionID, p, len + 11, labeledQueueWriter, transfer);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send table transfer updates that withdraw the prefixes of a delta transfer
+ * Input: sessionID - the ID of the session
+ *		entries - the withdrawals, see copyRibWithdrawals
+ *		count - the number of withdrawals
+ *	  labeledQueueWriter - name of queue for sending BMF messages
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
+ * Output: 0 for success or -1 for failure
+ * NOTE: The withdrawals are grouped by address family, at most MAX_WITHDRAW_FAMILIES.
+ * -------------------------------------------------------------------------------------*/ 
+int sendWithdrawalBMFs(int sessionID, WithdrawEntry *entries, u_int32_t count,
+	QueueWriter labeledQueueWriter, TransferState *transfer)
+{
+	u_int32_t	families[MAX_WITHDRAW_FAMILIES];
+	int		numFamilies = 0, f, maxLen;
+	u_int32_t	i, family;
+	u_int16_t	len, prefixLen;
+	Prefix		*prefix;
+
+	for( i = 0; i < count; i++ )
+	{
+		prefix = (Prefix *)entries[i].key;
+		family = (prefix->afi << 8) | prefix->safi;
+		for( f = 0; f < numFamilies && families[f] != family; f++ );
+		if( f == numFamilies )
+		{
+			if( numFamilies == MAX_WITHDRAW_FAMILIES )
+			{
+				log_err("sendWithdrawalBMFs: too many address families");
+				return -1;
+			}
+			families[numFamilies++] = family;
+		}
+	}
+
+	for( f = 0; f < numFamilies; f++ )
+	{
+		// the room left in an update after the header and the fixed fields
+		maxLen = MAX_BGP_MESSAGE_LEN - BGP_HEADER_LEN - 4 - ((families[f] == 0x101) ? 0 : 7);
+		len = 0;
+		for( i = 0; i < count; i++ )
+		{
+			prefix = (Prefix *)entries[i].key;
+			if( ((prefix->afi << 8) | prefix->safi) != families[f] )
+				continue;
+			prefixLen = PREFIX_SIZE(prefix->addr.p_len) + 1;
+			if( len + prefixLen > maxLen )
+			{
+				sendWithdrawnPrefixes(sessionID, families[f] >> 8, families[f] & 0xff,
+					transfer->nlriBuf, len, labeledQueueWriter, transfer);
+				len = 0;
+			}
+			memcpy(transfer->nlriBuf + len, &prefix->addr, prefixLen);
+			len += prefixLen;
+		}
+		if( len > 0 )
+			sendWithdrawnPrefixes(sessionID, families[f] >> 8, families[f] & 0xff,
+				transfer->nlriBuf, len, labeledQueueWriter, transfer);
+	}
 	return 0;
-}	
+}
 /* END */
 
@@ -33,13 +33,14 @@
 
 #include <pthread.h>
 #include "myhash.h"
+#include "v4table.h"
 #include "../Util/bgpmon_formats.h"
 #include "labelutils.h"
 
 #include "../Queues/queue.h"
 #define MAX_BGP_MESSAGE_LEN	4096
 #define MAX_PREFIX_LEN  512
-#define PREFIX_SIZE(x) ((x/8)*8 == x)?x/8:x/8+1
+#define PREFIX_SIZE(x) ((((x)/8)*8 == (x)) ? (x)/8 : (x)/8+1)
 #define MAXV(x, y) (x>y)?x:y
 
 /*----------------------------------------------------------------------------------------
@@ -66,13 +67,20 @@ typedef struct ASPathStruct {
 	u_int32_t	refCount;
 } ASPath;
 
+typedef struct AsIndexLinkStruct AsIndexLink;
+
 typedef struct AttrNodeStruct {
    struct AttrNodeStruct	*next;
    u_int16_t				refCount;
    PrefixRefNode			*prefixRefNode;
-   pthread_rwlock_t			lock;
    ASPath					*asPath;
    INDEX					bucketIndex;
+   u_int32_t				v4Handle;	/* handle in the IPv4 prefix table or V4_NONE */
+   u_int64_t				generation;	/* last rib generation in which a prefix joined the node */
+   u_int64_t				fingerprint;	/* attr_fingerprint of the AS path and attributes */
+   AsIndexLink				*asLinks;	/* links in the AS indexes, origins first */
+   u_int16_t				asLinkCount;
+   u_int16_t				asOriginCount;
    u_int16_t				basicAttrLen;
    u_int16_t				totalAttrLen;
    u_char					attr[0];
@@ -80,10 +88,39 @@ typedef struct AttrNodeStruct {
 
 typedef struct AttrEntryStruct {
    struct AttrNodeStruct	*node;
-   pthread_rwlock_t          lock;
    u_int16_t				nodeCount;
 } AttrEntry;
 
+/* Reverse indexes from an AS number to the attribute nodes whose AS path has 
+ * it, one for origin ASes and one for the ASes a route transits.  An attribute 
+ * node is linked in when its first prefix is applied and unlinked when it is
+ * removed, so only attribute nodes in use are found.  Readers walk the lists
+ * inside an epoch section, an unlinked link keeps its next. */
+#define AS_INDEX_SIZE 4096
+
+typedef struct AsIndexHeadStruct {
+   struct AsIndexHeadStruct	*next;
+   AsIndexLink				*first;
+   u_int32_t				as;
+   u_int32_t				count;	/* number of attribute nodes */
+} AsIndexHead;
+
+struct AsIndexLinkStruct {
+   AsIndexLink				*next;
+   AsIndexLink				*prev;
+   AsIndexHead				*head;
+   AttrNode				*attrNode;
+};
+
+typedef struct AsIndexStruct {
+   AsIndexHead				*heads[AS_INDEX_SIZE];
+   u_int32_t				asCount;
+} AsIndex;
+
+/* attribute nodes the last updates of a session resolved to, so a burst of
+ * updates with the same attributes is matched on the fingerprint alone */
+#define ATTR_CACHE_SIZE 4
+
 typedef struct AttrTableStruct {
    u_int32_t                  attrCount;
    u_int32_t                  tableSize;
@@ -91,6 +128,10 @@ typedef struct AttrTableStruct {
    u_int32_t                  maxNodeCount;
    u_int16_t                  maxCollision; 
    AttrEntry                 *attrEntries;
+   AttrNode                  *recent[ATTR_CACHE_SIZE];
+   u_int32_t                  recentNext;	/* slot of recent replaced next */
+   AsIndex                    originIndex;
+   AsIndex                    transitIndex;
 } AttrTable;
 
 
@@ -110,10 +151,26 @@ typedef struct PrefixStruct {
    PAddress       addr;
 } Prefix;
 
+/* Fixed width lookup key of a prefix. The key holds the Prefix header (afi, safi,
+ * length) and the zero padded address bytes, so prefixes with up to 4 address
+ * bytes (IPv4) fit in one 64 bit word and prefixes with up to 20 address bytes
+ * (IPv6) fit in three. Longer prefixes do not fit and have words set to 0.
+ */
+#define PREFIX_KEY_WORDS 3
+typedef struct PrefixKeyStruct {
+   u_int64_t      w[PREFIX_KEY_WORDS];
+   int            words;
+} PrefixKey;
+
+/* number of address bytes stored in a prefix node, padded to the key width */
+#define PREFIX_KEY_BYTES(x) ((PREFIX_SIZE(x)) <= 4 ? 4 : ((PREFIX_SIZE(x)) <= 20 ? 20 : (PREFIX_SIZE(x))))
+
+/* the address of keyPrefix is padded with zeros to PREFIX_KEY_BYTES */
 struct PrefixNodeStruct {
    struct PrefixNodeStruct  *next;
    AttrNode                  *dataAttr;
    u_int32_t                  originatedTS;      
+   u_int64_t                  generation;	/* rib generation in which the prefix got its attributes */
    Prefix                     keyPrefix;
 };
 
@@ -122,6 +179,35 @@ typedef struct PrefixEntryStruct {
    u_int16_t                  nodeCount;
 } PrefixEntry;
 
+/* a withdrawn prefix, the key words hold the Prefix as in PrefixKey */
+/* address families a delta transfer can withdraw prefixes of */
+#define MAX_WITHDRAW_FAMILIES 16
+
+typedef struct WithdrawEntryStruct {
+   u_int64_t      generation;
+   u_int64_t      key[PREFIX_KEY_WORDS];
+} WithdrawEntry;
+
+/* The prefixes withdrawn from a rib, oldest first, kept for delta transfers.
+ * Once the journal is full the oldest entries are dropped and floor tells
+ * from which generation on the journal is still complete. */
+typedef struct WithdrawJournalStruct {
+   pthread_mutex_t            lock;
+   WithdrawEntry             *entries;
+   u_int32_t                  size;	/* allocated entries */
+   u_int32_t                  start;	/* index of the oldest entry */
+   u_int32_t                  count;
+   u_int64_t                  floor;
+} WithdrawJournal;
+
+/* Every update applied to a rib gets the next generation of its prefix table
+ * and changed prefixes are stamped with it. The generations of a table start
+ * at baseGeneration, which is unique to the table, so a checkpoint taken from
+ * one table is never mistaken for a checkpoint of another. completeGeneration
+ * is the last generation whose changes are all visible to other threads.
+ * A rib kept over a session flap is stale: the prefixes stamped in
+ * staleGeneration or before were not announced again yet and are withdrawn
+ * at the end of rib or at staleDeadline.  staleGeneration is 0 otherwise. */
 typedef struct PrefixTableStruct {
    u_int32_t                  prefixCount;
    u_int32_t                  tableSize;
@@ -129,8 +215,58 @@ typedef struct PrefixTableStruct {
    u_int16_t                  maxNodeCount;
    u_int16_t                  maxCollision;   
    PrefixEntry               *prefixEntries;
+   V4Table                   *v4Table;	/* IPv4 unicast prefixes, all others are in prefixEntries */
+   u_int64_t                  baseGeneration;
+   u_int64_t                  generation;
+   volatile u_int64_t         completeGeneration;
+   WithdrawJournal            journal;
+   u_int64_t                  staleGeneration;
+   time_t                     staleDeadline;
 } PrefixTable;
 
+/* called by walkRibTable for every prefix, a non zero return value stops the walk */
+typedef int (*RibWalkCallback)(const Prefix *prefix, AttrNode *attrNode, void *arg);
+
+/* where walkRibTablePage goes on, zeroed to start at the first prefix */
+typedef struct RibWalkCursorStruct {
+	u_int32_t	bucket;		/* the bucket of prefixEntries */
+	u_int32_t	skip;		/* the prefixes of that bucket already passed */
+	u_int32_t	slot;		/* the slot of the compact IPv4 table */
+} RibWalkCursor;
+
+/* where walkOriginASPage and walkTransitASPage go on, zeroed to start at the first one */
+typedef struct AsWalkCursorStruct {
+	u_int32_t	link;		/* the attribute nodes of the AS already passed */
+	u_int32_t	skip;		/* the prefixes of the next attribute node already passed */
+} AsWalkCursor;
+
+/* called by walkTransitAS for every attribute node, a non zero return value stops the walk */
+typedef int (*AttrWalkCallback)(AttrNode *attrNode, void *arg);
+
+/* Where a table transfer sends its messages instead of the labeled queue.
+ * put takes over every message and is called inside an epoch section, so it
+ * must not block; flush is called outside of it after every bucket and may
+ * block. A non zero return value of either stops the transfer. */
+typedef struct TransferSinkStruct {
+	int		(*put)(BMF bmf, void *arg);
+	int		(*flush)(void *arg);
+	void		*arg;
+} TransferSink;
+
+/* what a table transfer has written to the labeled queue so far and the
+ * buffers it builds updates in, one set per transfer so transfers can run at once.
+ * A delta transfer only sends prefixes stamped after since, a full one has since 0 */
+typedef struct TransferStateStruct {
+	u_int32_t	messages;
+	u_int32_t	bytes;
+	u_int64_t	since;
+	TransferSink	*sink;		/* NULL to write to the labeled queue */
+	int		failed;		/* set once the sink refused a message */
+	u_char		updateBuf[MAX_BGP_MESSAGE_LEN];
+	u_char		mpAttrBuf[MAX_BGP_MESSAGE_LEN];
+	u_char		nlriBuf[MAX_BGP_MESSAGE_LEN];
+} TransferState;
+
 
 /*----------------------------------------------------------------------------------------
  * Parsed BGP Update Structures
@@ -174,6 +310,8 @@ typedef struct ParsedBGPUpdateStruct {
 	u_int8_t	numOfMpNlri;
 	BGPASPath		asPath;		/*as path*/
 	BGPAttribute	 attr;	   /*other attributes*/ 
+	u_char		buffer[MAX_BGP_MESSAGE_LEN];	/*backing store for nlri, as path and attributes*/
+	u_char		buffer1[MAX_BGP_MESSAGE_LEN];	/*backing store for mp nlri*/
 } ParsedBGPUpdate;
 
 
@@ -202,6 +340,101 @@ void createPrefixTable(int sessionID, u_int32_t prefixTableSize, u_int16_t	maxCo
 void createAttributeTable(int sessionID, u_int32_t attributeTableSize, u_int16_t  maxCollision);
 
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every prefix in the rib table of a session
+ * Input: sessionID - the ID of the session
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * NOTE: The prefix and attribute node passed to the callback are only valid 
+ *       during the call.
+ * -------------------------------------------------------------------------------------*/ 
+int walkRibTable(int sessionID, RibWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the prefixes in the rib table of a session, from a 
+ *		cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		cursor - where to start, zeroed for the first prefix, moved past the 
+ *		prefix that stopped the walk
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if the end of the table was reached
+ * NOTE: No epoch section is held between the calls, so the caller may block 
+ *       before it goes on with the cursor.
+ * -------------------------------------------------------------------------------------*/ 
+int walkRibTablePage(int sessionID, RibWalkCursor *cursor, RibWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every prefix originated by an AS in the rib of a session
+ * Input: sessionID - the ID of the session
+ *		as - the origin AS
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * NOTE: Takes time in proportion to the number of prefixes found. The prefix
+ *       and attribute node passed to the callback are only valid during the call.
+ * -------------------------------------------------------------------------------------*/ 
+int walkOriginAS(int sessionID, u_int32_t as, RibWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the prefixes originated by an AS in the rib of a 
+ *		session, from a cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		as - the origin AS
+ *		cursor - where to start, zeroed for the first prefix, moved past the 
+ *		prefix that stopped the walk
+ *		callback - the function to call with each prefix and its attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if all prefixes were passed
+ * NOTE: No epoch section is held between the calls, so the caller may block 
+ *       before it goes on with the cursor.
+ * -------------------------------------------------------------------------------------*/ 
+int walkOriginASPage(int sessionID, u_int32_t as, AsWalkCursor *cursor, RibWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for every attribute node whose AS path transits an AS
+ * Input: sessionID - the ID of the session
+ *		as - the transit AS, any AS of the path but the origin
+ *		callback - the function to call with each attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 otherwise
+ * NOTE: Takes time in proportion to the number of attribute nodes found. The 
+ *       attribute node passed to the callback is only valid during the call.
+ * -------------------------------------------------------------------------------------*/ 
+int walkTransitAS(int sessionID, u_int32_t as, AttrWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Call a function for the attribute nodes whose AS path transits an AS, 
+ *		from a cursor on until the callback stops the walk
+ * Input: sessionID - the ID of the session
+ *		as - the transit AS
+ *		cursor - where to start, zeroed for the first node, moved past the 
+ *		node that stopped the walk
+ *		callback - the function to call with each attribute node
+ *		arg - passed to the callback
+ * Output: 1 if the callback stopped the walk, 0 if all nodes were passed
+ * NOTE: No epoch section is held between the calls, as in walkOriginASPage.
+ * -------------------------------------------------------------------------------------*/ 
+int walkTransitASPage(int sessionID, u_int32_t as, AsWalkCursor *cursor, AttrWalkCallback callback, void *arg);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Build the fixed width lookup key of a prefix
+ * Input: prefix - the prefix
+ *		key - the key to fill in
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+void makePrefixKey(const Prefix *prefix, PrefixKey *key);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if a prefix stored in a prefix node matches a lookup key
+ * Input: key - the lookup key built by makePrefixKey
+ *		prefix - the lookup prefix, used when the key does not fit in words
+ *		nodePrefix - the zero padded key prefix of a prefix node
+ * Output: 1 if they match, 0 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int prefixKeyMatch(const PrefixKey *key, const Prefix *prefix, const Prefix *nodePrefix);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Parse a BGP Update message into reach nlri, unreach nlri, mpreach
  * 		    nlri, mpunreach nlri and attribute whcih is basic attr + mpreach - mpreach nlri.
@@ -213,6 +446,22 @@ void createAttributeTable(int sessionID, u_int32_t attributeTableSize, u_int16_t
  * -------------------------------------------------------------------------------------*/ 
 int parseBGPUpdate (void *rawBGPUpdate, u_int32_t length, ParsedBGPUpdate *parsedBGPUpdate);
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if a BGP Update message is an End-of-RIB marker (RFC 4724)
+ * Input: rawBGPUpdate - Raw BGP update message
+ *		len	- length of rw BGP update
+ *		afi, safi - set to the address family of the marker
+ * Output:  1 if it is a marker, 0 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int getEndOfRib (void *rawBGPUpdate, u_int32_t length, u_int16_t *afi, u_int8_t *safi);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove the prefixes labeled as duplicates from a labeled BGP update
+ * Input: bmf - the labeled message, rewritten in place
+ * Output: 0 if only duplicates were in it and it should be dropped, 1 otherwise
+ * -------------------------------------------------------------------------------------*/ 
+int stripDuplicatePrefixes (BMF bmf);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Print an AS path, for debugging
  * Input: asPath - pointer to the buffer of AS path
@@ -254,11 +503,14 @@ char * printPrefix(const Prefix *prefix);
  * Input: attrNode -  the attribute node used to create a BMF
  *		sessionID -  the ID of the session	
  *	  labeledQueueWriter - name of queue for sending BMF messages	
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
  * Output: 0 for success or -1 for failure
+ * NOTE: must be called inside an epoch section, see epoch.h
+ *       Only the prefixes added after transfer->since are included.
  * He Yan @ July 4th, 2008
  * Mikhail Strizhov @ July 21st, 2010
  * -------------------------------------------------------------------------------------*/ 
-int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQueueWriter);
+int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQueueWriter, TransferState *transfer);
 
 
 /*--------------------------------------------------------------------------------------
@@ -266,9 +518,53 @@ int sendBMFFromAttrNode(AttrNode *attrNode, int sessionID, QueueWriter labeledQu
  * Input: attrNode -  the attribute node used to create a BMF
  * 	  nlri - NLRI structure
  *	  labeledQueueWriter - name of queue for sending BMF messages	
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
  * Output: 0 for success or -1 for failure
  * Mikhail Strizhov @ July 21st, 2010
  * -------------------------------------------------------------------------------------*/ 
-int createAndSendBMFFromAttr(int sessionID,AttrNode *attrNode, MSTREAM mpAttr, MSTREAM nlri,  QueueWriter labeledQueueWriter); 
+int createAndSendBMFFromAttr(int sessionID,AttrNode *attrNode, MSTREAM mpAttr, MSTREAM nlri,  QueueWriter labeledQueueWriter, TransferState *transfer); 
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send a message of a table transfer to its sink or the labeled queue
+ * Input: transfer - the table transfer
+ *	  labeledQueueWriter - name of queue for sending BMF messages, unused with a sink
+ *	  bmf - the message, taken over
+ * Output:
+ * -------------------------------------------------------------------------------------*/ 
+void writeTransferBMF(TransferState *transfer, QueueWriter labeledQueueWriter, BMF bmf);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy the prefixes withdrawn from a rib after a checkpoint
+ * Input:	 prefixTable - the prefix table
+ *		 since - the checkpoint
+ *		 entries - set to a malloced copy of the withdrawals, NULL if there are none
+ *		 count - set to the number of withdrawals
+ * Output:  0 for success or -1 if the journal no longer goes back to the checkpoint
+ * -------------------------------------------------------------------------------------*/
+int copyRibWithdrawals (PrefixTable *prefixTable, u_int64_t since, WithdrawEntry **entries, u_int32_t *count);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy the stale prefixes of a rib that was kept over a session flap
+ * Input:	 prefixTable - the prefix table, owned by the calling labeling worker
+ *		 afi, safi - the address family to copy, afi 0 for all of them
+ *		 entries - set to a malloced array of the prefixes, NULL if there are none
+ *		 count - set to the number of prefixes
+ * Output:  0 for success or -1 for failure
+ * NOTE: Prefixes without a fixed width key can not be copied, they stay stale.
+ * -------------------------------------------------------------------------------------*/
+int copyStalePrefixes (PrefixTable *prefixTable, u_int16_t afi, u_int8_t safi, WithdrawEntry **entries, u_int32_t *count);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Send table transfer updates that withdraw the prefixes of a delta transfer
+ * Input: sessionID - the ID of the session
+ *		entries - the withdrawals, see copyRibWithdrawals
+ *		count - the number of withdrawals
+ *	  labeledQueueWriter - name of queue for sending BMF messages
+ *	  transfer - counts the messages and bytes sent, holds the update buffers
+ * Output: 0 for success or -1 for failure
+ * NOTE: The withdrawals are grouped by address family, at most MAX_WITHDRAW_FAMILIES.
+ * -------------------------------------------------------------------------------------*/ 
+int sendWithdrawalBMFs(int sessionID, WithdrawEntry *entries, u_int32_t count,
+	QueueWriter labeledQueueWriter, TransferState *transfer);
 
 #endif /*RTABLE_H_*/
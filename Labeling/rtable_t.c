@@ -30,9 +30,14 @@
 #include <CUnit/Basic.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "rtable.h"
+#include "labelinternal.h"
+#include "epoch.h"
+#include "myhash.h"
 
 /* a few global variables to play with across tests */
+static int epochFreed = 0;
 
 
 
@@ -438,6 +443,243 @@ testRTABLE_printPrefixV6(void){
 
 }
 
+void
+testRTABLE_prefixKey(void){
+
+  PrefixKey key;
+  Prefix *test_prefix = malloc(sizeof(Prefix) + (PREFIX_SIZE(128)));
+  Prefix *node_prefix = malloc(sizeof(Prefix) + (PREFIX_KEY_BYTES(128)));
+  Prefix *other_prefix = malloc(sizeof(Prefix) + (PREFIX_KEY_BYTES(128)));
+
+  // IPv4 /24 fits in one word and matches its zero padded node copy
+  test_prefix->afi = 1;
+  test_prefix->safi = 1;
+  test_prefix->addr.p_len = 24;
+  test_prefix->addr.paddr[0] = 10;
+  test_prefix->addr.paddr[1] = 20;
+  test_prefix->addr.paddr[2] = 30;
+  makePrefixKey(test_prefix, &key);
+  CU_ASSERT(key.words == 1);
+  memcpy(node_prefix, key.w, sizeof(Prefix) + PREFIX_KEY_BYTES(24));
+  CU_ASSERT(node_prefix->addr.paddr[3] == 0);
+  CU_ASSERT(prefixKeyMatch(&key, test_prefix, node_prefix));
+  CU_ASSERT(prefix_key_hash(key.w, key.words, 40000) < 40000);
+
+  // a different length or address does not match
+  memcpy(other_prefix, node_prefix, sizeof(Prefix) + PREFIX_KEY_BYTES(24));
+  other_prefix->addr.p_len = 23;
+  CU_ASSERT(!prefixKeyMatch(&key, test_prefix, other_prefix));
+  other_prefix->addr.p_len = 24;
+  other_prefix->addr.paddr[2] = 31;
+  CU_ASSERT(!prefixKeyMatch(&key, test_prefix, other_prefix));
+
+  // IPv6 /128 needs three words, a v4 node never matches it
+  int i;
+  test_prefix->afi = 2;
+  test_prefix->addr.p_len = 128;
+  for(i=0;i<16;i++){
+    test_prefix->addr.paddr[i] = i;
+  }
+  makePrefixKey(test_prefix, &key);
+  CU_ASSERT(key.words == 3);
+  CU_ASSERT(!prefixKeyMatch(&key, test_prefix, node_prefix));
+  memcpy(node_prefix, key.w, sizeof(Prefix) + PREFIX_KEY_BYTES(128));
+  CU_ASSERT(prefixKeyMatch(&key, test_prefix, node_prefix));
+  node_prefix->addr.paddr[15] = 0xFF;
+  CU_ASSERT(!prefixKeyMatch(&key, test_prefix, node_prefix));
+
+  free(test_prefix);
+  free(node_prefix);
+  free(other_prefix);
+}
+
+void
+testRTABLE_v4table(void){
+
+  V4Table *t = createV4Table(16);
+  int a = 1, b = 2;
+  u_int32_t ha, hb, slot, i, count;
+  u_int64_t key;
+
+  ha = v4TableNewHandle(t, &a);
+  hb = v4TableNewHandle(t, &b);
+  CU_ASSERT(ha != hb);
+
+  // enough keys to force the table to grow
+  for(i=1;i<=1000;i++){
+    key = ((u_int64_t)i << 32) | 1;
+    CU_ASSERT(v4TableFind(t, key) == V4_NONE);
+    slot = v4TableAdd(t, key);
+    t->data->gens[slot] = i;
+    v4TableLink(t, slot, (i % 2) ? ha : hb);
+  }
+  CU_ASSERT(t->count == 1000);
+  CU_ASSERT(t->data->size >= 1000);
+
+  // every key is found and linked to the right handle, its generation moved with it
+  for(i=1;i<=1000;i++){
+    key = ((u_int64_t)i << 32) | 1;
+    slot = v4TableFind(t, key);
+    CU_ASSERT(slot != V4_NONE);
+    CU_ASSERT(t->data->gens[slot] == i);
+    CU_ASSERT(t->data->values[t->data->attrs[slot]] == ((i % 2) ? (void *)&a : (void *)&b));
+  }
+  count = 0;
+  for(slot = t->data->heads[ha]; slot != V4_NONE; slot = t->data->next[slot]){
+    count++;
+  }
+  CU_ASSERT(count == 500);
+
+  // remove the even keys, the odd ones stay reachable
+  for(i=2;i<=1000;i+=2){
+    key = ((u_int64_t)i << 32) | 1;
+    slot = v4TableFind(t, key);
+    CU_ASSERT(v4TableUnlink(t, slot) == 0);
+    v4TableRemove(t, slot);
+  }
+  CU_ASSERT(t->count == 500);
+  CU_ASSERT(t->data->heads[hb] == V4_NONE);
+  for(i=1;i<=1000;i++){
+    key = ((u_int64_t)i << 32) | 1;
+    CU_ASSERT((v4TableFind(t, key) != V4_NONE) == (i % 2));
+  }
+
+  v4TableFreeHandle(t, hb);
+  clearV4Table(t);
+  CU_ASSERT(t->count == 0);
+  destroyV4Table(t);
+}
+
+static void
+countEpochFree(void *ptr){
+  epochFreed++;
+}
+
+void
+testRTABLE_epoch(void){
+
+  V4Table *t;
+  int x, reader;
+  u_int32_t h1, h2, slot1, slot2;
+  u_int64_t key = ((u_int64_t)1 << 32) | 1;
+
+  // nothing is freed while a reader that could see it is active
+  epochReclaim();
+  epochFreed = 0;
+  reader = epochEnter();
+  epochRetire(&x, countEpochFree);
+  epochReclaim();
+  CU_ASSERT(epochFreed == 0);
+  epochExit(reader);
+  epochReclaim();
+  CU_ASSERT(epochFreed == 1);
+
+  // a released handle is not given out again until the reader has left
+  t = createV4Table(16);
+  h1 = v4TableNewHandle(t, &x);
+  reader = epochEnter();
+  v4TableFreeHandle(t, h1);
+  h2 = v4TableNewHandle(t, &x);
+  CU_ASSERT(h2 != h1);
+  epochExit(reader);
+  epochReclaim();
+  CU_ASSERT(v4TableNewHandle(t, &x) == h1);
+
+  // an unlinked slot still leads to the rest of the list, and it is not
+  // used again before the next resize
+  slot1 = v4TableAdd(t, key);
+  v4TableLink(t, slot1, h2);
+  slot2 = v4TableAdd(t, key + ((u_int64_t)1 << 32));
+  v4TableLink(t, slot2, h2);
+  CU_ASSERT(v4TableUnlink(t, slot2) == 0);
+  CU_ASSERT(t->data->heads[h2] == slot1);
+  CU_ASSERT(t->data->next[slot2] == slot1);
+  v4TableRemove(t, slot2);
+  CU_ASSERT(v4TableAdd(t, key + ((u_int64_t)1 << 32)) != slot2);
+  destroyV4Table(t);
+  epochReclaim();
+}
+
+void
+testRTABLE_attrFingerprint(void){
+
+  u_char path[] = {0x40,2,6,2,1,0,0,0xfd,0xe9};
+  u_char attr[] = {0x40,1,1,0, 0x40,3,4,1,2,3,4, 0x80,4,4,0,0,0,100};
+  u_int64_t fp = attr_fingerprint(path, sizeof(path), attr, sizeof(attr));
+
+  // the same attribute set always gets the same fingerprint
+  CU_ASSERT(fp == attr_fingerprint(path, sizeof(path), attr, sizeof(attr)));
+
+  // a change in any byte, also past the last full word, changes it
+  attr[sizeof(attr)-1] = 101;
+  CU_ASSERT(fp != attr_fingerprint(path, sizeof(path), attr, sizeof(attr)));
+  attr[sizeof(attr)-1] = 100;
+  path[8] = 0xea;
+  CU_ASSERT(fp != attr_fingerprint(path, sizeof(path), attr, sizeof(attr)));
+  path[8] = 0xe9;
+
+  // the split between the AS path and the attributes is part of it
+  CU_ASSERT(attr_fingerprint(attr, 4, attr + 4, sizeof(attr) - 4) != attr_fingerprint(attr, 8, attr + 8, sizeof(attr) - 8));
+  CU_ASSERT(attr_fingerprint(path, sizeof(path), attr, 0) != attr_fingerprint(path, sizeof(path) - 1, attr, 0));
+}
+
+// one step of the attribute fingerprint, copied to build a collision
+static u_int64_t
+fingerprintStep(u_int64_t h, const u_char *word){
+  u_int64_t w;
+  memcpy(&w, word, 8);
+  h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
+
+void
+testRTABLE_attrCollision(void){
+
+  u_char path[8] = {0x40,2,6,2,1,0,0,0xfd};
+  u_char attrA[16] = {0x40,1,1,0, 0x40,3,4,1,2,3,4, 0x80,4,4,0,0};
+  u_char attrB[16];
+  u_int64_t h, hA, hB, w;
+  AttrNode *nodeA, *nodeB;
+  Session_structp session = calloc(1, sizeof(struct SessionStruct));
+
+  // attrB differs from attrA in the first word, the second word cancels it out
+  h = ((u_int64_t)sizeof(path) << 16 | sizeof(attrA)) * 0xC2B2AE3D27D4EB4FULL;
+  h = fingerprintStep(h, path);
+  memcpy(attrB, attrA, sizeof(attrA));
+  attrB[0] = 0x50;
+  hA = fingerprintStep(h, attrA);
+  hB = fingerprintStep(h, attrB);
+  memcpy(&w, attrA + 8, 8);
+  w ^= hA ^ hB;
+  memcpy(attrB + 8, &w, 8);
+  CU_ASSERT(memcmp(attrA, attrB, sizeof(attrA)) != 0);
+  CU_ASSERT(attr_fingerprint(path, sizeof(path), attrA, sizeof(attrA)) == attr_fingerprint(path, sizeof(path), attrB, sizeof(attrB)));
+
+  // the cached node of attrA must not be returned for attrB
+  session->attributeTable = calloc(1, sizeof(AttrTable));
+  session->attributeTable->tableSize = 16;
+  session->attributeTable->maxCollision = 100;
+  session->attributeTable->attrEntries = calloc(16, sizeof(AttrEntry));
+  nodeA = searchAttrNode(path, sizeof(path), attrA, sizeof(attrA), sizeof(attrA), session);
+  nodeB = searchAttrNode(path, sizeof(path), attrB, sizeof(attrB), sizeof(attrB), session);
+  CU_ASSERT(nodeA != NULL);
+  CU_ASSERT(nodeB != NULL);
+  CU_ASSERT(nodeA != nodeB);
+  CU_ASSERT(nodeB != NULL && memcmp(nodeB->attr, attrB, sizeof(attrB)) == 0);
+  CU_ASSERT(searchAttrNode(path, sizeof(path), attrA, sizeof(attrA), sizeof(attrA), session) == nodeA);
+  CU_ASSERT(searchAttrNode(path, sizeof(path), attrB, sizeof(attrB), sizeof(attrB), session) == nodeB);
+
+  if (nodeA != NULL) {
+    free(nodeA->asPath->asPathData.data);
+    free(nodeA->asPath);
+  }
+  free(nodeA);
+  free(nodeB);
+  free(session->attributeTable->attrEntries);
+  free(session->attributeTable);
+  free(session);
+}
+
 /* The suite initialization function.
  * Returns zero on success, non-zero otherwise.
  */
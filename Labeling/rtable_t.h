@@ -37,6 +37,11 @@ void testRTABLE_stringToPrefixV4(void);
 void testRTABLE_stringToPrefixV6(void);
 void testRTABLE_printPrefixV4();
 void testRTABLE_printPrefixV6();
+void testRTABLE_prefixKey(void);
+void testRTABLE_v4table(void);
+void testRTABLE_epoch(void);
+void testRTABLE_attrFingerprint(void);
+void testRTABLE_attrCollision(void);
 int init_RTABLE(void);
 int clean_RTABLE(void);
 
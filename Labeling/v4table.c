@@ -0,0 +1,393 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: v4table.c
+ *  Date: Oct 18, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "v4table.h"
+#include "myhash.h"
+#include "epoch.h"
+#include "../Util/log.h"
+
+//#define DEBUG
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Allocate the arrays of a table in one block and mark all slots empty
+ * Input: size - the number of slots
+ *		handleSize - the number of handles
+ * Output: the new arrays, exits on fatal error if out of memory
+ * NOTE: the block is freed with a single free(), so it can be retired as it is
+ * -------------------------------------------------------------------------------------*/
+static V4TableData *allocV4Data(u_int32_t size, u_int32_t handleSize)
+{
+	V4TableData *d = malloc(sizeof(V4TableData) + (size_t)size * (2*sizeof(u_int64_t) + 2*sizeof(u_int32_t))
+		+ (size_t)handleSize * (sizeof(void *) + sizeof(u_int32_t)));
+	if( d == NULL )
+		log_fatal("allocV4Data: out of memory for %u slots and %u handles", size, handleSize);
+
+	d->size = size;
+	d->handleSize = handleSize;
+	d->keys = (u_int64_t *)(d + 1);
+	d->gens = d->keys + size;
+	d->values = (void **)(d->gens + size);
+	d->attrs = (u_int32_t *)(d->values + handleSize);
+	d->next = d->attrs + size;
+	d->heads = d->next + size;
+	memset(d->keys, 0, size * sizeof(u_int64_t));
+	memset(d->attrs, 0xFF, size * sizeof(u_int32_t));
+	memset(d->next, 0xFF, size * sizeof(u_int32_t));
+	return d;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the number of bytes of a block of arrays
+ * Input: d - the arrays
+ * Output: the size in bytes
+ * -------------------------------------------------------------------------------------*/
+static size_t v4DataMemory(V4TableData *d)
+{
+	return sizeof(V4TableData) + (size_t)d->size * (2*sizeof(u_int64_t) + 2*sizeof(u_int32_t))
+		+ (size_t)d->handleSize * (sizeof(void *) + sizeof(u_int32_t));
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Make new arrays visible to readers and retire the old ones
+ * Input: t - the table
+ *		d - the new arrays
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void publishV4Data(V4Table *t, V4TableData *d)
+{
+	V4TableData *old = t->data;
+
+	__sync_synchronize();
+	t->data = d;
+	epochRetire(old, NULL);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Create a compact IPv4 prefix table
+ * Input: size - the initial number of slots
+ * Output: the new table, exits on fatal error if out of memory
+ * -------------------------------------------------------------------------------------*/
+V4Table *createV4Table(u_int32_t size)
+{
+	V4Table *t = malloc(sizeof(V4Table));
+	if( t == NULL )
+		log_fatal("createV4Table: malloc failed");
+
+	t->count = 0;
+	t->used = 0;
+	t->handleCount = 0;
+	t->links = NULL;
+	t->freeHandle = V4_NONE;
+	t->retiringHandle = V4_NONE;
+	t->retiredHandle = V4_NONE;
+	t->retiringEpoch = 0;
+	t->data = allocV4Data(size, 0);
+	return t;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove all prefixes and handles from a table, keeps the arrays
+ * Input: t - the table
+ * Output:
+ * NOTE: the table must not be reachable by readers anymore
+ * -------------------------------------------------------------------------------------*/
+void clearV4Table(V4Table *t)
+{
+	V4TableData *d = t->data;
+
+	memset(d->keys, 0, d->size * sizeof(u_int64_t));
+	memset(d->attrs, 0xFF, d->size * sizeof(u_int32_t));
+	memset(d->next, 0xFF, d->size * sizeof(u_int32_t));
+	t->count = 0;
+	t->used = 0;
+	t->handleCount = 0;
+	t->freeHandle = V4_NONE;
+	t->retiringHandle = V4_NONE;
+	t->retiredHandle = V4_NONE;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free a table and its arrays
+ * Input: t - the table
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void destroyV4Table(V4Table *t)
+{
+	free(t->data);
+	free(t->links);
+	free(t);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the number of bytes used by a table
+ * Input: t - the table
+ * Output: the size in bytes
+ * -------------------------------------------------------------------------------------*/
+size_t v4TableMemory(V4Table *t)
+{
+	return sizeof(V4Table) + v4DataMemory(t->data) + (size_t)t->data->handleSize * sizeof(u_int32_t);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Make released handles available once no reader can see them anymore
+ * Input: t - the table
+ * Output:
+ * NOTE: Handles are released into retiredHandle. That list is closed with the 
+ *       current epoch as retiringHandle, and once that epoch has passed the 
+ *       handles in it become free.
+ * -------------------------------------------------------------------------------------*/
+static void recycleV4Handles(V4Table *t)
+{
+	if( t->retiringHandle != V4_NONE && epochPassed(t->retiringEpoch) )
+	{
+		t->freeHandle = t->retiringHandle;
+		t->retiringHandle = V4_NONE;
+	}
+	if( t->retiringHandle == V4_NONE && t->retiredHandle != V4_NONE )
+	{
+		t->retiringHandle = t->retiredHandle;
+		t->retiringEpoch = epochCurrent();
+		t->retiredHandle = V4_NONE;
+	}
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Allocate an attribute handle
+ * Input: t - the table
+ *		value - the value the handle refers to
+ * Output: the new handle
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableNewHandle(V4Table *t, void *value)
+{
+	V4TableData	*d = t->data;
+	u_int32_t	handle;
+
+	if( t->freeHandle == V4_NONE )
+		recycleV4Handles(t);
+
+	if( t->freeHandle != V4_NONE )
+	{
+		handle = t->freeHandle;
+		t->freeHandle = t->links[handle];
+	}
+	else
+	{
+		if( t->handleCount == d->handleSize )
+		{
+			u_int32_t newSize = d->handleSize ? d->handleSize * 2 : 1024;
+			V4TableData *nd = allocV4Data(d->size, newSize);
+			memcpy(nd->keys, d->keys, d->size * sizeof(u_int64_t));
+			memcpy(nd->gens, d->gens, d->size * sizeof(u_int64_t));
+			memcpy(nd->attrs, d->attrs, d->size * sizeof(u_int32_t));
+			memcpy(nd->next, d->next, d->size * sizeof(u_int32_t));
+			memcpy(nd->heads, d->heads, t->handleCount * sizeof(u_int32_t));
+			memcpy(nd->values, d->values, t->handleCount * sizeof(void *));
+			t->links = realloc(t->links, newSize * sizeof(u_int32_t));
+			if( t->links == NULL )
+				log_fatal("v4TableNewHandle: out of memory for %u handles", newSize);
+			publishV4Data(t, nd);
+			d = nd;
+		}
+		handle = t->handleCount++;
+	}
+	d->heads[handle] = V4_NONE;
+	d->values[handle] = value;
+	__sync_synchronize();
+	return handle;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Release an attribute handle, no slot may be linked to it
+ * Input: t - the table
+ *		handle - the handle to release
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void v4TableFreeHandle(V4Table *t, u_int32_t handle)
+{
+	if( t->data->heads[handle] != V4_NONE )
+		log_err("v4TableFreeHandle: handle %u is still in use", handle);
+	t->data->values[handle] = NULL;
+	t->links[handle] = t->retiredHandle;
+	t->retiredHandle = handle;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Move all prefixes into new slot arrays and rebuild the handle lists
+ * Input: t - the table
+ *		size - the new number of slots
+ * Output:
+ * NOTE: readers that still use the old arrays see the table as it was before
+ * -------------------------------------------------------------------------------------*/
+static void resizeV4Table(V4Table *t, u_int32_t size)
+{
+	V4TableData	*d = t->data;
+	V4TableData	*nd = allocV4Data(size, d->handleSize);
+	u_int32_t	i, j;
+
+	memcpy(nd->values, d->values, t->handleCount * sizeof(void *));
+	memset(nd->heads, 0xFF, t->handleCount * sizeof(u_int32_t));
+	for( i = 0; i < d->size; i++ )
+	{
+		if( d->keys[i] == V4_KEY_EMPTY || d->keys[i] == V4_KEY_DELETED )
+			continue;
+		j = prefix_key_hash(&d->keys[i], 1, size);
+		while( nd->keys[j] != V4_KEY_EMPTY )
+			j = (j + 1 == size) ? 0 : j + 1;
+		nd->keys[j] = d->keys[i];
+		nd->gens[j] = d->gens[i];
+		nd->attrs[j] = d->attrs[i];
+		if( nd->attrs[j] != V4_NONE )
+		{
+			nd->next[j] = nd->heads[nd->attrs[j]];
+			nd->heads[nd->attrs[j]] = j;
+		}
+	}
+	t->used = t->count;
+	publishV4Data(t, nd);
+
+#ifdef DEBUG
+	debug(__FUNCTION__, "Resized IPv4 prefix table to %u slots for %u prefixes", size, t->count);
+#endif
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Look up a key
+ * Input: t - the table
+ *		key - the prefix key
+ * Output: the slot of the key or V4_NONE
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableFind(V4Table *t, u_int64_t key)
+{
+	V4TableData	*d = t->data;
+	u_int32_t	i = prefix_key_hash(&key, 1, d->size);
+
+	while( d->keys[i] != V4_KEY_EMPTY )
+	{
+		if( d->keys[i] == key )
+			return i;
+		i = (i + 1 == d->size) ? 0 : i + 1;
+	}
+	return V4_NONE;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add a key that is not in the table yet
+ * Input: t - the table
+ *		key - the prefix key
+ * Output: the slot of the key, not linked to any handle
+ * NOTE: may publish new arrays
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableAdd(V4Table *t, u_int64_t key)
+{
+	V4TableData	*d = t->data;
+	u_int32_t	i;
+
+	if( t->used + 1 > d->size * V4_TABLE_MAX_LOAD )
+	{
+		u_int32_t size = (t->count + 1) * 2;
+		resizeV4Table(t, size > V4_TABLE_INITIAL_SIZE ? size : V4_TABLE_INITIAL_SIZE);
+		d = t->data;
+	}
+
+	// deleted slots are skipped, a reader may still stand on them
+	i = prefix_key_hash(&key, 1, d->size);
+	while( d->keys[i] != V4_KEY_EMPTY )
+		i = (i + 1 == d->size) ? 0 : i + 1;
+
+	t->used++;
+	d->gens[i] = 0;
+	d->attrs[i] = V4_NONE;
+	d->next[i] = V4_NONE;
+	d->keys[i] = key;
+	t->count++;
+	return i;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Link a slot to an attribute handle
+ * Input: t - the table
+ *		slot - a slot that is not linked
+ *		handle - the attribute handle
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void v4TableLink(V4Table *t, u_int32_t slot, u_int32_t handle)
+{
+	V4TableData *d = t->data;
+
+	d->attrs[slot] = handle;
+	d->next[slot] = d->heads[handle];
+	__sync_synchronize();
+	d->heads[handle] = slot;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Unlink a slot from its attribute handle
+ * Input: t - the table
+ *		slot - a linked slot
+ * Output: 0 for success or -1 if the slot was not in the list of its handle
+ * NOTE: the slot keeps its next for readers that stand on it
+ * -------------------------------------------------------------------------------------*/
+int v4TableUnlink(V4Table *t, u_int32_t slot)
+{
+	V4TableData	*d = t->data;
+	u_int32_t	handle = d->attrs[slot];
+	u_int32_t	i, prev = V4_NONE;
+
+	if( handle == V4_NONE )
+		return -1;
+
+	for( i = d->heads[handle]; i != V4_NONE && i != slot; i = d->next[i] )
+		prev = i;
+	if( i == V4_NONE )
+		return -1;
+
+	if( prev == V4_NONE )
+		d->heads[handle] = d->next[slot];
+	else
+		d->next[prev] = d->next[slot];
+	d->attrs[slot] = V4_NONE;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove an unlinked slot from the table
+ * Input: t - the table
+ *		slot - the slot
+ * Output:
+ * NOTE: The slot stays deleted until the next resize, so a reader never finds
+ *       another prefix in a slot it has reached.
+ * -------------------------------------------------------------------------------------*/
+void v4TableRemove(V4Table *t, u_int32_t slot)
+{
+	t->count--;
+	t->data->keys[slot] = V4_KEY_DELETED;
+}
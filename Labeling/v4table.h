@@ -0,0 +1,172 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: v4table.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef V4TABLE_H_
+#define V4TABLE_H_
+
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------------------
+ * Compact IPv4 unicast prefix table.
+ * An open addressing (linear probing) hash table whose slots are kept in parallel
+ * arrays. A key is the 8 byte PrefixKey word of an IPv4 unicast prefix (afi, safi,
+ * length and address). A slot holds a 32 bit attribute handle in place of an
+ * AttrNode pointer. The table also keeps a list of slots for every handle, which
+ * is what the table transfer walks.
+ * A slot takes 24 bytes (key, generation, handle and next). The slots double
+ * when they are 80% full, so a prefix costs between 30 and 60 bytes, plus 16
+ * bytes (value, head and link) per attribute handle.
+ * Slots are changed only by the labeling thread. Other threads read the arrays
+ * inside an epoch section (see epoch.h) without locking:
+ *  - the arrays are never reallocated in place, a bigger copy is published in
+ *    data and the old one is retired,
+ *  - a removed slot is not used again until the next resize, and it keeps its
+ *    next so a reader standing on it can go on, 
+ *  - a released handle is not given out again until the readers that could
+ *    have seen it have left.
+ * A reader walking the list of a handle must skip slots whose attrs is no 
+ * longer that handle.
+ * -------------------------------------------------------------------------------------*/
+#define V4_NONE			0xFFFFFFFF
+#define V4_KEY_EMPTY		0ULL
+#define V4_KEY_DELETED		0xFFFFFFFFFFFFFFFFULL
+#define V4_TABLE_INITIAL_SIZE	4096
+#define V4_TABLE_MAX_LOAD	0.8
+
+typedef struct V4TableDataStruct {
+   u_int32_t		size;		/* number of slots */
+   u_int32_t		handleSize;	/* number of allocated handles */
+   u_int64_t		*keys;
+   u_int64_t		*gens;		/* rib generation in which each slot was added */
+   void			**values;	/* value of each handle, NULL if free */
+   u_int32_t		*attrs;		/* attribute handle of each slot */
+   u_int32_t		*next;		/* next slot with the same attribute handle */
+   u_int32_t		*heads;		/* first slot of each handle */
+} V4TableData;
+
+typedef struct V4TableStruct {
+   u_int32_t		count;		/* number of prefixes */
+   u_int32_t		used;		/* prefixes plus deleted slots */
+   u_int32_t		handleCount;	/* number of handles ever used */
+   u_int32_t		*links;		/* links of the handle lists below */
+   u_int32_t		freeHandle;	/* handles that can be given out */
+   u_int32_t		retiringHandle;	/* handles released before retiringEpoch */
+   u_int32_t		retiredHandle;	/* handles released after retiringEpoch */
+   u_int64_t		retiringEpoch;
+   V4TableData		*data;
+} V4Table;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Create a compact IPv4 prefix table
+ * Input: size - the initial number of slots
+ * Output: the new table, exits on fatal error if out of memory
+ * -------------------------------------------------------------------------------------*/
+V4Table *createV4Table(u_int32_t size);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove all prefixes and handles from a table, keeps the arrays
+ * Input: t - the table
+ * Output:
+ * NOTE: the table must not be reachable by readers anymore
+ * -------------------------------------------------------------------------------------*/
+void clearV4Table(V4Table *t);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Free a table and its arrays
+ * Input: t - the table
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void destroyV4Table(V4Table *t);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the number of bytes used by a table
+ * Input: t - the table
+ * Output: the size in bytes
+ * -------------------------------------------------------------------------------------*/
+size_t v4TableMemory(V4Table *t);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Allocate an attribute handle
+ * Input: t - the table
+ *		value - the value the handle refers to
+ * Output: the new handle
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableNewHandle(V4Table *t, void *value);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Release an attribute handle, no slot may be linked to it
+ * Input: t - the table
+ *		handle - the handle to release
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void v4TableFreeHandle(V4Table *t, u_int32_t handle);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Look up a key
+ * Input: t - the table
+ *		key - the prefix key
+ * Output: the slot of the key or V4_NONE
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableFind(V4Table *t, u_int64_t key);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add a key that is not in the table yet
+ * Input: t - the table
+ *		key - the prefix key
+ * Output: the slot of the key, not linked to any handle
+ * NOTE: may publish new arrays
+ * -------------------------------------------------------------------------------------*/
+u_int32_t v4TableAdd(V4Table *t, u_int64_t key);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Link a slot to an attribute handle
+ * Input: t - the table
+ *		slot - a slot that is not linked
+ *		handle - the attribute handle
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void v4TableLink(V4Table *t, u_int32_t slot, u_int32_t handle);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Unlink a slot from its attribute handle
+ * Input: t - the table
+ *		slot - a linked slot
+ * Output: 0 for success or -1 if the slot was not in the list of its handle
+ * -------------------------------------------------------------------------------------*/
+int v4TableUnlink(V4Table *t, u_int32_t slot);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Remove an unlinked slot from the table
+ * Input: t - the table
+ *		slot - the slot
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void v4TableRemove(V4Table *t, u_int32_t slot);
+
+#endif /*V4TABLE_H_*/
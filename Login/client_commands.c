@@ -74,6 +74,8 @@ int cmdClientListenerPort(commandArgument * ca, clientThreadArguments * client,
 		type = CLIENT_LISTENER_UPDATA;
 	} else if(listContainsCommand(cn, "rib")) {
 		type = CLIENT_LISTENER_RIB;
+	} else if(listContainsCommand(cn, "binary")) {
+		type = CLIENT_LISTENER_BINARY;
 	}
 
 	if(type!=-1)
@@ -133,6 +135,8 @@ int cmdShowClientListenerPort(commandArgument * ca, clientThreadArguments * clie
 		type = CLIENT_LISTENER_UPDATA;
 	} else if(listContainsCommand(cn, "rib")) {
 		type = CLIENT_LISTENER_RIB;
+	} else if(listContainsCommand(cn, "binary")) {
+		type = CLIENT_LISTENER_BINARY;
 	}
 
 	if(type!=-1) {
@@ -186,6 +190,8 @@ int cmdClientListenerAddress(commandArgument * ca, clientThreadArguments * clien
 		type = CLIENT_LISTENER_UPDATA;
 	} else if(listContainsCommand(cn, "rib")) {
 		type = CLIENT_LISTENER_RIB;
+	} else if(listContainsCommand(cn, "binary")) {
+		type = CLIENT_LISTENER_BINARY;
 	}
 
 	// get the address
@@ -220,6 +226,8 @@ int cmdShowClientListenerAddress(commandArgument * ca, clientThreadArguments * c
 		type = CLIENT_LISTENER_UPDATA;
 	} else if(listContainsCommand(cn, "rib")) {
 		type = CLIENT_LISTENER_RIB;
+	} else if(listContainsCommand(cn, "binary")) {
+		type = CLIENT_LISTENER_BINARY;
 	}
 
 	if(type!=-1) {
@@ -257,6 +265,11 @@ int cmdClientListenerMaxConnections(commandArgument * ca, clientThreadArguments
       sendMessage(client->socket, "Update of max connections failed");
       return 1;
     }
+  }else if(listContainsCommand(root, "binary")) {
+    if(setClientsControlMaxConnections(newMax,CLIENT_LISTENER_BINARY)){
+      sendMessage(client->socket, "Update of max connections failed");
+      return 1;
+    }
   }else{
     return 1;
   }
@@ -282,6 +295,8 @@ cmdShowClientListenerMaxConnections(commandArgument * ca, clientThreadArguments
     type = CLIENT_LISTENER_UPDATA;
   } else if(listContainsCommand(cn, "rib")) {
     type = CLIENT_LISTENER_RIB;
+  } else if(listContainsCommand(cn, "binary")) {
+    type = CLIENT_LISTENER_BINARY;
   }
 
   if(type!=-1) {
@@ -295,7 +310,7 @@ cmdShowClientListenerMaxConnections(commandArgument * ca, clientThreadArguments
 }
 
 /*----------------------------------------------------------------------------------------
- * Purpose: Display summary info for UPDATE and RIB client listener 
+ * Purpose: Display summary info for UPDATE, RIB and BINARY client listener 
  * Input: commandArgument - A linked list that provides all the parameters the users typed 
  * 		in. This list is in the same order as they were typed.
  * 	clientThreadArguments - A struct providing the basic address information for the 
@@ -352,6 +367,16 @@ int cmdShowClientListenerSummary(commandArgument * ca, clientThreadArguments * c
 		sendMessage(client->socket, "RIB port is %d\n", port);
                 maxClients = getClientsControlMaxConnections(CLIENT_LISTENER_RIB);
 		sendMessage(client->socket, "RIB max clients is %d\n", maxClients);
+		free(address);
+
+		sendMessage(client->socket, "\n");
+		sendMessage(client->socket, "BINARY clients use the UPDATE ACL\n");
+		address = getClientsControlListenAddr(CLIENT_LISTENER_BINARY);
+		sendMessage(client->socket, "BINARY address is %s\n", address);
+		port = getClientsControlListenPort(CLIENT_LISTENER_BINARY);
+		sendMessage(client->socket, "BINARY port is %d\n", port);
+                maxClients = getClientsControlMaxConnections(CLIENT_LISTENER_BINARY);
+		sendMessage(client->socket, "BINARY max clients is %d\n", maxClients);
 
 		free(address);
 	}
@@ -469,10 +494,13 @@ int cmdShowClientListenerAcl(commandArgument * ca, clientThreadArguments * clien
 		type = CLIENT_LISTENER_UPDATA;
 	} else if(listContainsCommand(cn, "rib")) {
 		type = CLIENT_LISTENER_RIB;
+	} else if(listContainsCommand(cn, "binary")) {
+		type = CLIENT_LISTENER_BINARY;
 	}
 
 	if(type!=-1) {
-		if(type==CLIENT_LISTENER_UPDATA) {
+		// the binary clients are checked against the update acl
+		if(type==CLIENT_LISTENER_UPDATA || type==CLIENT_LISTENER_BINARY) {
 			acl = LoginSettings.clientUpdateAcl;
 		} else if(type==CLIENT_LISTENER_RIB) {
 			acl = LoginSettings.clientRIBAcl;
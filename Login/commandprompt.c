@@ -393,10 +393,11 @@ int initClientCommands(commandNode * root) {
 		temp = buildCommandTree(root, "client-listener", 1,
 				buildCommand("disable", "disable", CONFIGURE, &cmdClientListenerDisable));
 
-		//[client-listener rib], and [client-listener update]
-		temp = buildCommandTree(root, "client-listener", 2,
+		//[client-listener rib], [client-listener update] and [client-listener binary]
+		temp = buildCommandTree(root, "client-listener", 3,
 				buildCommand("rib", "rib", CONFIGURE, NULL),
-				buildCommand("update", "update", CONFIGURE, NULL));
+				buildCommand("update", "update", CONFIGURE, NULL),
+				buildCommand("binary", "binary", CONFIGURE, NULL));
 
 		// CLIENT-LISTENER UPDATE commands
 			// [client-listener update acl *] command
@@ -448,6 +449,25 @@ int initClientCommands(commandNode * root) {
 			temp = buildCommandTree(temp, "limit", 1,
 					buildCommand("*", "[max connections]", CONFIGURE, &cmdClientListenerMaxConnections));
 
+		// CLIENT-LISTENER BINARY commands, the binary clients use the update acl
+			// [client-listener binary port *]
+			temp = buildCommandTree(root, "client-listener binary", 1,
+					buildCommand("port", "port", CONFIGURE, NULL));
+			temp = buildCommandTree(temp, "port", 1,
+					buildCommand("*", "[port number]", CONFIGURE, &cmdClientListenerPort));
+
+			// [client-listener binary address *]
+			temp = buildCommandTree(root, "client-listener binary", 1,
+					buildCommand("address", "address", CONFIGURE, NULL));
+			temp = buildCommandTree(temp, "address", 1,
+					buildCommand("*", "[address]", CONFIGURE, &cmdClientListenerAddress));
+
+			// [client-listener binary limit *]
+			temp = buildCommandTree(root, "client-listener binary", 1,
+					buildCommand("limit", "limit", CONFIGURE, NULL));
+			temp = buildCommandTree(temp, "limit", 1,
+					buildCommand("*", "[max connections]", CONFIGURE, &cmdClientListenerMaxConnections));
+
 
 		// [show client-listener]
 		temp = buildCommandTree(root, "show", 1,
@@ -457,10 +477,11 @@ int initClientCommands(commandNode * root) {
 		temp = buildCommandTree(root, "show client-listener", 1,
 				buildCommand("status", "status", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerStatus));
 
-		// [show client-listener update] and [show client-listener rib] commands
-		temp = buildCommandTree(root, "show client-listener", 2,
+		// [show client-listener update], [show client-listener rib] and [show client-listener binary] commands
+		temp = buildCommandTree(root, "show client-listener", 3,
 				buildCommand("update", "update", ACCESS | ENABLE | CONFIGURE, NULL),
-				buildCommand("rib", "rib", ACCESS | ENABLE | CONFIGURE, NULL));
+				buildCommand("rib", "rib", ACCESS | ENABLE | CONFIGURE, NULL),
+				buildCommand("binary", "binary", ACCESS | ENABLE | CONFIGURE, NULL));
 
 		// [show client-listener summary]
 		temp = buildCommandTree(root, "show client-listener", 1,
@@ -500,6 +521,23 @@ int initClientCommands(commandNode * root) {
 			temp = buildCommandTree(root, "show client-listener rib", 1,
 					buildCommand("limit", "limit", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerMaxConnections));
 
+		// SHOW CLIENT-LISTENER BINARY commands
+			// [show client-listener binary acl] command, the update acl
+			temp = buildCommandTree(root, "show client-listener binary", 1,
+					buildCommand("acl", "acl", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerAcl));
+
+			// [show client-listener binary port]
+			temp = buildCommandTree(root, "show client-listener binary", 1,
+					buildCommand("port", "port", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerPort));
+
+			// [show client-listener binary address]
+			temp = buildCommandTree(root, "show client-listener binary", 1,
+					buildCommand("address", "address", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerAddress));
+
+			// [show client-listener binary limit]
+			temp = buildCommandTree(root, "show client-listener binary", 1,
+					buildCommand("limit", "limit", ACCESS | ENABLE | CONFIGURE, &cmdShowClientListenerMaxConnections));
+
 
 	return 0;
 }
@@ -553,11 +591,13 @@ int initQueueCommands(commandNode * root) {
 	// [show queue peer], [show queue ribonly], and [show queue xml] commands
 	temp = buildCommandTree(root, "show", 1,
 			buildCommand("queue", "queue", ACCESS | ENABLE | CONFIGURE, &showQueue));
-	temp = buildCommandTree(root, "show queue", 4,
+	temp = buildCommandTree(root, "show queue", 6,
 			buildCommand(PEER_QUEUE_NAME, PEER_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue),
 			buildCommand(LABEL_QUEUE_NAME, LABEL_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue),
+			buildCommand(LABEL_RIB_QUEUE_NAME, LABEL_RIB_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue),
 			buildCommand(XML_U_QUEUE_NAME, XML_U_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue),
-			buildCommand(XML_R_QUEUE_NAME, XML_R_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue));
+			buildCommand(XML_R_QUEUE_NAME, XML_R_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue),
+			buildCommand(BMF_STREAM_QUEUE_NAME, BMF_STREAM_QUEUE_NAME, ACCESS | ENABLE | CONFIGURE, &showQueue));
 
 	return 0;
 }
@@ -832,21 +872,25 @@ int initPeerCommands(commandNode * root) {
 	temp = buildCommandTree(root, "neighbor * port * local hold-time", 1,
 			buildCommand("*", "[hold time]", ROUTER_BGP, &cmdNeighborLocalHoldTime));
 
-	// [neighbor * label-action NoAction], [neighbor * label-action Label], [neighbor * label-action StoreRibOnly] commands
+	// [neighbor * label-action NoAction], [neighbor * label-action Label], [neighbor * label-action StoreRibOnly], 
+	// [neighbor * label-action LabelNoDuplicates] commands
 	temp = buildCommandTree(root, "neighbor *", 1,
 			buildCommand("label-action", "label-action", ROUTER_BGP, NULL));
-	temp = buildCommandTree(root, "neighbor * label-action", 3,
+	temp = buildCommandTree(root, "neighbor * label-action", 4,
 			buildCommand("NoAction", "NoAction", ROUTER_BGP, &cmdNeighborLabelAction),
 			buildCommand("Label", "Label", ROUTER_BGP, &cmdNeighborLabelAction),
-			buildCommand("StoreRibOnly", "StoreRibOnly", ROUTER_BGP, &cmdNeighborLabelAction));
+			buildCommand("StoreRibOnly", "StoreRibOnly", ROUTER_BGP, &cmdNeighborLabelAction),
+			buildCommand("LabelNoDuplicates", "LabelNoDuplicates", ROUTER_BGP, &cmdNeighborLabelAction));
 	
-	// [neighbor * port * label-action NoAction], [neighbor * port * label-action Label], [neighbor * port * label-action StoreRibOnly] commands
+	// [neighbor * port * label-action NoAction], [neighbor * port * label-action Label], [neighbor * port * label-action StoreRibOnly], 
+	// [neighbor * port * label-action LabelNoDuplicates] commands
 	temp = buildCommandTree(root, "neighbor * port *", 1,
 			buildCommand("label-action", "label-action", ROUTER_BGP, NULL));
-	temp = buildCommandTree(root, "neighbor * port * label-action", 3,
+	temp = buildCommandTree(root, "neighbor * port * label-action", 4,
 			buildCommand("NoAction", "NoAction", ROUTER_BGP, &cmdNeighborLabelAction),
 			buildCommand("Label", "Label", ROUTER_BGP, &cmdNeighborLabelAction),
-			buildCommand("StoreRibOnly", "StoreRibOnly", ROUTER_BGP, &cmdNeighborLabelAction));
+			buildCommand("StoreRibOnly", "StoreRibOnly", ROUTER_BGP, &cmdNeighborLabelAction),
+			buildCommand("LabelNoDuplicates", "LabelNoDuplicates", ROUTER_BGP, &cmdNeighborLabelAction));
 
 	// [neighbor * route-refresh] command
 	temp = buildCommandTree(root, "neighbor *", 1,
@@ -938,6 +982,16 @@ int initPeerCommands(commandNode * root) {
 				buildCommand("prefix", "prefix", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, NULL));
 		temp = buildCommandTree(root, "show bgp prefix", 1,
 				buildCommand("*", "[prefix]", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, &cmdShowBGPprefix));
+
+		// show the prefixes an AS originates and the AS paths through an AS
+		temp = buildCommandTree(root, "show bgp", 1,
+				buildCommand("origin-as", "origin-as", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, NULL));
+		temp = buildCommandTree(root, "show bgp origin-as", 1,
+				buildCommand("*", "[AS number]", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, &cmdShowBGPOriginAS));
+		temp = buildCommandTree(root, "show bgp", 1,
+				buildCommand("transit-as", "transit-as", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, NULL));
+		temp = buildCommandTree(root, "show bgp transit-as", 1,
+				buildCommand("*", "[AS number]", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, &cmdShowBGPTransitAS));
 	// setup [SHOW RUNNING] command
 	temp = buildCommandTree(root, "show", 1,
 			buildCommand("running", "running", ACCESS | ENABLE | CONFIGURE | ROUTER_BGP, &cmdShowRunning));
@@ -329,6 +329,9 @@ int cmdShowMrtClient(commandArgument * ca, clientThreadArguments * client, comma
 					case StoreRibOnly:
 						sendMessage(client->socket, "StoreRibOnly\n");
 						break;
+					case LabelNoDuplicates:
+						sendMessage(client->socket, "LabelNoDuplicates\n");
+						break;
 				}
 
 				struct tm * timeinfo;
@@ -37,6 +37,8 @@
 #include <errno.h>
 // needed for time_t functions
 #include <time.h>
+// needed for va_list
+#include <stdarg.h>
 
 // Needed for the function definitions
 #include "commands.h"
@@ -520,6 +522,9 @@ int cmdNeighborLabelAction(commandArgument * ca, clientThreadArguments * client,
 	if(listContainsCommand(root, "NoAction")) {
 		action = NoAction;
 	} else
+	if(listContainsCommand(root, "LabelNoDuplicates")) {
+		action = LabelNoDuplicates;
+	} else
 	if(listContainsCommand(root, "StoreRibOnly")) {
 		action = StoreRibOnly;
 	} else
@@ -691,6 +696,9 @@ int cmdShowRunningPeerGroup(commandArgument * ca, clientThreadArguments * client
 				case StoreRibOnly:
 					sendMessage(client->socket, "StoreRibOnly\n");
 					break;
+				case LabelNoDuplicates:
+					sendMessage(client->socket, "LabelNoDuplicates\n");
+					break;
 			}
 			sendMessage(client->socket, "\troute refresh action: %d\n", peerRouteRefreshAction);
 
@@ -851,6 +859,9 @@ int cmdShowRunningNeighbor(commandArgument * ca, clientThreadArguments * client,
 				case StoreRibOnly:
 					sendMessage(client->socket, "StoreRibOnly\n");
 					break;
+				case LabelNoDuplicates:
+					sendMessage(client->socket, "LabelNoDuplicates\n");
+					break;
 			}
 			sendMessage(client->socket, "\troute refresh action: %d\n", peerRouteRefreshAction);
 
@@ -1024,6 +1035,9 @@ int cmdShowBGPNeighbor(commandArgument * ca, clientThreadArguments * client, com
 						case StoreRibOnly:
 							sendMessage(client->socket, "StoreRibOnly\n");
 							break;
+						case LabelNoDuplicates:
+							sendMessage(client->socket, "LabelNoDuplicates\n");
+							break;
 					}
 					sendMessage(client->socket, "\troute refresh action: %d\n", peerRouteRefreshAction);
 
@@ -1432,6 +1446,117 @@ int cmdClearNeighbor(commandArgument * ca, clientThreadArguments * client, comma
 	return 0;
 }
 
+/* the number of routes shown before the user is asked to go on */
+#define SHOW_PAGE_ROWS 30
+
+/* state shared by the show bgp commands and their rib walk callbacks */
+typedef struct ShowRoutesArgStruct {
+  clientThreadArguments *client;
+  int sessionID;
+  int ASLen;
+  int found;
+  char *prefixaddr;
+  PAddress *prefix;
+  char *rows[SHOW_PAGE_ROWS];	/* the page filled by a rib walk */
+  int rowCount;
+} ShowRoutesArg;
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: get the printable AS path of an attribute node
+ * Input: attrNode - the attribute node
+ *	ASLen - 2 or 4 bytes AS
+ * Output: the AS path string, the caller must free it
+ * -------------------------------------------------------------------------------------*/
+static char *
+showASPath(AttrNode *attrNode, int ASLen) {
+  // check if we have 2 byte lenght of as path
+  if (attrNode->asPath->asPathData.data[0] & 0x10 ){
+    return printASPath(attrNode->asPath->asPathData.data+4, ASLen);
+  }
+  return printASPath(attrNode->asPath->asPathData.data+3, ASLen);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: add a line to the page of a show command
+ * Input: sa - the ShowRoutesArg of the command
+ *	format - the line, just like printf
+ * Output: 1 if the page is full or the line could not be added, 0 otherwise
+ * NOTE: Called by the rib walk callbacks, which must not block.
+ * -------------------------------------------------------------------------------------*/
+static int
+showAddRow(ShowRoutesArg *sa, const char *format, ...) {
+  va_list args;
+  char *row;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (len < 0 || (row = malloc(len + 1)) == NULL) {
+    return 1;
+  }
+  va_start(args, format);
+  vsnprintf(row, len + 1, format, args);
+  va_end(args);
+
+  sa->rows[sa->rowCount++] = row;
+  return sa->rowCount == SHOW_PAGE_ROWS;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: send the page of a show command and ask the user to go on if it is full
+ * Input: sa - the ShowRoutesArg of the command
+ *	more - 1 if the walk stopped with more lines to come
+ * Output: 1 if the user asked to stop, 0 otherwise
+ * NOTE: Called outside of the rib walk, so it may wait for the user.
+ * -------------------------------------------------------------------------------------*/
+static int
+showPage(ShowRoutesArg *sa, int more) {
+  char msg[8];
+  int i;
+
+  for (i = 0; i < sa->rowCount; i++) {
+    sendMessage(sa->client->socket, "%s", sa->rows[i]);
+    free(sa->rows[i]);
+  }
+  sa->rowCount = 0;
+
+  if (more) {
+    sendMessage(sa->client->socket,
+                "\n\nPress ENTER to see more or Q to leave: ");
+    memset(msg, 0, sizeof(msg));
+    getMessage(sa->client->socket, msg, 5);
+    if (strcmp(msg,"q")==0 || strcmp(msg,"Q")==0){
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: rib walk callback of cmdShowBGPRoutes and cmdShowBGPOriginAS, adds one
+ *	route to the page
+ * Input: prefix - the prefix
+ *	attrNode - the attribute node of the prefix
+ *	arg - the ShowRoutesArg of the command
+ * Output: 1 if the page is full, 0 otherwise
+ * -------------------------------------------------------------------------------------*/
+static int
+showRouteCallback(const Prefix *prefix, AttrNode *attrNode, void *arg) {
+  ShowRoutesArg *sa = arg;
+  char * aspath;
+  char * prefixaddr;
+  int full;
+
+  prefixaddr = printPrefix((Prefix *)prefix);
+  aspath = showASPath(attrNode, sa->ASLen);
+  full = showAddRow(sa, "%-44s%-44s%-6d%s\n", prefixaddr, 
+                    getSessionRemoteAddr(sa->sessionID), sa->ASLen, aspath);
+  free(prefixaddr);
+  free(aspath);
+  return full;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: show bgp routes which stored in rtable.c
  * Input: commandArgument - A linked list that provides all the parameters the users typed 
@@ -1447,23 +1572,20 @@ int
 cmdShowBGPRoutes(commandArgument * ca, clientThreadArguments * client, 
                  commandNode * root) {
 
-  int i = 0, showcount = 0;
-  u_int32_t j = 0;
+  int i = 0;
   int establishedSessions[MAX_SESSION_IDS];
   int establishedSessionCount;
-  PrefixNode    *prefixNode;
-  PrefixNode    *nextPrefixNode;
+  ShowRoutesArg sa;
+  RibWalkCursor cursor;
+  int more;
 
   establishedSessionCount = 0;
   memset(establishedSessions, 0, sizeof(int)*MAX_SESSION_IDS);
+  memset(&sa, 0, sizeof(sa));
+  sa.client = client;
 	
-  char * msg;
-  char * aspath;
-  char * prefixaddr;
   char * peerAddress = NULL;
 
-  int ASLen=0;
-
   if(ca!=NULL) {
     peerAddress = ca->commandArgument;
   }
@@ -1486,59 +1608,60 @@ cmdShowBGPRoutes(commandArgument * ca, clientThreadArguments * client,
         //sendMessage(client->socket, "Session is %d\n", establishedSessions[i]);
 			
         // 2 or 4 bytes AS 
-        ASLen = session->fsm.ASNumlen;
+        sa.ASLen = session->fsm.ASNumlen;
+        sa.sessionID = establishedSessions[i];
 
         sendMessage(client->socket, "%-44s%-44s%-6s%s","Network","Next Hop",
                                     "ASLen","AS Path\n");
-        for( j=0; j < session->prefixTable->tableSize; j++ ){
-          if (session->prefixTable->prefixEntries[j].node != NULL){
-            prefixNode = session->prefixTable->prefixEntries[j].node;
-            while (prefixNode != NULL){
-						
-              prefixaddr = printPrefix(&(prefixNode->keyPrefix));
-              sendMessage(client->socket, "%-44s", prefixaddr);
-              free(prefixaddr);
-			
-              sendMessage(client->socket, "%-44s",
-                          getSessionRemoteAddr(establishedSessions[i]));
-              sendMessage(client->socket, "%-6d", ASLen);
-					
-              // check if we have 2 byte lenght of as path
-              if (prefixNode->dataAttr->asPath->asPathData.data[0] & 0x10 ){
-                aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+4,
-                                     ASLen);
-              } else {
-                aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+3,
-                                      ASLen);
-              }
-              sendMessage(client->socket, "%s\n", aspath);
-              free(aspath);
-
-              nextPrefixNode = prefixNode->next;
-              prefixNode = nextPrefixNode;
-              showcount++;
-              if (showcount > 30) {
-                sendMessage(client->socket,
-                            "\n\nPress ENTER to see more or Q to leave: ");
-                msg = (char *)malloc(sizeof(char));
-                getMessage(client->socket, msg, 5);
-                if (strcmp(msg,"q")==0 || strcmp(msg,"Q")==0){
-                  free(msg);
-                  return 0;
-                } else {
-                  showcount = 0;
-                }
-                free(msg);
-              }
-            }
+        // the page is sent after the walk returns, so no epoch section waits for the user
+        memset(&cursor, 0, sizeof(cursor));
+        do {
+          more = walkRibTablePage(establishedSessions[i], &cursor, showRouteCallback, &sa);
+          if (showPage(&sa, more)) {
+            return 0;
           }
-        }
+        } while (more);
       }
     }// session end
   }
 return 0;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: rib walk callback of cmdShowBGProutesASpath, prints the route of the
+ *	prefix given by the user
+ * Input: prefix - the prefix
+ *	attrNode - the attribute node of the prefix
+ *	arg - the ShowRoutesArg of the command
+ * Output: 0 to continue the walk
+ * -------------------------------------------------------------------------------------*/
+static int
+showRouteASpathCallback(const Prefix *prefix, AttrNode *attrNode, void *arg)
+{
+	ShowRoutesArg *sa = arg;
+	char * aspath;
+	char * tempprefixaddr;
+
+	// get prefix name
+	tempprefixaddr = printPrefix((Prefix *)prefix);
+
+	if( (strcmp(tempprefixaddr,sa->prefixaddr)==0))
+	{
+		sendMessage(sa->client->socket, "Network\t\tNext Hop\tASLen\tAS Path\n");
+		sendMessage(sa->client->socket, "%s\t", tempprefixaddr);
+	
+		sendMessage(sa->client->socket, "%s\t", getSessionRemoteAddr(sa->sessionID));
+		sendMessage(sa->client->socket, "%d\t", sa->ASLen);
+
+		aspath = showASPath(attrNode, sa->ASLen);
+		sendMessage(sa->client->socket, "%s\n", aspath);
+		free(aspath);
+	}
+	// free prefix memory
+	free(tempprefixaddr);
+	return 0;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: show AS path for entered prefix
  * Input: commandArgument - A linked list that provides all the parameters the users typed 
@@ -1553,22 +1676,17 @@ return 0;
 int cmdShowBGProutesASpath(commandArgument * ca, clientThreadArguments * client, commandNode * root) {
 
 	int i = 0;
-	u_int32_t j = 0;
 	int establishedSessions[MAX_SESSION_IDS];
 	int establishedSessionCount;
-        PrefixNode    *prefixNode;
-        PrefixNode    *nextPrefixNode;
+	ShowRoutesArg sa;
 
 	establishedSessionCount = 0;
 	memset(establishedSessions, 0, sizeof(int)*MAX_SESSION_IDS);
+	memset(&sa, 0, sizeof(sa));
+	sa.client = client;
 	
-	char * aspath;
-	char * prefixaddr = NULL;
-	char * tempprefixaddr = NULL;
 	char * peerAddress = NULL;
 
-	int ASLen=0;
-
 	// look for arguments, there should be two args
 	if (ca==NULL)
 	{
@@ -1588,7 +1706,7 @@ int cmdShowBGProutesASpath(commandArgument * ca, clientThreadArguments * client,
 	}
 	else
 	{
-		prefixaddr = ca->commandArgument;
+		sa.prefixaddr = ca->commandArgument;
 	}
 
 
@@ -1616,46 +1734,10 @@ int cmdShowBGProutesASpath(commandArgument * ca, clientThreadArguments * client,
 			//sendMessage(client->socket, "Session is %d\n", establishedSessions[i]);
 			
 			// 2 or 4 bytes AS 
-			ASLen = session->fsm.ASNumlen;
+			sa.ASLen = session->fsm.ASNumlen;
+			sa.sessionID = establishedSessions[i];
 
-			for( j=0; j < session->prefixTable->tableSize; j++ ) 
-			{
-				if (session->prefixTable->prefixEntries[j].node != NULL) 
-				{
-					prefixNode = session->prefixTable->prefixEntries[j].node;
-					while (prefixNode != NULL) 
-					{
-						// get prefix name
-						tempprefixaddr = printPrefix(&(prefixNode->keyPrefix));
-
-						if( (strcmp(tempprefixaddr,prefixaddr)==0))
-						{
-							sendMessage(client->socket, "Network\t\tNext Hop\tASLen\tAS Path\n");
-							sendMessage(client->socket, "%s\t", tempprefixaddr);
-						
-							sendMessage(client->socket, "%s\t", getSessionRemoteAddr(establishedSessions[i]));
-							sendMessage(client->socket, "%d\t", ASLen);
-					
-							// check if we have 2 byte lenght of as path
-							if (prefixNode->dataAttr->asPath->asPathData.data[0] & 0x10 )
-							{
-								aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+4, ASLen);
-							}
-							else
-							{
-								aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+3, ASLen);
-							}
-							sendMessage(client->socket, "%s\n", aspath);
-							free(aspath);
-						}
-						// free prefix memory
-						free(tempprefixaddr);
-
-						nextPrefixNode = prefixNode->next;
-						prefixNode = nextPrefixNode;
-					}
-				}
-			}
+			walkRibTable(establishedSessions[i], showRouteASpathCallback, &sa);
 			}
 		}// session end
 		
@@ -1664,6 +1746,35 @@ int cmdShowBGProutesASpath(commandArgument * ca, clientThreadArguments * client,
 	return 0;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: rib walk callback of cmdShowBGPprefix, prints the route of the
+ *	prefix given by the user
+ * Input: prefix - the prefix
+ *	attrNode - the attribute node of the prefix
+ *	arg - the ShowRoutesArg of the command
+ * Output: 0 to continue the walk
+ * -------------------------------------------------------------------------------------*/
+static int
+showPrefixCallback(const Prefix *prefix, AttrNode *attrNode, void *arg) {
+  ShowRoutesArg *sa = arg;
+  char * aspath;
+  PAddress * tempprefixaddr = (PAddress *)&(prefix->addr);
+
+  if(prefixesEqual(tempprefixaddr,sa->prefix)){
+    sa->found = 1;
+    sendMessage(sa->client->socket, "%s\t", tempprefixaddr);
+
+    sendMessage(sa->client->socket, "%s\t", 
+                getSessionRemoteAddr(sa->sessionID));
+    sendMessage(sa->client->socket, "%d\t", sa->ASLen);
+		
+    aspath = showASPath(attrNode, sa->ASLen);
+    sendMessage(sa->client->socket, "%s\n", aspath);
+    free(aspath);
+  }
+  return 0;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: show all AS paths for prefix
  * Input: commandArgument - A linked list that provides all the parameters the users typed 
@@ -1679,21 +1790,16 @@ int
 cmdShowBGPprefix(commandArgument * ca, clientThreadArguments * client, 
                  commandNode * root) {
   int i = 0;
-  u_int32_t j = 0;
   int establishedSessions[MAX_SESSION_IDS];
   int establishedSessionCount;
-  PrefixNode    *prefixNode;
-  PrefixNode    *nextPrefixNode;
+  ShowRoutesArg sa;
 
   establishedSessionCount = 0;
   memset(establishedSessions, 0, sizeof(int)*MAX_SESSION_IDS);
+  memset(&sa, 0, sizeof(sa));
+  sa.client = client;
 	
-  char * aspath;
   char * prefixaddr = NULL;
-  PAddress * tempprefixaddr = NULL;
-
-  int ASLen=0;
-  int found = 0;
 
   // look for arguments, there should be two args
   if (ca==NULL) {
@@ -1704,7 +1810,7 @@ cmdShowBGPprefix(commandArgument * ca, clientThreadArguments * client,
   }
 
   // create an address object for the prefix
-  PAddress *prefix = stringToPrefix(prefixaddr);
+  sa.prefix = stringToPrefix(prefixaddr);
 
   // get the established session count and list
   for(i=0; i<MAX_SESSION_IDS; i++ ) {
@@ -1719,44 +1825,18 @@ cmdShowBGPprefix(commandArgument * ca, clientThreadArguments * client,
   for (i=0; i<establishedSessionCount; i++) {
     Session_structp session = getSessionByID(establishedSessions[i]);
     if (session) {
-      found = 0;
+      sa.found = 0;
       // 2 or 4 bytes AS 
-      ASLen = session->fsm.ASNumlen;
-
-      for( j=0; j < session->prefixTable->tableSize; j++ ){
-        if (session->prefixTable->prefixEntries[j].node != NULL){
-          prefixNode = session->prefixTable->prefixEntries[j].node;
-          while (prefixNode != NULL){ 
-            tempprefixaddr = &(prefixNode->keyPrefix.addr);
-            if(prefixesEqual(tempprefixaddr,prefix)){
-              found = 1;
-              sendMessage(client->socket, "%s\t", tempprefixaddr);
-	
-              sendMessage(client->socket, "%s\t", 
-                          getSessionRemoteAddr(establishedSessions[i]));
-              sendMessage(client->socket, "%d\t", ASLen);
-				
-              // check if we have 2 byte lenght of as path
-              if (prefixNode->dataAttr->asPath->asPathData.data[0] & 0x10 ) {
-                aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+4, ASLen);
-              } else {
-                aspath = printASPath(prefixNode->dataAttr->asPath->asPathData.data+3, ASLen);
-              }
-              sendMessage(client->socket, "%s\n", aspath);
-              free(aspath);
-            }
-
-            nextPrefixNode = prefixNode->next;
-            prefixNode = nextPrefixNode;
-          }
-        }
-      } // table for loop
+      sa.ASLen = session->fsm.ASNumlen;
+      sa.sessionID = establishedSessions[i];
+
+      walkRibTable(establishedSessions[i], showPrefixCallback, &sa);
 	
-	if (found != 1)
+	if (sa.found != 1)
 		{
 			sendMessage(client->socket, "%s\t", prefixaddr);
 			sendMessage(client->socket, "%s\t", getSessionRemoteAddr(establishedSessions[i]));
-			sendMessage(client->socket, "%d\t", ASLen);
+			sendMessage(client->socket, "%d\t", sa.ASLen);
 			sendMessage(client->socket, "%s\n", "N/A");
 		}
 		
@@ -1767,4 +1847,131 @@ cmdShowBGPprefix(commandArgument * ca, clientThreadArguments * client,
 	return 0;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: read the AS number argument of a show bgp command
+ * Input: ca - the argument
+ *	as - set to the AS number
+ * Output: 0 for success or 1 if the argument is not an AS number
+ * -------------------------------------------------------------------------------------*/
+static int
+getASArgument(commandArgument * ca, u_int32_t *as) {
+  char *end;
+  unsigned long value;
+
+  if (ca == NULL || ca->commandArgument[0] == '\0') {
+    return 1;
+  }
+  errno = 0;
+  value = strtoul(ca->commandArgument, &end, 10);
+  if (errno != 0 || end == ca->commandArgument || *end != '\0' || value > 0xFFFFFFFFUL) {
+    return 1;
+  }
+  *as = value;
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: show the prefixes an AS originates, from the origin AS index of each rib
+ * Input: commandArgument - A linked list that provides all the parameters the users typed 
+ * 		in. This list is in the same order as they were typed.
+ * 	clientThreadArguments - A struct providing the basic address information for the 
+ * 		current connection.
+ * 	commandNode - A pointer to the current node in the command tree structure.
+ * Output:  0 for success or 1 for failure
+ * -------------------------------------------------------------------------------------*/
+int 
+cmdShowBGPOriginAS(commandArgument * ca, clientThreadArguments * client, 
+                   commandNode * root) {
+  int i, more;
+  u_int32_t as;
+  ShowRoutesArg sa;
+  AsWalkCursor cursor;
+
+  if (getASArgument(ca, &as)) {
+    sendMessage(client->socket, "Please enter correct arguments\n");
+    return 1;
+  }
+  memset(&sa, 0, sizeof(sa));
+  sa.client = client;
+
+  sendMessage(client->socket, "%-44s%-44s%-6s%s","Network","Next Hop",
+                              "ASLen","AS Path\n");
+  for (i=0; i<MAX_SESSION_IDS; i++) {
+    if (Sessions[i] == NULL || isSessionEstablished(Sessions[i]->sessionID) != TRUE) {
+      continue;
+    }
+    sa.ASLen = Sessions[i]->fsm.ASNumlen;
+    sa.sessionID = Sessions[i]->sessionID;
+    memset(&cursor, 0, sizeof(cursor));
+    do {
+      more = walkOriginASPage(sa.sessionID, as, &cursor, showRouteCallback, &sa);
+      if (showPage(&sa, more)) {
+        return 0;
+      }
+    } while (more);
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: attribute walk callback of cmdShowBGPTransitAS, adds one AS path to the page
+ * Input: attrNode - the attribute node
+ *	arg - the ShowRoutesArg of the command
+ * Output: 1 if the page is full, 0 otherwise
+ * -------------------------------------------------------------------------------------*/
+static int
+showTransitCallback(AttrNode *attrNode, void *arg) {
+  ShowRoutesArg *sa = arg;
+  char * aspath;
+  int full;
+
+  aspath = showASPath(attrNode, sa->ASLen);
+  full = showAddRow(sa, "%-44s%-10d%s\n", getSessionRemoteAddr(sa->sessionID), 
+                    attrNode->refCount, aspath);
+  free(aspath);
+  return full;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: show the AS paths that transit an AS, from the transit AS index of each rib
+ * Input: commandArgument - A linked list that provides all the parameters the users typed 
+ * 		in. This list is in the same order as they were typed.
+ * 	clientThreadArguments - A struct providing the basic address information for the 
+ * 		current connection.
+ * 	commandNode - A pointer to the current node in the command tree structure.
+ * Output:  0 for success or 1 for failure
+ * -------------------------------------------------------------------------------------*/
+int 
+cmdShowBGPTransitAS(commandArgument * ca, clientThreadArguments * client, 
+                    commandNode * root) {
+  int i, more;
+  u_int32_t as;
+  ShowRoutesArg sa;
+  AsWalkCursor cursor;
+
+  if (getASArgument(ca, &as)) {
+    sendMessage(client->socket, "Please enter correct arguments\n");
+    return 1;
+  }
+  memset(&sa, 0, sizeof(sa));
+  sa.client = client;
+
+  sendMessage(client->socket, "%-44s%-10s%s","Next Hop","Prefixes","AS Path\n");
+  for (i=0; i<MAX_SESSION_IDS; i++) {
+    if (Sessions[i] == NULL || isSessionEstablished(Sessions[i]->sessionID) != TRUE) {
+      continue;
+    }
+    sa.ASLen = Sessions[i]->fsm.ASNumlen;
+    sa.sessionID = Sessions[i]->sessionID;
+    memset(&cursor, 0, sizeof(cursor));
+    do {
+      more = walkTransitASPage(sa.sessionID, as, &cursor, showTransitCallback, &sa);
+      if (showPage(&sa, more)) {
+        return 0;
+      }
+    } while (more);
+  }
+  return 0;
+}
+
 
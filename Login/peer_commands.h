@@ -42,6 +42,8 @@ int cmdShowBGPNeighbor(commandArgument * ca, clientThreadArguments * client, com
 int cmdShowBGPRoutes(commandArgument * ca, clientThreadArguments * client, commandNode * root);
 int cmdShowBGProutesASpath(commandArgument * ca, clientThreadArguments * client, commandNode * root);
 int cmdShowBGPprefix(commandArgument * ca, clientThreadArguments * client, commandNode * root);
+int cmdShowBGPOriginAS(commandArgument * ca, clientThreadArguments * client, commandNode * root);
+int cmdShowBGPTransitAS(commandArgument * ca, clientThreadArguments * client, commandNode * root);
 
 int cmdNeighborPeerGroupCreate(commandArgument * ca, clientThreadArguments * client, commandNode * root);
 int cmdNeighborPeerGroupAssign(commandArgument * ca, clientThreadArguments * client, commandNode * root);
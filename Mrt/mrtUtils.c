@@ -32,6 +32,7 @@
  
 /* externally visible structures and functions for mrts */
 #include "mrtUtils.h"
+#include "../Peering/bgpmessagetypes.h"
 
 //#define DEBUG
 
@@ -601,8 +602,7 @@ MRT_parseHeader(int socket,MRTheader* mrtHeader)
 /*--------------------------------------------------------------------------------------
  * Purpose: write an MRT header to a buffer
  * Input:  the buffer to write to and the mrt header
- * Output: 1 for success
- *         0 for failure --> should result in closing the MRT session
+ * Output: the number of bytes written, MRT_HEADER_LENGTH
  * Cathie Olschanowsky @ march 2012
  * first read the MRT common header http://tools.ietf.org/search/draft-ietf-grow-mrt-15#section-2
  * expected format
@@ -617,26 +617,94 @@ MRT_parseHeader(int socket,MRTheader* mrtHeader)
  *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *|                      Message... (variable)
  *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * The header is left in host byte order.
 --------------------------------------------------------------------------------------*/
 int
 MRT_writeHeader(uint8_t *dest,MRTheader* mrtHeader){
 
-  int time_pos = 0;
-  int type_pos = 4; 
-  int subtype_pos = 6;
-  int length_pos = 8;
+  uint32_t timestamp = htonl(mrtHeader->timestamp);
+  uint16_t type = htons(mrtHeader->type);
+  uint16_t subtype = htons(mrtHeader->subtype);
+  uint32_t length = htonl(mrtHeader->length);
 
-  dest[time_pos]   = htonl(mrtHeader->timestamp);
-  dest[type_pos]   = htons(mrtHeader->type);
-  dest[subtype_pos]= htons(mrtHeader->subtype);
-  dest[length_pos] = htons(mrtHeader->length);
+  memcpy(dest, &timestamp, 4);
+  memcpy(dest+4, &type, 2);
+  memcpy(dest+6, &subtype, 2);
+  memcpy(dest+8, &length, 4);
 
-  mrtHeader->timestamp = ntohl(mrtHeader->timestamp);
-  mrtHeader->type = ntohs(mrtHeader->type);
-  mrtHeader->subtype = ntohs(mrtHeader->subtype);
-  mrtHeader->length = ntohl(mrtHeader->length);
+  return MRT_HEADER_LENGTH;
+}
 
-  return 0;
+/*--------------------------------------------------------------------------------------
+ * Purpose: write a BGP4MP record, the MRT header included, to a buffer
+ * Input:  the buffer to write to and its size, the mrt header with the timestamp
+ *         and the subtype set, the peering of the record and the data that follows
+ *         the BGP4MP header: a BGP message or the old and new state
+ * Output: the length of the record or -1 if it does not fit
+ * The AS numbers are 4 bytes for the AS4 subtypes and 2 bytes otherwise, the
+ * addresses are 4 or 16 bytes depending on the address family.
+ *0                   1                   2                   3
+ *0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *|         Peer AS Number        |        Local AS Number        |
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *|        Interface Index        |        Address Family         |
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *|                      Peer IP Address (variable)               |
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *|                      Local IP Address (variable)              |
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *|                    BGP Message... (variable)
+ *+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+--------------------------------------------------------------------------------------*/
+int
+MRT_writeBGP4MP(uint8_t *dest, int maxlen, MRTheader *mrtHeader, MRTmessage *peering,
+                uint8_t *data, int dataLen){
+
+  int asLen = 2;
+  int ipLen = 4;
+  int pos = MRT_HEADER_LENGTH;
+  uint32_t as4;
+  uint16_t as2, num;
+
+  if(mrtHeader->subtype == BGP4MP_MESSAGE_AS4 || mrtHeader->subtype == BGP4MP_STATE_CHANGE_AS4
+     || mrtHeader->subtype == BGP4MP_MESSAGE_AS4_LOCAL){
+    asLen = 4;
+  }
+  if(peering->addressFamily == BGP_AFI_IPv6){
+    ipLen = 16;
+  }
+  if(MRT_HEADER_LENGTH + 2*asLen + 4 + 2*ipLen + dataLen > maxlen){
+    return -1;
+  }
+
+  if(asLen == 4){
+    as4 = htonl(peering->peerAs);
+    memcpy(dest+pos, &as4, 4);
+    as4 = htonl(peering->localAs);
+    memcpy(dest+pos+4, &as4, 4);
+  }else{
+    as2 = htons(peering->peerAs);
+    memcpy(dest+pos, &as2, 2);
+    as2 = htons(peering->localAs);
+    memcpy(dest+pos+2, &as2, 2);
+  }
+  pos += 2*asLen;
+  num = htons(peering->interfaceIndex);
+  memcpy(dest+pos, &num, 2);
+  num = htons(peering->addressFamily);
+  memcpy(dest+pos+2, &num, 2);
+  pos += 4;
+  memcpy(dest+pos, peering->peerIPAddress, ipLen);
+  memcpy(dest+pos+ipLen, peering->localIPAddress, ipLen);
+  pos += 2*ipLen;
+  memcpy(dest+pos, data, dataLen);
+  pos += dataLen;
+
+  mrtHeader->type = BGP4MP;
+  mrtHeader->length = pos - MRT_HEADER_LENGTH;
+  MRT_writeHeader(dest, mrtHeader);
+  return pos;
 }
 
 /*--------------------------------------------------------------------------------------
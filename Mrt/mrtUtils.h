@@ -173,6 +173,24 @@ int MRT_readMessageNoHeader(int socket,MRTheader mrtHeader,uint8_t *rawMessage);
 --------------------------------------------------------------------------------------*/
 int MRT_parseHeader(int socket,MRTheader* mrtHeader);
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: write an MRT header to a buffer
+ * Input:  the buffer to write to and the mrt header
+ * Output: the number of bytes written, MRT_HEADER_LENGTH
+--------------------------------------------------------------------------------------*/
+int MRT_writeHeader(uint8_t *dest,MRTheader* mrtHeader);
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: write a BGP4MP record, the MRT header included, to a buffer
+ * Input:  the buffer to write to and its size, the mrt header with the timestamp
+ *         and the subtype set, the peering of the record and the data that follows
+ *         the BGP4MP header: a BGP message or the old and new state
+ * Output: the length of the record or -1 if it does not fit
+ * The type and the length of the header are set by the function.
+--------------------------------------------------------------------------------------*/
+int MRT_writeBGP4MP(uint8_t *dest, int maxlen, MRTheader *mrtHeader, MRTmessage *peering,
+                    uint8_t *data, int dataLen);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: fast forward reading from the socket, the given number of bytes
  * Input:  the socket to read from, the number of bytes to skip
@@ -30,6 +30,7 @@
 #include <CUnit/Basic.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "mrtUtils_t.h"
 
 /* a few global variables to play with across tests */
@@ -221,6 +222,72 @@ testMRT_backlog_resize()
 }
 
 
+void
+testMRT_writeHeader()
+{
+  uint8_t expected[MRT_HEADER_LENGTH] = {0x4e,0x78,0x39,0xf0, 0x00,0x10, 0x00,0x04, 0x00,0x00,0x00,0x3f};
+  uint8_t buf[MRT_HEADER_LENGTH];
+  MRTheader mrtHeader;
+
+  mrtHeader.timestamp = 0x4e7839f0;
+  mrtHeader.type = BGP4MP;
+  mrtHeader.subtype = BGP4MP_MESSAGE_AS4;
+  mrtHeader.length = 63;
+  CU_ASSERT(MRT_HEADER_LENGTH == MRT_writeHeader(buf,&mrtHeader));
+  CU_ASSERT(0 == memcmp(buf,expected,MRT_HEADER_LENGTH));
+  // the header is left as it was
+  CU_ASSERT(0x4e7839f0 == mrtHeader.timestamp);
+  CU_ASSERT(63 == mrtHeader.length);
+}
+
+void
+testMRT_writeBGP4MP()
+{
+  uint8_t keepalive[19];
+  uint8_t buf[128];
+  MRTheader mrtHeader;
+  MRTmessage peering;
+
+  memset(keepalive,0xff,16);
+  keepalive[16] = 0;
+  keepalive[17] = 19;
+  keepalive[18] = 4;
+  memset(&peering,0,sizeof(peering));
+  peering.peerAs = 196608;
+  peering.localAs = 6447;
+  peering.addressFamily = 1;
+  peering.peerIPAddress[0] = 192;
+  peering.peerIPAddress[3] = 1;
+  peering.localIPAddress[0] = 10;
+  peering.localIPAddress[3] = 2;
+
+  // AS4 subtype: 4 byte AS numbers and IPv4 addresses
+  mrtHeader.timestamp = 1000;
+  mrtHeader.subtype = BGP4MP_MESSAGE_AS4;
+  CU_ASSERT(MRT_HEADER_LENGTH+20+19 == MRT_writeBGP4MP(buf,sizeof(buf),&mrtHeader,&peering,keepalive,19));
+  CU_ASSERT(BGP4MP == mrtHeader.type);
+  CU_ASSERT(20+19 == mrtHeader.length);
+  CU_ASSERT(0 == buf[4] && 16 == buf[5] && 0 == buf[6] && 4 == buf[7] && 39 == buf[11]);
+  CU_ASSERT(0x00 == buf[12] && 0x03 == buf[13] && 0x00 == buf[14] && 0x00 == buf[15]);
+  CU_ASSERT(0x19 == buf[18] && 0x2f == buf[19]);
+  CU_ASSERT(0 == buf[22] && 1 == buf[23]);
+  CU_ASSERT(192 == buf[24] && 1 == buf[27] && 10 == buf[28] && 2 == buf[31]);
+  CU_ASSERT(0 == memcmp(buf+32,keepalive,19));
+
+  // 2 byte AS numbers and IPv6 addresses
+  peering.peerAs = 23456;
+  peering.addressFamily = 2;
+  mrtHeader.subtype = BGP4MP_MESSAGE;
+  CU_ASSERT(MRT_HEADER_LENGTH+40+19 == MRT_writeBGP4MP(buf,sizeof(buf),&mrtHeader,&peering,keepalive,19));
+  CU_ASSERT(0x5b == buf[12] && 0xa0 == buf[13] && 0x19 == buf[14] && 0x2f == buf[15]);
+  CU_ASSERT(0 == buf[18] && 2 == buf[19]);
+  CU_ASSERT(192 == buf[20] && 10 == buf[36]);
+  CU_ASSERT(0 == memcmp(buf+52,keepalive,19));
+
+  // the record does not fit
+  CU_ASSERT(-1 == MRT_writeBGP4MP(buf,MRT_HEADER_LENGTH+40+18,&mrtHeader,&peering,keepalive,19));
+}
+
 void
 help_load_test_MRT(MRTheader *mrtHeader1,uint8_t *rawMessage1){
 
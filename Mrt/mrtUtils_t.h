@@ -39,6 +39,8 @@ void testMRT_backlog_read();
 void testMRT_backlog_write();
 void testMRT_backlog_init();
 void testMRT_backlog_resize();
+void testMRT_writeHeader();
+void testMRT_writeBGP4MP();
 int init_mrtUtils(void);
 int clean_mrtUtils(void);
 
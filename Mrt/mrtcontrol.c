@@ -131,7 +131,7 @@ initMrtControlSettings()
   }
   
 	// The label action for mrts
-	if (MRT_LABEL_ACTION < NoAction || MRT_LABEL_ACTION > StoreRibOnly){
+	if (MRT_LABEL_ACTION < NoAction || MRT_LABEL_ACTION > LabelNoDuplicates){
 		err = 1;
 		log_warning("Invalid site default for qugga label action.");
 		MrtControls.labeAction = Label;
@@ -245,7 +245,7 @@ readMrtControlSettings()
 #endif
 
 	// get enabled status of mrts control module
-	result = getConfigValueAsInt(&num, XML_MRTS_CTR_LABEL_ACTION_PATH, NoAction, StoreRibOnly);
+	result = getConfigValueAsInt(&num, XML_MRTS_CTR_LABEL_ACTION_PATH, NoAction, LabelNoDuplicates);
 	if (result == CONFIG_VALID_ENTRY) 
 		MrtControls.labeAction = num;
 	else if ( result == CONFIG_INVALID_ENTRY ) 
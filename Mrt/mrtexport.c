@@ -0,0 +1,762 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: mrtexport.c
+ *  Date: Oct 18, 2026
+ */
+
+/*
+ * Archive the live messages as BGP4MP records in rotating MRT files
+ */
+
+/* externally visible functions of the mrt export */
+#include "mrtexport.h"
+/* needed for the MRT header and record writers */
+#include "mrtUtils.h"
+/* needed for the periodic rib dumps */
+#include "mrtribdump.h"
+
+/* required for logging functions */
+#include "../Util/log.h"
+/* needed for reading and saving configuration */
+#include "../Config/configdefaults.h"
+#include "../Config/configfile.h"
+/* required for TRUE/FALSE defines and the export defaults */
+#include "../Util/bgpmon_defaults.h"
+/* needed for the default export directory */
+#include "../site_defaults.h"
+/* needed for the label queue */
+#include "../Queues/queue.h"
+/* needed for the sessions and their state changes */
+#include "../Peering/peersession.h"
+#include "../Peering/bgpstates.h"
+#include "../Peering/bgpmessagetypes.h"
+/* needed to keep sessions from being deleted while they are read */
+#include "../XML/xml.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+//#define DEBUG
+
+/* AS number written for a 4 byte AS in the 2 byte AS fields */
+#define MRT_EXPORT_AS_TRANS 23456
+
+/* BGP4MP header with 4 byte AS numbers and IPv6 addresses */
+#define MRT_EXPORT_BGP4MP_MAX_LEN 44
+
+/* the peering of a session as written in its records */
+struct MrtExportPeerStruct
+{
+	int		known;		// TRUE once read from the session
+	int		as4;		// TRUE if the session uses 4 byte AS numbers
+	u_int32_t	peerAs;
+	u_int32_t	localAs;
+	u_int16_t	afi;
+	u_int8_t	peerIP[16];
+	u_int8_t	localIP[16];
+};
+typedef struct MrtExportPeerStruct MrtExportPeer;
+
+struct MrtExportControls_struct_st
+{
+	int		enabled;	// TRUE: enabled or FALSE: disabled
+	char		directory[PATH_MAX_CHARS];	// where the files are written
+	int		interval;	// seconds covered by a file
+	int		fsyncInterval;	// seconds between syncs of the open file
+	int		ribEnabled;	// TRUE if the rib tables are dumped
+	int		ribInterval;	// seconds between rib dumps, 0 for none
+	int		ribRate;	// most prefixes dumped per second, 0 for no limit
+	int		launched;	// TRUE if the thread was started
+	int		ribLaunched;	// TRUE if the rib dump thread was started
+	int		shutdown;	// TRUE once no more messages are coming
+	volatile int	stopping;	// TRUE once bgpmon is shutting down
+	time_t		lastAction;	// last time the thread was active
+	pthread_t	exportThread;	// reference to the export thread
+	pthread_t	ribThread;	// reference to the rib dump thread
+};
+typedef struct MrtExportControls_struct_st MrtExportControls_struct;
+
+static MrtExportControls_struct MrtExportControls;
+
+/* the file being written */
+struct MrtExportFileStruct
+{
+	FILE		*file;
+	char		*buffer;	// the stdio buffer of the file
+	time_t		start;		// start of the interval the file covers
+	time_t		retry;		// when to try again after a failed open
+	time_t		lastSync;	// last time the file was synced
+	int		unsynced;	// TRUE if records were written since the sync
+	long		dropped;	// records lost while no file was open
+};
+typedef struct MrtExportFileStruct MrtExportFile;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Initialize the default mrt export configuration.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int
+initMrtExportSettings()
+{
+	MrtExportControls.enabled = MRT_EXPORT_ENABLED;
+	strncpy(MrtExportControls.directory, MRT_EXPORT_DIR, PATH_MAX_CHARS-1);
+	MrtExportControls.interval = MRT_EXPORT_INTERVAL;
+	MrtExportControls.fsyncInterval = MRT_EXPORT_FSYNC_INTERVAL;
+	MrtExportControls.ribEnabled = MRT_RIB_DUMP_ENABLED;
+	MrtExportControls.ribInterval = MRT_RIB_DUMP_INTERVAL;
+	MrtExportControls.ribRate = MRT_RIB_DUMP_RATE;
+	MrtExportControls.launched = FALSE;
+	MrtExportControls.ribLaunched = FALSE;
+	MrtExportControls.shutdown = FALSE;
+	MrtExportControls.stopping = FALSE;
+	MrtExportControls.lastAction = time(NULL);
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Read the mrt export settings from the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int
+readMrtExportSettings()
+{
+	int err = 0;
+	int result;
+	int num;
+	char *dir = NULL;
+
+	// get enabled status of the mrt export
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_ENABLED_PATH, 0, 1);
+	if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.enabled = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of mrt export enabled.");
+	}
+	else
+		log_msg("No configuration of mrt export enabled, using default.");
+
+	// get the directory of the mrt files
+	result = getConfigValueAsString(&dir, XML_MRT_EXPORT_DIR_PATH, PATH_MAX_CHARS-1);
+	if (result == CONFIG_VALID_ENTRY)
+	{
+		strncpy(MrtExportControls.directory, dir, PATH_MAX_CHARS-1);
+		free(dir);
+	}
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export directory.");
+	}
+	else
+		log_msg("No configuration of the mrt export directory, using default.");
+
+	// get the interval covered by a file
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_INTERVAL_PATH, MIN_MRT_EXPORT_INTERVAL, MAX_MRT_EXPORT_INTERVAL);
+	if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.interval = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export interval.");
+	}
+	else
+		log_msg("No configuration of the mrt export interval, using default.");
+
+	// get how often the open file is synced
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_FSYNC_INTERVAL_PATH, 0, MAX_MRT_EXPORT_FSYNC_INTERVAL);
+	if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.fsyncInterval = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export fsync interval.");
+	}
+	else
+		log_msg("No configuration of the mrt export fsync interval, using default.");
+
+	// get enabled status of the rib dumps
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_RIB_ENABLED_PATH, 0, 1);
+	if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.ribEnabled = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of mrt export rib enabled.");
+	}
+	else
+		log_msg("No configuration of mrt export rib enabled, using default.");
+
+	// get the interval between rib dumps
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_RIB_INTERVAL_PATH, 0, MAX_MRT_RIB_DUMP_INTERVAL);
+	if (result == CONFIG_VALID_ENTRY && num != 0 && num < MIN_MRT_RIB_DUMP_INTERVAL)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export rib interval.");
+	}
+	else if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.ribInterval = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export rib interval.");
+	}
+	else
+		log_msg("No configuration of the mrt export rib interval, using default.");
+
+	// get the pace of the rib dumps
+	result = getConfigValueAsInt(&num, XML_MRT_EXPORT_RIB_RATE_PATH, 0, MAX_MRT_RIB_DUMP_RATE);
+	if (result == CONFIG_VALID_ENTRY)
+		MrtExportControls.ribRate = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the mrt export rib rate.");
+	}
+	else
+		log_msg("No configuration of the mrt export rib rate, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "Mrt export %d to [%s] every %d seconds, synced every %d seconds.",
+		MrtExportControls.enabled, MrtExportControls.directory,
+		MrtExportControls.interval, MrtExportControls.fsyncInterval );
+	debug( __FUNCTION__, "Rib dump %d every %d seconds at %d prefixes per second.",
+		MrtExportControls.ribEnabled, MrtExportControls.ribInterval, MrtExportControls.ribRate );
+#endif
+
+	return err;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Save the mrt export settings to the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int
+saveMrtExportSettings()
+{
+	int err = 0;
+
+	// save mrt export tag
+	if ( openConfigElement(XML_MRT_EXPORT_TAG) ) {
+		err = 1;
+		log_warning("Failed to save mrt export settings to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_ENABLED, MrtExportControls.enabled) ) {
+		err = 1;
+		log_warning("Failed to save mrt export enabled to config file.");
+	}
+
+	if ( setConfigValueAsString(XML_MRT_EXPORT_DIR, MrtExportControls.directory) ) {
+		err = 1;
+		log_warning("Failed to save mrt export directory to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_INTERVAL, MrtExportControls.interval) ) {
+		err = 1;
+		log_warning("Failed to save mrt export interval to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_FSYNC_INTERVAL, MrtExportControls.fsyncInterval) ) {
+		err = 1;
+		log_warning("Failed to save mrt export fsync interval to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_RIB_ENABLED, MrtExportControls.ribEnabled) ) {
+		err = 1;
+		log_warning("Failed to save mrt export rib enabled to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_RIB_INTERVAL, MrtExportControls.ribInterval) ) {
+		err = 1;
+		log_warning("Failed to save mrt export rib interval to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_MRT_EXPORT_RIB_RATE, MrtExportControls.ribRate) ) {
+		err = 1;
+		log_warning("Failed to save mrt export rib rate to config file.");
+	}
+
+	// close mrt export tag
+	if ( closeConfigElement(XML_MRT_EXPORT_TAG) ) {
+		err = 1;
+		log_warning("Failed to save mrt export settings to config file.");
+	}
+
+	return err;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Parse an address of a session for its records
+ * Input: addr - the address string
+ *        ip - set to the address, 16 bytes
+ * Output: the address family, IPv4 if the address can not be parsed
+ * -------------------------------------------------------------------------------------*/
+static u_int16_t
+parseExportAddr( const char *addr, u_int8_t *ip )
+{
+	memset(ip, 0, 16);
+	if ( inet_pton(AF_INET, addr, ip) == 1 )
+		return BGP_AFI_IPv4;
+	if ( inet_pton(AF_INET6, addr, ip) == 1 )
+		return BGP_AFI_IPv6;
+	memset(ip, 0, 16);
+	return BGP_AFI_IPv4;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Read the peering of a session for its records
+ * Input: peer - the cache entry of the session
+ *        sessionID - the ID of the session
+ * Output: 0 on success, -1 if the session is gone
+ * NOTE: a session is deleted by the xml thread once it is closed, the lookup is
+ *       done once per session while the xml thread is kept from deleting it
+ * -------------------------------------------------------------------------------------*/
+static int
+loadExportPeer( MrtExportPeer *peer, int sessionID )
+{
+	Session_structp sp;
+	u_int16_t localAfi;
+
+	lockXMLSessions();
+	sp = getSessionByID(sessionID);
+	if ( sp == NULL )
+	{
+		unlockXMLSessions();
+		return -1;
+	}
+	peer->as4 = ( sp->fsm.ASNumlen == 4 );
+	peer->peerAs = sp->configInUse.remoteAS2;
+	peer->localAs = sp->configInUse.localAS2;
+	peer->afi = parseExportAddr(sp->configInUse.remoteAddr, peer->peerIP);
+	localAfi = parseExportAddr(sp->sessionRealSrcAddr, peer->localIP);
+	if ( localAfi != peer->afi )
+		localAfi = parseExportAddr(sp->configInUse.localAddr, peer->localIP);
+	if ( localAfi != peer->afi )
+		memset(peer->localIP, 0, 16);
+	unlockXMLSessions();
+
+	peer->known = TRUE;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Encode a message of the label queue as a BGP4MP record
+ * Input: bmf - the message
+ *        peer - the peering of its session
+ *        record - the output
+ *        maxlen - the size of the output
+ * Output: the length of the record, 0 if the message is not archived
+ *         or -1 if it does not fit
+ * NOTE: the 2 byte AS sessions get BGP4MP_MESSAGE records, the AS4 subtypes
+ *       require the AS path of the message to have 4 byte AS numbers
+ * -------------------------------------------------------------------------------------*/
+static int
+encodeExportRecord( BMF bmf, MrtExportPeer *peer, u_int8_t *record, int maxlen )
+{
+	MRTheader mrtHeader;
+	MRTmessage peering;
+	StateChangeMsg *change;
+	u_int16_t states[2];
+	u_int8_t *data = bmf->message;
+	int dataLen = bmf->length;
+	int bgpLen;
+
+	mrtHeader.timestamp = bmf->timestamp;
+	switch ( bmf->type )
+	{
+		case BMF_TYPE_MSG_LABELED:
+			// only the BGP message, the labels follow it
+			if ( bmf->length < BGP_HEADER_LEN )
+				return 0;
+			bgpLen = (bmf->message[16] << 8) | bmf->message[17];
+			if ( bgpLen >= BGP_HEADER_LEN && bgpLen <= bmf->length )
+				dataLen = bgpLen;
+			mrtHeader.subtype = peer->as4 ? BGP4MP_MESSAGE_AS4 : BGP4MP_MESSAGE;
+			break;
+		case BMF_TYPE_MSG_FROM_PEER:
+			if ( bmf->length < BGP_HEADER_LEN )
+				return 0;
+			mrtHeader.subtype = peer->as4 ? BGP4MP_MESSAGE_AS4 : BGP4MP_MESSAGE;
+			break;
+		case BMF_TYPE_FSM_STATE_CHANGE:
+			// the session states are numbered as the MRT states
+			change = (StateChangeMsg *)bmf->message;
+			states[0] = htons(change->oldState == stateMrtEstablished ? stateEstablished : change->oldState);
+			states[1] = htons(change->newState == stateMrtEstablished ? stateEstablished : change->newState);
+			data = (u_int8_t *)states;
+			dataLen = sizeof(states);
+			mrtHeader.subtype = peer->as4 ? BGP4MP_STATE_CHANGE_AS4 : BGP4MP_STATE_CHANGE;
+			break;
+		default:
+			return 0;
+	}
+
+	peering.peerAs = peer->peerAs;
+	peering.localAs = peer->localAs;
+	if ( !peer->as4 )
+	{
+		if ( peering.peerAs > 0xffff )
+			peering.peerAs = MRT_EXPORT_AS_TRANS;
+		if ( peering.localAs > 0xffff )
+			peering.localAs = MRT_EXPORT_AS_TRANS;
+	}
+	peering.interfaceIndex = 0;
+	peering.addressFamily = peer->afi;
+	memcpy(peering.peerIPAddress, peer->peerIP, 16);
+	memcpy(peering.localIPAddress, peer->localIP, 16);
+
+	return MRT_writeBGP4MP(record, maxlen, &mrtHeader, &peering, data, dataLen);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Flush the records written to the open file and sync it if it is time
+ * Input: mf - the file
+ *        force - TRUE to sync regardless of the fsync interval
+ * Output: 0 on success, -1 on a write error
+ * -------------------------------------------------------------------------------------*/
+static int
+flushExportFile( MrtExportFile *mf, int force )
+{
+	time_t now;
+
+	if ( mf->file == NULL )
+		return 0;
+	if ( ferror(mf->file) || fflush(mf->file) )
+		return -1;
+	if ( !mf->unsynced )
+		return 0;
+
+	now = time(NULL);
+	if ( force || ( MrtExportControls.fsyncInterval > 0
+		&& now - mf->lastSync >= MrtExportControls.fsyncInterval ) )
+	{
+		if ( fsync(fileno(mf->file)) )
+			return -1;
+		mf->lastSync = now;
+		mf->unsynced = FALSE;
+	}
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write out, sync and close the open file
+ * Input: mf - the file
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+static void
+closeExportFile( MrtExportFile *mf )
+{
+	if ( mf->file == NULL )
+		return;
+	if ( flushExportFile(mf, TRUE) )
+		log_err("mrt export: unable to write out the file of %ld: %s", (long)mf->start, strerror(errno));
+	fclose(mf->file);
+	mf->file = NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Open the file of the interval the current time falls in
+ * Input: mf - the file
+ *        now - the current time
+ * Output: 0 on success, -1 on failure
+ * NOTE: the file is opened for appending, a restart within an interval adds to its file
+ * -------------------------------------------------------------------------------------*/
+static int
+openExportFile( MrtExportFile *mf, time_t now )
+{
+	char path[FILENAME_MAX_CHARS];
+	char name[64];
+	struct tm tm;
+
+	mf->start = now - now % MrtExportControls.interval;
+	gmtime_r(&mf->start, &tm);
+	strftime(name, sizeof(name), "updates.%Y%m%d.%H%M", &tm);
+	if ( snprintf(path, FILENAME_MAX_CHARS, "%s/%s", MrtExportControls.directory, name) >= FILENAME_MAX_CHARS )
+	{
+		log_err("mrt export: the path of %s is too long", name);
+		mf->retry = mf->start + MrtExportControls.interval;
+		return -1;
+	}
+
+	mf->file = fopen(path, "ab");
+	if ( mf->file == NULL )
+	{
+		log_err("mrt export: unable to open %s: %s", path, strerror(errno));
+		mf->retry = mf->start + MrtExportControls.interval;
+		return -1;
+	}
+	setvbuf(mf->file, mf->buffer, _IOFBF, MRT_EXPORT_BUFFER_LEN);
+	mf->lastSync = now;
+	mf->unsynced = FALSE;
+	if ( mf->dropped > 0 )
+	{
+		log_warning("mrt export: %ld records were lost while no file was open", mf->dropped);
+		mf->dropped = 0;
+	}
+	log_msg("mrt export: writing %s", path);
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: the main function of the mrt export thread
+ * Input: none
+ * Output: none
+ * NOTE: the records are collected in the stdio buffer of the file and written
+ *       out each time the thread has read all the messages of the label queue
+ * -------------------------------------------------------------------------------------*/
+static void *
+mrtExportThread( void *arg )
+{
+	QueueReader labeledQueueReader = createQueueReader( &labeledQueue, 1 );
+	MrtExportPeer *peers = calloc( MAX_SESSION_IDS, sizeof(MrtExportPeer) );
+	int maxlen = MRT_HEADER_LENGTH + MRT_EXPORT_BGP4MP_MAX_LEN + 65535;
+	u_int8_t *record = malloc( maxlen );
+	MrtExportFile mf;
+	long unread;
+	time_t now;
+	int len;
+	BMF bmf;
+
+	memset(&mf, 0, sizeof(mf));
+	mf.buffer = malloc( MRT_EXPORT_BUFFER_LEN );
+	if ( peers == NULL || record == NULL || mf.buffer == NULL )
+	{
+		log_err( "mrtExportThread: malloc failed" );
+		destroyQueueReader( labeledQueueReader );
+		free( mf.buffer );
+		free( record );
+		free( peers );
+		return NULL;
+	}
+	log_msg( "Mrt export thread started" );
+
+	while ( TRUE )
+	{
+		unread = readQueue( labeledQueueReader );
+		bmf = (BMF)labeledQueueReader->items[0];
+		// a NULL item is only used to wake up the thread
+		if ( bmf == NULL )
+		{
+			if ( MrtExportControls.shutdown == TRUE )
+				break;
+			continue;
+		}
+		MrtExportControls.lastAction = now = time(NULL);
+
+		if ( bmf->type == BMF_TYPE_BGPMON_STOP )
+		{
+			destroyBMF( bmf );
+			break;
+		}
+
+		// move on to the file of the next interval
+		if ( mf.file != NULL && now >= mf.start + MrtExportControls.interval )
+			closeExportFile( &mf );
+		if ( mf.file == NULL && now >= mf.retry )
+			openExportFile( &mf, now );
+
+		len = 0;
+		if ( bmf->sessionID >= 0 && bmf->sessionID < MAX_SESSION_IDS )
+		{
+			MrtExportPeer *peer = &peers[bmf->sessionID];
+			if ( peer->known || loadExportPeer( peer, bmf->sessionID ) == 0 )
+				len = encodeExportRecord( bmf, peer, record, maxlen );
+			// the ID may be given to another session once this one is closed
+			if ( bmf->type == BMF_TYPE_FSM_STATE_CHANGE && checkStateChangeMessage( bmf ) )
+				peer->known = FALSE;
+		}
+
+		if ( len > 0 )
+		{
+			if ( mf.file == NULL )
+				mf.dropped++;
+			else
+			{
+				fwrite( record, len, 1, mf.file );
+				mf.unsynced = TRUE;
+			}
+		}
+		destroyBMF( bmf );
+
+		// the queue is drained, write out the batch
+		if ( unread == 0 && flushExportFile( &mf, FALSE ) )
+		{
+			log_err( "mrt export: unable to write the file of %ld: %s", (long)mf.start, strerror(errno) );
+			closeExportFile( &mf );
+			mf.retry = mf.start + MrtExportControls.interval;
+		}
+	}
+
+	closeExportFile( &mf );
+	destroyQueueReader( labeledQueueReader );
+	free( mf.buffer );
+	free( record );
+	free( peers );
+	log_warning( "Mrt export thread exiting" );
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: the main function of the rib dump thread
+ * Input: none
+ * Output: none
+ * NOTE: the dumps are taken on multiples of the rib interval and named after
+ *       the time they are taken at, like the update files
+ * -------------------------------------------------------------------------------------*/
+static void *
+mrtRibDumpThread( void *arg )
+{
+	char path[PATH_MAX_CHARS];
+	char name[32];
+	struct tm tm;
+	time_t next;
+	time_t now;
+	int len;
+
+	log_msg( "Rib dump thread started" );
+	now = time(NULL);
+	next = now - now % MrtExportControls.ribInterval + MrtExportControls.ribInterval;
+	while ( MrtExportControls.stopping == FALSE )
+	{
+		now = time(NULL);
+		if ( now < next )
+		{
+			sleep( 1 );
+			continue;
+		}
+
+		gmtime_r( &next, &tm );
+		strftime( name, sizeof(name), "rib.%Y%m%d.%H%M", &tm );
+		len = snprintf( path, PATH_MAX_CHARS, "%s/%s", MrtExportControls.directory, name );
+		if ( len >= PATH_MAX_CHARS )
+			log_err( "mrt export: rib dump path is too long" );
+		else
+			writeMrtRibDump( path, next, MrtExportControls.ribRate, &MrtExportControls.stopping );
+
+		// skip the dumps missed while this one was written
+		now = time(NULL);
+		next = now - now % MrtExportControls.ribInterval + MrtExportControls.ribInterval;
+	}
+	log_warning( "Rib dump thread exiting" );
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: launch the mrt export thread if the export is enabled and the rib dump
+ *          thread if the rib dumps are enabled, called by main.c
+ * Input: none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void
+launchMrtExportThread()
+{
+	pthread_attr_t attr;
+	int error;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	if ( MrtExportControls.enabled == TRUE )
+	{
+		if ( (error = pthread_create(&MrtExportControls.exportThread, &attr, mrtExportThread, NULL)) > 0 )
+			log_fatal("Failed to create mrt export thread: %s\n", strerror(error));
+		MrtExportControls.launched = TRUE;
+	}
+	if ( MrtExportControls.ribEnabled == TRUE && MrtExportControls.ribInterval > 0 )
+	{
+		if ( (error = pthread_create(&MrtExportControls.ribThread, &attr, mrtRibDumpThread, NULL)) > 0 )
+			log_fatal("Failed to create rib dump thread: %s\n", strerror(error));
+		MrtExportControls.ribLaunched = TRUE;
+	}
+	pthread_attr_destroy(&attr);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the state of the mrt export
+ * Input: none
+ * Output: returns TRUE or FALSE
+ * -------------------------------------------------------------------------------------*/
+int
+isMrtExportEnabled()
+{
+	return MrtExportControls.enabled;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the last action time of the mrt export thread
+ * Input: none
+ * Output: a timevalue indicating the last time the thread was active
+ * -------------------------------------------------------------------------------------*/
+time_t
+getMrtExportLastAction()
+{
+	return MrtExportControls.lastAction;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Signal the rib dump thread to give up the dump it is writing
+ * Input: none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void
+signalMrtExportShutdown()
+{
+	MrtExportControls.stopping = TRUE;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wait for the mrt export thread to write out and close its file
+ * Input: none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void
+waitForMrtExportShutdown()
+{
+	QueueWriter labeledQueueWriter;
+
+	MrtExportControls.stopping = TRUE;
+	if ( MrtExportControls.ribLaunched == TRUE )
+		pthread_join( MrtExportControls.ribThread, NULL );
+	if ( MrtExportControls.launched == FALSE )
+		return;
+
+	// the thread stops at the BGPMON_STOP message passed on by the labeling
+	// module, or at this NULL item if the message did not make it
+	MrtExportControls.shutdown = TRUE;
+	labeledQueueWriter = createQueueWriter( labeledQueue );
+	writeQueue( labeledQueueWriter, NULL );
+	destroyQueueWriter( labeledQueueWriter );
+	pthread_join( MrtExportControls.exportThread, NULL );
+}
@@ -0,0 +1,99 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: mrtexport.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef MRTEXPORT_H_
+#define MRTEXPORT_H_
+
+/* needed for system types such as time_t */
+#include <sys/types.h>
+
+// functions of the thread archiving the live messages as MRT files
+// see mrtexport.c for corresponding functions
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Initialize the default mrt export configuration.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int initMrtExportSettings();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Read the mrt export settings from the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int readMrtExportSettings();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Save the mrt export settings to the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int saveMrtExportSettings();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: launch the mrt export thread if the export is enabled and the rib dump
+ *          thread if the rib dumps are enabled, called by main.c
+ * Input: none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void launchMrtExportThread();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the state of the mrt export
+ * Input: none
+ * Output: returns TRUE or FALSE
+ * -------------------------------------------------------------------------------------*/
+int isMrtExportEnabled();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get the last action time of the mrt export thread
+ * Input: none
+ * Output: a timevalue indicating the last time the thread was active
+ * -------------------------------------------------------------------------------------*/
+time_t getMrtExportLastAction();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Signal the rib dump thread to give up the dump it is writing
+ * Input: none
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void signalMrtExportShutdown();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: wait for the mrt export thread to write out and close its file
+ * Input: none
+ * Output: none
+ * NOTE: called once the labeling module is down, the thread exits on the
+ *       BGPMON_STOP message it wrote into the label queue. The rib dump
+ *       thread is joined first.
+ * -------------------------------------------------------------------------------------*/
+void waitForMrtExportShutdown();
+
+#endif /*MRTEXPORT_H_*/
@@ -0,0 +1,570 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: mrtribdump.c
+ *  Date: Oct 18, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "mrtribdump.h"
+#include "mrtUtils.h"
+#include "../Labeling/rtable.h"
+#include "../Labeling/epoch.h"
+#include "../Labeling/v4table.h"
+#include "../Peering/peersession.h"
+#include "../Peering/bgpstates.h"
+#include "../Peering/bgpmessagetypes.h"
+// needed for the bgpmon id
+#include "../Clients/clientscontrol.h"
+// needed to keep sessions from being deleted while they are read
+#include "../XML/xml.h"
+#include "../Util/log.h"
+#include "../Util/bgpmon_defaults.h"
+
+//#define DEBUG
+
+/* the most bytes of a RIB record before its attributes: MRT header, sequence
+ * number, prefix, entry count, peer index, originated time and attribute length */
+#define RIB_DUMP_RECORD_HEAD	(MRT_HEADER_LENGTH + 4 + 1 + 16 + 2 + 2 + 4 + 2)
+
+/* an AS path with every AS number made 4 bytes is at most twice as long */
+#define RIB_DUMP_ATTR_LEN	(3 * MAX_BGP_MESSAGE_LEN)
+
+/* a session in the peer index table of a dump */
+typedef struct RibDumpPeerStruct {
+	int			sessionID;
+	Session_structp		session;	// to tell the session from a later one with its ID
+	int			as4;		// TRUE if the AS path of the session has 4 byte AS numbers
+	time_t			establishTime;	// originated time written for the IPv4 unicast prefixes
+} RibDumpPeer;
+
+/* a dump being written */
+typedef struct RibDumpStruct {
+	time_t			timestamp;
+	u_int32_t		seq;		// sequence number of the next RIB record
+	long			prefixes;
+	long			skipped;	// attribute nodes that could not be written
+	u_char			*buf;		// the records of the bucket being read
+	size_t			len;
+	size_t			size;
+	u_char			attrs[RIB_DUMP_ATTR_LEN];	// the attributes of the node being read
+	int			attrsLen;
+} RibDump;
+
+static void
+put16(u_char *p, u_int16_t v)
+{
+	v = htons(v);
+	memcpy(p, &v, 2);
+}
+
+static void
+put32(u_char *p, u_int32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, 4);
+}
+
+static u_int16_t
+get16(u_char *p)
+{
+	u_int16_t v;
+	memcpy(&v, p, 2);
+	return ntohs(v);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Make room for a record at the end of the dump buffer
+ * Input: d - the dump
+ *		len - the most bytes the record takes
+ * Output: where to write the record or NULL if out of memory
+ * -------------------------------------------------------------------------------------*/
+static u_char *
+reserveRibDump( RibDump *d, size_t len )
+{
+	u_char *buf;
+	size_t size = d->size ? d->size : 65536;
+
+	while( d->len + len > size )
+		size *= 2;
+	if( size != d->size )
+	{
+		buf = realloc(d->buf, size);
+		if( buf == NULL )
+			return NULL;
+		d->buf = buf;
+		d->size = size;
+	}
+	return d->buf + d->len;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy the AS path attribute of a rib with 4 byte AS numbers
+ * Input: asPath - the AS path attribute as received
+ *		as4 - TRUE if it already has 4 byte AS numbers
+ *		out - the output, RIB_DUMP_ATTR_LEN bytes
+ * Output: the length of the attribute or -1 if it is corrupt
+ * -------------------------------------------------------------------------------------*/
+static int
+dumpASPath( BGPASPath *asPath, int as4, u_char *out )
+{
+	u_char *p = asPath->data;
+	int hdr, pos, len, count, i;
+
+	if( asPath->len < 3 )
+		return -1;
+	hdr = (p[0] & BGP_ATTR_FLAG_EXT_LEN) ? 4 : 3;
+	if( asPath->len < hdr )
+		return -1;
+	if( as4 )
+	{
+		memcpy(out, p, asPath->len);
+		return asPath->len;
+	}
+
+	// each segment is its type, its count and count AS numbers
+	len = 4;
+	for( pos = hdr; pos + 2 <= asPath->len; pos += 2 + 2*count )
+	{
+		count = p[pos+1];
+		if( pos + 2 + 2*count > asPath->len )
+			return -1;
+		out[len] = p[pos];
+		out[len+1] = count;
+		len += 2;
+		for( i = 0; i < count; i++ )
+		{
+			out[len] = 0;
+			out[len+1] = 0;
+			out[len+2] = p[pos+2+2*i];
+			out[len+3] = p[pos+3+2*i];
+			len += 4;
+		}
+	}
+	if( pos != asPath->len )
+		return -1;
+	out[0] = p[0] | BGP_ATTR_FLAG_EXT_LEN;
+	out[1] = p[1];
+	put16(out+2, len-4);
+	return len;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the MP_REACH_NLRI attribute of a prefix in the short form of
+ *		TABLE_DUMP_V2, only the next hop
+ * Input: attrNode - the attributes of the prefix
+ *		afi, safi - the address family of the prefix
+ *		out - the output
+ * Output: the length of the attribute, 0 if the node has none for the address
+ *         family or -1 if it is corrupt
+ * NOTE: the rib keeps the mp reach attributes without NLRI after the basic ones
+ * -------------------------------------------------------------------------------------*/
+static int
+dumpMPReach( AttrNode *attrNode, u_int16_t afi, u_int8_t safi, u_char *out )
+{
+	u_char *p = attrNode->attr + attrNode->basicAttrLen;
+	u_char *end = attrNode->attr + attrNode->totalAttrLen;
+	int hdr, len, nhLen;
+
+	while( p + 3 <= end )
+	{
+		hdr = (p[0] & BGP_ATTR_FLAG_EXT_LEN) ? 4 : 3;
+		if( p + hdr > end )
+			return -1;
+		len = (hdr == 4) ? get16(p+2) : p[2];
+		if( p + hdr + len > end )
+			return -1;
+		if( p[1] == BGP_MP_REACH && len >= 4 && get16(p+hdr) == afi && p[hdr+2] == safi )
+		{
+			nhLen = p[hdr+3];
+			if( 4 + nhLen > len || nhLen > 254 )
+				return -1;
+			out[0] = BGP_ATTR_FLAG_OPTIONAL;
+			out[1] = BGP_MP_REACH;
+			out[2] = 1 + nhLen;
+			out[3] = nhLen;
+			memcpy(out+4, p+hdr+4, nhLen);
+			return 4 + nhLen;
+		}
+		p += hdr + len;
+	}
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add the RIB record of a prefix to the dump buffer
+ * Input: d - the dump, its attrs hold the basic attributes and AS path of the prefix
+ *		peerIndex - the index of the session in the peer index table
+ *		prefix - the prefix
+ *		originated - when the prefix got its attributes
+ *		attrNode - the attributes of the prefix
+ * Output: 0 on success, -1 if out of memory
+ * -------------------------------------------------------------------------------------*/
+static int
+dumpPrefix( RibDump *d, u_int16_t peerIndex, const Prefix *prefix, time_t originated, AttrNode *attrNode )
+{
+	MRTheader mrtHeader;
+	u_char mpReach[4 + 255];
+	u_char *rec;
+	int mpLen = 0;
+	int plen = prefix->addr.p_len;
+	int bytes = (PREFIX_SIZE(plen));
+	int pos;
+
+	if( prefix->afi == BGP_AFI_IPv4 && plen <= 32 )
+		mrtHeader.subtype = (prefix->safi == 1) ? RIB_IPV4_UNICAST : RIB_IPV4_MULTICAST;
+	else if( prefix->afi == BGP_AFI_IPv6 && plen <= 128 )
+		mrtHeader.subtype = (prefix->safi == 1) ? RIB_IPV6_UNICAST : RIB_IPV6_MULTICAST;
+	else
+		return 0;
+	if( prefix->safi != 1 && prefix->safi != 2 )
+		return 0;
+
+	// IPv4 unicast has its next hop in the basic attributes
+	if( prefix->afi != BGP_AFI_IPv4 || prefix->safi != 1 )
+	{
+		mpLen = dumpMPReach(attrNode, prefix->afi, prefix->safi, mpReach);
+		if( mpLen < 0 )
+		{
+			d->skipped++;
+			return 0;
+		}
+	}
+
+	rec = reserveRibDump(d, RIB_DUMP_RECORD_HEAD + d->attrsLen + mpLen);
+	if( rec == NULL )
+		return -1;
+	pos = MRT_HEADER_LENGTH;
+	put32(rec+pos, d->seq);
+	rec[pos+4] = plen;
+	memcpy(rec+pos+5, prefix->addr.paddr, bytes);
+	pos += 5 + bytes;
+	put16(rec+pos, 1);
+	put16(rec+pos+2, peerIndex);
+	put32(rec+pos+4, originated);
+	put16(rec+pos+8, d->attrsLen + mpLen);
+	pos += 10;
+	memcpy(rec+pos, d->attrs, d->attrsLen);
+	memcpy(rec+pos+d->attrsLen, mpReach, mpLen);
+	pos += d->attrsLen + mpLen;
+
+	mrtHeader.timestamp = d->timestamp;
+	mrtHeader.type = TABLE_DUMP_V2;
+	mrtHeader.length = pos - MRT_HEADER_LENGTH;
+	MRT_writeHeader(rec, &mrtHeader);
+	d->len += pos;
+	d->seq++;
+	d->prefixes++;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add the RIB records of the prefixes of an attribute node to the dump buffer
+ * Input: d - the dump
+ *		peer - the session of the rib
+ *		peerIndex - the index of the session in the peer index table
+ *		attrNode - the attribute node
+ *		prefixTable - the prefix table of the rib
+ * Output: 0 on success, -1 if out of memory
+ * NOTE: must be called inside an epoch section, the prefixes are found as the
+ *       table transfer finds them, see sendBMFFromAttrNode. The compact IPv4
+ *       unicast table keeps no time per prefix, see v4table.h, so those records
+ *       carry the time the session was established instead of the time the
+ *       prefix was learned. The other prefixes carry their own time.
+ * -------------------------------------------------------------------------------------*/
+static int
+dumpAttrNode( RibDump *d, RibDumpPeer *peer, u_int16_t peerIndex, AttrNode *attrNode, PrefixTable *prefixTable )
+{
+	PrefixRefNode *prefixRefNode;
+	V4TableData *v4;
+	u_int32_t handle, slot;
+	int asPathLen;
+
+	if( attrNode->prefixRefNode == NULL && attrNode->v4Handle == V4_NONE )
+		return 0;
+
+	// the basic attributes and the AS path are the same for every prefix of the node
+	asPathLen = dumpASPath(&attrNode->asPath->asPathData, peer->as4, d->attrs + attrNode->basicAttrLen);
+	if( asPathLen < 0 )
+	{
+		d->skipped++;
+		return 0;
+	}
+	memcpy(d->attrs, attrNode->attr, attrNode->basicAttrLen);
+	d->attrsLen = attrNode->basicAttrLen + asPathLen;
+
+	for( prefixRefNode = attrNode->prefixRefNode; prefixRefNode != NULL; prefixRefNode = prefixRefNode->next )
+	{
+		if( dumpPrefix(d, peerIndex, &prefixRefNode->prefixNode->keyPrefix,
+			prefixRefNode->prefixNode->originatedTS, attrNode) )
+			return -1;
+	}
+
+	// a slot that was unlinked while we stand on it still leads to the rest of the list
+	handle = attrNode->v4Handle;
+	if( prefixTable->v4Table != NULL && handle != V4_NONE )
+	{
+		v4 = prefixTable->v4Table->data;
+		slot = (handle < v4->handleSize && v4->values[handle] == attrNode) ? v4->heads[handle] : V4_NONE;
+		while( slot != V4_NONE )
+		{
+			u_int64_t keyBuf = v4->keys[slot];
+			if( v4->attrs[slot] == handle
+				&& dumpPrefix(d, peerIndex, (Prefix *)&keyBuf, peer->establishTime, attrNode) )
+				return -1;
+			slot = v4->next[slot];
+		}
+	}
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Find the sessions to dump and write the peer index table
+ * Input: d - the dump
+ *		peers - set to the sessions, the caller frees them
+ * Output: the number of sessions or -1 if out of memory
+ * -------------------------------------------------------------------------------------*/
+static int
+dumpPeerIndex( RibDump *d, RibDumpPeer **peers )
+{
+	MRTheader mrtHeader;
+	Session_structp sp;
+	u_int32_t bgpID;
+	u_int8_t ip[16];
+	u_char *rec;
+	int i, count = 0, pos, ipLen;
+
+	*peers = malloc(sizeof(RibDumpPeer) * 65535);
+	// collector BGP ID, view name length, peer count and at most 65535 peers of 27 bytes
+	rec = reserveRibDump(d, MRT_HEADER_LENGTH + 8 + 65535 * 27);
+	if( *peers == NULL || rec == NULL )
+		return -1;
+	pos = MRT_HEADER_LENGTH;
+	put32(rec+pos, ClientControls.bgpmon_id);
+	put16(rec+pos+4, 0);
+	pos += 8;
+
+	lockXMLSessions();
+	for( i = 0; i < MAX_SESSION_IDS && count < 65535; i++ )
+	{
+		sp = Sessions[i];
+		if( sp == NULL || sp->attributeTable == NULL || sp->prefixTable == NULL
+			|| (sp->fsm.state != stateEstablished && sp->fsm.state != stateMrtEstablished) )
+			continue;
+
+		(*peers)[count].sessionID = i;
+		(*peers)[count].session = sp;
+		(*peers)[count].as4 = (sp->fsm.ASNumlen == 4);
+		(*peers)[count].establishTime = sp->stats.establishTime;
+
+		// peer type: the AS number is 4 bytes, the address 4 or 16 bytes
+		memset(ip, 0, sizeof(ip));
+		if( inet_pton(AF_INET6, sp->configInUse.remoteAddr, ip) == 1 )
+		{
+			rec[pos] = 0x03;
+			ipLen = 16;
+		}
+		else
+		{
+			inet_pton(AF_INET, sp->configInUse.remoteAddr, ip);
+			rec[pos] = 0x02;
+			ipLen = 4;
+		}
+		// the BGP ID is kept as received, see xmlNewNodeBGPID
+		bgpID = (u_int32_t)sp->configInUse.remoteBGPID;
+		memcpy(rec+pos+1, &bgpID, 4);
+		memcpy(rec+pos+5, ip, ipLen);
+		put32(rec+pos+5+ipLen, sp->configInUse.remoteAS2);
+		pos += 9 + ipLen;
+		count++;
+	}
+	unlockXMLSessions();
+
+	put16(rec+MRT_HEADER_LENGTH+6, count);
+	mrtHeader.timestamp = d->timestamp;
+	mrtHeader.type = TABLE_DUMP_V2;
+	mrtHeader.subtype = PEER_INDEX_TABLE;
+	mrtHeader.length = pos - MRT_HEADER_LENGTH;
+	MRT_writeHeader(rec, &mrtHeader);
+	d->len += pos;
+	return count;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Sleep while the dump is ahead of its rate
+ * Input: start - when the dump started
+ *		prefixes - the number of prefixes written
+ *		rate - the most prefixes per second, 0 for no limit
+ *		stop - the dump is given up once it is set
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void
+paceRibDump( struct timeval *start, long prefixes, int rate, volatile int *stop )
+{
+	struct timeval now;
+	long long due, elapsed;
+
+	if( rate <= 0 )
+		return;
+	due = (long long)prefixes * 1000000 / rate;
+	while( !*stop )
+	{
+		gettimeofday(&now, NULL);
+		elapsed = (long long)(now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec);
+		if( elapsed >= due )
+			break;
+		usleep( (due - elapsed > 100000) ? 100000 : due - elapsed );
+	}
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib tables of all sessions to a TABLE_DUMP_V2 file
+ * Input: path - the name of the file
+ *		timestamp - the time of the dump, written in the MRT headers
+ *		rate - the most prefixes written per second, 0 for no limit
+ *		stop - the dump is given up once it is set
+ * Output: the number of prefixes written or -1 on failure
+ * NOTE: the file is written under a temporary name and renamed once it is
+ *       complete. The rib tables are read in epoch sections, see epoch.h, and
+ *       the writer sleeps between them to keep to the rate.
+ * -------------------------------------------------------------------------------------*/
+long
+writeMrtRibDump( const char *path, time_t timestamp, int rate, volatile int *stop )
+{
+	char tmp[FILENAME_MAX_CHARS];
+	struct timeval start;
+	RibDumpPeer *peers = NULL;
+	RibDumpPeer *peer;
+	Session_structp sp;
+	AttrTable *attributeTable;
+	PrefixTable *prefixTable;
+	AttrNode *node;
+	RibDump *d;
+	FILE *f;
+	int peerCount, k, reader, failed = 0;
+	long prefixes;
+	u_int32_t i;
+
+	snprintf(tmp, FILENAME_MAX_CHARS, "%s.tmp", path);
+	d = calloc(1, sizeof(RibDump));
+	if( d == NULL )
+	{
+		log_err("writeMrtRibDump: malloc failed");
+		return -1;
+	}
+	d->timestamp = timestamp;
+	f = fopen(tmp, "wb");
+	if( f == NULL )
+	{
+		log_err("Unable to open the rib dump %s: %s", tmp, strerror(errno));
+		free(d);
+		return -1;
+	}
+	gettimeofday(&start, NULL);
+
+	peerCount = dumpPeerIndex(d, &peers);
+	if( peerCount < 0 || fwrite(d->buf, d->len, 1, f) != 1 )
+		failed = 1;
+	d->len = 0;
+	for( k = 0; k < peerCount && !failed; k++ )
+	{
+		peer = &peers[k];
+		for( i = 0; !failed; i++ )
+		{
+			if( *stop )
+			{
+				failed = 1;
+				break;
+			}
+
+			// the session may have been closed since the peer index table was written
+			lockXMLSessions();
+			reader = epochEnter();
+			sp = Sessions[peer->sessionID];
+			attributeTable = (sp == peer->session) ? sp->attributeTable : NULL;
+			prefixTable = (sp == peer->session) ? sp->prefixTable : NULL;
+			if( attributeTable == NULL || prefixTable == NULL || i >= attributeTable->tableSize )
+			{
+				epochExit(reader);
+				unlockXMLSessions();
+				break;
+			}
+			for( node = attributeTable->attrEntries[i].node; node != NULL && !failed; node = node->next )
+			{
+				if( dumpAttrNode(d, peer, k, node, prefixTable) )
+				{
+					log_err("writeMrtRibDump: malloc failed");
+					failed = 1;
+				}
+			}
+			epochExit(reader);
+			unlockXMLSessions();
+
+			// write the bucket out of the epoch section, then keep to the rate
+			if( d->len > 0 && fwrite(d->buf, d->len, 1, f) != 1 )
+				failed = 1;
+			d->len = 0;
+			paceRibDump(&start, d->prefixes, rate, stop);
+		}
+	}
+
+	if( failed || ferror(f) || fflush(f) || fsync(fileno(f)) )
+	{
+		if( *stop )
+			log_msg("Rib dump %s given up on shutdown", path);
+		else
+			log_err("Unable to write the rib dump %s: %s", tmp, strerror(errno));
+		fclose(f);
+		unlink(tmp);
+		failed = 1;
+	}
+	else if( fclose(f) || rename(tmp, path) )
+	{
+		log_err("Unable to write the rib dump %s: %s", path, strerror(errno));
+		unlink(tmp);
+		failed = 1;
+	}
+	else
+	{
+		log_msg("Wrote rib dump %s, %d sessions and %ld prefixes in %d seconds", path,
+			peerCount, d->prefixes, (int)(time(NULL) - start.tv_sec));
+		if( d->skipped > 0 )
+			log_warning("Rib dump %s left out %ld corrupt attributes", path, d->skipped);
+	}
+
+	prefixes = d->prefixes;
+	free(peers);
+	free(d->buf);
+	free(d);
+	return failed ? -1 : prefixes;
+}
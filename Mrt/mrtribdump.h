@@ -0,0 +1,60 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: mrtribdump.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef MRTRIBDUMP_H_
+#define MRTRIBDUMP_H_
+
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------------------
+ * TABLE_DUMP_V2 dumps of the rib tables.
+ * A dump file holds a PEER_INDEX_TABLE record listing the established sessions
+ * with a rib, then one RIB_IPV4_UNICAST, RIB_IPV4_MULTICAST, RIB_IPV6_UNICAST or
+ * RIB_IPV6_MULTICAST record per prefix of each session. The records of a session
+ * follow each other and carry a single RIB entry, a prefix several sessions have
+ * is found in several records. The AS numbers are always 4 bytes.
+ * The originated time of an IPv4 unicast prefix is the time its session was
+ * established, the rib keeps no time for those prefixes. Other prefixes have
+ * the time they were last announced.
+ * -------------------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Write the rib tables of all sessions to a TABLE_DUMP_V2 file
+ * Input: path - the name of the file
+ *		timestamp - the time of the dump, written in the MRT headers
+ *		rate - the most prefixes written per second, 0 for no limit
+ *		stop - the dump is given up once it is set
+ * Output: the number of prefixes written or -1 on failure
+ * NOTE: the file is written under a temporary name and renamed once it is
+ *       complete. The rib tables are read in epoch sections, see epoch.h, and
+ *       the writer sleeps between them to keep to the rate.
+ * -------------------------------------------------------------------------------------*/
+long writeMrtRibDump(const char *path, time_t timestamp, int rate, volatile int *stop);
+
+#endif /*MRTRIBDUMP_H_*/
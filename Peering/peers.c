@@ -361,7 +361,7 @@ int readPeerConf( PConfiguration *conf, char * xpath, int i)
 	 * Read Label Related Settings
 	 ****************************************/
 	// get label action
-	result = getConfigValueFromListAsInt(&labelAction, xpath, XML_LABEL_ACTION, i, 0, 2);
+	result = getConfigValueFromListAsInt(&labelAction, xpath, XML_LABEL_ACTION, i, NoAction, LabelNoDuplicates);
 	if ( result == CONFIG_INVALID_ENTRY ) 
 	{
 		log_warning("Invalid configuration of peer %d label action.", i);
@@ -2297,7 +2297,8 @@ int setPeerLabelAction( int peerID, int labelAction )
 	
 	// if changed ...
 	log_msg("setPeerLabelAction: from %d to %d", Peers[peerID]->configuration->labelAction, labelAction);
-	if( Peers[peerID]->configuration->labelAction == Label || Peers[peerID]->configuration->labelAction == StoreRibOnly )
+	if( Peers[peerID]->configuration->labelAction == Label || Peers[peerID]->configuration->labelAction == StoreRibOnly
+		|| Peers[peerID]->configuration->labelAction == LabelNoDuplicates )
 	{
 		setSessionLabelAction(Peers[peerID]->sessionID, labelAction);
 	}
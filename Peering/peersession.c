@@ -467,6 +467,10 @@ destroySession( int sessionID )
 {
 /* Frees the memory associated with the session.
  * Do not use the sesssion after this operation.
+ * Only the xml module destroys a session, see destroyXMLSession, while no
+ * render worker converts a message of it and nobody holds lockXMLSessions.
+ * Whoever reads a session outside the xml render lanes and the table transfer
+ * workers has to hold lockXMLSessions meanwhile.
  */
   if ( Sessions[sessionID] )
   {
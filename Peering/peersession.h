@@ -262,6 +262,9 @@ int findOrCreateMRTSessionStruct( u_int32_t remoteAS, char *remoteIP, char *coll
  * Purpose:delete a session
  * Input:  sessionID - ID of the session
  * Output: 
+ * NOTE: called by destroyXMLSession only, with the xml session lock held for
+ *       writing. Readers outside the xml render lanes and the table transfer
+ *       workers hold lockXMLSessions while they use a session.
  * He Yan @ July 22, 2008
  * -------------------------------------------------------------------------------------*/
 void 
@@ -30,6 +30,8 @@
 #include "../Queues/queue.h"
 // needed for the transfer type enums 
 #include "periodic.h"
+// needed for MAX_TRANSFER_WORKERS
+#include "../Util/bgpmon_defaults.h"
 
 #ifndef INTERNALPERIODIC_H_
 #define INTERNALPERIODIC_H_
@@ -39,8 +41,13 @@ struct Periodic_struct_st {
 	int StatusMessageInterval;
 	int RouteRefreshInterval;
 	int isRouteRefreshEnabled;
+	int isDeltaTransferEnabled;
 	int CacheExpirationInterval;
 	int CacheEntryLifetime;
+	int TransferMsgRate;
+	int TransferByteRate;
+	float TransferQueueFill;
+	int TransferWorkers;
 	QueueWriter	lableQueueWriter;
 
 	time_t		routeRefreshThreadLastAction;
@@ -49,6 +56,7 @@ struct Periodic_struct_st {
 	pthread_t 	periodicRouteRefreshThread;
 	pthread_t 	periodicStatusThread;
 	pthread_t	periodicCacheExpirationThread;
+	pthread_t	transferThreads[MAX_TRANSFER_WORKERS];
 	int shutdown;
 };
 
@@ -73,13 +81,12 @@ void sendSessionStatusMessage( int sessionID, QueueWriter labeledQueueWriter);
 /*----------------------------------------------------------------------------------------
  * Purpose: do a route refresh for a speficified session
  * Input: 	sessionID - ID of the session 
- *		labeledQueueWriter - the writer of label queue 
- *		time to transfer to each session
+ *		labeledQueueWriter - the writer of label rib queue 
  * Output:
  * He Yan @ Jun 22, 2008
  * Mikhail Strizhov @ July 23, 2010
  * -------------------------------------------------------------------------------------*/
-void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter, int transfer_time ); 
+void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter ); 
 
 /*----------------------------------------------------------------------------------------
  * Purpose: the thread of periodic sending route refresh for all sessions.
@@ -90,6 +97,15 @@ void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter, int transfer
 void *
 periodicRouteRefreshThread( void *arg );
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: the worker thread that sends the rib tables handed out by the
+ *		route refresh thread, one session at a time.
+ * Input:
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+void *
+periodicTransferThread( void *arg );
+
 /*----------------------------------------------------------------------------------------
  * Purpose: the thread of periodic sending status messages for all sessions.
  * Input:
@@ -40,6 +40,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
 //#ifdef TCPMD5
 //#include <linux/tcp.h>
 //#endif
@@ -65,6 +66,21 @@
 
 //#define DEBUG
 
+/* the sessions waiting for a table transfer worker, in the order they were scheduled.
+ * A session is in transferBusy from the time it is queued until its rib is sent,
+ * so it is never queued twice and the queue needs no more than MAX_SESSION_IDS slots */
+static pthread_mutex_t	transferLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	transferReady = PTHREAD_COND_INITIALIZER;
+static int		transferJobs[MAX_SESSION_IDS];
+static int		transferHead = 0;
+static int		transferCount = 0;
+static u_char		transferBusy[MAX_SESSION_IDS];
+/* the sessions closed while in transferBusy, their worker hands them to the rib xml lane */
+static u_char		transferClosed[MAX_SESSION_IDS];
+
+/* the checkpoint of the last table transfer of each session, see sendRibTable */
+static u_int64_t	transferCheckpoints[MAX_SESSION_IDS];
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Initialize the periodic events settings.
  * Input: none
@@ -110,8 +126,38 @@ initPeriodicSettings()
 	else
 		PeriodicEvents.CacheEntryLifetime = CACHE_ENTRY_LIFETIME;
 
+	// default budget of the table transfers
+	if ( TRANSFER_MSG_RATE < 0 || TRANSFER_BYTE_RATE < 0 ) {
+		err = 1;
+		log_warning("Invalid site default for the table transfer rates.");
+		PeriodicEvents.TransferMsgRate = 2000;
+		PeriodicEvents.TransferByteRate = 4000000;
+	}
+	else {
+		PeriodicEvents.TransferMsgRate = TRANSFER_MSG_RATE;
+		PeriodicEvents.TransferByteRate = TRANSFER_BYTE_RATE;
+	}
+
+	if ( (TRANSFER_QUEUE_FILL < 0) || (TRANSFER_QUEUE_FILL > 1) ) {
+		err = 1;
+		log_warning("Invalid site default for the table transfer queue fill.");
+		PeriodicEvents.TransferQueueFill = 0.40;
+	}
+	else
+		PeriodicEvents.TransferQueueFill = TRANSFER_QUEUE_FILL;
+
+	// default number of table transfer workers
+	if ( TRANSFER_WORKERS < 1 || TRANSFER_WORKERS > MAX_TRANSFER_WORKERS ) {
+		err = 1;
+		log_warning("Invalid site default for the number of table transfer workers.");
+		PeriodicEvents.TransferWorkers = 4;
+	}
+	else
+		PeriodicEvents.TransferWorkers = TRANSFER_WORKERS;
+
 	// default transfer type
 	PeriodicEvents.isRouteRefreshEnabled = FALSE;
+	PeriodicEvents.isDeltaTransferEnabled = DELTA_TRANSFER_ENABLED;
 
 	PeriodicEvents.shutdown = FALSE;
 
@@ -134,6 +180,7 @@ readPeriodicSettings()
 	int err = 0; 
 	int result;
 	int num;
+	float fnum;
 
 	// get the interval of sending status messages
 	result = getConfigValueAsInt(&num, XML_PERIODIC_STATUS_INTERVAL_PATH, 0, 65536);
@@ -181,6 +228,76 @@ readPeriodicSettings()
 	debug( __FUNCTION__, "Route refresh is %d.", PeriodicEvents.isRouteRefreshEnabled );
 #endif
 
+	// get the flag indicating whether the periodic transfers only send the changes
+	result = getConfigValueAsInt(&num, XML_PERIODIC_DELTA_TRANSFER_PATH, 0, 1);
+	if (result == CONFIG_VALID_ENTRY) 
+		PeriodicEvents.isDeltaTransferEnabled = num; 
+	else if (result == CONFIG_INVALID_ENTRY) 
+	{
+		err = 1;
+		log_warning("Invalid configuration of the DELTA_TRANSFER.");
+	}
+	else 
+		log_msg("No configuration of the DELTA_TRANSFER, using default.");
+
+#ifdef DEBUG
+	debug( __FUNCTION__, "Delta transfer is %d.", PeriodicEvents.isDeltaTransferEnabled );
+#endif
+
+	// get the message rate budget of the table transfers
+	result = getConfigValueAsInt(&num, XML_PERIODIC_TRANSFER_MSG_RATE_PATH, 0, MAX_TRANSFER_RATE);
+	if (result == CONFIG_VALID_ENTRY) 
+		PeriodicEvents.TransferMsgRate = num; 
+	else if (result == CONFIG_INVALID_ENTRY) 
+	{
+		err = 1;
+		log_warning("Invalid configuration of the table transfer message rate.");
+	}
+	else 
+		log_msg("No configuration of the table transfer message rate, using default.");
+
+	// get the byte rate budget of the table transfers
+	result = getConfigValueAsInt(&num, XML_PERIODIC_TRANSFER_BYTE_RATE_PATH, 0, MAX_TRANSFER_RATE);
+	if (result == CONFIG_VALID_ENTRY) 
+		PeriodicEvents.TransferByteRate = num; 
+	else if (result == CONFIG_INVALID_ENTRY) 
+	{
+		err = 1;
+		log_warning("Invalid configuration of the table transfer byte rate.");
+	}
+	else 
+		log_msg("No configuration of the table transfer byte rate, using default.");
+
+	// get the queue utilization at which table transfers wait
+	result = getConfigValueAsFloat(&fnum, XML_PERIODIC_TRANSFER_QUEUE_FILL_PATH, 0, 1);
+	if (result == CONFIG_VALID_ENTRY) 
+		PeriodicEvents.TransferQueueFill = fnum; 
+	else if (result == CONFIG_INVALID_ENTRY) 
+	{
+		err = 1;
+		log_warning("Invalid configuration of the table transfer queue fill.");
+	}
+	else 
+		log_msg("No configuration of the table transfer queue fill, using default.");
+
+	// get the number of table transfer workers
+	result = getConfigValueAsInt(&num, XML_PERIODIC_TRANSFER_WORKERS_PATH, 1, MAX_TRANSFER_WORKERS);
+	if (result == CONFIG_VALID_ENTRY) 
+		PeriodicEvents.TransferWorkers = num; 
+	else if (result == CONFIG_INVALID_ENTRY) 
+	{
+		err = 1;
+		log_warning("Invalid configuration of the number of table transfer workers.");
+	}
+	else 
+		log_msg("No configuration of the number of table transfer workers, using default.");
+
+#ifdef DEBUG
+	debug( __FUNCTION__, "Table transfer budget %d msgs/s, %d bytes/s, queue fill %f, %d workers.",
+		PeriodicEvents.TransferMsgRate, PeriodicEvents.TransferByteRate, PeriodicEvents.TransferQueueFill,
+		PeriodicEvents.TransferWorkers );
+#endif
+
 
 	return err;
 };
@@ -220,6 +337,32 @@ savePeriodicSettings()
 		log_warning("Failed to save send_route_refresh to config file.");
 	}
 
+	if ( setConfigValueAsInt(XML_DELTA_TRANSFER, PeriodicEvents.isDeltaTransferEnabled) ) {
+		err = 1;
+		log_warning("Failed to save delta_transfer to config file.");
+	}
+
+	// save the table transfer budget
+	if ( setConfigValueAsInt(XML_TRANSFER_MSG_RATE, PeriodicEvents.TransferMsgRate) ) {
+		err = 1;
+		log_warning("Failed to save table transfer message rate to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_TRANSFER_BYTE_RATE, PeriodicEvents.TransferByteRate) ) {
+		err = 1;
+		log_warning("Failed to save table transfer byte rate to config file.");
+	}
+
+	if ( setConfigValueAsFloat(XML_TRANSFER_QUEUE_FILL, PeriodicEvents.TransferQueueFill) ) {
+		err = 1;
+		log_warning("Failed to save table transfer queue fill to config file.");
+	}
+
+	if ( setConfigValueAsInt(XML_TRANSFER_WORKERS, PeriodicEvents.TransferWorkers) ) {
+		err = 1;
+		log_warning("Failed to save number of table transfer workers to config file.");
+	}
+
 	// save queue tag
 	if ( closeConfigElement(XML_PERIODIC_TAG) ) {
 		err = 1;
@@ -239,6 +382,15 @@ savePeriodicSettings()
 void LaunchPeriodicThreads()
 {
 	int error;
+	long i;
+
+	// the route refresh thread hands the rib transfers to the transfer workers
+	for( i = 0; i < PeriodicEvents.TransferWorkers; i++ )
+	{
+		if ((error = pthread_create(&PeriodicEvents.transferThreads[i], NULL, periodicTransferThread, (void *)i)) > 0 )
+			log_fatal("Failed to create table transfer thread %ld: %s\n", i, strerror(error));
+	}
+	debug(__FUNCTION__, "Created %d table transfer threads!", PeriodicEvents.TransferWorkers);
 	
 	pthread_t rrThreadID;
 	if ((error = pthread_create(&rrThreadID, NULL, periodicRouteRefreshThread, NULL)) > 0 )
@@ -368,16 +520,33 @@ void sendMRTStatusMessage( QueueWriter labeledQueueWriter)
 /*----------------------------------------------------------------------------------------
  * Purpose: do a route refresh for a speficified session
  * Input: 	sessionID - ID of the session 
- *		labeledQueueWriter - the writer of label queue 
- *		time to transfer to each session
+ *		labeledQueueWriter - the writer of label rib queue 
  * Output:
+ * NOTE: a session is only handled by one transfer worker at a time, so its
+ *	entry of transferCheckpoints needs no lock.  No table is sent while
+ *	no client reads the rib xml queue.
  * He Yan @ Jun 22, 2008
  * Mikhail Strizhov @ July 23, 2010
  * -------------------------------------------------------------------------------------*/
-void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter, int transfer_time ) 
+void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter ) 
 {
-	// always send the periodic table refresh
-	sendRibTable(sessionID, labeledQueueWriter, transfer_time);
+	u_int64_t since = 0;
+
+	// the table is only sent to the rib clients, without any there is nothing to do;
+	// the next table sent is then a full one, nobody has the changes since the last
+	if( getReaderCount(XML_R_QUEUE_NAME) == 0 )
+	{
+		debug(__FUNCTION__, "No rib clients, table of session %d not sent", sessionID);
+		transferCheckpoints[sessionID] = 0;
+	}
+	// send the periodic table refresh, only the changes since the last one in delta mode
+	else
+	{
+		if( PeriodicEvents.isDeltaTransferEnabled == TRUE )
+			since = transferCheckpoints[sessionID];
+		if( sendRibTable(sessionID, labeledQueueWriter, since, &transferCheckpoints[sessionID]) )
+			transferCheckpoints[sessionID] = 0;
+	}
 
 	if (getSessionUPTime(sessionID) > PeriodicEvents.RouteRefreshInterval )
 	{
@@ -391,10 +560,140 @@ void doRouteRefresh( int sessionID, QueueWriter labeledQueueWriter, int transfer
 	}
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: hand the rib transfer of a session to the table transfer workers
+ * Input:	sessionID - ID of the session 
+ * Output: 0 if the transfer was queued, -1 if the last transfer of the
+ *	session is still queued or running
+ * -------------------------------------------------------------------------------------*/
+static int 
+scheduleRouteRefresh( int sessionID )
+{
+	pthread_mutex_lock(&transferLock);
+	if( transferBusy[sessionID] )
+	{
+		pthread_mutex_unlock(&transferLock);
+		return -1;
+	}
+	transferBusy[sessionID] = TRUE;
+	transferJobs[(transferHead + transferCount) % MAX_SESSION_IDS] = sessionID;
+	transferCount++;
+	pthread_cond_signal(&transferReady);
+	pthread_mutex_unlock(&transferLock);
+	return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: the worker thread that sends the rib tables handed out by the
+ *		route refresh thread, one session at a time.
+ * Input:	the index of the worker
+ * Output:
+ * NOTE: the workers share the global table transfer budget, see transferbudget.h
+ * -------------------------------------------------------------------------------------*/
+void *
+periodicTransferThread( void *arg )
+{
+	long worker = (long)arg;
+	int sessionID, closed;
+	// the tables go through their own queue, so live updates do not wait behind them
+	QueueWriter labeledQueueWriter = createQueueWriter( labeledRibQueue );
+	log_msg( "Table transfer thread %ld started", worker );
+
+	while( PeriodicEvents.shutdown == FALSE )
+	{
+		pthread_mutex_lock(&transferLock);
+		while( transferCount == 0 && PeriodicEvents.shutdown == FALSE )
+			pthread_cond_wait(&transferReady, &transferLock);
+		if( PeriodicEvents.shutdown != FALSE )
+		{
+			pthread_mutex_unlock(&transferLock);
+			break;
+		}
+		sessionID = transferJobs[transferHead];
+		transferHead = (transferHead + 1) % MAX_SESSION_IDS;
+		transferCount--;
+		pthread_mutex_unlock(&transferLock);
+
+		// the session may have gone away while it was waiting for a worker
+		if( Sessions[sessionID] != NULL && isSessionEstablished(sessionID) == TRUE )
+		{
+			doRouteRefresh(sessionID, labeledQueueWriter);
+			log_msg("Done with %d Session", sessionID);
+		}
+
+		pthread_mutex_lock(&transferLock);
+		transferBusy[sessionID] = FALSE;
+		closed = transferClosed[sessionID];
+		transferClosed[sessionID] = FALSE;
+		pthread_mutex_unlock(&transferLock);
+
+		// the session closed while its rib was sent, nothing more is written about it
+		if( closed )
+			writeQueue( labeledQueueWriter, createBMF(sessionID, BMF_TYPE_SESSION_CLOSED) );
+	}
+
+	destroyQueueWriter(labeledQueueWriter);
+	log_warning( "Table transfer thread %ld exiting", worker );
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: hand a closed session to the rib xml lane once no table transfer
+ *		writes about it any more
+ * Input:	sessionID - ID of the closed session 
+ * Output:
+ * NOTE: the rib xml lane destroys the session when it reads the marker, so the
+ *	marker has to follow the last message of a transfer of the session.  While
+ *	a transfer is queued or running, its worker writes the marker once it is done.
+ * -------------------------------------------------------------------------------------*/
+void 
+closeTableTransfer( int sessionID )
+{
+	QueueWriter ribQueueWriter;
+
+	pthread_mutex_lock(&transferLock);
+	if( transferBusy[sessionID] )
+	{
+		transferClosed[sessionID] = TRUE;
+		pthread_mutex_unlock(&transferLock);
+		return;
+	}
+	pthread_mutex_unlock(&transferLock);
+
+	ribQueueWriter = createQueueWriter( labeledRibQueue );
+	writeQueue( ribQueueWriter, createBMF(sessionID, BMF_TYPE_SESSION_CLOSED) );
+	destroyQueueWriter( ribQueueWriter );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: sleep until a point in time, keeping the route refresh thread alive
+ * Input:	wakeup - the time to sleep until
+ * Output: 0 at the wakeup time, -1 if BGPmon is closing
+ * -------------------------------------------------------------------------------------*/
+static int 
+sleepUntilRefreshTime( time_t wakeup )
+{
+	time_t now = time(NULL);
+	while( now < wakeup )
+	{
+		sleep( wakeup - now < THREAD_CHECK_INTERVAL ? wakeup - now : THREAD_CHECK_INTERVAL );
+		// after sleep update thread time
+		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
+		// check if BGPmon is closing
+		if ( PeriodicEvents.shutdown != FALSE )
+			return -1;
+		now = time(NULL);
+	}
+	return 0;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: the thread of periodic sending route refresh for all sessions.
  * Input:
  * Output:
+ * NOTE: the transfers are started evenly over the route refresh interval and
+ *	sent by the table transfer workers, each paced by the global table
+ *	transfer budget, see transferbudget.h
  * He Yan @ Jun 22, 2008
  * -------------------------------------------------------------------------------------*/
 void *
@@ -403,11 +702,11 @@ periodicRouteRefreshThread( void *arg )
 	log_msg( "Periodic route refresh thread started" );
 	PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
 	
-	int i, transferInterval, extraSleepTime, sendsPerInt, extraSends;
+	int i;
 	int actualsends = 0;
 	int establishedSessions[MAX_SESSION_IDS];
 	int establishedSessionCount;
-	QueueWriter labeledQueueWriter = createQueueWriter( labeledQueue );
+	time_t cycleStart;
 	while( PeriodicEvents.shutdown == FALSE )
 	{
 		// reset counter
@@ -439,64 +738,28 @@ periodicRouteRefreshThread( void *arg )
 			continue;
 		}
 		
-		// distribute the route refresh evenly over time in order to prevent the queues being overwhelmed
-		if( PeriodicEvents.RouteRefreshInterval >= establishedSessionCount )
-		{
-			// each RR should take transferInterval seconds
-			transferInterval = PeriodicEvents.RouteRefreshInterval/establishedSessionCount;
-			sendsPerInt = 1;
-			extraSleepTime = PeriodicEvents.RouteRefreshInterval%establishedSessionCount;
-			extraSends = 0;
-		}
-		else
-		{
-			// send multiple RRs every 1s. If x = establishedSessionCount%PeriodicEvents.RouteRefreshInterval and y = establishedSessionCount%PeriodicEvents.RouteRefreshInterval then:
-			// In the first x seconds, y + 1 RRs are sent
-			// In the rest of RouteRefreshInterval, y RRs are sent	
-			transferInterval = 1;
-			sendsPerInt = establishedSessionCount/PeriodicEvents.RouteRefreshInterval;
-			extraSleepTime = 0;
-			extraSends = establishedSessionCount%PeriodicEvents.RouteRefreshInterval;
-		}
-	
 		// start to do route refresh
-		int nextSession = 0;
-		int sends = 0;
-#ifdef DEBUG		
-		log_msg("transferIntervval is %d", transferInterval);
-		log_msg("extraSleepTime is %d", extraSleepTime);
-		log_msg("Number of established sessions %d", establishedSessionCount);
-#endif		
-		while( nextSession < establishedSessionCount )
+		cycleStart = time(NULL);
+		for( i=0; i<establishedSessionCount; i++ )
 		{
-			if( extraSends >0 )
+			int sessionID = establishedSessions[i];
+			if( getSessionRouteRefreshAction(sessionID) != TRUE )
+				continue;
+
+			// distribute the route refresh evenly over time in order to prevent the queues being overwhelmed
+			if( sleepUntilRefreshTime(cycleStart + (time_t)actualsends * PeriodicEvents.RouteRefreshInterval / establishedSessionCount) )
 			{
-				sends = sendsPerInt + 1;
-				extraSends--;
+				log_warning( "Periodic route refresh thread exiting" );
+				return NULL;
 			}
+
+			if( scheduleRouteRefresh(sessionID) == 0 )
+				log_msg( "Session %d route refresh scheduled!", sessionID);
 			else
-				sends = sendsPerInt;
-			
-			for( i=0; i<sends; i++ )
-			{
-				int sessionID = establishedSessions[nextSession];
-				if( getSessionRouteRefreshAction(sessionID) == TRUE )
-				{	
-					log_msg( "Session %d route refresh scheduled!", sessionID);
-					doRouteRefresh(sessionID, labeledQueueWriter, transferInterval);
-					actualsends++;
-					log_msg("Done with %d Session", sessionID);
-				}
-				nextSession++;
-				if ( PeriodicEvents.shutdown != FALSE )
-				{
-					destroyQueueWriter(labeledQueueWriter);
-					log_warning( "Periodic route refresh thread exiting" );
-					return NULL;
-				}
-				PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			}
-		} // end of while loop
+				log_warning( "Session %d is still sending its last rib table, route refresh skipped", sessionID);
+			actualsends++;
+			PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
+		}
 
 		// check if doRouteRefresh was triggered, otherwise sleep
 		if ( actualsends == 0 )
@@ -506,26 +769,15 @@ periodicRouteRefreshThread( void *arg )
 			continue;
 		}
 
-		// sleep(extraSleepTime);
-		int num_of_sleeps = extraSleepTime / THREAD_CHECK_INTERVAL;
-		for (i=0; i < num_of_sleeps; i++) 
+		// the next cycle starts one route refresh interval after this one
+		if( sleepUntilRefreshTime(cycleStart + PeriodicEvents.RouteRefreshInterval) )
 		{
-			sleep(THREAD_CHECK_INTERVAL);
-			// after sleep update thread time
-			PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
-			// check if BGPmon is closing
-			if ( PeriodicEvents.shutdown != FALSE )
-			{
-				destroyQueueWriter(labeledQueueWriter);
-				log_warning( "Periodic route refresh thread exiting" );
-				return NULL;
-			}
+			log_warning( "Periodic route refresh thread exiting" );
+			return NULL;
 		}
-		sleep(extraSleepTime % THREAD_CHECK_INTERVAL);
 		// after sleep update thread time
 		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
 	}	
-	destroyQueueWriter(labeledQueueWriter);
 	log_warning( "periodic route refresh thread exiting" );
 	return NULL;
 }
@@ -719,6 +971,11 @@ time_t getPeriodicStatusMessageThreadLastActionTime()
 void signalPeriodicShutdown()
 {
 	PeriodicEvents.shutdown = TRUE;
+
+	// wake up the idle table transfer workers
+	pthread_mutex_lock(&transferLock);
+	pthread_cond_broadcast(&transferReady);
+	pthread_mutex_unlock(&transferLock);
 }
 
 /*--------------------------------------------------------------------------------------
@@ -730,6 +987,7 @@ void signalPeriodicShutdown()
 void waitForPeriodicShutdown() 
 {
 	void * status = NULL;
+	int i;
 
 	// wait for control thread exit
 	pthread_join(PeriodicEvents.periodicRouteRefreshThread, status);
@@ -738,5 +996,8 @@ void waitForPeriodicShutdown()
 	pthread_join(PeriodicEvents.periodicStatusThread, status);
 
 	pthread_join(PeriodicEvents.periodicCacheExpirationThread, status);
+
+	for( i = 0; i < PeriodicEvents.TransferWorkers; i++ )
+		pthread_join(PeriodicEvents.transferThreads[i], status);
 }
 
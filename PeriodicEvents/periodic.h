@@ -148,6 +148,16 @@ getPeriodicRouteRefreshThreadLastActionTime();
 time_t
 getPeriodicStatusMessageThreadLastActionTime();
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: hand a closed session to the rib xml lane once no table transfer
+ *          writes about it any more
+ * Input:  sessionID - ID of the closed session
+ * Output: none
+ * NOTE: the BMF_TYPE_SESSION_CLOSED marker follows the last message of a running
+ *       or queued transfer of the session in the label rib queue
+ * -------------------------------------------------------------------------------------*/
+void closeTableTransfer( int sessionID );
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Intialize the shutdown process for the periodic module
  * Input:  none
@@ -0,0 +1,166 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: transferbudget.c
+ *  Date: Oct 18, 2026
+ */
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "transferbudget.h"
+#include "internalperiodic.h"
+#include "../Queues/queue.h"
+#include "../Util/log.h"
+#include "../Util/bgpmon_defaults.h"
+
+//#define DEBUG
+
+/* how long a waiting transfer sleeps before it checks again, in nanoseconds */
+#define TRANSFER_WAIT_SLICE 100000000L
+
+/* the token bucket shared by all the table transfers */
+static pthread_mutex_t	budgetLock = PTHREAD_MUTEX_INITIALIZER;
+static double		msgTokens;
+static double		byteTokens;
+static struct timespec	lastRefill;
+static int		budgetStarted = FALSE;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Sleep in short slices, keeping the route refresh thread alive
+ * Input: seconds - how long to sleep
+ * Output: 0 after the sleep, -1 if BGPmon is shutting down
+ * -------------------------------------------------------------------------------------*/
+static int transferSleep( double seconds )
+{
+	struct timespec slice;
+	while( seconds > 0 )
+	{
+		slice.tv_sec = 0;
+		slice.tv_nsec = seconds < 0.1 ? (long)(seconds * 1e9) : TRANSFER_WAIT_SLICE;
+		nanosleep(&slice, NULL);
+		seconds -= 0.1;
+		PeriodicEvents.routeRefreshThreadLastAction = time(NULL);
+		if( PeriodicEvents.shutdown != FALSE )
+			return -1;
+	}
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Add the tokens earned since the last refill, up to one second of tokens
+ * Input: tokens - the tokens left in the bucket
+ *		rate - the tokens earned per second, 0 for no limit
+ *		elapsed - the seconds since the last refill
+ * Output: the new number of tokens
+ * -------------------------------------------------------------------------------------*/
+static double refillTokens( double tokens, int rate, double elapsed )
+{
+	tokens += elapsed * rate;
+	if( tokens > rate )
+		tokens = rate;
+	return tokens;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Charge messages written by a table transfer against the global budget
+ * Input: messages - the number of messages written since the last charge
+ *		bytes - the number of bytes written since the last charge
+ * Output: 0 when the caller may go on, -1 if BGPmon is shutting down
+ * NOTE: may sleep, never call it inside an epoch section
+ * -------------------------------------------------------------------------------------*/
+int chargeTransferBudget( u_int32_t messages, u_int32_t bytes )
+{
+	struct timespec now;
+	double elapsed, wait = 0;
+	int msgRate = PeriodicEvents.TransferMsgRate;
+	int byteRate = PeriodicEvents.TransferByteRate;
+
+	pthread_mutex_lock(&budgetLock);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if( budgetStarted == FALSE )
+	{
+		msgTokens = msgRate;
+		byteTokens = byteRate;
+		budgetStarted = TRUE;
+	}
+	else
+	{
+		elapsed = (now.tv_sec - lastRefill.tv_sec) + (now.tv_nsec - lastRefill.tv_nsec) / 1e9;
+		msgTokens = refillTokens(msgTokens, msgRate, elapsed);
+		byteTokens = refillTokens(byteTokens, byteRate, elapsed);
+	}
+	lastRefill = now;
+
+	// a transfer that overdraws the bucket waits until the debt is paid back,
+	// later transfers see the debt too so the budget stays global
+	if( msgRate > 0 )
+	{
+		msgTokens -= messages;
+		if( msgTokens < 0 )
+			wait = -msgTokens / msgRate;
+	}
+	if( byteRate > 0 )
+	{
+		byteTokens -= bytes;
+		if( byteTokens < 0 && -byteTokens / byteRate > wait )
+			wait = -byteTokens / byteRate;
+	}
+	pthread_mutex_unlock(&budgetLock);
+
+#ifdef DEBUG
+	if( wait > 0 )
+		debug(__FUNCTION__, "table transfer waits %f seconds for the budget", wait);
+#endif
+	return transferSleep(wait);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Check if a queue is above the table transfer utilization
+ * Input: name - the name of the queue
+ * Output: TRUE or FALSE
+ * -------------------------------------------------------------------------------------*/
+static int isTransferQueueFull( char *name )
+{
+	return getItemsUsed(name) > PeriodicEvents.TransferQueueFill * getItemsTotal(name);
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Wait while the queues downstream of the table transfers are above
+ *		the configured utilization
+ * Input: none
+ * Output: 0 when the caller may go on, -1 if BGPmon is shutting down
+ * NOTE: may sleep, never call it inside an epoch section
+ * -------------------------------------------------------------------------------------*/
+int waitForTransferQueues()
+{
+	while( isTransferQueueFull(LABEL_RIB_QUEUE_NAME) || isTransferQueueFull(XML_R_QUEUE_NAME) )
+	{
+		if( transferSleep(0.1) )
+			return -1;
+	}
+	return 0;
+}
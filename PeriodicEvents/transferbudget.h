@@ -0,0 +1,62 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * 
+ *  File: transferbudget.h
+ *  Date: Oct 18, 2026
+ */
+
+#ifndef TRANSFERBUDGET_H_
+#define TRANSFERBUDGET_H_
+
+#include <sys/types.h>
+
+/*----------------------------------------------------------------------------------------
+ * The global budget of the table transfers.
+ * A token bucket in messages and bytes per second that every session sending
+ * its rib draws from, so the transfers together never exceed the configured
+ * rates however many of them run at once. Tokens are charged after the
+ * messages were written and a transfer that overdraws the bucket sleeps the
+ * debt off. The bucket holds at most one second of tokens.
+ * -------------------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Charge messages written by a table transfer against the global budget
+ * Input: messages - the number of messages written since the last charge
+ *		bytes - the number of bytes written since the last charge
+ * Output: 0 when the caller may go on, -1 if BGPmon is shutting down
+ * NOTE: may sleep, never call it inside an epoch section
+ * -------------------------------------------------------------------------------------*/
+int chargeTransferBudget( u_int32_t messages, u_int32_t bytes );
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Wait while the queues downstream of the table transfers are above
+ *		the configured utilization
+ * Input: none
+ * Output: 0 when the caller may go on, -1 if BGPmon is shutting down
+ * NOTE: may sleep, never call it inside an epoch section
+ * -------------------------------------------------------------------------------------*/
+int waitForTransferQueues();
+
+#endif /*TRANSFERBUDGET_H_*/
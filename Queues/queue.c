@@ -51,7 +51,7 @@
 /* needed for copying BGPmon Internal Format messages */
 #include "../Util/bgpmon_formats.h"
 
-/* needed for function getXMLMessageLen */
+/* needed for the xml message structure */
 #include "../XML/xml.h"
 
 /*  needed to lock structures */
@@ -60,6 +60,8 @@
 /* needed for malloc */
 #include <stdlib.h>
 
+/* needed for ntohl */
+#include <netinet/in.h>
 
 //#define DEBUG
 
@@ -842,7 +844,14 @@ void
 copyBMF( void **copy, void *original )
 {
 	BMF bmf = (BMF)original;
-	BMF cpy = malloc( bmf->length + BMF_HEADER_LEN );
+	BMF cpy;
+	// a NULL item only wakes up the readers
+	if ( bmf == NULL )
+	{
+		*copy = NULL;
+		return;
+	}
+	cpy = malloc( bmf->length + BMF_HEADER_LEN );
 	if ( cpy == NULL) 
 		log_fatal( "out of memory: malloc copy of queue item failed");
 		// not reached
@@ -860,6 +869,8 @@ int
 sizeOfBMF( void *msg )
 {
 	BMF bmf = (BMF)msg;
+	if ( bmf == NULL )
+		return 0;
 	return ( bmf->length + BMF_HEADER_LEN );
 }
 
@@ -871,14 +882,11 @@ sizeOfBMF( void *msg )
  * -------------------------------------------------------------------------------------*/
 void copyXML ( void **copy, void *original )
 {
-	//int len = strlen((const char *)original);
-	int len = getXMLMessageLen((char *)original);
-	//u_char *cpy = malloc( (len+1)*sizeof(u_char) );
+	int len = sizeOfXML(original);
 	u_char *cpy = malloc( len*sizeof(u_char) );
 	if ( cpy == NULL) 
 		log_fatal( "out of memory: malloc copy of queue item failed");
 		// not reached
-	//memcpy( cpy, original, len+1 );
 	memcpy( cpy, original, len );
 	*copy = (void *)cpy;
 }
@@ -891,7 +899,36 @@ void copyXML ( void **copy, void *original )
  * -------------------------------------------------------------------------------------*/
 int sizeOfXML ( void *msg )
 {
-	return strlen((const char *)msg);
+	XMLMessage xml = (XMLMessage)msg;
+	return ( sizeof(struct XMLMessageStruct) + xml->length );
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy function for a record of the binary stream
+ * Input: pointer to hold copy and original record
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void copyBMFRecord ( void **copy, void *original )
+{
+	int len = sizeOfBMFRecord(original);
+	u_char *cpy = malloc( len*sizeof(u_char) );
+	if ( cpy == NULL) 
+		log_fatal( "out of memory: malloc copy of queue item failed");
+		// not reached
+	memcpy( cpy, original, len );
+	*copy = (void *)cpy;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get Size of a record of the binary stream
+ * Input: pointer to a record, it starts with the length of the rest of the record
+ * Output: the size in bytes
+ * -------------------------------------------------------------------------------------*/
+int sizeOfBMFRecord ( void *msg )
+{
+	u_int32_t len;
+	memcpy( &len, msg, sizeof(len) );
+	return ( sizeof(len) + ntohl(len) );
 }
 
 /*--------------------------------------------------------------------------------------
@@ -1142,10 +1179,14 @@ Queue getQueueByName(char *name)
 		return peerQueue;
 	if(strcmp(name, LABEL_QUEUE_NAME) == 0)
 		return labeledQueue;
+	if(strcmp(name, LABEL_RIB_QUEUE_NAME) == 0)
+		return labeledRibQueue;
 	if(strcmp(name, XML_U_QUEUE_NAME) == 0)
 		return xmlUQueue;	
 	if(strcmp(name, XML_R_QUEUE_NAME) == 0)
 		return xmlRQueue;
+	if(strcmp(name, BMF_STREAM_QUEUE_NAME) == 0)
+		return bmfStreamQueue;
 	
 	log_warning("Unable to find a queue with name %s", name);
 	return NULL;
@@ -1495,6 +1536,17 @@ int getReaderCount(char *queueName)
 	}
 }
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Return the count of readers of the queue a writer writes to.
+ * Input: the Queue Writer
+ * Output: the number of readers
+ * NOTE: no lock is taken, a reader may come or go right after the check
+ * -------------------------------------------------------------------------------------*/
+int getReaderCountForWriter(QueueWriter writer)
+{
+	return writer->queue->readercount;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Return the count of writers of the queue.
  * Input: the queue name in string
@@ -79,6 +79,12 @@ Queue mrtQueue;
  */
 Queue labeledQueue;
 
+/*Labeled Rib queue, the table transfers, kept apart from the live updates
+ *  Written by: Periodic Events module
+ *  Read by: XML Module
+ */
+Queue labeledRibQueue;
+
 /*XML queue,
  *  Written by: XML Module
  *  Read by: Clients Module
@@ -86,6 +92,12 @@ Queue labeledQueue;
 Queue xmlUQueue;
 Queue xmlRQueue;
 
+/*Binary stream queue, the encoded live messages
+ *  Written by: Clients Module
+ *  Read by: Clients Module, the binary clients
+ */
+Queue bmfStreamQueue;
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Initialize the default queue parameters.
  * Input: none
@@ -201,6 +213,20 @@ void copyXML ( void **copy, void *original );
  * -------------------------------------------------------------------------------------*/
 int sizeOfXML ( void *msg );
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Copy function for a record of the binary stream
+ * Input: pointer to hold copy and original record
+ * Output: none
+ * -------------------------------------------------------------------------------------*/
+void copyBMFRecord ( void **copy, void *original );
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Get Size of a record of the binary stream
+ * Input: pointer to a record
+ * Output: the size in bytes
+ * -------------------------------------------------------------------------------------*/
+int sizeOfBMFRecord ( void *msg );
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Free the queue
  * Input:  the queue to destroy
@@ -465,6 +491,13 @@ long getReaderPosition(char *queueName, int readerIndex);
  * -------------------------------------------------------------------------------------*/
 int getReaderCount(char *queueName);
 
+/*--------------------------------------------------------------------------------------
+ * Purpose: Return the count of readers of the queue a writer writes to.
+ * Input: the Queue Writer
+ * Output: the number of readers
+ * -------------------------------------------------------------------------------------*/
+int getReaderCountForWriter(QueueWriter writer);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Return the count of writers of the queue.
  * Input: the queue name in string
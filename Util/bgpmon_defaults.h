@@ -141,8 +141,11 @@ long bgpmon_start_time;
 #define PEER_QUEUE_NAME "PeerQueue"
 #define MRT_QUEUE_NAME "MrtQueue"
 #define LABEL_QUEUE_NAME "LabelQueue"
+#define LABEL_RIB_QUEUE_NAME "LabelRibQueue"
 #define XML_U_QUEUE_NAME "XMLUQueue"
 #define XML_R_QUEUE_NAME "XMLRQueue"
+#define BMF_STREAM_QUEUE_NAME "BMFStreamQueue"
+#define LABEL_WORKER_QUEUE_NAME "LabelWorkerQueue"
 
 /* PEERING RELATED DEFAULTS  */
 /* MAX_PEER_IDS controls how many peers can be supported over the lifetime
@@ -194,6 +197,34 @@ long bgpmon_start_time;
  * during a BGPmon execution cannot exceed MAX_MRTS_IDS
  */
 #define MAX_MRTS_IDS 500
+
+/* MRT_EXPORT_ENABLED decides if the live messages are archived as BGP4MP
+ * records.  The records are written to a new file every MRT_EXPORT_INTERVAL
+ * seconds, the files start on a multiple of the interval.  The records are
+ * buffered in MRT_EXPORT_BUFFER_LEN bytes and written out each time the label
+ * queue is drained.  The file is synced to disk at most every
+ * MRT_EXPORT_FSYNC_INTERVAL seconds and always when it is closed, 0 syncs
+ * only closed files.
+ */
+#define MRT_EXPORT_ENABLED FALSE
+#define MRT_EXPORT_INTERVAL 900
+#define MIN_MRT_EXPORT_INTERVAL 60
+#define MAX_MRT_EXPORT_INTERVAL 86400
+#define MRT_EXPORT_FSYNC_INTERVAL 60
+#define MAX_MRT_EXPORT_FSYNC_INTERVAL 3600
+#define MRT_EXPORT_BUFFER_LEN 1048576
+/* MRT_RIB_DUMP_ENABLED decides if the rib tables are dumped as TABLE_DUMP_V2
+ * files, whether or not the live messages are archived.  The dumps go to the
+ * directory of the export every MRT_RIB_DUMP_INTERVAL seconds, 0 takes no
+ * dumps.  A dump writes at most MRT_RIB_DUMP_RATE prefixes per second, 0
+ * writes them as fast as the tables can be read.
+ */
+#define MRT_RIB_DUMP_ENABLED FALSE
+#define MRT_RIB_DUMP_INTERVAL 7200
+#define MIN_MRT_RIB_DUMP_INTERVAL 300
+#define MAX_MRT_RIB_DUMP_INTERVAL 86400
+#define MRT_RIB_DUMP_RATE 100000
+#define MAX_MRT_RIB_DUMP_RATE 10000000
 /* GMT_TIME_STAMP decides if GMT timestamp will be generated under the "time" tag or not */
 #define GMT_TIME_STAMP TRUE
 
@@ -204,6 +235,108 @@ long bgpmon_start_time;
 
 /* STORE_RIB_ENABLED decides if store the rib table*/
 #define STORE_RIB_ENABLED TRUE
+
+/* LABEL_WORKER_THREADS is the default number of labeling worker threads.
+ * Each session is always handled by the same worker (sessionID modulo
+ * the number of workers) so updates from one session are labeled in order.
+ * MAX_LABEL_WORKERS bounds the value that can be configured.
+ */
+#define LABEL_WORKER_THREADS 4
+#define MAX_LABEL_WORKERS 64
+
+/* RIB_SNAPSHOT_INTERVAL is how often (in seconds) the rib snapshot thread
+ * writes a snapshot of the rib tables of the sessions. The snapshots are
+ * also written on a clean shutdown and are used to restore the rib of a
+ * session when it is established again after a restart. 0 disables the
+ * periodic snapshots. Snapshots older than RIB_SNAPSHOT_MAX_AGE seconds
+ * are not restored. The prefixes of a restored rib are stale like those of
+ * a kept rib, they are withdrawn at End-of-RIB or after STALE_RIB_TIME, or
+ * RESTORED_RIB_STALE_TIME if STALE_RIB_TIME is 0.
+ */
+#define RIB_SNAPSHOT_INTERVAL 900
+#define MAX_RIB_SNAPSHOT_INTERVAL 86400
+#define RIB_SNAPSHOT_MAX_AGE 3600
+#define RESTORED_RIB_STALE_TIME 300
+
+/* DELTA_JOURNAL_SIZE is the number of withdrawn prefixes each rib keeps so
+ * a table transfer can send only the changes since an earlier checkpoint.
+ * Once more prefixes are withdrawn the oldest are dropped and a transfer
+ * from before them falls back to the full table.  0 disables the journal.
+ */
+#define DELTA_JOURNAL_SIZE 16384
+#define MAX_DELTA_JOURNAL_SIZE 1048576
+
+/* STALE_RIB_TIME is how long (in seconds) the rib of a session that went
+ * down is kept for the session coming back.  The rib is then labeled against
+ * as usual, and the prefixes that were not announced again are withdrawn
+ * once the peer sends End-of-RIB for their family or STALE_RIB_TIME after
+ * the session came back.  A rib whose session does not come back in time is
+ * freed.  0 disables the retention and the rib is freed right away.
+ */
+#define STALE_RIB_TIME 0
+#define MAX_STALE_RIB_TIME 3600
+
+/* RIB_REAPER_BATCH is the number of hash buckets the rib reaper frees
+ * before it updates the retired rib memory and yields the cpu.
+ */
+#define RIB_REAPER_BATCH 256
+
+/* XML RELATED DEFAULTS */
+
+/* XML_RENDER_WORKERS is the default number of threads converting the labeled
+ * messages to xml.  The xml thread numbers the messages as it reads them and
+ * the workers render them in batches of XML_RENDER_BATCH; the messages reach
+ * the xml queues in the order they were numbered.  At most XML_RENDER_RING_SIZE
+ * messages (a power of two) are being converted at a time.
+ * The table transfers have their own queue, xml thread and XML_RIB_RENDER_WORKERS
+ * workers, so the live updates do not wait behind them.
+ */
+#define XML_RENDER_WORKERS 4
+#define XML_RIB_RENDER_WORKERS 2
+#define MAX_XML_RENDER_WORKERS 64
+#define XML_RENDER_BATCH 16
+#define XML_RENDER_RING_SIZE 1024
+
+/* The xml of the attributes a table transfer repeats for every message of an
+ * attribute node is cached in XML_ATTR_CACHE_SETS sets of XML_ATTR_CACHE_WAYS
+ * entries, up to XML_ATTR_CACHE_MAX_BYTES bytes in total.  The least recently
+ * used entries make room for new ones.  The sets are spread over
+ * XML_ATTR_CACHE_LOCKS locks, XML_ATTR_CACHE_SETS must be a multiple of it.
+ */
+#define XML_ATTR_CACHE_SETS 16384
+#define XML_ATTR_CACHE_WAYS 4
+#define XML_ATTR_CACHE_LOCKS 64
+#define XML_ATTR_CACHE_MAX_BYTES (256*1024*1024)
+
+/* TRANSFER_MSG_RATE and TRANSFER_BYTE_RATE are the global budget of the
+ * periodic table transfers, in BGP messages and bytes per second.  The
+ * budget is shared by all the sessions whose rib is being sent at the same
+ * time.  0 removes the limit.
+ * TRANSFER_QUEUE_FILL is the utilization (0 to 1) of the labeled or the xml
+ * rib queue above which table transfers stop until the queue drains.  It is
+ * below QUEUE_PACING_ON_THRESHOLD so transfers back off before live updates
+ * are paced.
+ */
+#define TRANSFER_MSG_RATE 2000
+#define TRANSFER_BYTE_RATE 4000000
+#define MAX_TRANSFER_RATE 1000000000
+#define TRANSFER_QUEUE_FILL 0.40
+
+/* TRANSFER_WORKERS is the default number of threads that send the rib
+ * tables of the periodic route refresh.  Each one sends one session at a
+ * time, so a large rib does not hold up the transfers of the other
+ * sessions.  MAX_TRANSFER_WORKERS bounds the value that can be configured.
+ */
+#define TRANSFER_WORKERS 4
+#define MAX_TRANSFER_WORKERS 32
+
+/* DELTA_TRANSFER_ENABLED decides if the periodic table transfer of a session
+ * only sends the prefixes changed or withdrawn since its last transfer.  The
+ * first transfer of a session and any transfer the rib can not tell the
+ * changes for still send the full table, see DELTA_JOURNAL_SIZE.
+ */
+#define DELTA_TRANSFER_ENABLED FALSE
+
 // CACHE_EXPIRATION_INTERVAL defines how often the entries in the chain/ownership database get checked
 #define CACHE_EXPIRATION_INTERVAL 1200
 // CACHE_ENTRY_LIFETIME defines how long a chain/ownership entry lasts before getting cleared
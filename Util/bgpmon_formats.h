@@ -75,6 +75,10 @@ typedef struct BGPmonInternalMessageFormatStruct *BMF;
 #define BMF_TYPE_MRT_STATUS			277
 #define BMF_TYPE_TABLE_START		267
 #define BMF_TYPE_TABLE_STOP		268
+#define BMF_TYPE_SNAPSHOT_START		278
+#define BMF_TYPE_SNAPSHOT_STOP		279
+/* internal, hands a closed session from the live to the rib xml lane, never rendered */
+#define BMF_TYPE_SESSION_CLOSED		280
 
 /* Create a BMF instance by allocating memory and setting time */
 /* time is set to the current time and is the main purpose of this function */  
@@ -48,6 +48,7 @@
 #include "../PeriodicEvents/periodic.h"
 #include "../Chains/chains.h"
 #include "../Mrt/mrt.h"
+#include "../Mrt/mrtexport.h"
 
 //#define DEBUG
 
@@ -73,6 +74,7 @@ void closeBgpmon(char *config_file)
 	signalLabelShutdown();
 	signalPeriodicShutdown();
 	signalXMLShutdown();
+	signalMrtExportShutdown();
 	signalClientsShutdown();
 
 	// wait for each module to shutdown before proceeding
@@ -90,14 +92,18 @@ void closeBgpmon(char *config_file)
         log_warning("Periodic shutdown complete");
 	waitForXMLShutdown();
         log_warning("XML shutdown complete");
+	waitForMrtExportShutdown();
+        log_warning("MRT export shutdown complete");
 	waitForClientsShutdown();
         log_warning("Client shutdown complete");
 
 	//all modules are shut down; tear down the queues
 	destroyQueue(peerQueue);
 	destroyQueue(labeledQueue);
+	destroyQueue(labeledRibQueue);
 	destroyQueue(xmlRQueue);
 	destroyQueue(xmlUQueue);
+	destroyQueue(bmfStreamQueue);
 	
 	log_warning("BGPmon Exit Successfully!");
 	exit(0);
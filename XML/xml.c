@@ -32,6 +32,9 @@
 /* needed for pthread related functions */
 #include <pthread.h>
 
+/* needed for scanning the length of a message */
+#include <ctype.h>
+
 /* needed for queues*/
 #include "../Queues/queue.h"
 
@@ -69,63 +72,243 @@
 //needed for loop cache
 #include "../Chains/chains.h"
 
+//needed to hand closed sessions to the rib lane
+#include "../PeriodicEvents/periodic.h"
+
+// needed for the xml conversion settings
+#include "../Config/configdefaults.h"
+#include "../Config/configfile.h"
+
 //#define DEBUG
 
-// buffer used to do xml conversion
-static char xml[XML_BUFFER_LEN]; /* XML_BUFFER_LEN defined in xmlinternal.h */
+/* a labeled message between the xml thread and the xml queues */
+struct XMLRenderSlotStruct
+{
+	BMF		bmf;		// the message, freed once it is published
+	u_int32_t	seq;		// its sequence number, assigned when it is read
+	XMLMessage	xml;		// the rendered message, NULL if the conversion failed
+	int		done;		// set once a worker has rendered it
+};
+
+/* a render lane: the thread reading one labeled queue, the workers converting its
+ * messages and their reorder buffer.  The thread adds messages at head, the workers
+ * claim them in batches and the rendered messages are published from tail, in order.
+ * The counters only grow, a message is at ring[counter % XML_RENDER_RING_SIZE] */
+struct XMLRenderLaneStruct
+{
+	char		*name;
+	Queue		*queue;			// the labeled queue the lane reads
+	struct XMLRenderSlotStruct ring[XML_RENDER_RING_SIZE];
+	u_int32_t	head;			// next message read by the lane thread
+	u_int32_t	claim;			// next message claimed by a worker
+	u_int32_t	tail;			// next message to publish
+	int		writing;		// set while a message taken from tail is written
+	u_int32_t	writingSeq;		// its sequence number
+	int		stop;			// set once the workers should exit
+	pthread_mutex_t	ringLock;
+	pthread_cond_t	work;			// messages to claim, or stop
+	pthread_cond_t	space;			// messages published
+	pthread_mutex_t	publishLock;		// held while the rendered messages are written, in order
+	QueueWriter	xmlUQueueWriter;
+	QueueWriter	xmlRQueueWriter;
+	int		numWorkers;
+	pthread_t	workerThreads[MAX_XML_RENDER_WORKERS];
+};
+typedef struct XMLRenderLaneStruct XMLRenderLane;
+
+/* live updates, status and state changes go through the live lane, the table
+ * transfers through the rib lane, so the updates never wait behind a transfer.
+ * Both lanes publish to the xml rib queue, a lane writes a message to it only
+ * once the other lane wrote the messages numbered before it, so the rib clients
+ * get the numbers in increasing order, as the update clients do.
+ * A closed session is destroyed by the rib lane, after its last transfer */
+static XMLRenderLane liveLane = { "live", &labeledQueue, .ringLock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER, .space = PTHREAD_COND_INITIALIZER, .publishLock = PTHREAD_MUTEX_INITIALIZER };
+static XMLRenderLane ribLane = { "rib", &labeledRibQueue, .ringLock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER, .space = PTHREAD_COND_INITIALIZER, .publishLock = PTHREAD_MUTEX_INITIALIZER };
+
+// held while a lane numbers a message, ClientControls.seq_num is the next number given out
+static pthread_mutex_t xmlSeqLock = PTHREAD_MUTEX_INITIALIZER;
+
+// a lane waits on xmlROrderCond for the other one to write its earlier messages
+static pthread_mutex_t xmlROrderLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xmlROrderCond = PTHREAD_COND_INITIALIZER;
+
+// the workers of both lanes read the sessions while they render, a closed session
+// is destroyed with the write lock held
+static pthread_rwlock_t xmlSessionLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Initialize the default xml conversion configuration.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int initXMLSettings()
+{
+	XMLControls.shutdown = FALSE;
+	XMLControls.numWorkers = XML_RENDER_WORKERS;
+	XMLControls.numRibWorkers = XML_RIB_RENDER_WORKERS;
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Read the xml conversion settings from the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int readXMLSettings()
+{
+	int err = 0;
+	int result;
+	int num;
+
+	// get the number of xml render worker threads
+	result = getConfigValueAsInt(&num, XML_CONVERSION_WORKERS_PATH, 1, MAX_XML_RENDER_WORKERS);
+	if (result == CONFIG_VALID_ENTRY)
+		XMLControls.numWorkers = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the number of xml render worker threads.");
+	}
+	else
+		log_msg("No configuration of the number of xml render worker threads, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "XML render worker threads %d.", XMLControls.numWorkers );
+#endif
+
+	// get the number of xml render worker threads of the table transfers
+	result = getConfigValueAsInt(&num, XML_CONVERSION_RIB_WORKERS_PATH, 1, MAX_XML_RENDER_WORKERS);
+	if (result == CONFIG_VALID_ENTRY)
+		XMLControls.numRibWorkers = num;
+	else if (result == CONFIG_INVALID_ENTRY)
+	{
+		err = 1;
+		log_warning("Invalid configuration of the number of xml rib render worker threads.");
+	}
+	else
+		log_msg("No configuration of the number of xml rib render worker threads, using default.");
+#ifdef DEBUG
+	debug( __FUNCTION__, "XML rib render worker threads %d.", XMLControls.numRibWorkers );
+#endif
+
+	return err;
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Save the xml conversion settings to the config file.
+ * Input:  none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int saveXMLSettings()
+{
+	int err = 0;
+
+	// save xml conversion tag
+	if ( openConfigElement(XML_CONVERSION_TAG) ) {
+		err = 1;
+		log_warning("Failed to save xml conversion settings to config file.");
+	}
+
+	// save the number of worker threads
+	if ( setConfigValueAsInt(XML_CONVERSION_WORKERS, XMLControls.numWorkers) ) {
+		err = 1;
+		log_warning("Failed to save xml render worker threads to config file.");
+	}
+	if ( setConfigValueAsInt(XML_CONVERSION_RIB_WORKERS, XMLControls.numRibWorkers) ) {
+		err = 1;
+		log_warning("Failed to save xml rib render worker threads to config file.");
+	}
+
+	// close xml conversion tag
+	if ( closeConfigElement(XML_CONVERSION_TAG) ) {
+		err = 1;
+		log_warning("Failed to save xml conversion settings to config file.");
+	}
+
+	return err;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: find an integer attribute in the open tag of an element
+ * Input:   tag - pointer to the open tag
+ *          end - end of the open tag
+ *          name - name of the attribute
+ *          value - set to the value of the attribute
+ * Output:  0 if the attribute was found, -1 if not
+ * -------------------------------------------------------------------------------------*/
+static int
+findIntAttribute( char *tag, char *end, char *name, int *value )
+{
+    int  n = strlen(name);
+    char *p, *q;
+
+    for ( p = tag; p + 1 + n < end; p++ )
+    {
+        /* the name follows white space and is followed by =, maybe with white space around it */
+        if ( !isspace((u_char)*p) || strncmp(p + 1, name, n) != 0 )
+            continue;
+        q = p + 1 + n;
+        while ( q < end && isspace((u_char)*q) ) q++;
+        if ( q >= end || *q != '=' )
+            continue;
+        q++;
+        while ( q < end && isspace((u_char)*q) ) q++;
+        if ( q >= end || (*q != '"' && *q != '\'') )
+            continue;
+
+        *value = 0;
+        for ( q++; q < end && isdigit((u_char)*q); q++ )
+            *value = *value * 10 + (*q - '0');
+        return 0;
+    }
+    return -1;
+}
 
 /*----------------------------------------------------------------------------------------
  * Purpose: get the length of a XML message,
  *          assuming that there exists a "length" attribute in the root element 
- * Input:   pointer to the XML message or partial XML message
- * Output:  length of the message
+ * Input:   xmlMsg - pointer to the XML message or partial XML message
+ *          size - number of bytes available at xmlMsg
+ * Output:  length of the message, 0 if the root element has no length
+ * NOTE: the open tag of the root element is scanned in place, it has to end within size bytes
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/
-int getXMLMessageLen( char *xmlMsg )
+int getXMLMessageLen( char *xmlMsg, int size )
 {
-    char *p;
-    int  len = 0;
-    int  xmllen = strlen(xmlMsg);
-
-    char * xml_preamble = malloc(sizeof(char) * (xmllen+1));
-    memset(xml_preamble, '\0', xmllen);
-    strncpy(xml_preamble, xmlMsg, xmllen);
-
-    /* 
-     * Find the open tag for the root element and enclose it 
-     * The enclosed element would be in the form <TAG .... length="?" ..../>
-     */
-    p = strtok (xml_preamble,">");
-    if (p)
-    {
-        strcat(p, "/>");
-    }
+    char *end = memchr(xmlMsg, '>', size);
+    int  len  = 0;
 
-    xmlDocPtr  header_doc  = xmlReadMemory(p, strlen(p), "getXMLMessageLen.xml", NULL, 0);
-    xmlNodePtr header_node = xmlDocGetRootElement(header_doc); /* Get the root element node */
+    if ( end == NULL )
+        return 0;
 
-    /* Retrieve the value of "length" attribute */
-    char * len_str = (char *)xmlGetProp(header_node, BAD_CAST "length");
-    if ( len_str == NULL )
+    if ( findIntAttribute(xmlMsg, end, "length", &len) != 0 )
     {
         // In order to be compatible with v5 message
-        len_str = (char *)xmlGetProp(header_node, BAD_CAST "len");
-    }
-
-    /* Convert ascii length to numberic value */
-    if ( len_str != NULL )
-    {
-        len = atoi(len_str);
-	    free(len_str);
+        if ( findIntAttribute(xmlMsg, end, "len", &len) != 0 )
+            len = 0;
     }
-
-    /* Clean up */
-    xmlFreeDoc(header_doc);  /* Free the xml data */
-    free(xml_preamble);
-
     return len;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Create a message for the xml queues
+ * Input:   xml - the xml text
+ *          len - length of the xml text
+ * Output:  the message, the reader frees it
+ * -------------------------------------------------------------------------------------*/
+XMLMessage
+createXMLMessage( const char *xml, int len )
+{
+	XMLMessage msg = malloc(sizeof(struct XMLMessageStruct) + len);
+	if ( msg == NULL )
+		log_fatal( "out of memory: malloc of xml message failed");
+		// not reached
+	msg->length = len;
+	memcpy(msg->text, xml, len);
+	return msg;
+}
+
 /*--------------------------------------------------------------------------------------
  * Purpose: Get the BGPmon ID and sequence number from incoming message
  * Input:	msg - a pointer to the message data
@@ -182,62 +365,93 @@ int getMsgIdSeq(char* msg,int msglen,u_int32_t *id,u_int32_t *seq)
 }
 
 /*----------------------------------------------------------------------------------------
- * Purpose: Entry function of xml thread
- * Input:
+ * Purpose: tell if a lane has not written a message numbered before seq yet
+ * Input:   lane - the render lane
+ *          seq - the sequence number
+ * Output:  TRUE if it has, FALSE if not
+ * NOTE: the numbers wrap around, a message read later always has a higher one
+ * -------------------------------------------------------------------------------------*/
+static int
+hasEarlierUnwritten( XMLRenderLane *lane, u_int32_t seq )
+{
+	int earlier = FALSE;
+
+	pthread_mutex_lock( &lane->ringLock );
+	if( lane->writing )
+		earlier = (int32_t)(lane->writingSeq - seq) < 0;
+	else if( lane->tail != lane->head )
+		earlier = (int32_t)(lane->ring[lane->tail % XML_RENDER_RING_SIZE].seq - seq) < 0;
+	pthread_mutex_unlock( &lane->ringLock );
+	return earlier;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write a message to the xml rib queue, after the earlier ones of the other lane
+ * Input:   lane - the render lane writing it
+ *          seq - its sequence number
+ *          xml - the message
  * Output:
- * He Yan @ Jun 22, 2008
+ * NOTE: the lane holding the lowest unwritten number never waits, so the two lanes
+ *       cannot wait on each other
  * -------------------------------------------------------------------------------------*/
-void * 
-xmlThread( void *arg )
+static void
+writeRibQueueInOrder( XMLRenderLane *lane, u_int32_t seq, XMLMessage xml )
 {
-	log_msg( "XML thread started" );
-	XMLControls.lastAction = time(NULL);
-	XMLControls.shutdown = FALSE;
-	
-	QueueReader labeledQueueReader =  createQueueReader( &labeledQueue, 1 );
-	QueueWriter xmlUQueueWriter = createQueueWriter( xmlUQueue );
-	QueueWriter xmlRQueueWriter = createQueueWriter( xmlRQueue );	
+	XMLRenderLane *other = ( lane == &liveLane ) ? &ribLane : &liveLane;
 
-	while( XMLControls.shutdown==FALSE )
+	pthread_mutex_lock( &xmlROrderLock );
+	while( hasEarlierUnwritten( other, seq ) )
+		pthread_cond_wait( &xmlROrderCond, &xmlROrderLock );
+	pthread_mutex_unlock( &xmlROrderLock );
+
+	writeQueue( lane->xmlRQueueWriter, xml );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the rendered messages at the tail of a lane to the xml queues
+ * Input:   lane - the render lane
+ * Output:
+ * NOTE: stops at the first message that is not rendered yet, the worker rendering
+ *       it publishes it and the ones after it
+ * -------------------------------------------------------------------------------------*/
+static void
+publishRenderedXML( XMLRenderLane *lane )
+{
+	struct XMLRenderSlotStruct slot;
+
+	pthread_mutex_lock( &lane->publishLock );
+	while( 1 )
 	{
-		BMF bmf = NULL;	
-		readQueue( labeledQueueReader);
-                bmf = (BMF)labeledQueueReader->items[0];
-	
-		// update time - make sure thread is alive
-		XMLControls.lastAction = time(NULL);
-	
-        /* Reset xml buffer */
-		xml[0] = '\0';
-		char *xmlp = xml;
-		int  len   = 0;
-
-        /* Convert BMF internal structure to XMl text string */
-		len = BMF2XMLDATA( bmf, xmlp, XML_BUFFER_LEN );
-		if(len > 0)
+		pthread_mutex_lock( &lane->ringLock );
+		if( lane->tail == lane->claim || !lane->ring[lane->tail % XML_RENDER_RING_SIZE].done )
 		{
-			switch ( bmf->type )
+			pthread_mutex_unlock( &lane->ringLock );
+			break;
+		}
+		slot = lane->ring[lane->tail % XML_RENDER_RING_SIZE];
+		lane->ring[lane->tail % XML_RENDER_RING_SIZE].done = FALSE;
+		lane->tail++;
+		lane->writing = TRUE;
+		lane->writingSeq = slot.seq;
+		pthread_cond_broadcast( &lane->space );
+		pthread_mutex_unlock( &lane->ringLock );
+
+		if( slot.xml != NULL )
+		{
+			switch ( slot.bmf->type )
 			{
-				//write out newly-generated messages and increment sequence number
+				//write out newly-generated messages
 				case BMF_TYPE_MSG_TO_PEER:
 				case BMF_TYPE_MSG_LABELED:
 				case BMF_TYPE_MSG_FROM_PEER:
-					{	
-						u_char *xmlData = malloc(len);
-						memcpy(xmlData, xml, len);
-						writeQueue( xmlUQueueWriter, xmlData );
-						break;
-					}
+					writeQueue( lane->xmlUQueueWriter, slot.xml );
+					break;
 				case BMF_TYPE_TABLE_TRANSFER:
 				case BMF_TYPE_TABLE_START:
 				case BMF_TYPE_TABLE_STOP:
 				case BMF_TYPE_FSM_STATE_CHANGE:
-					{
-						u_char *xmlData = malloc(len);
-						memcpy(xmlData, xml, len);
-						writeQueue( xmlRQueueWriter, xmlData );
-						break;
-					}
+					writeRibQueueInOrder( lane, slot.seq, slot.xml );
+					break;
 
 				case BMF_TYPE_CHAINS_STATUS:
 				case BMF_TYPE_QUEUES_STATUS:
@@ -245,68 +459,423 @@ xmlThread( void *arg )
 				case BMF_TYPE_MRT_STATUS:
 				case BMF_TYPE_BGPMON_START:
 				case BMF_TYPE_BGPMON_STOP:
-					{
-						u_char *UxmlData = malloc(len);
-						u_char *RxmlData = malloc(len);
-						memcpy(UxmlData, xml, len);
-						memcpy(RxmlData, xml, len);
-						writeQueue( xmlUQueueWriter, UxmlData );
-						writeQueue( xmlRQueueWriter, RxmlData );
-						break;    	
-					}
+					writeQueue( lane->xmlUQueueWriter, createXMLMessage(slot.xml->text, slot.xml->length) );
+					writeRibQueueInOrder( lane, slot.seq, slot.xml );
+					break;
 
 				default:
 					{
 						log_err ("BMF2XML: unknown type!!!!!!!!!!!!!!!");
+						free( slot.xml );
 						break;
 					}
 
 			}
-			//increment sequence number, wrap around if necessary
-			if(ClientControls.seq_num != UINT_MAX)
-				ClientControls.seq_num++;
-			else ClientControls.seq_num = 0;
 		}
-		
-		/* delete the session structure of closed session */
-		if( bmf->type == BMF_TYPE_FSM_STATE_CHANGE )
+
+		/* Delete bmf structure */
+		destroyBMF( slot.bmf );
+
+		// the other lane may wait for this message to be written
+		pthread_mutex_lock( &lane->ringLock );
+		lane->writing = FALSE;
+		pthread_mutex_unlock( &lane->ringLock );
+		pthread_mutex_lock( &xmlROrderLock );
+		pthread_cond_broadcast( &xmlROrderCond );
+		pthread_mutex_unlock( &xmlROrderLock );
+	}
+	pthread_mutex_unlock( &lane->publishLock );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: tell if any client reads the xml queues a message is published to
+ * Input:   lane - the render lane
+ *          bmf - the message
+ * Output:  TRUE if the message has to be rendered, FALSE if nobody would read it
+ * NOTE: a client connecting right after the check misses the message, as if it
+ *       had connected a moment later
+ * -------------------------------------------------------------------------------------*/
+static int
+hasXMLReaders( XMLRenderLane *lane, BMF bmf )
+{
+	switch ( bmf->type )
+	{
+		case BMF_TYPE_MSG_TO_PEER:
+		case BMF_TYPE_MSG_LABELED:
+		case BMF_TYPE_MSG_FROM_PEER:
+			return getReaderCountForWriter( lane->xmlUQueueWriter ) > 0;
+		case BMF_TYPE_TABLE_TRANSFER:
+		case BMF_TYPE_TABLE_START:
+		case BMF_TYPE_TABLE_STOP:
+		case BMF_TYPE_FSM_STATE_CHANGE:
+			return getReaderCountForWriter( lane->xmlRQueueWriter ) > 0;
+		case BMF_TYPE_CHAINS_STATUS:
+		case BMF_TYPE_QUEUES_STATUS:
+		case BMF_TYPE_SESSION_STATUS:
+		case BMF_TYPE_MRT_STATUS:
+		case BMF_TYPE_BGPMON_START:
+		case BMF_TYPE_BGPMON_STOP:
+			return getReaderCountForWriter( lane->xmlUQueueWriter ) > 0
+				|| getReaderCountForWriter( lane->xmlRQueueWriter ) > 0;
+		default:
+			// left to publishRenderedXML, which reports it
+			return TRUE;
+	}
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of the xml render workers
+ * Input:   arg - the render lane of the worker
+ * Output:
+ * NOTE: a worker claims up to XML_RENDER_BATCH consecutive messages, converts them
+ *       in its own buffer and then publishes whatever is ready at the tail
+ * -------------------------------------------------------------------------------------*/
+void *
+xmlRenderWorker( void *arg )
+{
+	XMLRenderLane *lane = arg;
+	struct XMLRenderSlotStruct *slot;
+	u_int32_t first, count, i;
+	int len;
+
+	char *xml = malloc(XML_BUFFER_LEN); /* XML_BUFFER_LEN defined in xmlinternal.h */
+	if( xml == NULL )
+		log_fatal( "out of memory: malloc of xml render buffer failed");
+
+	while( 1 )
+	{
+		pthread_mutex_lock( &lane->ringLock );
+		while( lane->claim == lane->head && !lane->stop )
+			pthread_cond_wait( &lane->work, &lane->ringLock );
+		if( lane->claim == lane->head )
 		{
-			if( checkStateChangeMessage(bmf) )
-			{
-				destroySession(bmf->sessionID);
-				log_msg( "Successfully destroy the session %d!", bmf->sessionID);
-			}
+			pthread_mutex_unlock( &lane->ringLock );
+			break;
+		}
+		first = lane->claim;
+		count = lane->head - lane->claim;
+		if( count > XML_RENDER_BATCH )
+			count = XML_RENDER_BATCH;
+		lane->claim += count;
+		pthread_mutex_unlock( &lane->ringLock );
+
+		/* Convert BMF internal structure to XMl text string */
+		pthread_rwlock_rdlock( &xmlSessionLock );
+		for( i = 0; i < count; i++ )
+		{
+			slot = &lane->ring[(first + i) % XML_RENDER_RING_SIZE];
+			len = BMF2XMLDATA( slot->bmf, xml, XML_BUFFER_LEN, slot->seq );
+			slot->xml = len > 0 ? createXMLMessage(xml, len) : NULL;
 		}
+		pthread_rwlock_unlock( &xmlSessionLock );
 
-		/* Delete bmf structure */
-		destroyBMF( bmf );
+		pthread_mutex_lock( &lane->ringLock );
+		for( i = 0; i < count; i++ )
+			lane->ring[(first + i) % XML_RENDER_RING_SIZE].done = TRUE;
+		pthread_mutex_unlock( &lane->ringLock );
+
+		publishRenderedXML( lane );
+	}
+	free( xml );
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: number a message and hand it to the render workers of a lane
+ * Input:   lane - the render lane
+ *          bmf - the message, freed once it is published
+ * Output:
+ * NOTE: waits while the ring of the lane is full
+ * -------------------------------------------------------------------------------------*/
+static void
+addRenderSlot( XMLRenderLane *lane, BMF bmf )
+{
+	struct XMLRenderSlotStruct *slot;
+
+	pthread_mutex_lock( &lane->ringLock );
+	while( lane->head - lane->tail == XML_RENDER_RING_SIZE )
+		pthread_cond_wait( &lane->space, &lane->ringLock );
+	slot = &lane->ring[lane->head % XML_RENDER_RING_SIZE];
+	slot->bmf = bmf;
+	slot->xml = NULL;
+	slot->done = FALSE;
+
+	// every message takes a sequence number, wrap around if necessary
+	pthread_mutex_lock( &xmlSeqLock );
+	slot->seq = ClientControls.seq_num;
+	if( ClientControls.seq_num != UINT_MAX )
+		ClientControls.seq_num++;
+	else ClientControls.seq_num = 0;
+	pthread_mutex_unlock( &xmlSeqLock );
+
+	lane->head++;
+	pthread_cond_signal( &lane->work );
+	pthread_mutex_unlock( &lane->ringLock );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: wait until a lane published every message it has read
+ * Input:   lane - the render lane
+ * Output:
+ * -------------------------------------------------------------------------------------*/
+static void
+waitForRenderLane( XMLRenderLane *lane )
+{
+	pthread_mutex_lock( &lane->ringLock );
+	while( lane->tail != lane->head )
+		pthread_cond_wait( &lane->space, &lane->ringLock );
+	pthread_mutex_unlock( &lane->ringLock );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Entry function of xml thread, one for each render lane
+ * Input:   arg - the render lane
+ * Output:
+ * NOTE: the xml thread numbers the labeled messages and hands them to the render workers
+ * He Yan @ Jun 22, 2008
+ * -------------------------------------------------------------------------------------*/
+void * 
+xmlThread( void *arg )
+{
+	XMLRenderLane *lane = arg;
+
+	log_msg( "XML %s thread started", lane->name );
+	XMLControls.lastAction = time(NULL);
+	
+	QueueReader labeledQueueReader =  createQueueReader( lane->queue, 1 );
+	int closed, sessionID, i;
+
+	while( XMLControls.shutdown==FALSE )
+	{
+		BMF bmf = NULL;	
+		readQueue( labeledQueueReader);
+                bmf = (BMF)labeledQueueReader->items[0];
+		// a NULL item is only used to wake up the thread
+		if( bmf == NULL )
+			continue;
+	
+		// update time - make sure thread is alive
+		XMLControls.lastAction = time(NULL);
+
+		// read before the message is handed over, the worker publishing it frees it
+		closed = ( bmf->type == BMF_TYPE_FSM_STATE_CHANGE && checkStateChangeMessage(bmf) );
+		sessionID = bmf->sessionID;
+
+		/* the live lane handed over a closed session, the transfers wrote everything
+		   about it before the marker.  Delete the session structure once those
+		   messages are rendered and no worker is rendering */
+		if( bmf->type == BMF_TYPE_SESSION_CLOSED )
+		{
+			destroyBMF( bmf );
+			waitForRenderLane( lane );
+			destroyXMLSession( sessionID );
+			log_msg( "Successfully destroy the session %d!", sessionID);
+			continue;
+		}
+
+		// render only what a client reads, the rest is dropped without a sequence number
+		if( hasXMLReaders( lane, bmf ) )
+			addRenderSlot( lane, bmf );
+		else
+			destroyBMF( bmf );
+
+		/* a closed session is destroyed by the rib lane, once the messages read
+		   before the state change are rendered here and its transfers are done */
+		if( closed )
+		{
+			waitForRenderLane( lane );
+			closeTableTransfer( sessionID );
+		}
     }
+
+    // let the workers finish what was read and exit
+    pthread_mutex_lock( &lane->ringLock );
+    lane->stop = TRUE;
+    pthread_cond_broadcast( &lane->work );
+    pthread_mutex_unlock( &lane->ringLock );
+    for( i = 0; i < lane->numWorkers; i++ )
+        pthread_join( lane->workerThreads[i], NULL );
+
     destroyQueueReader(labeledQueueReader);
-    destroyQueueWriter(xmlUQueueWriter);
-    destroyQueueWriter(xmlRQueueWriter);
-    log_warning( "XML thread exiting" );
+    destroyQueueWriter(lane->xmlUQueueWriter);
+    destroyQueueWriter(lane->xmlRQueueWriter);
+    log_warning( "XML %s thread exiting", lane->name );
 
     return NULL;
 }
 
-/*--------------------------------------------------------------------------------------
- * Purpose: launch xml converter thread, called by main.c
+/*----------------------------------------------------------------------------------------
+ * Purpose: Convert a message for a single client, outside of the xml queues
+ * Input:   bmf - the message
+ *          len - set to the length of the xml message
+ * Output:  the xml message, the caller frees it, or NULL on failure
+ * NOTE: the message carries the next sequence number, it does not move it on.
+ *       The session of the message is kept while it is converted
+ * -------------------------------------------------------------------------------------*/
+char *
+renderClientXML( BMF bmf, int *len )
+{
+	u_int32_t seq;
+	char *xmlData = malloc(XML_BUFFER_LEN);
+
+	if( xmlData == NULL )
+	{
+		log_err("renderClientXML: malloc failed");
+		return NULL;
+	}
+
+	pthread_mutex_lock( &xmlSeqLock );
+	seq = ClientControls.seq_num;
+	pthread_mutex_unlock( &xmlSeqLock );
+
+	// the rib lane may destroy the session of the message meanwhile
+	pthread_rwlock_rdlock( &xmlSessionLock );
+	*len = BMF2XMLDATA( bmf, xmlData, XML_BUFFER_LEN, seq );
+	pthread_rwlock_unlock( &xmlSessionLock );
+	if( *len <= 0 )
+	{
+		free( xmlData );
+		return NULL;
+	}
+	return xmlData;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Get the sequence number of the next message a lane publishes
+ * Input:   lane - the render lane, its publish lock held
+ * Output:  the number of its oldest unpublished message, or the next number given out
+ * -------------------------------------------------------------------------------------*/
+static u_int32_t
+nextPublishedSeq( XMLRenderLane *lane )
+{
+	u_int32_t seq;
+
+	pthread_mutex_lock( &lane->ringLock );
+	if( lane->tail != lane->head )
+		seq = lane->ring[lane->tail % XML_RENDER_RING_SIZE].seq;
+	else
+	{
+		pthread_mutex_lock( &xmlSeqLock );
+		seq = ClientControls.seq_num;
+		pthread_mutex_unlock( &xmlSeqLock );
+	}
+	pthread_mutex_unlock( &lane->ringLock );
+	return seq;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Create a reader of the xml rib queue for a client
+ * Input:   seq - set to the lowest sequence number of the messages the reader gets
+ * Output:  the reader
+ * NOTE: both lanes write to the xml rib queue, the numbers the reader gets increase
+ *       but are not consecutive, the messages only sent to the update clients have
+ *       numbers too
+ * -------------------------------------------------------------------------------------*/
+QueueReader
+createRibClientReader( u_int32_t *seq )
+{
+	QueueReader reader;
+	u_int32_t liveSeq, ribSeq;
+
+	// no message can be written between creating the reader and reading the numbers
+	pthread_mutex_lock( &liveLane.publishLock );
+	pthread_mutex_lock( &ribLane.publishLock );
+	reader = createQueueReader( &xmlRQueue, 1 );
+	liveSeq = nextPublishedSeq( &liveLane );
+	ribSeq = nextPublishedSeq( &ribLane );
+	pthread_mutex_unlock( &ribLane.publishLock );
+	pthread_mutex_unlock( &liveLane.publishLock );
+
+	// the lower of the two, the numbers wrap around
+	*seq = ( (int32_t)(ribSeq - liveSeq) < 0 ) ? ribSeq : liveSeq;
+	return reader;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Keep the xml thread from deleting closed sessions
  * Input:   none
  * Output:  none
- * He Yan @ July 22, 2008
+ * NOTE: for everyone reading sessions outside the render lanes and the table
+ *       transfer workers: the readers of the label queue that look up the session
+ *       of a message, client snapshots and the rib snapshots.  The session may
+ *       already be gone if they are behind the xml thread, but not while they
+ *       hold the lock
  * -------------------------------------------------------------------------------------*/
-void launchXMLThread()
+void
+lockXMLSessions()
+{
+	pthread_rwlock_rdlock( &xmlSessionLock );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Let the xml thread delete closed sessions again
+ * Input:   none
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+void
+unlockXMLSessions()
+{
+	pthread_rwlock_unlock( &xmlSessionLock );
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Destroy a closed session once nobody reads it
+ * Input:   sessionID - ID of the session
+ * Output:  none
+ * NOTE: waits for the render workers and the holders of lockXMLSessions
+ * -------------------------------------------------------------------------------------*/
+void
+destroyXMLSession( int sessionID )
+{
+	pthread_rwlock_wrlock( &xmlSessionLock );
+	destroySession(sessionID);
+	pthread_rwlock_unlock( &xmlSessionLock );
+}
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: start the thread and the render workers of a lane
+ * Input:   lane - the render lane
+ *          workers - the number of render workers
+ *          thread - set to the thread of the lane
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+static void
+launchRenderLane( XMLRenderLane *lane, int workers, pthread_t *thread )
 {
     int error;
-    
-    pthread_t XMLThreadID;
+    int i;
+
+    lane->xmlUQueueWriter = createQueueWriter( xmlUQueue );
+    lane->xmlRQueueWriter = createQueueWriter( xmlRQueue );
+
+    lane->numWorkers = workers;
+    if( lane->numWorkers < 1 || lane->numWorkers > MAX_XML_RENDER_WORKERS )
+        lane->numWorkers = XML_RENDER_WORKERS;
 
-    if ((error = pthread_create(&XMLThreadID, NULL, xmlThread, NULL)) > 0 )
+    for( i = 0; i < lane->numWorkers; i++ )
+    {
+        if ((error = pthread_create(&lane->workerThreads[i], NULL, xmlRenderWorker, lane)) > 0 )
+            log_fatal("Failed to create XML render worker thread: %s\n", strerror(error));
+    }
+
+    if ((error = pthread_create(thread, NULL, xmlThread, lane)) > 0 )
         log_fatal("Failed to create XML thread: %s\n", strerror(error));
 
-    XMLControls.xmlThread = XMLThreadID;
+    debug(__FUNCTION__, "Created XML %s thread and %d render workers!", lane->name, lane->numWorkers);
+}
 
-    debug(__FUNCTION__, "Created XML thread!");
+/*--------------------------------------------------------------------------------------
+ * Purpose: launch xml converter thread, called by main.c
+ * Input:   none
+ * Output:  none
+ * NOTE: the live updates and the table transfers each get their own xml thread
+ * He Yan @ July 22, 2008
+ * -------------------------------------------------------------------------------------*/
+void launchXMLThread()
+{
+    XMLControls.shutdown = FALSE;
+    launchRenderLane( &liveLane, XMLControls.numWorkers, &XMLControls.xmlThread );
+    launchRenderLane( &ribLane, XMLControls.numRibWorkers, &XMLControls.ribThread );
 }
 
 /*--------------------------------------------------------------------------------------
@@ -332,6 +901,11 @@ void signalXMLShutdown()
 	log_msg("shutdown XML");
 #endif
 	XMLControls.shutdown = TRUE;
+
+	// the rib queue may stay empty, wake its thread up
+	QueueWriter ribQueueWriter = createQueueWriter( labeledRibQueue );
+	writeQueue( ribQueueWriter, NULL );
+	destroyQueueWriter( ribQueueWriter );
 }
 
 /*--------------------------------------------------------------------------------------
@@ -344,7 +918,7 @@ void waitForXMLShutdown()
 {
 	void * status = NULL;
 
-	// wait for xml control thread exit
+	// wait for xml control threads exit
 	pthread_join(XMLControls.xmlThread, status);
+	pthread_join(XMLControls.ribThread, status);
 }
-
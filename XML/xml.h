@@ -32,16 +32,58 @@
 #ifndef XML_H_
 #define XML_H_
 
+/* needed for BMF */
+#include "../Util/bgpmon_formats.h"
+
+/* needed for QueueReader */
+#include "../Queues/queue.h"
+
+/* needed for MAX_XML_RENDER_WORKERS */
+#include "../Util/bgpmon_defaults.h"
+
 /* label thread last action time */
 struct XMLControls_struct_st {
 	time_t		lastAction;
 	pthread_t 	xmlThread;
 	int		    shutdown;
+	pthread_t	ribThread;				// renders the table transfers
+	int		numWorkers;				// number of xml render worker threads
+	int		numRibWorkers;				// number of them for the table transfers
 };
 typedef struct XMLControls_struct_st XMLControls_struct;
 
 XMLControls_struct XMLControls;
 
+/* an xml message as it is passed through the xml queues,
+   the length goes with the text, which is not null terminated */
+struct XMLMessageStruct
+{
+	u_int32_t	length;		// length of the xml text
+	char		text[];		// the xml text
+};
+typedef struct XMLMessageStruct *XMLMessage;
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Initialize the default xml conversion configuration.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int initXMLSettings();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Read the xml conversion settings from the config file.
+ * Input: none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int readXMLSettings();
+
+/*--------------------------------------------------------------------------------------
+ * Purpose: Save the xml conversion settings to the config file.
+ * Input:  none
+ * Output: returns 0 on success, 1 on failure
+ * -------------------------------------------------------------------------------------*/
+int saveXMLSettings();
+
 /*--------------------------------------------------------------------------------------
  * Purpose: launch xml converter thread, called by main.c
  * Input:   none
@@ -52,12 +94,22 @@ void launchXMLThread();
 
 /*----------------------------------------------------------------------------------------
  * Purpose: get the length of a XML message (from the attribute "length")
- * Input:   pointer to the XML message or partial XML message
- * Output:  length of the message
+ * Input:   xmlMsg - pointer to the XML message or partial XML message
+ *          size - number of bytes available at xmlMsg
+ * Output:  length of the message, 0 if the root element has no length
+ * NOTE: only needed for messages read from a chain, the xml queues carry the length
  * He Yan @ Jun 22, 2008
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/
-int getXMLMessageLen(char *xmlMsg);
+int getXMLMessageLen(char *xmlMsg, int size);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Create a message for the xml queues
+ * Input:   xml - the xml text
+ *          len - length of the xml text
+ * Output:  the message, the reader frees it
+ * -------------------------------------------------------------------------------------*/
+XMLMessage createXMLMessage(const char *xml, int len);
 
 /*--------------------------------------------------------------------------------------
  * Purpose: Get the BGPmon ID and sequence number from incoming message
@@ -70,6 +122,43 @@ int getXMLMessageLen(char *xmlMsg);
  *------------------------------------------------------------------------------------*/
 int getMsgIdSeq(char *msg, int msglen,u_int32_t* id,u_int32_t* seq);
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Convert a message for a single client, outside of the xml queues
+ * Input:   bmf - the message
+ *          len - set to the length of the xml message
+ * Output:  the xml message, the caller frees it, or NULL on failure
+ * NOTE: the message carries the next sequence number, it does not move it on
+ * -------------------------------------------------------------------------------------*/
+char *renderClientXML(BMF bmf, int *len);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Create a reader of the xml rib queue for a client
+ * Input:   seq - set to the lowest sequence number of the messages the reader gets
+ * Output:  the reader
+ * -------------------------------------------------------------------------------------*/
+QueueReader createRibClientReader(u_int32_t *seq);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Keep the xml thread from deleting closed sessions while they are read
+ * Input:   none
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+void lockXMLSessions();
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Let the xml thread delete closed sessions again
+ * Input:   none
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+void unlockXMLSessions();
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: Destroy a closed session once nobody reads it
+ * Input:   sessionID - ID of the session
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+void destroyXMLSession(int sessionID);
+
 /*--------------------------------------------------------------------------------------
  * Purpose: get the last action time of the XML thread
  * Input:
@@ -51,6 +51,9 @@
 #include <stdio.h>
 #include <limits.h>
 
+/* needed for the tree lock */
+#include <pthread.h>
+
 /* needed for xml operation tring and math operation */
 #include <libxml/parser.h>
 #include <libxml/tree.h>
@@ -105,6 +108,9 @@ static int  _XML_LEN_DIGITS = 0;     /* Global variable, number of digits for XM
                                         would be calculated by ceil(log10(XML_BUFFER_LEN)) 
                                       */
 
+/* the tree functions share static buffers, so only one thread at a time builds and dumps nodes */
+static pthread_mutex_t xmlTreeLock = PTHREAD_MUTEX_INITIALIZER;
+
 /* for improving perfomance */
 //static xmlNodePtr static_marker_node = NULL;
 
@@ -205,7 +211,7 @@ xmlNewNodeBGPID(char *tag, long long ip)
     buff[0] = '\0';
 
     if (ip > LONG_MAX) { inet_ntop(AF_INET6, &ip, buff, XML_TEMP_BUFFER_LEN); } /* >  4 bytes */
-    else               { inet_ntop(AF_INET,  &ip, buff, XML_TEMP_BUFFER_LEN); } /* <= 4 bytes */
+    else               { buff[xmlEncodeIPv4(buff, (u_char *)&ip)] = '\0'; }  /* <= 4 bytes */
 
     return xmlNewNodeString(tag, buff);
 }
@@ -269,6 +275,27 @@ xmlNewChildNetAddr(xmlNodePtr parent_node, char *tag, u_char *addr, int len)
     return xmlAddChild(parent_node, xmlNewNodeNetAddr(tag, addr, len));
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Return a string representation of a prefix label
+ * input:   label - the label byte appended to the BMF for the prefix
+ * Output:  the human-readable version of the label
+ * -------------------------------------------------------------------------------------*/
+static char *
+getAsciiLabel(int label)
+{
+    switch (label)
+    {
+        case BGPMON_LABEL_NULL:                return "NULL";
+        case BGPMON_LABEL_WITHDRAW:            return "WITH";
+        case BGPMON_LABEL_WITHDRAW_DUPLICATE:  return "DUPW";
+        case BGPMON_LABEL_ANNOUNCE_NEW:        return "NANN";
+        case BGPMON_LABEL_ANNOUNCE_DUPLICATE:  return "DANN";
+        case BGPMON_LABEL_ANNOUNCE_DPATH:      return "DPATH";
+        case BGPMON_LABEL_ANNOUNCE_SPATH:      return "SPATH";
+        default:                               return "UNKNOWN";
+    }
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: add PREFIX child nodes to a xml node
  * input:   parent_node - parent xml node
@@ -289,9 +316,8 @@ xmlNewChildPrefixes(xmlNodePtr parent_node, u_char *prefix, int len, u_int16_t a
 
 	//char *stag = "";
 	int i = 0, l = 0;
-	int bits = 0;
+	int bits = 0, prefix_len;
 	static char prefix_str[XML_TEMP_BUFFER_LEN];
-	static char str[XML_TEMP_BUFFER_LEN];
 	
 	u_int8_t  prefix_value[16];
 
@@ -299,35 +325,19 @@ xmlNewChildPrefixes(xmlNodePtr parent_node, u_char *prefix, int len, u_int16_t a
 	for ( i = 0; i < len; i = i + 1 + l )
 	{
 	        /* Get prefix string */
-	        prefix_str[0] = '\0';
 	        bits = prefix[i];
 	        l = (bits + 7)/8;
 		memset(prefix_value, 0, 16);
 		memcpy(prefix_value, &prefix[i+1], l);	
-		// IPv4 
-		if (afi == 1)
-		{
-			if( inet_ntop(AF_INET, prefix_value, str, ADDR_MAX_CHARS) == NULL )
-			{
-				log_err("xmlNewChildPrefixes, could not convert IPv4 prefix");
-				strcat(prefix_str, "0");
-			}
-		}
-		else // IPv6
-		if (afi == 2)
+		prefix_len = xmlEncodePrefix(prefix_str, afi, prefix_value, bits);
+		if (prefix_len < 0)
 		{
-			if( inet_ntop(AF_INET6, prefix_value, str, ADDR_MAX_CHARS) == NULL )
-			{
-				log_err("xmlNewChildPrefixes, could not convert IPv6 prefix");
-				strcat(prefix_str, "0");
-			}
+			// not IPv4 or IPv6
+			prefix_str[0] = '0';
+			prefix_str[1] = '/';
+			prefix_len = 2 + xmlEncodeInt(prefix_str+2, bits);
 		}
-	        else
-		{
-			strcat(prefix_str, "0");
-		}	
-        	snprintf(prefix_str , XML_TEMP_BUFFER_LEN, "%s", str );
-	        snprintf(prefix_str+strlen(str) , XML_TEMP_BUFFER_LEN, "/%d", bits );
+		prefix_str[prefix_len] = '\0';
 
         	/* generate prefix node */
 	        prefix_node = xmlNewNode(NULL,BAD_CAST "PREFIX");
@@ -338,20 +348,7 @@ xmlNewChildPrefixes(xmlNodePtr parent_node, u_char *prefix, int len, u_int16_t a
 	        {
 			int label = **lt;
 			*lt = *lt + 1;
-			char *label_str;
-
-			switch (label)
-			{
-				case BGPMON_LABEL_NULL:                label_str = "NULL";    break;
-				case BGPMON_LABEL_WITHDRAW:            label_str = "WITH";    break;
-				case BGPMON_LABEL_WITHDRAW_DUPLICATE:  label_str = "DUPW";    break;
-				case BGPMON_LABEL_ANNOUNCE_NEW:        label_str = "NANN";    break;
-				case BGPMON_LABEL_ANNOUNCE_DUPLICATE:  label_str = "DANN";    break;
-				case BGPMON_LABEL_ANNOUNCE_DPATH:      label_str = "DPATH";   break;
-				case BGPMON_LABEL_ANNOUNCE_SPATH:      label_str = "SPATH";   break;
-				default: label_str = "UNKNOWN"; break;
-			}
-			xmlNewProp(prefix_node, BAD_CAST "label", BAD_CAST label_str);
+			xmlNewProp(prefix_node, BAD_CAST "label", BAD_CAST getAsciiLabel(label));
 		}
 		xmlNewChildAFI(prefix_node,  afi);
 		xmlNewChildSAFI(prefix_node, safi);
@@ -943,11 +940,7 @@ genBgpMPReachNode(u_char *attr, int len, u_char **lt)
             for(;i < nhlen;i+=4){
                 memset(ip_value,0,4);
                 memcpy(ip_value,&attr[4+i],4);  //copy IPv4 address to buffer
-	            if( inet_ntop(AF_INET, ip_value, str, ADDR_MAX_CHARS) == NULL )
-	            {
-		            log_err("genBgpMPReachNode, could not convert IPv4 address");
-		            strcat(str, "0");
-	            }
+                str[xmlEncodeIPv4(str, ip_value)] = '\0';
                 xmlNewChildString(nh_node,"ADDRESS", str);
             }
         }
@@ -957,11 +950,7 @@ genBgpMPReachNode(u_char *attr, int len, u_char **lt)
             for(;i < nhlen;i+=16){
                 memset(ip_value,0,16);
                 memcpy(ip_value,&attr[4+i],16);  //copy IPv6 address to buffer
-	            if( inet_ntop(AF_INET6, ip_value, str, ADDR_MAX_CHARS) == NULL )
-	            {
-		            log_err("genBgpMPReachNode, could not convert IPv6 address");
-		            strcat(str, "0");
-	            }
+                str[xmlEncodeIPv6(str, ip_value)] = '\0';
                 xmlNewChildString(nh_node,"ADDRESS", str);
             }
         }
@@ -1582,6 +1571,12 @@ genUpdateAttributesNode(BMF bmf, u_char *attr, int len, u_char **lt )
 
     /* Session specific setting */
     Session_structp sp = getSessionByID(bmf->sessionID);
+    if ( sp == NULL )
+    {
+        /* the session is gone, leave the attributes out */
+        xmlFreeNode(attributes_node);
+        return NULL;
+    }
     int asn_len = sp->fsm.ASNumlen;
 
     /* For each attribute */
@@ -2344,13 +2339,14 @@ genOctetMsgNode(BMF bmf)
 
 /*---------------------------------------------------------------------------------------
  * purpose: generate the BGPMON_SEQ node
+ * input:   seq - the sequence number of the message
  * output:  the new sequence number node
  * Jason Bartlett @ 21 Oct 2010
  *-------------------------------------------------------------------------------------*/
-xmlNodePtr genSequenceNode(){
+xmlNodePtr genSequenceNode(u_int32_t seq){
     xmlNodePtr seq_node = xmlNewNode(NULL, BAD_CAST "BGPMON_SEQ");
     xmlNewPropInt(seq_node,"id",ClientControls.bgpmon_id);
-    xmlNewPropInt(seq_node,"seq_num",ClientControls.seq_num);
+    xmlNewPropInt(seq_node,"seq_num",seq);
 
     return seq_node;
 }
@@ -2442,8 +2438,10 @@ genQueueStatusNode(BMF bmf)
     int count = 0; 
     count++; xmlAddChild(node, genQueueNode(PEER_QUEUE_NAME));
     count++; xmlAddChild(node, genQueueNode(LABEL_QUEUE_NAME));
+    count++; xmlAddChild(node, genQueueNode(LABEL_RIB_QUEUE_NAME));
     count++; xmlAddChild(node, genQueueNode(XML_U_QUEUE_NAME));
     count++; xmlAddChild(node, genQueueNode(XML_R_QUEUE_NAME));
+    count++; xmlAddChild(node, genQueueNode(BMF_STREAM_QUEUE_NAME));
             
     xmlNewPropInt(node, "count", count);
     return node;
@@ -2848,6 +2846,23 @@ genStatusMsgNode(BMF bmf)
     return status_node;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: format a rib generation carried by a TABLE_START or TABLE_STOP message
+ * input:   data - the generation, two 32 bit words in network byte order
+ *          buf - buffer of TABLE_GENERATION_CHARS for the string
+ * Output:  buf, the generation as a decimal string
+ * -------------------------------------------------------------------------------------*/
+#define TABLE_GENERATION_CHARS 24
+static char *
+genTableGeneration(u_char *data, char *buf)
+{
+    u_int32_t word[2];
+
+    memcpy(word, data, sizeof(word));
+    snprintf(buf, TABLE_GENERATION_CHARS, "%llu", ((unsigned long long)ntohl(word[0]) << 32) | ntohl(word[1]));
+    return buf;
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: generate the TABLE_STOP node
  * input:   bmf - our internal BMF message
@@ -2858,6 +2873,7 @@ xmlNodePtr
 genTableStopNode(BMF bmf)
 {
     xmlNodePtr node = NULL;
+    char generation[TABLE_GENERATION_CHARS];
 
     //Creates BGP_MESSAGE node
     node = xmlNewNode(NULL, BAD_CAST "TABLE_STOP_MSG");
@@ -2868,17 +2884,63 @@ genTableStopNode(BMF bmf)
     // Counter 
     xmlNewPropUnsignedInt( node, "counter", counter);
 
+    // checkpoint a client can ask the next delta transfer from
+    if ( bmf->length >= 3*sizeof(u_int32_t) )
+        xmlNewPropString( node, "checkpoint", genTableGeneration(bmf->message + sizeof(u_int32_t), generation) );
+
+    return node;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: generate the TABLE_START node of a delta transfer
+ * input:   bmf - our internal BMF message
+ * Output:  the new xml node, NULL if the transfer sends the full table
+ * -------------------------------------------------------------------------------------*/
+xmlNodePtr
+genTableStartNode(BMF bmf)
+{
+    xmlNodePtr node = NULL;
+    char generation[TABLE_GENERATION_CHARS];
+
+    if ( bmf->length < 2*sizeof(u_int32_t) )
+        return NULL;
+
+    node = xmlNewNode(NULL, BAD_CAST "TABLE_START_MSG");
+    xmlNewPropString( node, "type", "DELTA");
+    xmlNewPropString( node, "since", genTableGeneration(bmf->message, generation) );
+
+    return node;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: generate the SNAPSHOT_STOP node
+ * input:   bmf - our internal BMF message
+ * Output:  the new xml node
+ * -------------------------------------------------------------------------------------*/
+xmlNodePtr
+genSnapshotStopNode(BMF bmf)
+{
+    xmlNodePtr node = NULL;
+    u_int32_t seq;
+
+    node = xmlNewNode(NULL, BAD_CAST "SNAPSHOT_STOP_MSG");
+
+    // sequence number of the first live message after the snapshot
+    memcpy(&seq, bmf->message, sizeof(u_int32_t));
+    xmlNewPropUnsignedInt( node, "live_seq_num", ntohl(seq));
+
     return node;
 }
 
 /*----------------------------------------------------------------------------------------
  * Purpose: generate BGP_MESSAGE node
  * input:   bmf - our internal BMF message
+ *          seq - the sequence number of the message
  * Output:  the new xml node
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/
 xmlNodePtr
-genBgpMessageNodeWithDummyLength(BMF bmf)
+genBgpMessageNodeWithDummyLength(BMF bmf, u_int32_t seq)
 {
     xmlNodePtr bgp_message_node = NULL; /* node pointers */
 
@@ -2901,7 +2963,7 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
         case BMF_TYPE_MSG_FROM_PEER:
         case BMF_TYPE_MSG_LABELED:
         {
-            /* sequence num  */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num  */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time          */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* peering       */ xmlAddChild(bgp_message_node, genPeeringNode(bmf));
             /* ascii message */ xmlAddChild(bgp_message_node, genAsciiMsgNode(bmf));
@@ -2919,7 +2981,7 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
         }
         case BMF_TYPE_TABLE_TRANSFER:
         {
-            /* sequence num  */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num  */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time          */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* peering       */ xmlAddChild(bgp_message_node, genPeeringNode(bmf));
             /* pseudo message*/ xmlAddChild(bgp_message_node, genAsciiMsgNode(bmf));
@@ -2933,9 +2995,12 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
 	/* Table start messages */
 	case BMF_TYPE_TABLE_START:
         {
-            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time           */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* peering       */  xmlAddChild(bgp_message_node, genPeeringNode(bmf));
+            /* delta transfer */ xmlNodePtr start_node = genTableStartNode(bmf);
+            if ( start_node != NULL )
+                xmlAddChild(bgp_message_node, start_node);
             type_str = "TABLE_START";
 
             xmlNewPropInt(bgp_message_node,    "type_value",  bmf->type); /* bgpmon message type value */
@@ -2945,7 +3010,7 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
 	/* Table sttop messages */
 	case BMF_TYPE_TABLE_STOP:
         {
-            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time           */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* peering       */  xmlAddChild(bgp_message_node, genPeeringNode(bmf));
 	    /* stop message  */  xmlAddChild(bgp_message_node, genTableStopNode(bmf));
@@ -2955,10 +3020,28 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
             xmlNewPropString(bgp_message_node, "type",        type_str);  /* bgpmon message type */
             break;
         }
+	/* Snapshot messages, sent to a new rib client only */
+	case BMF_TYPE_SNAPSHOT_START:
+	case BMF_TYPE_SNAPSHOT_STOP:
+        {
+            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
+            /* time           */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
+            if ( bmf->type == BMF_TYPE_SNAPSHOT_STOP )
+            {
+                /* stop message  */ xmlAddChild(bgp_message_node, genSnapshotStopNode(bmf));
+                type_str = "SNAPSHOT_STOP";
+            }
+            else
+                type_str = "SNAPSHOT_START";
+
+            xmlNewPropInt(bgp_message_node,    "type_value",  bmf->type); /* bgpmon message type value */
+            xmlNewPropString(bgp_message_node, "type",        type_str);  /* bgpmon message type */
+            break;
+        }
         /* State change messages */
         case BMF_TYPE_FSM_STATE_CHANGE:
         {
-            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time           */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* peering        */ xmlAddChild(bgp_message_node, genPeeringNode(bmf));
             /* status message */ xmlAddChild(bgp_message_node, genStatusMsgNode(bmf));
@@ -2976,7 +3059,7 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
         case BMF_TYPE_BGPMON_START:
         case BMF_TYPE_BGPMON_STOP:
         {
-            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode());
+            /* sequence num   */ xmlAddChild(bgp_message_node, genSequenceNode(seq));
             /* time           */ xmlAddChild(bgp_message_node, genTimeNode(bmf));
             /* status message */ xmlAddChild(bgp_message_node, genStatusMsgNode(bmf));
             type_str = "STATUS";
@@ -3002,18 +3085,20 @@ genBgpMessageNodeWithDummyLength(BMF bmf)
 /*----------------------------------------------------------------------------------------
  * Purpose: generate BGP_MESSAGE node
  * input:   bmf - our internal BMF message
+ *          xml - set to the xml text of the node
+ *          seq - the sequence number of the message
  * Output:  the new xml node
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/
 xmlNodePtr
-genBgpMessageNodeWithStr(BMF bmf, char* xml)
+genBgpMessageNodeWithStr(BMF bmf, char* xml, u_int32_t seq)
 {
     xmlNodePtr bgp_message_node = NULL; /* node pointers */
 
     /*-------------------------------------------------------
      * Create a BGP_MESSAGE node with dummy length attribute
      *------------------------------------------------------*/
-    bgp_message_node = genBgpMessageNodeWithDummyLength(bmf);
+    bgp_message_node = genBgpMessageNodeWithDummyLength(bmf, seq);
 
     /*-------------------------------------------------------
      * Steps to replace the dummy length attribute
@@ -3053,14 +3138,1109 @@ genBgpMessageNodeWithStr(BMF bmf, char* xml)
 
 
 /*----------------------------------------------------------------------------------------
- * Purpose: entry fucntion which converts all types of BMF messages to XML text representations
+ * Streaming serializer
+ *
+ * Writes the same text as xmlNodeDump of the tree from genBgpMessageNodeWithStr,
+ * but appends it straight to the output buffer instead of building nodes first.
+ * It handles BGP messages and table transfers, which are nearly all of the
+ * traffic. The few parts without a writer of their own (OPEN, NOTIFICATION and
+ * the rarer attributes) are built as a node and dumped in place. Every other
+ * message type goes through the tree.
+ * -------------------------------------------------------------------------------------*/
+
+/* output buffer of the streaming serializer */
+typedef struct
+{
+    char *pos;      /* next byte to write */
+    char *end;      /* end of the buffer, less one byte for the terminating null */
+    int  failed;    /* set once the output did not fit or cannot be streamed */
+} xml_stream_t;
+
+/* true if len more bytes fit, marks the output failed otherwise */
+static inline int
+xsRoom(xml_stream_t *xs, int len)
+{
+    if ( xs->failed || xs->end - xs->pos < len )
+    {
+        xs->failed = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+xsWrite(xml_stream_t *xs, const char *str, int len)
+{
+    if ( !xsRoom(xs, len) )
+        return;
+    memcpy(xs->pos, str, len);
+    xs->pos += len;
+}
+
+static inline void
+xsPut(xml_stream_t *xs, const char *str)
+{
+    xsWrite(xs, str, strlen(str));
+}
+
+static void
+xsUnsigned(xml_stream_t *xs, u_int32_t value)
+{
+    if ( xsRoom(xs, XML_UINT_CHARS) )
+        xs->pos += xmlEncodeUnsigned(xs->pos, value);
+}
+
+static void
+xsInt(xml_stream_t *xs, int value)
+{
+    if ( xsRoom(xs, XML_INT_CHARS) )
+        xs->pos += xmlEncodeInt(xs->pos, value);
+}
+
+/* text content, escaped the way libxml2 escapes it */
+static void
+xsText(xml_stream_t *xs, const char *str)
+{
+    for ( ; *str != '\0'; str++ )
+    {
+        switch ( *str )
+        {
+            case '<':  xsWrite(xs, "&lt;",  4); break;
+            case '>':  xsWrite(xs, "&gt;",  4); break;
+            case '&':  xsWrite(xs, "&amp;", 5); break;
+            case '\r': xsWrite(xs, "&#13;", 5); break;
+            default:
+                /* libxml2 turns non-ascii bytes into character references, leave those to the tree */
+                if ( (u_char)*str >= 0x80 )
+                    xs->failed = TRUE;
+                else
+                    xsWrite(xs, str, 1);
+                break;
+        }
+    }
+}
+
+/* <tag, attributes follow */
+static void
+xsStart(xml_stream_t *xs, const char *tag)
+{
+    xsWrite(xs, "<", 1);
+    xsPut(xs, tag);
+}
+
+/* <tag> */
+static void
+xsOpen(xml_stream_t *xs, const char *tag)
+{
+    xsStart(xs, tag);
+    xsWrite(xs, ">", 1);
+}
+
+/* </tag> */
+static void
+xsClose(xml_stream_t *xs, const char *tag)
+{
+    xsWrite(xs, "</", 2);
+    xsPut(xs, tag);
+    xsWrite(xs, ">", 1);
+}
+
+/* <tag/> */
+static void
+xsEmpty(xml_stream_t *xs, const char *tag)
+{
+    xsStart(xs, tag);
+    xsWrite(xs, "/>", 2);
+}
+
+/* attribute with a constant value, written as is */
+static void
+xsAttr(xml_stream_t *xs, const char *name, const char *value)
+{
+    xsWrite(xs, " ", 1);
+    xsPut(xs, name);
+    xsWrite(xs, "=\"", 2);
+    xsPut(xs, value);
+    xsWrite(xs, "\"", 1);
+}
+
+static void
+xsIntAttr(xml_stream_t *xs, const char *name, int value)
+{
+    xsWrite(xs, " ", 1);
+    xsPut(xs, name);
+    xsWrite(xs, "=\"", 2);
+    xsInt(xs, value);
+    xsWrite(xs, "\"", 1);
+}
+
+static void
+xsUnsignedAttr(xml_stream_t *xs, const char *name, u_int32_t value)
+{
+    xsWrite(xs, " ", 1);
+    xsPut(xs, name);
+    xsWrite(xs, "=\"", 2);
+    xsUnsigned(xs, value);
+    xsWrite(xs, "\"", 1);
+}
+
+static void
+xsTextElement(xml_stream_t *xs, const char *tag, const char *text)
+{
+    xsOpen(xs, tag);
+    xsText(xs, text);
+    xsClose(xs, tag);
+}
+
+static void
+xsIntElement(xml_stream_t *xs, const char *tag, int value)
+{
+    xsOpen(xs, tag);
+    xsInt(xs, value);
+    xsClose(xs, tag);
+}
+
+static void
+xsUnsignedElement(xml_stream_t *xs, const char *tag, u_int32_t value)
+{
+    xsOpen(xs, tag);
+    xsUnsigned(xs, value);
+    xsClose(xs, tag);
+}
+
+static void
+xsIPElement(xml_stream_t *xs, const char *tag, u_int32_t ip)
+{
+    xsOpen(xs, tag);
+    if ( xsRoom(xs, XML_IPV4_CHARS) )
+        xs->pos += xmlEncodeIPv4(xs->pos, (u_char *)&ip);
+    xsClose(xs, tag);
+}
+
+static void
+xsOctetsElement(xml_stream_t *xs, const char *tag, u_char *octets, int len)
+{
+    xsStart(xs, tag);
+    xsIntAttr(xs, "length", len);
+    xsWrite(xs, ">", 1);
+    if ( !xsRoom(xs, 2*len) )
+        return;
+    xs->pos += xmlEncodeOctets(xs->pos, octets, len);
+    xsClose(xs, tag);
+}
+
+/* build a node with one of the gen functions, dump it and free it */
+#define XS_NODE(xs, gen) \
+    do { pthread_mutex_lock(&xmlTreeLock); xsNode((xs), (gen)); pthread_mutex_unlock(&xmlTreeLock); } while (0)
+
+/* dump a node built by one of the gen functions and free it, called through XS_NODE */
+static void
+xsNode(xml_stream_t *xs, xmlNodePtr node)
+{
+    xmlBufferPtr buff;
+
+    if ( node == NULL )
+        return;
+    buff = xmlBufferCreate();
+    xmlNodeDump(buff, NULL, node, 0, 0);
+    xsWrite(xs, (char *)xmlBufferContent(buff), xmlBufferLength(buff));
+    xmlBufferFree(buff);
+    xmlFreeNode(node);
+}
+
+/* streaming counterpart of xmlNewChildAFI */
+static void
+xsAfi(xml_stream_t *xs, int afi)
+{
+    char *afi_str;
+
+    switch(afi)
+    {
+        case BGP_AFI_IPv4:  afi_str = "IPV4";  break;
+        case BGP_AFI_IPv6:  afi_str = "IPV6";  break;
+        default:            afi_str = "OTHER"; break;
+    }
+    xsStart(xs, "AFI");
+    xsIntAttr(xs, "value", afi);
+    xsWrite(xs, ">", 1);
+    xsPut(xs, afi_str);
+    xsClose(xs, "AFI");
+}
+
+/* streaming counterpart of xmlNewChildSAFI */
+static void
+xsSafi(xml_stream_t *xs, int safi)
+{
+    char *safi_str;
+
+    switch(safi)
+    {
+        case BGP_MP_SAFI_UNICAST:    safi_str = "UNICAST";       break;
+        case BGP_MP_SAFI_MULTICAST:  safi_str = "MULTICAST";     break;
+        case BGP_MP_SAFI_MPLS:       safi_str = "MPLS";          break;
+        case BGP_MP_SAFI_ENCAP:      safi_str = "ENCAPSULATION"; break;
+        default:                     safi_str = "OTHER";         break;
+    }
+    xsStart(xs, "SAFI");
+    xsIntAttr(xs, "value", safi);
+    xsWrite(xs, ">", 1);
+    xsPut(xs, safi_str);
+    xsClose(xs, "SAFI");
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: stream a WITHDRAWN or NLRI element with its PREFIX children
+ * input:   xs     - the output
+ *          tag    - WITHDRAWN or NLRI
+ *          prefix - pointer to the first prefix
+ *          len    - length of the prefixes
+ *          afi    - address family of the prefixes
+ *          safi   - sub address family of the prefixes
+ *          lt     - pointer to an array of labels. it could be NULL.
+ * Output:  none, xs is marked failed for prefixes the tree has to convert
+ * -------------------------------------------------------------------------------------*/
+static void
+xsPrefixes(xml_stream_t *xs, const char *tag, u_char *prefix, int len, u_int16_t afi, u_int8_t safi, u_char **lt)
+{
+    u_int8_t value[16];
+    int i, l, bits;
+    int count = 0;
+
+    /* the count goes in the opening tag */
+    for ( i = 0; i < len; i = i + 1 + (prefix[i] + 7)/8 )
+        count++;
+
+    xsStart(xs, tag);
+    xsIntAttr(xs, "count", count);
+    if ( count == 0 )
+    {
+        xsWrite(xs, "/>", 2);
+        return;
+    }
+    xsWrite(xs, ">", 1);
+
+    for ( i = 0; i < len; i = i + 1 + l )
+    {
+        bits = prefix[i];
+        l = (bits + 7)/8;
+        if ( l > sizeof(value) || (afi != BGP_AFI_IPv4 && afi != BGP_AFI_IPv6) )
+        {
+            xs->failed = TRUE;
+            return;
+        }
+        memset(value, 0, sizeof(value));
+        memcpy(value, &prefix[i+1], l);
+
+        xsStart(xs, "PREFIX");
+        if ( *lt != NULL )
+        {
+            xsAttr(xs, "label", getAsciiLabel(**lt));
+            *lt = *lt + 1;
+        }
+        xsWrite(xs, "><ADDRESS>", 10);
+        if ( xsRoom(xs, XML_PREFIX_CHARS) )
+            xs->pos += xmlEncodePrefix(xs->pos, afi, value, bits);
+        xsClose(xs, "ADDRESS");
+        xsAfi(xs, afi);
+        xsSafi(xs, safi);
+        xsClose(xs, "PREFIX");
+    }
+    xsClose(xs, tag);
+}
+
+/* streaming counterpart of genBgpASPathNode and genBgpAS4PathNode */
+static void
+xsASPath(xml_stream_t *xs, const char *tag, u_char *value, int len, int asn_len)
+{
+    u_char *seg;
+    char *type_str;
+    int index, i, l, as;
+
+    if ( len <= 0 )
+    {
+        xsEmpty(xs, tag);
+        return;
+    }
+    xsOpen(xs, tag);
+    for ( index = 0; index < len; index = index + 2 + l*asn_len )
+    {
+        seg = value + index;
+        l   = seg[1];
+        switch ( seg[0] )
+        {
+            case 1:  type_str = "AS_SET";             break;
+            case 2:  type_str = "AS_SEQUENCE";        break;
+            case 3:  type_str = "AS_CONFED_SEQUENCE"; break;
+            case 4:  type_str = "AS_CONFED_SET";      break;
+            default: type_str = "OTHER";              break;
+        }
+        xsStart(xs, "AS_SEG");
+        xsAttr(xs, "type", type_str);
+        xsIntAttr(xs, "length", l);
+        if ( l == 0 )
+        {
+            xsWrite(xs, "/>", 2);
+            continue;
+        }
+        xsWrite(xs, ">", 1);
+        for ( i = 0; i < l; i++ )
+        {
+            if ( asn_len == 4 )
+                as = ntohl(*((u_int32_t *) (seg + 2 + i*4)));
+            else
+                as = ntohs(*((u_int16_t *) (seg + 2 + i*2)));
+            xsIntElement(xs, "AS", as);
+        }
+        xsClose(xs, "AS_SEG");
+    }
+    xsClose(xs, tag);
+}
+
+/* streaming counterpart of genBgpCommunitiesNode */
+static void
+xsCommunities(xml_stream_t *xs, u_char *list, int len)
+{
+    u_int16_t as, val;
+    char *tag;
+    int i;
+
+    if ( len <= 0 )
+    {
+        xsEmpty(xs, "COMMUNITIES");
+        return;
+    }
+    xsOpen(xs, "COMMUNITIES");
+    for ( i = 0; i < len; i = i + 4, list = list + 4 )
+    {
+        as  = ntohs(*((u_int16_t *) list));
+        val = ntohs(*((u_int16_t *) (list+2)));
+
+        if ( as == 0xFFFF && val == 0xFF01 )
+            xsEmpty(xs, "NO_EXPORT");
+        else if ( as == 0xFFFF && val == 0xFF02 )
+            xsEmpty(xs, "NO_ADVERTISE");
+        else if ( as == 0xFFFF && val == 0xFF03 )
+            xsEmpty(xs, "NO_EXPORT_SUBCONFED");
+        else
+        {
+            tag = ( as == 0x0000 || as == 0xFFFF ) ? "RESERVED_COMMUNITY" : "COMMUNITY";
+            xsOpen(xs, tag);
+            xsIntElement(xs, "AS", as);
+            xsIntElement(xs, "VALUE", val);
+            xsClose(xs, tag);
+        }
+    }
+    xsClose(xs, "COMMUNITIES");
+}
+
+/* streaming counterpart of genBgpMPReachNode */
+static void
+xsMPReach(xml_stream_t *xs, u_char *attr, int len, u_char **lt)
+{
+    u_int8_t ip_value[16];
+    u_int16_t afi = ntohs(*((u_int16_t *) attr));
+    u_int8_t safi = attr[2];
+    int nhlen     = attr[3];
+    int i, step;
+
+    xsOpen(xs, "MP_REACH_NLRI");
+    xsAfi(xs, afi);
+    xsSafi(xs, safi);
+    xsIntElement(xs, "NEXT_HOP_LEN", nhlen);
+
+    if ( afi != BGP_AFI_IPv4 && afi != BGP_AFI_IPv6 )
+    {
+        xsOpen(xs, "NEXT_HOP");
+        xsOctetsElement(xs, "OCTETS", attr+4, nhlen);
+        xsClose(xs, "NEXT_HOP");
+    }
+    else if ( nhlen == 0 )
+        xsEmpty(xs, "NEXT_HOP");
+    else
+    {
+        step = (afi == BGP_AFI_IPv4) ? 4 : 16;
+        xsOpen(xs, "NEXT_HOP");
+        for ( i = 0; i < nhlen; i += step )
+        {
+            memset(ip_value, 0, sizeof(ip_value));
+            memcpy(ip_value, &attr[4+i], step);
+            xsOpen(xs, "ADDRESS");
+            if ( xsRoom(xs, XML_IPV6_CHARS) )
+                xs->pos += (afi == BGP_AFI_IPv4) ? xmlEncodeIPv4(xs->pos, ip_value) : xmlEncodeIPv6(xs->pos, ip_value);
+            xsClose(xs, "ADDRESS");
+        }
+        xsClose(xs, "NEXT_HOP");
+    }
+
+    /* 5 = 2B for AFI, 1B for SAFI, 1B for NH_LEN, 1B for SNPA/Reserved 0 */
+    xsPrefixes(xs, "NLRI", attr + 5 + nhlen, len - 5 - nhlen, afi, safi, lt);
+    xsClose(xs, "MP_REACH_NLRI");
+}
+
+/* streaming counterpart of genBgpMPUnreachNode */
+static void
+xsMPUnreach(xml_stream_t *xs, u_char *attr, int len, u_char **lt)
+{
+    u_int16_t afi = ntohs(*((u_int16_t *) attr));
+    u_int8_t safi = attr[2];
+
+    xsOpen(xs, "MP_UNREACH_NLRI");
+    xsAfi(xs, afi);
+    xsSafi(xs, safi);
+    xsPrefixes(xs, "WITHDRAWN", attr+3, len-3, afi, safi, lt);
+    xsClose(xs, "MP_UNREACH_NLRI");
+}
+
+/* <tag> with the raw value as OCTETS, for attributes without a decoder */
+static void
+xsOctetsValue(xml_stream_t *xs, const char *tag, u_char *value, int len)
+{
+    if ( len <= 0 )
+    {
+        xsEmpty(xs, tag);
+        return;
+    }
+    xsOpen(xs, tag);
+    xsOctetsElement(xs, "OCTETS", value, len);
+    xsClose(xs, tag);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Rendered attribute cache
+ * A table transfer sends one message per batch of prefixes sharing an attribute node,
+ * so the same attributes are rendered again and again.  The text of the attributes
+ * in front of the MP attributes (the node's basic attributes and AS_PATH) is kept
+ * here, keyed by their bytes and the AS number length they were decoded with, so
+ * an entry is never stale, only unused.
+ * The cache has XML_ATTR_CACHE_SETS sets of XML_ATTR_CACHE_WAYS entries, the most
+ * recently used first.  A full set gives up its least recently used entry.  The
+ * sets are spread over XML_ATTR_CACHE_LOCKS stripes, each with its own lock and
+ * its share of XML_ATTR_CACHE_MAX_BYTES.  A full stripe goes round its sets with
+ * a clock hand and takes their least recently used entries until the new one fits.
+ * -------------------------------------------------------------------------------------*/
+
+typedef struct XMLAttrFragmentStruct XMLAttrFragment;
+struct XMLAttrFragmentStruct
+{
+    u_int32_t hash;
+    int asNumLen;
+    int keyLen;
+    int textLen;
+    char data[];    /* the attribute bytes, then the text */
+};
+
+typedef struct XMLAttrCacheSetStruct
+{
+    XMLAttrFragment *way[XML_ATTR_CACHE_WAYS];    /* most recently used first */
+} XMLAttrCacheSet;
+
+typedef struct XMLAttrCacheStripeStruct
+{
+    pthread_mutex_t lock;   /* held while one of its sets is read or changed */
+    long bytes;             /* held by the entries of its sets */
+    int hand;               /* the next of its sets to give up an entry */
+} XMLAttrCacheStripe;
+
+/* set i belongs to stripe i % XML_ATTR_CACHE_LOCKS */
+#define XML_ATTR_CACHE_STRIPE_SETS (XML_ATTR_CACHE_SETS / XML_ATTR_CACHE_LOCKS)
+#define XML_ATTR_CACHE_STRIPE_BYTES (XML_ATTR_CACHE_MAX_BYTES / XML_ATTR_CACHE_LOCKS)
+
+static XMLAttrCacheSet xmlAttrCache[XML_ATTR_CACHE_SETS];
+static XMLAttrCacheStripe xmlAttrCacheStripes[XML_ATTR_CACHE_LOCKS];
+static pthread_once_t xmlAttrCacheOnce = PTHREAD_ONCE_INIT;
+
+static void
+initXMLAttrCache(void)
+{
+    int i;
+    for ( i = 0; i < XML_ATTR_CACHE_LOCKS; i++ )
+        pthread_mutex_init(&xmlAttrCacheStripes[i].lock, NULL);
+}
+
+/* FNV-1a, continued from hash so a key can be hashed in pieces */
+static u_int32_t
+xmlAttrHash(u_int32_t hash, u_char *data, int len)
+{
+    int i;
+    for ( i = 0; i < len; i++ )
+    {
+        hash ^= data[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+#define XML_ATTR_HASH_INIT 2166136261U
+
+/* length of the complete attributes in front of the first MP attribute */
+static int
+xsCachedAttrLength(u_char *attr, int len)
+{
+    int i, l;
+    for ( i = 0; i + 3 <= len; i = i + l )
+    {
+        if ( attr[i+1] == BGP_ATTR_MP_REACH_NLRI || attr[i+1] == BGP_ATTR_MP_UNREACH_NLRI )
+            break;
+        if ( (attr[i] & BGP_ATTR_FLAG_EXT_LEN) > 0 )
+        {
+            if ( i + 4 > len )
+                break;
+            l = 4 + ntohs( *((u_int16_t *) (attr+i+2)) );
+        }
+        else
+            l = 3 + attr[i+2];
+        if ( i + l > len )
+            break;
+    }
+    return i;
+}
+
+/* the way of a set holding the attributes, -1 if none does */
+static int
+findAttrFragment(XMLAttrCacheSet *set, u_int32_t hash, u_char *attr, int len, int asNumLen)
+{
+    XMLAttrFragment *f;
+    int w;
+    for ( w = 0; w < XML_ATTR_CACHE_WAYS && (f = set->way[w]) != NULL; w++ )
+    {
+        if ( f->hash == hash && f->keyLen == len && f->asNumLen == asNumLen && memcmp(f->data, attr, len) == 0 )
+            return w;
+    }
+    return -1;
+}
+
+/* free the least recently used entry of a set, 0 if the set was empty */
+static long
+evictAttrFragment(XMLAttrCacheSet *set)
+{
+    XMLAttrFragment *f;
+    long size;
+    int w;
+    for ( w = XML_ATTR_CACHE_WAYS - 1; w >= 0 && set->way[w] == NULL; w-- )
+        ;
+    if ( w < 0 )
+        return 0;
+    f = set->way[w];
+    set->way[w] = NULL;
+    size = sizeof(XMLAttrFragment) + f->keyLen + f->textLen;
+    free(f);
+    return size;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the cached text of the attributes, if there is one
+ * input:   xs       - the output
+ *          attr     - the attributes
+ *          len      - their length
+ *          asNumLen - the AS number length of the session
+ * Output:  0 if the text was written, -1 if the attributes are not cached
+ * NOTE: a hit becomes the most recently used entry of its set
+ * -------------------------------------------------------------------------------------*/
+static int
+xsCachedAttributes(xml_stream_t *xs, u_char *attr, int len, int asNumLen)
+{
+    u_int32_t hash = xmlAttrHash(XML_ATTR_HASH_INIT, attr, len);
+    int set = hash % XML_ATTR_CACHE_SETS;
+    XMLAttrCacheStripe *stripe = &xmlAttrCacheStripes[set % XML_ATTR_CACHE_LOCKS];
+    XMLAttrFragment *f;
+    int w;
+
+    pthread_once(&xmlAttrCacheOnce, initXMLAttrCache);
+    pthread_mutex_lock(&stripe->lock);
+    w = findAttrFragment(&xmlAttrCache[set], hash, attr, len, asNumLen);
+    if ( w < 0 )
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1;
+    }
+    f = xmlAttrCache[set].way[w];
+    memmove(&xmlAttrCache[set].way[1], &xmlAttrCache[set].way[0], w * sizeof(XMLAttrFragment *));
+    xmlAttrCache[set].way[0] = f;
+    xsWrite(xs, f->data + f->keyLen, f->textLen);
+    pthread_mutex_unlock(&stripe->lock);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: keep the text rendered for the attributes
+ * input:   attr     - the attributes
+ *          len      - their length
+ *          asNumLen - the AS number length of the session
+ *          text     - the rendered text
+ *          textLen  - its length
+ * Output:  none
+ * NOTE: makes room by evicting the least recently used entries, see above
+ * -------------------------------------------------------------------------------------*/
+static void
+cacheAttributes(u_char *attr, int len, int asNumLen, char *text, int textLen)
+{
+    u_int32_t hash = xmlAttrHash(XML_ATTR_HASH_INIT, attr, len);
+    int set = hash % XML_ATTR_CACHE_SETS;
+    XMLAttrCacheStripe *stripe = &xmlAttrCacheStripes[set % XML_ATTR_CACHE_LOCKS];
+    long size = sizeof(XMLAttrFragment) + len + textLen;
+    XMLAttrFragment *f;
+
+    if ( size > XML_ATTR_CACHE_STRIPE_BYTES )
+        return;
+    f = malloc(size);
+    if ( f == NULL )
+    {
+        log_warning("cacheAttributes: malloc failed");
+        return;
+    }
+    f->hash = hash;
+    f->asNumLen = asNumLen;
+    f->keyLen = len;
+    f->textLen = textLen;
+    memcpy(f->data, attr, len);
+    memcpy(f->data + len, text, textLen);
+
+    pthread_once(&xmlAttrCacheOnce, initXMLAttrCache);
+    pthread_mutex_lock(&stripe->lock);
+    /* another worker may have rendered the same attributes */
+    if ( findAttrFragment(&xmlAttrCache[set], hash, attr, len, asNumLen) >= 0 )
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        free(f);
+        return;
+    }
+    if ( xmlAttrCache[set].way[XML_ATTR_CACHE_WAYS-1] != NULL )
+        stripe->bytes -= evictAttrFragment(&xmlAttrCache[set]);
+    while ( stripe->bytes + size > XML_ATTR_CACHE_STRIPE_BYTES )
+    {
+        stripe->bytes -= evictAttrFragment(&xmlAttrCache[set % XML_ATTR_CACHE_LOCKS + stripe->hand * XML_ATTR_CACHE_LOCKS]);
+        stripe->hand = (stripe->hand + 1) % XML_ATTR_CACHE_STRIPE_SETS;
+    }
+    memmove(&xmlAttrCache[set].way[1], &xmlAttrCache[set].way[0], (XML_ATTR_CACHE_WAYS-1) * sizeof(XMLAttrFragment *));
+    xmlAttrCache[set].way[0] = f;
+    stripe->bytes += size;
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: stream the PATH_ATTRIBUTES element, see genUpdateAttributesNode
+ * input:   xs   - the output
+ *          bmf  - the message
+ *          attr - pointer to normal attribute
+ *          len  - length of normal attribute
+ *          lt   - pointer to an array of labels. it could be NULL
+ * Output:  none
+ * -------------------------------------------------------------------------------------*/
+static void
+xsAttributes(xml_stream_t *xs, BMF bmf, u_char *attr, int len, u_char **lt)
+{
+    Session_structp sp = getSessionByID(bmf->sessionID);
+    u_char *value;
+    char *atag;
+    int i, hl, l, flags, type;
+    int count = 0;
+    int cached = 0;
+    char *start = NULL;
+
+    if ( sp == NULL )
+    {
+        xs->failed = TRUE;
+        return;
+    }
+
+    /* the count goes in the opening tag */
+    for ( i = 0; i < len; i = i + 2 + hl + l )
+    {
+        if ( (attr[i] & BGP_ATTR_FLAG_EXT_LEN) > 0 )
+        {
+            hl = 2;
+            l = ntohs( *((u_int16_t *) (attr+i+2)) );
+        }
+        else
+        {
+            hl = 1;
+            l = attr[i+2];
+        }
+        count++;
+    }
+
+    xsStart(xs, "PATH_ATTRIBUTES");
+    xsIntAttr(xs, "count", count);
+    if ( count == 0 )
+    {
+        xsWrite(xs, "/>", 2);
+        return;
+    }
+    xsWrite(xs, ">", 1);
+
+    /* a table transfer takes the attributes of its node from the cache */
+    i = 0;
+    if ( bmf->type == BMF_TYPE_TABLE_TRANSFER )
+    {
+        cached = xsCachedAttrLength(attr, len);
+        if ( cached > 0 && xsCachedAttributes(xs, attr, cached, sp->fsm.ASNumlen) == 0 )
+            i = cached;
+        else if ( cached > 0 )
+            start = xs->pos;
+    }
+
+    for ( ; i < len && xs->failed == FALSE; i = i + 2 + hl + l )
+    {
+        if ( start != NULL && i == cached )
+        {
+            cacheAttributes(attr, cached, sp->fsm.ASNumlen, start, xs->pos - start);
+            start = NULL;
+        }
+        flags = attr[i];
+        type  = attr[i+1];
+        if ( (flags & BGP_ATTR_FLAG_EXT_LEN) > 0 )
+        {
+            hl = 2;
+            l = ntohs( *((u_int16_t *) (attr+i+2)) );
+            value = attr+i+4;
+        }
+        else
+        {
+            hl = 1;
+            l = attr[i+2];
+            value = attr+i+3;
+        }
+
+        xsStart(xs, "ATTRIBUTE");
+        xsIntAttr(xs, "length", l);
+        xsWrite(xs, "><FLAGS", 7);
+        if ( (flags & BGP_ATTR_FLAG_OPTIONAL) > 0 ) xsAttr(xs, "optional",   "TRUE");
+        if ( (flags & BGP_ATTR_FLAG_TRANS)    > 0 ) xsAttr(xs, "transitive", "TRUE");
+        if ( (flags & BGP_ATTR_FLAG_PARTIAL)  > 0 ) xsAttr(xs, "partial",    "TRUE");
+        if ( (flags & BGP_ATTR_FLAG_EXT_LEN)  > 0 ) xsAttr(xs, "extended",   "TRUE");
+        xsWrite(xs, "/>", 2);
+
+        switch ( type )
+        {
+            case BGP_ATTR_ORIGIN:           atag = "ORIGIN";                 break;
+            case BGP_ATTR_AS_PATH:          atag = "AS_PATH";                break;
+            case BGP_ATTR_NEXT_HOP:         atag = "NEXT_HOP";               break;
+            case BGP_ATTR_MULTI_EXIT_DISC:  atag = "MULTI_EXIT_DISC";        break;
+            case BGP_ATTR_LOCAL_PREF:       atag = "LOCAL_PREF";             break;
+            case BGP_ATTR_ATOMIC_AGGREGATE: atag = "ATOMIC_AGGREGATE";       break;
+            case BGP_ATTR_AGGREGATOR:       atag = "AGGREGATOR";             break;
+            case BGP_ATTR_COMMUNITIES:      atag = "COMMUNITIES";            break;
+            case BGP_ATTR_ORIGINATOR_ID:    atag = "ORIGINATOR_ID";          break;
+            case BGP_ATTR_CLUSTER_LIST:     atag = "CLUSTER_LIST";           break;
+            case BGP_ATTR_DPA:              atag = "DESTINATION_PREFERENCE"; break;
+            case BGP_ATTR_ADVERTISER:       atag = "ADVERTISER";             break;
+            case BGP_ATTR_RCID_PATH:        atag = "RCID_PATH";              break;
+            case BGP_ATTR_MP_REACH_NLRI:    atag = "MP_REACH_NLRI";          break;
+            case BGP_ATTR_MP_UNREACH_NLRI:  atag = "MP_UNREACH_NLRI";        break;
+            case BGP_ATTR_EXT_COMMUNITIES:  atag = "EXTENDED_COMMUNITIES";   break;
+            case BGP_ATTR_AS4_PATH:         atag = "AS4_PATH";               break;
+            case BGP_ATTR_AS4_AGGREGATOR:   atag = "AS4_AGGREGATOR";         break;
+            case BGP_ATTR_TUNNEL_ENCAP:     atag = "TUNNEL_ENCAPSULATION";   break;
+            case BGP_ATTR_TRAFFIC_ENGR:     atag = "TRAFFIC_ENGINEERING";    break;
+            case BGP_ATTR_IPV6_EXT_COM:     atag = "EXTENDED_COMMUNITIES";   break;
+            default:                        atag = "OTHER";                  break;
+        }
+        xsStart(xs, "TYPE");
+        xsIntAttr(xs, "value", type);
+        xsWrite(xs, ">", 1);
+        xsPut(xs, atag);
+        xsClose(xs, "TYPE");
+
+        switch ( type )
+        {
+            case BGP_ATTR_ORIGIN:
+            {
+                char *otag;
+                switch ( value[0] )
+                {
+                    case BGP_ORIGIN_IGP:        otag = "IGP";        break;
+                    case BGP_ORIGIN_EGP:        otag = "EGP";        break;
+                    case BGP_ORIGIN_INCOMPLETE: otag = "INCOMPLETE"; break;
+                    default:                    otag = "OTHER";      break;
+                }
+                xsStart(xs, "ORIGIN");
+                xsIntAttr(xs, "value", value[0]);
+                xsWrite(xs, ">", 1);
+                xsPut(xs, otag);
+                xsClose(xs, "ORIGIN");
+                break;
+            }
+            case BGP_ATTR_AS_PATH:
+                xsASPath(xs, atag, value, l, sp->fsm.ASNumlen);
+                break;
+            case BGP_ATTR_NEXT_HOP:
+            case BGP_ATTR_ORIGINATOR_ID:
+                xsIPElement(xs, atag, *((u_int32_t *) value));
+                break;
+            case BGP_ATTR_MULTI_EXIT_DISC:
+            case BGP_ATTR_LOCAL_PREF:
+                xsIntElement(xs, atag, ntohl( *((u_int32_t *) value )));
+                break;
+            case BGP_ATTR_ATOMIC_AGGREGATE:
+                xsEmpty(xs, atag);
+                break;
+            case BGP_ATTR_AGGREGATOR:
+                /* same offsets as genUpdateAttributesNode, the output has to match */
+                xsOpen(xs, atag);
+                xsIntElement(xs, "AS", ntohs( *((u_int16_t *) value )));
+                xsIPElement(xs, "ADDR", *((u_int32_t *) value+2 ));
+                xsClose(xs, atag);
+                break;
+            case BGP_ATTR_AS4_AGGREGATOR:
+                xsOpen(xs, atag);
+                xsIntElement(xs, "AS", ntohl( *((u_int32_t *) value )));
+                xsIPElement(xs, "ADDR", *((u_int32_t *) value+4 ));
+                xsClose(xs, atag);
+                break;
+            case BGP_ATTR_COMMUNITIES:
+                xsCommunities(xs, value, l);
+                break;
+            case BGP_ATTR_MP_REACH_NLRI:
+                xsMPReach(xs, value, l, lt);
+                break;
+            case BGP_ATTR_MP_UNREACH_NLRI:
+                xsMPUnreach(xs, value, l, lt);
+                break;
+            case BGP_ATTR_AS4_PATH:
+                xsASPath(xs, atag, value, l, 4);
+                break;
+            case BGP_ATTR_CLUSTER_LIST:
+                XS_NODE(xs, genBgpClusterListNode(value, l));
+                break;
+            case BGP_ATTR_EXT_COMMUNITIES:
+                XS_NODE(xs, genBgpExtCommunitiesNode(value, l));
+                break;
+            case BGP_ATTR_TUNNEL_ENCAP:
+                XS_NODE(xs, genTunnelEncapNode(value, l));
+                break;
+            case BGP_ATTR_TRAFFIC_ENGR:
+                XS_NODE(xs, genTrafficEngineeringNode(value, l));
+                break;
+            case BGP_ATTR_IPV6_EXT_COM:
+                XS_NODE(xs, genIPv6ExtCommunityNode(value, l));
+                break;
+            default:
+                /* DPA, ADVERTISER, RCID_PATH and unknown attributes */
+                xsOctetsValue(xs, atag, value, l);
+                break;
+        }
+        xsClose(xs, "ATTRIBUTE");
+    }
+    if ( start != NULL && i == cached && xs->failed == FALSE )
+        cacheAttributes(attr, cached, sp->fsm.ASNumlen, start, xs->pos - start);
+    xsClose(xs, "PATH_ATTRIBUTES");
+}
+
+/* streaming counterpart of genBgpUpdateNode */
+static void
+xsBgpUpdate(xml_stream_t *xs, BMF bmf)
+{
+    PBgpHeader hdr      = (PBgpHeader)(bmf->message);
+    u_int32_t bgpMsgLen = getBGPHeaderLength(hdr);
+
+    u_char *lt1 = NULL;
+    if ( bmf->type == BMF_TYPE_MSG_LABELED ) lt1 = (u_char *)(bmf->message + bgpMsgLen);
+
+    u_char *update = bmf->message + BGP_HEADER_LEN;
+    int len        = bgpMsgLen   - BGP_HEADER_LEN;
+    int real_len   = bmf->length - BGP_HEADER_LEN; /* In case of prefixes have been truncated */
+
+    int wlen = ntohs( *((u_int16_t *) update)  );           if (wlen > real_len - 4) wlen = real_len - 4; /* prefixes are truncated */
+    int alen = ntohs( *((u_int16_t *) (update+2+wlen)) );
+    int nlen = len - alen - wlen - 4;                       if (nlen > real_len - 4) nlen = real_len - 4; /* prefixes are truncated */
+
+    xsStart(xs, "UPDATE");
+    xsIntAttr(xs, "withdrawn_len", wlen);
+    xsIntAttr(xs, "path_attr_len", alen);
+    xsWrite(xs, ">", 1);
+    xsPrefixes(xs, "WITHDRAWN", update+2, wlen, 1, 1, &lt1);
+    xsAttributes(xs, bmf, update+4+wlen, alen, &lt1);
+    xsPrefixes(xs, "NLRI", update+4+wlen+alen, nlen, 1, 1, &lt1);
+    xsClose(xs, "UPDATE");
+}
+
+/* streaming counterpart of genPeeringNode */
+static void
+xsPeering(xml_stream_t *xs, BMF bmf)
+{
+    Session_structp sp = getSessionByID(bmf->sessionID);
+    long long ip;
+
+    if ( sp == NULL )
+    {
+        xsEmpty(xs, "PEERING");
+        return;
+    }
+
+    xsStart(xs, "PEERING");
+    xsIntAttr(xs, "as_num_len", sp->fsm.ASNumlen);
+    xsWrite(xs, ">", 1);
+
+    xsOpen(xs, "SRC_ADDR");
+    xsTextElement(xs, "ADDRESS", sp->configInUse.remoteAddr);
+    xsAfi(xs, get_afi(sp->configInUse.remoteAddr));
+    xsClose(xs, "SRC_ADDR");
+    xsIntElement(xs, "SRC_PORT", sp->configInUse.remotePort);
+    xsUnsignedElement(xs, "SRC_AS", sp->configInUse.remoteAS2);
+
+    /* use real source address */
+    xsOpen(xs, "DST_ADDR");
+    xsTextElement(xs, "ADDRESS", sp->sessionRealSrcAddr);
+    xsAfi(xs, get_afi(sp->sessionRealSrcAddr));
+    xsClose(xs, "DST_ADDR");
+    xsIntElement(xs, "DST_PORT", sp->configInUse.localPort);
+    xsUnsignedElement(xs, "DST_AS", sp->configInUse.localAS2);
+
+    /* see xmlNewNodeBGPID */
+    ip = sp->configInUse.remoteBGPID;
+    if ( ip > LONG_MAX )
+    {
+        xs->failed = TRUE;
+        return;
+    }
+    xsOpen(xs, "BGPID");
+    if ( xsRoom(xs, XML_IPV4_CHARS) )
+        xs->pos += xmlEncodeIPv4(xs->pos, (u_char *)&ip);
+    xsClose(xs, "BGPID");
+    xsClose(xs, "PEERING");
+}
+
+/* streaming counterpart of genAsciiMsgNode */
+static void
+xsAsciiMsg(xml_stream_t *xs, BMF bmf)
+{
+    PBgpHeader hdr      = (PBgpHeader)(bmf->message);
+    u_int32_t bgpMsgLen = getBGPHeaderLength(hdr);
+
+    if ( bgpMsgLen > 4096 )
+    {
+        log_err("msg len is %d",bgpMsgLen);
+    }
+
+    xsStart(xs, "ASCII_MSG");
+    xsUnsignedAttr(xs, "length", bgpMsgLen);
+    xsWrite(xs, ">", 1);
+    xsOctetsElement(xs, "MARKER", hdr->mask, sizeof(hdr->mask));
+    switch ( hdr->type )
+    {
+        case typeUpdate:        xsBgpUpdate(xs, bmf);                        break;
+        case typeKeepalive:     xsEmpty(xs, "KEEPALIVE");                    break;
+        case typeOpen:          XS_NODE(xs, genBgpOpenNode(bmf));             break;
+        case typeNotification:  XS_NODE(xs, genBgpNotificationNode(bmf));     break;
+        case typeRouteRefresh:  XS_NODE(xs, genBgpRouteRefreshNode(bmf));     break;
+        default:                xsEmpty(xs, "UNKNOWN");                      break;
+    }
+    xsClose(xs, "ASCII_MSG");
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: convert a BGP message or table transfer BMF to XML without building a tree
  * input:   bmf - our internal BMF message
  *          xml - pointer to the buffer used to store the result XML string
  *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
+ * Output:  the length of the XML string, or -1 if the message has to go through
+ *          BMF2XMLTREE, because of its type or because it did not fit
+ * NOTE: the output is the same, byte for byte, as that of BMF2XMLTREE,
+ *       and unlike the tree several threads can stream at the same time
+ * -------------------------------------------------------------------------------------*/
+int BMF2XMLSTREAM(BMF bmf, char *xml, int maxlen, u_int32_t seq)
+{
+    PBgpHeader hdr = (PBgpHeader)(bmf->message);
+    xml_stream_t xs;
+    char format[XML_TEMP_BUFFER_LEN];
+    char length_str[XML_TEMP_BUFFER_LEN];
+    char *length_pos;
+    char *type_str;
+    int  type_value;
+
+    switch ( bmf->type )
+    {
+        case BMF_TYPE_MSG_TO_PEER:
+        case BMF_TYPE_MSG_FROM_PEER:
+        case BMF_TYPE_MSG_LABELED:
+            type_value = hdr->type;
+            type_str   = getAsciiMsgType(hdr->type);
+            break;
+        case BMF_TYPE_TABLE_TRANSFER:
+            type_value = bmf->type;
+            type_str   = "TABLE";
+            break;
+        default:
+            return -1;
+    }
+
+    xs.pos    = xml;
+    xs.end    = xml + maxlen - 1;
+    xs.failed = FALSE;
+
+    /* the length is known only at the end, write the same dummy length as the tree and replace it */
+    xsStart(&xs, "BGP_MESSAGE");
+    xsWrite(&xs, " length=\"", 9);
+    length_pos = xs.pos;
+    xsInt(&xs, XML_BUFFER_LEN);
+    xsWrite(&xs, "\"", 1);
+    xsAttr(&xs, "version", _VERSION);
+    xsAttr(&xs, "xmlns",   _XMLNS);
+    xsIntAttr(&xs, "type_value", type_value);
+    xsAttr(&xs, "type", type_str);
+    xsWrite(&xs, ">", 1);
+
+    /* sequence num */
+    xsStart(&xs, "BGPMON_SEQ");
+    xsIntAttr(&xs, "id",      ClientControls.bgpmon_id);
+    xsIntAttr(&xs, "seq_num", seq);
+    xsWrite(&xs, "/>", 2);
+
+    /* time */
+    xsStart(&xs, "TIME");
+    xsUnsignedAttr(&xs, "timestamp", bmf->timestamp);
+    if (GMT_TIME_STAMP == TRUE)
+    {
+        char gmttime[XML_TEMP_BUFFER_LEN];
+        time_t timestamp = bmf->timestamp;
+        struct tm tm;
+        strftime(gmttime, XML_TEMP_BUFFER_LEN, "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&timestamp, &tm));
+        xsAttr(&xs, "datetime", gmttime);
+    }
+    xsUnsignedAttr(&xs, "precision_time", bmf->precisiontime);
+    xsWrite(&xs, "/>", 2);
+
+    /* peering */
+    xsPeering(&xs, bmf);
+
+    /* ascii message */
+    if (ASCII_MESSAGES == TRUE) xsAsciiMsg(&xs, bmf);
+
+    /* octet message */
+    xsOpen(&xs, "OCTET_MSG");
+    xsOctetsElement(&xs, "OCTETS", bmf->message, getBGPHeaderLength(hdr));
+    xsClose(&xs, "OCTET_MSG");
+
+    xsClose(&xs, "BGP_MESSAGE");
+    if ( xs.failed )
+        return -1;
+    *xs.pos = '\0';
+
+    /* Replace the dummy length, as genBgpMessageNodeWithStr does */
+    if (_XML_LEN_DIGITS == 0)
+        _XML_LEN_DIGITS = ceil(log10(XML_BUFFER_LEN));
+    sprintf(format, "%s%d.%dd", "%", _XML_LEN_DIGITS, _XML_LEN_DIGITS);
+    sprintf(length_str, format, (int)(xs.pos - xml));
+    memcpy(length_pos, length_str, strlen(length_str));
+
+    return xs.pos - xml;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: convert any type of BMF message to XML by building and dumping an xml tree
+ * input:   bmf - our internal BMF message
+ *          xml - pointer to the buffer used to store the result XML string
+ *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
+ * NOTE: one message at a time goes through the tree, the others wait on the tree lock
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/
-int BMF2XMLDATA(BMF bmf, char *xml, int maxlen)
+int BMF2XMLTREE(BMF bmf, char *xml, int maxlen, u_int32_t seq)
 {
+    int len;
+
+    pthread_mutex_lock(&xmlTreeLock);
     xmlInitParser();
 
     xmlDocPtr  doc              = NULL;  /* document pointer */
@@ -3070,7 +4250,7 @@ int BMF2XMLDATA(BMF bmf, char *xml, int maxlen)
      * Implementation:
      *------------------------------------------------------*/
     doc = xmlNewDoc(BAD_CAST "1.0");
-    bgp_message_node = genBgpMessageNodeWithStr(bmf, xml);
+    bgp_message_node = genBgpMessageNodeWithStr(bmf, xml, seq);
     xmlDocSetRootElement(doc, bgp_message_node);
     strcpy(_XML, xml);
 
@@ -3078,8 +4258,30 @@ int BMF2XMLDATA(BMF bmf, char *xml, int maxlen)
      * Clean up
      *------------------------------------------------------*/
     xmlFreeDoc(doc);      /* Free the xml document */
+    len = strlen(xml);
+    pthread_mutex_unlock(&xmlTreeLock);
+
+    return len;
+}
+
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: entry fucntion which converts all types of BMF messages to XML text representations
+ * input:   bmf - our internal BMF message
+ *          xml - pointer to the buffer used to store the result XML string
+ *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
+ * Output:  the length of the XML string
+ * NOTE: BGP messages are streamed, the rest is converted through the xml tree
+ * Pei-chun Cheng @ Dec 20, 2008
+ * -------------------------------------------------------------------------------------*/
+int BMF2XMLDATA(BMF bmf, char *xml, int maxlen, u_int32_t seq)
+{
+    int len = BMF2XMLSTREAM(bmf, xml, maxlen, seq);
 
-    return strlen(xml);
+    if ( len < 0 )
+        len = BMF2XMLTREE(bmf, xml, maxlen, seq);
+    return len;
 }
 
 
@@ -41,10 +41,31 @@
  * input:   bmf - our internal BMF message
  *          xml - pointer to the buffer used for conversion
  *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
  * output:  the length of generated xml string
  * Pei-chun Cheng @ Dec 20, 2008
  * -------------------------------------------------------------------------------------*/ 
-int BMF2XMLDATA(BMF bmf, char *xml, int maxlen);
+int BMF2XMLDATA(BMF bmf, char *xml, int maxlen, u_int32_t seq);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: convert a BGP message or table transfer BMF to XML without building a tree
+ * input:   bmf - our internal BMF message
+ *          xml - pointer to the buffer used for conversion
+ *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
+ * output:  the length of generated xml string, or -1 if the message needs BMF2XMLTREE
+ * -------------------------------------------------------------------------------------*/
+int BMF2XMLSTREAM(BMF bmf, char *xml, int maxlen, u_int32_t seq);
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: convert any type of BMF message to XML through a libxml2 tree
+ * input:   bmf - our internal BMF message
+ *          xml - pointer to the buffer used for conversion
+ *          maxlen - max length of the buffer
+ *          seq - the sequence number of the message
+ * output:  the length of generated xml string
+ * -------------------------------------------------------------------------------------*/
+int BMF2XMLTREE(BMF bmf, char *xml, int maxlen, u_int32_t seq);
 
 #endif /*XMLDATA_H_*/
 
@@ -0,0 +1,437 @@
+/* 
+ * 	Copyright (c) 2010 Colorado State University
+ * 
+ *	Permission is hereby granted, free of charge, to any person
+ *	obtaining a copy of this software and associated documentation
+ *	files (the "Software"), to deal in the Software without
+ *	restriction, including without limitation the rights to use,
+ *	copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom
+ *	the Software is furnished to do so, subject to the following
+ *	conditions:
+ *
+ *	The above copyright notice and this permission notice shall be
+ *	included in all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *	HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *	WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *	OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ *  File: xmldata_t.c
+ *  Date: Oct 18, 2026
+ */
+#include <CUnit/Basic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "xmldata_t.h"
+#include "../Peering/peersession.h"
+#include "../Peering/bgpmessagetypes.h"
+#include "xmlinternal.h"
+#include "../Util/log.h"
+#include "../Util/bgpmon_defaults.h"
+#include <arpa/inet.h>
+
+#define TEST_SESSION_ID 7
+#define TEST_XML_LEN    65536
+
+/* the two conversions write to their own buffers */
+static char streamXML[TEST_XML_LEN];
+static char treeXML[TEST_XML_LEN];
+
+/*
+ * Captured messages, the BGP message body without the 19 byte header.
+ * Together they cover every attribute the streaming serializer writes itself,
+ * a few it hands to the tree, and the message types other than UPDATE.
+ */
+static u_char announceV4[] = {
+  0x00,0x00,                                        // no withdrawn routes
+  0x00,0x40,
+  0x40,0x01,0x01,0x00,                              // ORIGIN IGP
+  0x40,0x02,0x0e,0x02,0x03,0x00,0x00,0xfd,0xe9,     // AS_PATH 65001 3549 4294967294
+  0x00,0x00,0x0d,0xdd,0xff,0xff,0xff,0xfe,
+  0x40,0x03,0x04,0xc0,0x00,0x02,0x01,               // NEXT_HOP
+  0x80,0x04,0x04,0x00,0x00,0x00,0x64,               // MED
+  0x40,0x05,0x04,0x00,0x00,0x00,0xc8,               // LOCAL_PREF
+  0x40,0x06,0x00,                                   // ATOMIC_AGGREGATE
+  0xc0,0x08,0x10,0xfd,0xe9,0x00,0x01,0xff,0xff,     // COMMUNITIES, normal, NO_EXPORT,
+  0xff,0x01,0x00,0x00,0x00,0x05,0xff,0xff,0xff,0x03 //   reserved, NO_EXPORT_SUBCONFED
+  ,
+  0x18,0x0a,0x01,0x02,                              // 10.1.2.0/24
+  0x10,0xac,0x10,                                   // 172.16.0.0/16
+  0x20,0xc0,0x00,0x02,0x01,                         // 192.0.2.1/32
+  0x00                                              // 0.0.0.0/0
+};
+
+static u_char withdrawV4[] = {
+  0x00,0x06,
+  0x18,0x0a,0x01,0x02,                              // 10.1.2.0/24
+  0x08,0x0a,                                        // 10.0.0.0/8
+  0x00,0x00
+};
+
+static u_char announceMP[] = {
+  0x00,0x00,
+  0x00,0x9b,
+  0x40,0x01,0x01,0x02,                              // ORIGIN INCOMPLETE
+  0x50,0x02,0x00,0x10,0x02,0x01,0x00,0x00,0xfd,0xe9,// extended length AS_PATH with
+  0x01,0x02,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x02,//   a trailing AS_SET
+  0x90,0x0e,0x00,0x31,0x00,0x02,0x01,0x20,          // MP_REACH_NLRI IPv6 unicast
+  0x20,0x01,0x0d,0xb8,0,0,0,0,0,0,0,0,0,0,0,0x01,   //   global next hop
+  0xfe,0x80,0,0,0,0,0,0,0,0,0,0,0,0,0,0x01,         //   link local next hop
+  0x00,
+  0x20,0x20,0x01,0x0d,0xb8,                         //   2001:db8::/32
+  0x30,0x20,0x01,0x0d,0xb8,0x00,0x01,               //   2001:db8:1::/48
+  0x80,0x0f,0x09,0x00,0x02,0x01,                    // MP_UNREACH_NLRI IPv6 unicast
+  0x28,0x20,0x01,0x0d,0xb8,0x00,                    //   2001:db8::/40
+  0xc0,0x10,0x08,0x00,0x02,0xfd,0xe9,0x00,0x00,0x00,0x64, // EXTENDED_COMMUNITIES
+  0x80,0x0a,0x04,0x0a,0x00,0x00,0x01,               // CLUSTER_LIST
+  0x80,0x09,0x04,0x0a,0x00,0x00,0x02,               // ORIGINATOR_ID
+  0xc0,0x07,0x06,0xfd,0xe9,0x0a,0x00,0x00,0x03,     // AGGREGATOR
+  0xc0,0x12,0x08,0x00,0x00,0xfd,0xe9,0x0a,0x00,0x00,0x04, // AS4_AGGREGATOR
+  0xc0,0x11,0x06,0x02,0x01,0x00,0x01,0x00,0x01,     // AS4_PATH
+  0xc0,0x63,0x03,0x01,0x02,0x03,                    // unknown attribute
+  0x80,0x0f,0x03,0x00,0x01,0x01                     // empty MP_UNREACH_NLRI, IPv4 end of rib
+};
+
+static u_char endOfRib[] = { 0x00,0x00,0x00,0x00 };
+
+/* the attributes end inside the length of an extended length attribute */
+static u_char truncatedAttr[] = {
+  0x00,0x00,
+  0x00,0x07,
+  0x40,0x01,0x01,0x00,                              // ORIGIN IGP
+  0x90,0x08,0x00                                    // COMMUNITIES, half its length
+};
+
+static u_char originOnly[] = {
+  0x00,0x00,
+  0x00,0x04,
+  0x40,0x01,0x01,0x00                               // ORIGIN IGP
+};
+
+static u_char open[] = {
+  0x04,0xfd,0xe9,0x00,0xb4,0x0a,0x00,0x00,0x01,     // version, AS, hold time, BGP ID
+  0x08,0x02,0x06,0x01,0x04,0x00,0x01,0x00,0x01      // multiprotocol capability
+};
+
+static u_char notification[] = { 0x06,0x02 };
+
+static u_char routeRefresh[] = { 0x00,0x01,0x00,0x01 };
+
+/* one label of each kind, repeated for all prefixes of a message */
+static u_char labels[] = { 3,4,5,6,1,2,0,7,3,4,5,6,1,2,0,7 };
+
+/*
+ * Build a BMF of the given type around a BGP message body,
+ * labeled messages get a label byte per prefix after the message.
+ */
+static BMF
+makeBMF(u_int16_t type, u_int8_t bgpType, u_char *body, int len)
+{
+  BMF bmf = createBMF(TEST_SESSION_ID, type);
+  u_char header[BGP_HEADER_LEN];
+
+  memset(header, 0xff, 16);
+  header[16] = (BGP_HEADER_LEN + len) >> 8;
+  header[17] = (BGP_HEADER_LEN + len) & 0xff;
+  header[18] = bgpType;
+  bgpmonMessageAppend(bmf, header, BGP_HEADER_LEN);
+  if( len > 0 )
+    bgpmonMessageAppend(bmf, body, len);
+  if( type == BMF_TYPE_MSG_LABELED )
+    bgpmonMessageAppend(bmf, labels, sizeof(labels));
+  return bmf;
+}
+
+/* convert with both serializers and expect the same text, with the given sequence number */
+static void
+compareXML(BMF bmf, u_int32_t seq)
+{
+  int streamLen = BMF2XMLSTREAM(bmf, streamXML, TEST_XML_LEN, seq);
+  int treeLen   = BMF2XMLTREE(bmf, treeXML, TEST_XML_LEN, seq);
+  char seqAttr[32];
+  int i;
+
+  sprintf(seqAttr, "seq_num=\"%d\"", seq);
+  CU_ASSERT(streamLen > 0);
+  CU_ASSERT(streamLen == treeLen);
+  CU_ASSERT(strcmp(streamXML, treeXML) == 0);
+  CU_ASSERT(strstr(streamXML, seqAttr) != NULL);
+
+  // name the place the two differ, the messages are too long to log whole
+  for( i = 0; streamXML[i] != '\0' && streamXML[i] == treeXML[i]; i++ )
+    ;
+  if( streamXML[i] != treeXML[i] )
+    log_err("compareXML: message %u differs at byte %d, stream \"%.60s\" tree \"%.60s\"",
+            seq, i, streamXML + i, treeXML + i);
+}
+
+void
+testXML_streamMatchesTree(void){
+
+  u_int16_t types[] = { BMF_TYPE_MSG_FROM_PEER, BMF_TYPE_MSG_LABELED, BMF_TYPE_TABLE_TRANSFER };
+  struct { u_int8_t type; u_char *body; int len; } corpus[] = {
+    { typeUpdate,       announceV4,   sizeof(announceV4)   },
+    { typeUpdate,       withdrawV4,   sizeof(withdrawV4)   },
+    { typeUpdate,       announceMP,   sizeof(announceMP)   },
+    { typeUpdate,       endOfRib,     sizeof(endOfRib)     },
+    { typeOpen,         open,         sizeof(open)         },
+    { typeNotification, notification, sizeof(notification) },
+    { typeKeepalive,    NULL,         0                    },
+    { typeRouteRefresh, routeRefresh, sizeof(routeRefresh) },
+  };
+  int i, j;
+  BMF bmf;
+
+  for( i = 0; i < sizeof(corpus)/sizeof(corpus[0]); i++ ){
+    for( j = 0; j < sizeof(types)/sizeof(types[0]); j++ ){
+      bmf = makeBMF(types[j], corpus[i].type, corpus[i].body, corpus[i].len);
+      compareXML(bmf, i * 10 + j);
+      destroyBMF(bmf);
+    }
+  }
+
+  // a message that does not fit is left to the tree
+  bmf = makeBMF(BMF_TYPE_MSG_LABELED, typeUpdate, announceMP, sizeof(announceMP));
+  CU_ASSERT(BMF2XMLSTREAM(bmf, streamXML, 512, 0) == -1);
+  destroyBMF(bmf);
+
+  // and so are the messages bgpmon generates itself
+  bmf = createBMF(TEST_SESSION_ID, BMF_TYPE_TABLE_STOP);
+  CU_ASSERT(BMF2XMLSTREAM(bmf, streamXML, TEST_XML_LEN, 0) == -1);
+  destroyBMF(bmf);
+}
+
+void
+testXML_messageLen(void){
+
+  char v5[] = "<BGP_MESSAGE len='123' version=\"0.5\"><TIME/>";
+  char none[] = "<BGP_MESSAGE version=\"0.4\"><LENGTH length=\"99\"/>";
+  char open[] = "<BGP_MESSAGE length=\"00000042\"";
+  BMF bmf;
+  int len;
+
+  // the length of a converted message is found in its first bytes
+  bmf = makeBMF(BMF_TYPE_MSG_LABELED, typeUpdate, announceV4, sizeof(announceV4));
+  len = BMF2XMLSTREAM(bmf, streamXML, TEST_XML_LEN, 0);
+  CU_ASSERT(getXMLMessageLen(streamXML, 122) == len);
+  destroyBMF(bmf);
+
+  // v5 messages have len instead of length
+  CU_ASSERT(getXMLMessageLen(v5, strlen(v5)) == 123);
+
+  // only the root element counts, and its open tag has to be complete
+  CU_ASSERT(getXMLMessageLen(none, strlen(none)) == 0);
+  CU_ASSERT(getXMLMessageLen(open, strlen(open)) == 0);
+}
+
+void
+testXML_attrCache(void){
+
+  BMF v4 = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, announceV4, sizeof(announceV4));
+  BMF mp = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, announceMP, sizeof(announceMP));
+  u_char med[sizeof(announceV4)];
+  BMF bmf;
+  int i;
+
+  // the second conversion of a transfer takes its attributes from the cache
+  compareXML(v4, 1);
+  compareXML(v4, 2);
+  compareXML(mp, 3);
+  compareXML(mp, 4);
+
+  // the AS numbers are decoded with the length of the session
+  Sessions[TEST_SESSION_ID]->fsm.ASNumlen = 2;
+  compareXML(v4, 5);
+  compareXML(mp, 6);
+  Sessions[TEST_SESSION_ID]->fsm.ASNumlen = 4;
+
+  // more attributes than the cache holds, each with its own MED, push the first
+  // ones out, they are converted again and nothing of the others leaks into them
+  memcpy(med, announceV4, sizeof(announceV4));
+  for( i = 0; i <= XML_ATTR_CACHE_SETS * XML_ATTR_CACHE_WAYS; i++ ){
+    med[36] = i >> 16;
+    med[37] = i >> 8;
+    med[38] = i;
+    bmf = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, med, sizeof(med));
+    CU_ASSERT(BMF2XMLSTREAM(bmf, streamXML, TEST_XML_LEN, 0) > 0);
+    if( i == 0 || i == XML_ATTR_CACHE_SETS * XML_ATTR_CACHE_WAYS )
+      compareXML(bmf, 7);
+    destroyBMF(bmf);
+  }
+  compareXML(v4, 8);
+  compareXML(mp, 9);
+
+  // only the complete attributes in front of a truncated one are cached, the
+  // ORIGIN alone then comes from the cache
+  bmf = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, truncatedAttr, sizeof(truncatedAttr));
+  compareXML(bmf, 10);
+  destroyBMF(bmf);
+  bmf = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, originOnly, sizeof(originOnly));
+  compareXML(bmf, 11);
+  destroyBMF(bmf);
+
+  destroyBMF(v4);
+  destroyBMF(mp);
+}
+
+/* render transfer messages of a session for a client, as a snapshot flush does */
+static void *
+renderSnapshot(void *arg)
+{
+  BMF bmf = arg;
+  char *xml;
+  int i, len;
+
+  for( i = 0; i < 2000; i++ ){
+    xml = renderClientXML(bmf, &len);
+    CU_ASSERT(xml == NULL || len > 0);
+    free(xml);
+  }
+  return NULL;
+}
+
+/* close the session the tests add, as the rib lane does */
+static void *
+closeSession(void *arg)
+{
+  destroyXMLSession(TEST_SESSION_ID + 1);
+  return NULL;
+}
+
+void
+testXML_closeDuringSnapshot(void){
+
+  Session_structp session = calloc(1, sizeof(struct SessionStruct));
+  pthread_t thread;
+  BMF bmf;
+
+  CU_ASSERT_FATAL(session != NULL);
+  memcpy(session, Sessions[TEST_SESSION_ID], sizeof(struct SessionStruct));
+  session->sessionID = TEST_SESSION_ID + 1;
+  Sessions[TEST_SESSION_ID + 1] = session;
+  bmf = makeBMF(BMF_TYPE_TABLE_TRANSFER, typeUpdate, announceMP, sizeof(announceMP));
+  bmf->sessionID = TEST_SESSION_ID + 1;
+
+  // a session that is read is only destroyed once the reader lets it go
+  lockXMLSessions();
+  CU_ASSERT_FATAL(pthread_create(&thread, NULL, closeSession, NULL) == 0);
+  usleep(10000);
+  CU_ASSERT(Sessions[TEST_SESSION_ID + 1] == session);
+  unlockXMLSessions();
+  pthread_join(thread, NULL);
+  CU_ASSERT(Sessions[TEST_SESSION_ID + 1] == NULL);
+
+  // the session is closed while a client's snapshot is converted, the
+  // conversion keeps it until it is done with the message
+  session = calloc(1, sizeof(struct SessionStruct));
+  CU_ASSERT_FATAL(session != NULL);
+  memcpy(session, Sessions[TEST_SESSION_ID], sizeof(struct SessionStruct));
+  session->sessionID = TEST_SESSION_ID + 1;
+  Sessions[TEST_SESSION_ID + 1] = session;
+  CU_ASSERT_FATAL(pthread_create(&thread, NULL, renderSnapshot, bmf) == 0);
+  usleep(1000);
+  destroyXMLSession(TEST_SESSION_ID + 1);
+  CU_ASSERT(Sessions[TEST_SESSION_ID + 1] == NULL);
+  pthread_join(thread, NULL);
+
+  destroyBMF(bmf);
+}
+
+void
+testXML_encoders(void){
+
+  char text[XML_PREFIX_CHARS+1], expect[XML_PREFIX_CHARS+1];
+  u_int32_t ints[] = { 0, 9, 10, 99, 100, 65535, 999999999, 1000000000, 2147483648u, 4294967295u };
+  u_char v4[][4] = { {0,0,0,0}, {10,1,2,0}, {192,0,2,255}, {255,255,255,255} };
+  u_char v6[][16] = {
+    {0},                                                        // ::
+    {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1},                          // ::1
+    {0x20,0x01,0x0d,0xb8},                                      // 2001:db8::
+    {0x20,0x01,0x0d,0xb8,0,0,0,1,0,0,0,0,0,1,0,0},              // the first of two runs
+    {0x20,0x01,0x0d,0xb8,0,1,0,0,0,1,0,1,0,1,0,1},              // a run of one is not compressed
+    {0,0,0,0,0,0,0,0,0,0,0xff,0xff,192,0,2,1},                  // IPv4 mapped
+    {0,0,0,0,0,0,0,0,0,0,0,0,192,0,2,1},                        // IPv4 compatible
+    {0xfe,0x80,0,0,0,0,0,0,0x02,0x1b,0x21,0xff,0xfe,0x3a,0x0b,0xcd}
+  };
+  u_char octets[40];
+  int i, len;
+
+  for( i = 0; i < sizeof(ints)/sizeof(ints[0]); i++ ){
+    len = xmlEncodeUnsigned(text, ints[i]);
+    CU_ASSERT(len == sprintf(expect, "%u", ints[i]) && !memcmp(text, expect, len));
+    len = xmlEncodeInt(text, (int)ints[i]);
+    CU_ASSERT(len == sprintf(expect, "%d", (int)ints[i]) && !memcmp(text, expect, len));
+  }
+
+  // addresses are written as inet_ntop writes them
+  for( i = 0; i < sizeof(v4)/sizeof(v4[0]); i++ ){
+    text[xmlEncodeIPv4(text, v4[i])] = '\0';
+    inet_ntop(AF_INET, v4[i], expect, sizeof(expect));
+    CU_ASSERT(strcmp(text, expect) == 0);
+  }
+  for( i = 0; i < sizeof(v6)/sizeof(v6[0]); i++ ){
+    text[xmlEncodeIPv6(text, v6[i])] = '\0';
+    inet_ntop(AF_INET6, v6[i], expect, sizeof(expect));
+    CU_ASSERT(strcmp(text, expect) == 0);
+  }
+
+  text[xmlEncodePrefix(text, BGP_AFI_IPv4, v4[1], 24)] = '\0';
+  CU_ASSERT(strcmp(text, "10.1.2.0/24") == 0);
+  text[xmlEncodePrefix(text, BGP_AFI_IPv6, v6[2], 32)] = '\0';
+  CU_ASSERT(strcmp(text, "2001:db8::/32") == 0);
+  CU_ASSERT(xmlEncodePrefix(text, 3, v6[2], 32) == -1);
+
+  // longer than one vector of octets, with a tail
+  for( i = 0; i < sizeof(octets); i++ )
+    octets[i] = i * 37;
+  {
+    char hex[2*sizeof(octets)+1];
+    len = xmlEncodeOctets(hex, octets, sizeof(octets));
+    CU_ASSERT(len == 2*sizeof(octets));
+    for( i = 0; i < sizeof(octets); i++ ){
+      sprintf(expect, "%02X", octets[i]);
+      CU_ASSERT(!memcmp(hex + 2*i, expect, 2));
+    }
+  }
+}
+
+/* The suite initialization function.
+ * Returns zero on success, non-zero otherwise.
+ */
+int init_XMLDATA(void){
+  Session_structp session = calloc(1, sizeof(struct SessionStruct));
+  if( session == NULL )
+    return -1;
+  // a message of a closed session is logged, to stdout
+  init_log("xmldata_t", 0, LOG_ERR, 0);
+  session->sessionID = TEST_SESSION_ID;
+  session->fsm.ASNumlen = 4;
+  strcpy(session->configInUse.remoteAddr, "192.0.2.2");
+  strcpy(session->sessionRealSrcAddr, "2001:db8::1");
+  session->configInUse.remotePort = 179;
+  session->configInUse.localPort = 50000;
+  session->configInUse.remoteAS2 = 65001;
+  session->configInUse.localAS2 = 4200000000u;
+  session->configInUse.remoteBGPID = htonl(0x0a000001);
+  Sessions[TEST_SESSION_ID] = session;
+  return 0;
+}
+
+/* The suite cleanup function.
+ * Returns zero on success, non-zero otherwise.
+ */
+int clean_XMLDATA(void){
+  free(Sessions[TEST_SESSION_ID]);
+  Sessions[TEST_SESSION_ID] = NULL;
+  return 0;
+}
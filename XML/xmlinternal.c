@@ -53,6 +53,11 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+/* needed for the vector hex encoder */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* needed for xml operation tring and math operation */
 #include <libxml/parser.h>
 #include <libxml/tree.h>
@@ -154,6 +159,250 @@ int get_afi(char* addr)
     return afi;
 }
 
+/*----------------------------------------------------------------------------------------
+ * Text encoders
+ * They write the text of numbers, addresses and octets straight into the output and
+ * return its length. They do not add a terminating null, the caller makes room for
+ * the longest text of the value, see XML_*_CHARS in xmlinternal.h.
+ * -------------------------------------------------------------------------------------*/
+
+/* "00" to "99" */
+static const char xmlDigitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char xmlHexDigits[] = "0123456789ABCDEF";
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the decimal text of an unsigned integer
+ * input:   dst   - the output, XML_UINT_CHARS bytes
+ *          value - the integer
+ * Output:  the length of the text
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodeUnsigned(char *dst, u_int32_t value)
+{
+    int len, pos;
+
+    if      ( value < 10 )         len = 1;
+    else if ( value < 100 )        len = 2;
+    else if ( value < 1000 )       len = 3;
+    else if ( value < 10000 )      len = 4;
+    else if ( value < 100000 )     len = 5;
+    else if ( value < 1000000 )    len = 6;
+    else if ( value < 10000000 )   len = 7;
+    else if ( value < 100000000 )  len = 8;
+    else if ( value < 1000000000 ) len = 9;
+    else                           len = 10;
+
+    /* two digits at a time from the end */
+    pos = len;
+    while ( value >= 100 )
+    {
+        u_int32_t pair = (value % 100) * 2;
+        value /= 100;
+        dst[--pos] = xmlDigitPairs[pair + 1];
+        dst[--pos] = xmlDigitPairs[pair];
+    }
+    if ( value >= 10 )
+    {
+        dst[1] = xmlDigitPairs[value * 2 + 1];
+        dst[0] = xmlDigitPairs[value * 2];
+    }
+    else
+        dst[0] = '0' + value;
+    return len;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the decimal text of an integer
+ * input:   dst   - the output, XML_INT_CHARS bytes
+ *          value - the integer
+ * Output:  the length of the text
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodeInt(char *dst, int value)
+{
+    if ( value < 0 )
+    {
+        dst[0] = '-';
+        return 1 + xmlEncodeUnsigned(dst + 1, -(u_int32_t)value);
+    }
+    return xmlEncodeUnsigned(dst, value);
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the upper case hex text of some octets
+ * input:   dst    - the output, 2*len bytes
+ *          octets - the octets
+ *          len    - the number of octets
+ * Output:  the length of the text
+ * NOTE: 16 octets at a time where SSE2 is available
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodeOctets(char *dst, const u_char *octets, int len)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    {
+        const __m128i low   = _mm_set1_epi8(0x0f);
+        const __m128i nine  = _mm_set1_epi8(9);
+        const __m128i zero  = _mm_set1_epi8('0');
+        const __m128i alpha = _mm_set1_epi8('A' - '0' - 10);
+
+        for ( ; i + 16 <= len; i += 16 )
+        {
+            __m128i v  = _mm_loadu_si128((const __m128i *)(octets + i));
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+            __m128i lo = _mm_and_si128(v, low);
+            /* high nibble first, then the digit or letter of each nibble */
+            __m128i a  = _mm_unpacklo_epi8(hi, lo);
+            __m128i b  = _mm_unpackhi_epi8(hi, lo);
+            a = _mm_add_epi8(_mm_add_epi8(a, zero), _mm_and_si128(_mm_cmpgt_epi8(a, nine), alpha));
+            b = _mm_add_epi8(_mm_add_epi8(b, zero), _mm_and_si128(_mm_cmpgt_epi8(b, nine), alpha));
+            _mm_storeu_si128((__m128i *)(dst + 2*i), a);
+            _mm_storeu_si128((__m128i *)(dst + 2*i + 16), b);
+        }
+    }
+#endif
+    for ( ; i < len; i++ )
+    {
+        dst[2*i]   = xmlHexDigits[ octets[i] >> 4 ];
+        dst[2*i+1] = xmlHexDigits[ octets[i] & 15 ];
+    }
+    return 2*len;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the text of an IPv4 address, the same as inet_ntop
+ * input:   dst  - the output, XML_IPV4_CHARS bytes
+ *          addr - the 4 bytes of the address
+ * Output:  the length of the text
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodeIPv4(char *dst, const u_char *addr)
+{
+    int i, len = 0;
+    u_int32_t pair;
+
+    for ( i = 0; i < 4; i++ )
+    {
+        if ( addr[i] >= 100 )
+        {
+            pair = (addr[i] % 100) * 2;
+            dst[len++] = '0' + addr[i] / 100;
+            dst[len++] = xmlDigitPairs[pair];
+            dst[len++] = xmlDigitPairs[pair + 1];
+        }
+        else if ( addr[i] >= 10 )
+        {
+            dst[len++] = xmlDigitPairs[addr[i] * 2];
+            dst[len++] = xmlDigitPairs[addr[i] * 2 + 1];
+        }
+        else
+            dst[len++] = '0' + addr[i];
+        dst[len++] = '.';
+    }
+    return len - 1;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the text of an IPv6 address, the same as inet_ntop
+ * input:   dst  - the output, XML_IPV6_CHARS bytes
+ *          addr - the 16 bytes of the address
+ * Output:  the length of the text
+ * NOTE: the longest run of at least two zero words becomes "::", the first one
+ *       if there are several. IPv4 compatible and mapped addresses end with the
+ *       IPv4 address, as glibc writes them.
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodeIPv6(char *dst, const u_char *addr)
+{
+    static const char hex[] = "0123456789abcdef";
+    u_int16_t words[8];
+    int bestBase = -1, bestLen = 0, curBase = -1, curLen = 0;
+    int i, len = 0;
+
+    for ( i = 0; i < 8; i++ )
+    {
+        words[i] = (addr[2*i] << 8) | addr[2*i+1];
+        if ( words[i] == 0 )
+        {
+            if ( curBase == -1 )
+            {
+                curBase = i;
+                curLen = 0;
+            }
+            curLen++;
+        }
+        else if ( curBase != -1 )
+        {
+            if ( curLen > bestLen )
+            {
+                bestBase = curBase;
+                bestLen = curLen;
+            }
+            curBase = -1;
+        }
+    }
+    if ( curBase != -1 && curLen > bestLen )
+    {
+        bestBase = curBase;
+        bestLen = curLen;
+    }
+    if ( bestLen < 2 )
+        bestBase = -1;
+
+    for ( i = 0; i < 8; i++ )
+    {
+        if ( bestBase != -1 && i >= bestBase && i < bestBase + bestLen )
+        {
+            if ( i == bestBase )
+                dst[len++] = ':';
+            continue;
+        }
+        if ( i != 0 )
+            dst[len++] = ':';
+        if ( i == 6 && bestBase == 0 && (bestLen == 6 || (bestLen == 5 && words[5] == 0xffff)) )
+            return len + xmlEncodeIPv4(dst + len, addr + 12);
+
+        /* the hex digits without the leading zeros */
+        if ( words[i] >= 0x1000 ) dst[len++] = hex[ words[i] >> 12 ];
+        if ( words[i] >= 0x100 )  dst[len++] = hex[ (words[i] >> 8) & 15 ];
+        if ( words[i] >= 0x10 )   dst[len++] = hex[ (words[i] >> 4) & 15 ];
+        dst[len++] = hex[ words[i] & 15 ];
+    }
+    if ( bestBase != -1 && bestBase + bestLen == 8 )
+        dst[len++] = ':';
+    return len;
+}
+
+/*----------------------------------------------------------------------------------------
+ * Purpose: write the text of a prefix, "address/length"
+ * input:   dst  - the output, XML_PREFIX_CHARS bytes
+ *          afi  - the address family, 1:IPv4 or 2:IPv6
+ *          addr - the 4 or 16 bytes of the address, with the bytes past the
+ *                 prefix length set to zero
+ *          bits - the prefix length
+ * Output:  the length of the text or -1 for an unknown address family
+ * -------------------------------------------------------------------------------------*/
+int
+xmlEncodePrefix(char *dst, u_int16_t afi, const u_char *addr, int bits)
+{
+    int len;
+
+    if ( afi == 1 )
+        len = xmlEncodeIPv4(dst, addr);
+    else if ( afi == 2 )
+        len = xmlEncodeIPv6(dst, addr);
+    else
+        return -1;
+    dst[len++] = '/';
+    return len + xmlEncodeInt(dst + len, bits);
+}
+
 /*----------------------------------------------------------------------------------------
  * Purpose: print xml node
  * input:	node - pointer to the xml node
@@ -183,8 +432,7 @@ xmlNodePtr
 xmlNewPropInt(xmlNodePtr node, char *name, int value)
 {
     static char str[XML_TEMP_BUFFER_LEN];
-    memset(str,0,sizeof(str));
-    snprintf(str, XML_TEMP_BUFFER_LEN, "%d", value);
+    str[xmlEncodeInt(str, value)] = '\0';
     xmlNewProp(node, BAD_CAST name, BAD_CAST str);
     return node;
 }
@@ -249,8 +497,7 @@ xmlNewPropGmtTime(xmlNodePtr node,  char *tag, time_t timestamp)
  *--------------------------------------------------------------------------------------*/
 xmlAttrPtr xmlNewPropUnsignedInt(xmlNodePtr node, char *tag, u_int32_t value){
     static char str[XML_TEMP_BUFFER_LEN];
-    memset(str,0,sizeof(str));
-    snprintf( str, XML_TEMP_BUFFER_LEN, "%u", value);
+    str[xmlEncodeUnsigned(str, value)] = '\0';
     return xmlNewProp(node,BAD_CAST tag, BAD_CAST str);
 }
 
@@ -266,21 +513,10 @@ xmlAttrPtr xmlNewPropUnsignedInt(xmlNodePtr node, char *tag, u_int32_t value){
 xmlNodePtr
 xmlNewPropOctets(xmlNodePtr node,char *tag,u_char *octets,int len)
 {
-    static char tmpbuffs[XML_BUFFER_LEN];
     static char hexbuffs[XML_BUFFER_LEN];
-    tmpbuffs[0] = '\0';
-    hexbuffs[0] = '\0';
 
     /* Convert the binary string to hexdecimal ascii string */
-    static char *hex[16] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "A", "B", "C", "D", "E", "F" };
-    int i;
-    for ( i = 0; i < len; i++ )
-    {
-        tmpbuffs[2*i  ] = *hex[ octets[i] >> 4 ];
-        tmpbuffs[2*i+1] = *hex[ octets[i] & 15 ];
-    }
-    strncpy(hexbuffs, tmpbuffs, len*2);
-    hexbuffs[len*2] = '\0'; // terminate the string buffer
+    hexbuffs[xmlEncodeOctets(hexbuffs, octets, len)] = '\0';
 
     xmlNewPropString(node,tag, hexbuffs);
 
@@ -329,8 +565,7 @@ xmlNodePtr
 xmlNewNodeInt(char *tag, int value)
 {
     static char str[XML_TEMP_BUFFER_LEN];
-    memset(str,0,sizeof(str));
-    snprintf(str, XML_TEMP_BUFFER_LEN, "%d", value);
+    str[xmlEncodeInt(str, value)] = '\0';
     return xmlNewNodeString(tag, str);
 }
 
@@ -359,8 +594,7 @@ xmlNodePtr
 xmlNewNodeUnsignedInt(char *tag, u_int32_t value)
 {
     static char str[XML_TEMP_BUFFER_LEN];
-    memset(str,0,sizeof(str));
-    snprintf( str, XML_TEMP_BUFFER_LEN, "%u", value);
+    str[xmlEncodeUnsigned(str, value)] = '\0';
     return xmlNewNodeString(tag, str);
 }
 
@@ -422,11 +656,7 @@ xmlNewNodeIP(char *tag, u_int32_t ip)
 {
     char buf[ADDR_MAX_CHARS];
 
-    if( inet_ntop(AF_INET, &ip, buf, ADDR_MAX_CHARS) == NULL ){
-      log_err("xmlNewNodeIP: unable to create ip address string\n");
-      buf[0] = '\0';
-    }
-
+    buf[xmlEncodeIPv4(buf, (u_char *)&ip)] = '\0';
     return xmlNewNodeString(tag, buf);
 }
 
@@ -491,21 +721,10 @@ xmlNodePtr
 xmlNewNodeOctets(char *tag, u_char *octets, int len)
 {
     xmlNodePtr node = NULL;
-    static char tmpbuffs[XML_BUFFER_LEN];
     static char hexbuffs[XML_BUFFER_LEN];
-    tmpbuffs[0] = '\0';
-    hexbuffs[0] = '\0';
 
     /* Convert the binary string to hexdecimal ascii string */
-    static char *hex[16] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "A", "B", "C", "D", "E", "F" };
-    int i;
-    for ( i = 0; i < len; i++ )
-    {
-        tmpbuffs[2*i  ] = *hex[ octets[i] >> 4 ];
-        tmpbuffs[2*i+1] = *hex[ octets[i] & 15 ];
-    }
-    strncpy(hexbuffs, tmpbuffs, len*2);
-    hexbuffs[len*2] = '\0'; // terminate the string buffer
+    hexbuffs[xmlEncodeOctets(hexbuffs, octets, len)] = '\0';
 
     node = xmlNewNodeString(tag, hexbuffs);
 //Possible Modification: Length attribute on octets is unnecessary.
@@ -40,6 +40,13 @@
 #define XML_BUFFER_LEN      10240000  /* 10M  Bytes - max size of XML buffer, for the whole XML message */
 #define XML_TEMP_BUFFER_LEN 512       /* 512 Bytes  - max size of XML temporary buffer, for a single ascii word, like '128.110.1.1' or '7013' */
 
+/* longest text written by the encoders below */
+#define XML_UINT_CHARS      10        /* '4294967295' */
+#define XML_INT_CHARS       11        /* '-2147483648' */
+#define XML_IPV4_CHARS      15        /* '255.255.255.255' */
+#define XML_IPV6_CHARS      45        /* 'ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255' */
+#define XML_PREFIX_CHARS    (XML_IPV6_CHARS + 1 + XML_INT_CHARS)
+
 /*----------------------------------------------------------------------------------------
  * Purpose: special string concatenation routines that work in linear time 
  * input:   dst - pointer to the destination in the buffer
@@ -84,6 +91,21 @@ replace_str(char *str, char *orig, char *rep);
 int 
 get_afi(char* addr);
 
+/*----------------------------------------------------------------------------------------
+ * Purpose: Text encoders for the values of the xml messages, they write the text into
+ *          dst without a terminating null and return its length
+ * input:   dst   - the output, with room for XML_*_CHARS bytes or 2*len for octets
+ *          value - the value to write
+ * Output:  the length of the text, -1 from xmlEncodePrefix for an unknown afi
+ * NOTE: addresses are written the same as inet_ntop writes them, octets in upper case hex
+ * -------------------------------------------------------------------------------------*/
+/* u_int   */ int xmlEncodeUnsigned(char *dst, u_int32_t value);
+/* Integer */ int xmlEncodeInt     (char *dst, int       value);
+/* Octets  */ int xmlEncodeOctets  (char *dst, const u_char *octets, int len);
+/* IPv4    */ int xmlEncodeIPv4    (char *dst, const u_char *addr);
+/* IPv6    */ int xmlEncodeIPv6    (char *dst, const u_char *addr);
+/* Prefix  */ int xmlEncodePrefix  (char *dst, u_int16_t afi, const u_char *addr, int bits);
+
 /*----------------------------------------------------------------------------------------
  * Purpose: Basic utiliy functions that add a property (attribute) to an existing xml node
  * input:   node  - pointer to the existing xml node
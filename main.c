@@ -63,6 +63,7 @@
 #include "Queues/queue.h"
 #include "Clients/clients.h"
 #include "Mrt/mrt.h"
+#include "Mrt/mrtexport.h"
 #include "Chains/chains.h"
 #include "Labeling/label.h"
 #include "PeriodicEvents/periodic.h"
@@ -367,11 +368,27 @@ main(int argc, char **argv)
 	debug (__FUNCTION__, "Successfully initialized mrt settings.");
 #endif
 
+	// initialize the mrt export settings
+	if (initMrtExportSettings() ) {
+			log_fatal("Unable to initialize mrt export settings");
+	};
+#ifdef DEBUG
+	debug (__FUNCTION__, "Successfully initialized mrt export settings.");
+#endif
+
 	//  initialize chains settings
   	if (initChainsSettings() ) {
 		log_fatal("Unable to initialize chain settings");
 	};
 
+	// initialize the labeling settings
+	if (initLabelingSettings() ) {
+			log_fatal("Unable to initialize labeling settings");
+	};
+#ifdef DEBUG
+	debug (__FUNCTION__, "Successfully initialized labeling settings.");
+#endif
+
 	// initialize the periodic settings
 	if (initPeriodicSettings() ) {
 			log_fatal("Unable to initialize periodic settings");
@@ -379,6 +396,14 @@ main(int argc, char **argv)
 #ifdef DEBUG
 	debug (__FUNCTION__, "Successfully initialized periodic settings.");
 #endif
+
+	// initialize the xml conversion settings
+	if (initXMLSettings() ) {
+			log_fatal("Unable to initialize xml conversion settings");
+	};
+#ifdef DEBUG
+	debug (__FUNCTION__, "Successfully initialized xml conversion settings.");
+#endif
 	
 	// read in the configuration file and change
 	// all relevant settings based on config file
@@ -420,6 +445,9 @@ main(int argc, char **argv)
 	/*create the label queue*/		  
 	labeledQueue = createQueue(copyBMF, sizeOfBMF, LABEL_QUEUE_NAME,FALSE,NULL,NULL);
 
+	/*create the label rib queue for the table transfers*/
+	labeledRibQueue = createQueue(copyBMF, sizeOfBMF, LABEL_RIB_QUEUE_NAME,FALSE,NULL,NULL);
+
   /*create the MRT queue*/
   mrtQueue = createQueue(copyBMF, sizeOfBMF, MRT_QUEUE_NAME,FALSE,
                          peerQueue->queueGroupCond,peerQueue->queueGroupLock);
@@ -427,6 +455,9 @@ main(int argc, char **argv)
 	/*create the xml queue*/
 	xmlUQueue = createQueue(copyXML, sizeOfXML, XML_U_QUEUE_NAME, TRUE,NULL,NULL);
 	xmlRQueue = createQueue(copyXML, sizeOfXML, XML_R_QUEUE_NAME, TRUE,NULL,NULL);	
+
+	/*create the binary stream queue*/
+	bmfStreamQueue = createQueue(copyBMFRecord, sizeOfBMFRecord, BMF_STREAM_QUEUE_NAME, TRUE,NULL,NULL);
 #ifdef DEBUG
         debug(__FUNCTION__, "Created queues!");
 #endif
@@ -458,6 +489,15 @@ main(int argc, char **argv)
 	debug(__FUNCTION__, "Created xml thread!");
 #endif
 
+	// launch the mrt export thread
+#ifdef DEBUG
+	debug(__FUNCTION__, "Creating mrt export thread...");
+#endif
+	launchMrtExportThread();
+#ifdef DEBUG
+	debug(__FUNCTION__, "Created mrt export thread!");
+#endif
+
 
 	// launch the clients control thread
 #ifdef DEBUG
@@ -609,6 +649,23 @@ main(int argc, char **argv)
 				free(clientIDs);
 			}
 
+			// BINARY clients
+			clientcount = getActiveClientsIDs(&clientIDs, CLIENT_LISTENER_BINARY);
+			if(clientcount != -1)
+			{
+				for (i = 0; i < clientcount; i++) 
+				{
+					threadtime = getClientLastAction(clientIDs[i], CLIENT_LISTENER_BINARY);
+					if (difftime(currenttime,threadtime) > THREAD_DEAD_INTERVAL) 
+					{
+						thread_tm = localtime(&threadtime);
+						strftime(threadtime_extended, sizeof(threadtime_extended), "%Y-%m-%dT%H:%M:%SZ", thread_tm);
+						log_warning("Binary Client %d is idle: current time = %s, last client %d thread time = %s", clientIDs[i], currenttime_extended, clientIDs[i], threadtime_extended);
+					}
+				}
+				free(clientIDs);
+			}
+
 		// PEER MODULE
 			for (i=0; i < MAX_SESSION_IDS; i++)
 			{
@@ -646,6 +703,18 @@ main(int argc, char **argv)
 				//closeBgpmon(config_file);
 			}				
 
+		// MRT EXPORT
+			if (isMrtExportEnabled())
+			{
+				threadtime = getMrtExportLastAction();
+				if (difftime(currenttime,threadtime) > THREAD_DEAD_INTERVAL)
+				{
+					thread_tm = localtime(&threadtime);
+					strftime(threadtime_extended, sizeof(threadtime_extended), "%Y-%m-%dT%H:%M:%SZ", thread_tm);
+					log_warning("MRT export is idle: current time = %s, last thread time = %s", currenttime_extended, threadtime_extended);
+				}
+			}
+
 
 		// QUAGGA MODULE
 			// mrt listener
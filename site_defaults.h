@@ -37,6 +37,10 @@
 #define RUN_AS_USER "bgpmon"
 #define RUN_DIR "/usr/local/var/run"
 #define PID_FILE "/usr/local/var/run/bgpmon.pid"
+/* directory of the rib snapshots used to restore the rib tables on restart */
+#define RIB_SNAPSHOT_DIR "/usr/local/var/run/bgpmon"
+/* directory of the rotating MRT update files */
+#define MRT_EXPORT_DIR "/usr/local/var/lib/bgpmon/mrt"
 #define MAX_BACKLOG_SIZE_KB 1048576
 
 /* BGPmon LOGIN SETTINGS AND PARAMETERS */
@@ -168,6 +172,12 @@
 /* CLIENTS_RIB_LISTEN_ADDR is the default addr which the clients control rib module listens on */
 #define CLIENTS_RIB_LISTEN_ADDR "ipv4loopback"
 
+/* CLIENTS_BINARY_LISTEN_PORT is the default port which the clients control binary module listens on */
+#define CLIENTS_BINARY_LISTEN_PORT 50003
+
+/* CLIENTS_BINARY_LISTEN_ADDR is the default addr which the clients control binary module listens on */
+#define CLIENTS_BINARY_LISTEN_ADDR "ipv4loopback"
+
 /* CLIENTS_LISTEN_ENABLED is the default status of clients control module*/
 #define CLIENTS_LISTEN_ENABLED TRUE
 